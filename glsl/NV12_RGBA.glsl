@@ -1,15 +1,14 @@
-#version 110
+#version 130
 uniform sampler2D tex[2];
+uniform mat4 csc;           // Y, Cb, Cr to R, G, B
+in vec2 tex_coord;
+out vec4 frag_color;
 void main()
 {
-    vec2 y_coord = gl_TexCoord[0].xy;
-    float y = texture2D(tex[0], y_coord).r;
-    float cb = texture2D(tex[1], y_coord).r - 0.5;
-    float cr = texture2D(tex[1], y_coord).g - 0.5;
+    vec2 y_coord = tex_coord;
+    float y = texture(tex[0], y_coord).r;
+    float cb = texture(tex[1], y_coord).r;
+    float cr = texture(tex[1], y_coord).g;
 
-    gl_FragColor = vec4(
-        y + 1.4021 * cr,
-        y - 0.34482 * cb - 0.71405 * cr,
-        y + 1.7713 * cb,
-        1.0);
+    frag_color = csc * vec4(y, cb, cr, 1.0);
 }
@@ -0,0 +1,11 @@
+#version 130
+
+uniform sampler2D tex_0;
+uniform mat4 csc;
+in vec2 tex_coord;
+out vec4 frag_color;
+
+void main()
+{
+    frag_color = csc * texture(tex_0, tex_coord);
+}
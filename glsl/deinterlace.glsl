@@ -0,0 +1,63 @@
+#version 130
+uniform sampler2D tex[3];   // current, past and future frames
+uniform vec2 texel_size;    // 1/width, 1/height
+uniform float parity;       // 0.0 for top field, 1.0 for bottom
+uniform int mode;           // 0: bob, 1: temporal, 2: temporal with edge-directed spatial part
+out vec4 frag_color;
+
+vec3 fetch(int k, float x, float line)
+{
+    vec2 coord = vec2(x, line + 0.5) * texel_size;
+    if (k == 0)
+        return texture(tex[0], coord).rgb;
+    if (k == 1)
+        return texture(tex[1], coord).rgb;
+    return texture(tex[2], coord).rgb;
+}
+
+void main()
+{
+    float x = gl_FragCoord.x;
+    float line = floor(gl_FragCoord.y);
+
+    // lines of current field are passed as is
+    if (mod(line, 2.0) == parity) {
+        frag_color = vec4(fetch(0, x, line), 1.0);
+        return;
+    }
+
+    float height = 1.0 / texel_size.y;
+    float above_line = line > 0.0 ? line - 1.0 : line + 1.0;
+    float below_line = line + 1.0 < height ? line + 1.0 : line - 1.0;
+    vec3 above = fetch(0, x, above_line);
+    vec3 below = fetch(0, x, below_line);
+
+    vec3 spatial = (above + below) * 0.5;
+    if (mode == 2) {
+        // edge-line average: interpolate along direction where neighbouring lines match best
+        float best_score = dot(abs(above - below), vec3(1.0));
+        for (int d = -1; d <= 1; d += 2) {
+            vec3 a = fetch(0, x + float(d), above_line);
+            vec3 b = fetch(0, x - float(d), below_line);
+            float score = dot(abs(a - b), vec3(1.0));
+            if (score < best_score) {
+                best_score = score;
+                spatial = (a + b) * 0.5;
+            }
+        }
+    }
+
+    if (mode == 0) {
+        frag_color = vec4(spatial, 1.0);
+        return;
+    }
+
+    // motion adaptive: take missing line from neighbouring fields where picture is static,
+    // fall back to spatial interpolation where it moves
+    vec3 prev = fetch(1, x, line);
+    vec3 next = fetch(2, x, line);
+    vec3 temporal = (prev + next) * 0.5;
+    vec3 diff = abs(prev - next) * 0.5;
+
+    frag_color = vec4(clamp(spatial, temporal - diff, temporal + diff), 1.0);
+}
@@ -0,0 +1,33 @@
+#version 130
+// Expands indexed pictures. Indices with alpha come in tex[0], one or two bytes per pixel,
+// colors come in 256x1 palette in tex[1]
+uniform sampler2D tex[2];
+uniform int mode;           // VdpIndexedFormat of tex[0]
+in vec2 tex_coord;
+out vec4 frag_color;
+
+void main()
+{
+    vec2 texel = texture(tex[0], tex_coord).rg;
+    int index;
+    float alpha;
+
+    if (mode == 3) {            // I8A8
+        index = int(texel.r * 255.0 + 0.5);
+        alpha = texel.g;
+    } else if (mode == 2) {     // A8I8
+        index = int(texel.g * 255.0 + 0.5);
+        alpha = texel.r;
+    } else {
+        int v = int(texel.r * 255.0 + 0.5);
+        if (mode == 1) {        // I4A4, alpha in high nibble
+            index = v & 15;
+            alpha = float(v >> 4) / 15.0;
+        } else {                // A4I4, index in high nibble
+            index = v >> 4;
+            alpha = float(v & 15) / 15.0;
+        }
+    }
+
+    frag_color = vec4(texelFetch(tex[1], ivec2(index, 0), 0).rgb, alpha);
+}
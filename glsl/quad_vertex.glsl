@@ -0,0 +1,29 @@
+#version 130
+// Vertex shader shared by all programs. Unit quad from vertex buffer is placed and textured
+// according to per-quad attributes, which are either constant or sourced per instance
+in vec2 corner;             // (0, 0), (1, 0), (1, 1), (0, 1)
+in vec4 dst_rect;           // x0, y0, x1, y1 in pixels
+in vec4 src_rect;           // x0, y0, x1, y1 in normalized texture coordinates
+in float rotation;          // quarter turns of source, counter-clockwise
+in mat4 colors;             // colors of corners, in the same order as vertices
+uniform vec2 target_size;   // framebuffer size, in pixels
+out vec2 tex_coord;
+out vec4 color;
+
+void main()
+{
+    vec2 pos = mix(dst_rect.xy, dst_rect.zw, corner);
+    gl_Position = vec4(pos / target_size * 2.0 - 1.0, 0.0, 1.0);
+
+    int turns = int(rotation);
+    vec2 t = corner;
+    if (turns == 1)
+        t = vec2(corner.y, 1.0 - corner.x);
+    else if (turns == 2)
+        t = vec2(1.0) - corner;
+    else if (turns == 3)
+        t = vec2(1.0 - corner.y, corner.x);
+    tex_coord = mix(src_rect.xy, src_rect.zw, t);
+
+    color = colors[gl_VertexID];
+}
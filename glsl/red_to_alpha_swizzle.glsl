@@ -1,8 +1,11 @@
-#version 110
+#version 130
 
 uniform sampler2D tex_0;
+in vec2 tex_coord;
+in vec4 color;
+out vec4 frag_color;
 
 void main()
 {
-    gl_FragColor = gl_Color * vec4(1.0, 1.0, 1.0, texture2D(tex_0, gl_TexCoord[0].xy).r);
+    frag_color = color * vec4(1.0, 1.0, 1.0, texture(tex_0, tex_coord).r);
 }
@@ -0,0 +1,43 @@
+#version 130
+uniform sampler2D tex[2];   // source, filter weights
+uniform vec2 src_size;      // source texture size
+uniform vec2 src_origin;    // corner of scaled area in source texture
+uniform float src_length;   // length of scaled area along scaling axis
+uniform vec2 dst_origin;    // corner of destination area in framebuffer
+uniform float dst_length;   // length of destination area along scaling axis
+uniform float taps;
+uniform vec2 axis;          // (1, 0) for horizontal pass, (0, 1) for vertical
+uniform mat4 csc;           // color correction of result
+out vec4 frag_color;
+
+// should match values in scaling-weights.hh
+const float weight_scale = 2.0;
+const float weight_bias = -0.5;
+const float first_tap_bias = 1024.0;
+const int max_taps = 32;
+
+void main()
+{
+    vec2 pos = floor(gl_FragCoord.xy - dst_origin);
+    float out_idx = dot(pos, axis);
+    vec2 across = pos * (vec2(1.0) - axis);
+
+    float weights_x = (out_idx + 0.5) / dst_length;
+    float rows = taps + 1.0;
+    float first = floor(texture(tex[1], vec2(weights_x, 0.5 / rows)).r * 65535.0 + 0.5) -
+                  first_tap_bias;
+
+    vec4 sum = vec4(0.0);
+    for (int k = 0; k < max_taps; k ++) {
+        if (float(k) >= taps)
+            break;
+
+        float w = texture(tex[1], vec2(weights_x, (float(k) + 1.5) / rows)).r *
+                  weight_scale + weight_bias;
+        float idx = clamp(first + float(k), 0.0, src_length - 1.0);
+        vec2 src_pos = src_origin + across + axis * idx + vec2(0.5);
+        sum += w * texture(tex[0], src_pos / src_size);
+    }
+
+    frag_color = csc * sum;
+}
@@ -0,0 +1,11 @@
+#version 130
+
+uniform sampler2D tex_0;
+in vec2 tex_coord;
+in vec4 color;
+out vec4 frag_color;
+
+void main()
+{
+    frag_color = color * texture(tex_0, tex_coord);
+}
@@ -24,14 +24,20 @@
 
 #include "api-bitmap-surface.hh"
 #include "api-device.hh"
+#include "api-output-surface.hh"
+#include "content-hash.hh"
+#include "globals.hh"
 #include "glx-context.hh"
 #include "handle-storage.hh"
 #include "reverse-constant.hh"
 #include "trace.hh"
 #include <GL/gl.h>
+#include <algorithm>
+#include <memory>
 #include <stdlib.h>
 #include <string.h>
 #include <vdpau/vdpau.h>
+#include <vector>
 
 
 using std::shared_ptr;
@@ -44,6 +50,7 @@ Resource::Resource(shared_ptr<vdp::Device::Resource> a_device, VdpRGBAFormat a_r
     , width{a_width}
     , height{a_height}
     , frequently_accessed{a_frequently_accessed}
+    , dirty_region{kBitmapMaxDirtyRects}
 {
     device = a_device;
 
@@ -90,26 +97,41 @@ Resource::Resource(shared_ptr<vdp::Device::Resource> a_device, VdpRGBAFormat a_r
     }
 
     // Frequently accessed bitmaps reside in system memory rather that in GPU texture.
-    dirty = 0;
+    has_last_put = false;
     if (frequently_accessed)
-        bitmap_data.reserve(width * height * bytes_per_pixel);
+        bitmap_data.resize(width * height * bytes_per_pixel);
+
+    atlas_page = nullptr;
+    tex_x = 0;
+    tex_y = 0;
+    tex_width = width;
+    tex_height = height;
 
     GLXThreadLocalContext glc_guard{device};
 
-    glGenTextures(1, &tex_id);
-    glBindTexture(GL_TEXTURE_2D, tex_id);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexImage2D(GL_TEXTURE_2D, 0, gl_internal_format, width, height, 0, gl_format, gl_type,
-                 nullptr);
+    // small bitmaps, like glyphs, share textures, so whole subtitle can be drawn from one
+    if (!global.quirks.avoid_bitmap_atlas && width <= kBitmapAtlasMaxItemSize &&
+        height <= kBitmapAtlasMaxItemSize)
+    {
+        place_into_atlas();
+    } else {
+        glGenTextures(1, &tex_id);
+        glBindTexture(GL_TEXTURE_2D, tex_id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexImage2D(GL_TEXTURE_2D, 0, gl_internal_format, width, height, 0, gl_format, gl_type,
+                     nullptr);
+    }
     glFinish();
 
     const auto gl_error = glGetError();
     if (gl_error != GL_NO_ERROR) {
         // Requested RGBA format was wrong
         traceError("BitmapSurface::Resource::Resource(): texture failure, %d\n", gl_error);
+        if (atlas_page)
+            release_from_atlas();
         throw vdp::generic_error();
     }
 }
@@ -118,7 +140,12 @@ Resource::~Resource()
 {
     try {
         GLXThreadLocalContext glc_guard{device};
-        glDeleteTextures(1, &tex_id);
+
+        if (atlas_page) {
+            release_from_atlas();
+        } else {
+            glDeleteTextures(1, &tex_id);
+        }
 
         const auto gl_error = glGetError();
         if (gl_error != GL_NO_ERROR)
@@ -129,6 +156,162 @@ Resource::~Resource()
     }
 }
 
+void
+Resource::place_into_atlas()
+{
+    const uint32_t padded_width = width + 2 * kBitmapAtlasPadding;
+    const uint32_t padded_height = height + 2 * kBitmapAtlasPadding;
+    auto &pages = device->bitmap_atlas;
+    uint32_t x, y;
+
+    for (auto &page: pages) {
+        if (page->rgba_format != rgba_format)
+            continue;
+
+        if (page->allocator.allocate(padded_width, padded_height, &x, &y)) {
+            atlas_page = page.get();
+            break;
+        }
+    }
+
+    if (!atlas_page) {
+        GLuint page_tex_id;
+        glGenTextures(1, &page_tex_id);
+        glBindTexture(GL_TEXTURE_2D, page_tex_id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexImage2D(GL_TEXTURE_2D, 0, gl_internal_format, kBitmapAtlasPageSize,
+                     kBitmapAtlasPageSize, 0, gl_format, gl_type, nullptr);
+
+        pages.emplace_back(new BitmapAtlasPage{rgba_format, page_tex_id});
+        atlas_page = pages.back().get();
+
+        // bitmap is never larger than a page
+        atlas_page->allocator.allocate(padded_width, padded_height, &x, &y);
+    }
+
+    tex_id = atlas_page->tex_id;
+    tex_x = x + kBitmapAtlasPadding;
+    tex_y = y + kBitmapAtlasPadding;
+    tex_width = kBitmapAtlasPageSize;
+    tex_height = kBitmapAtlasPageSize;
+
+    // place may hold leftovers of a released bitmap. Border is updated along with bitmap
+    // contents later, see upload()
+    const std::vector<char> zeros(padded_width * padded_height * bytes_per_pixel);
+
+    glBindTexture(GL_TEXTURE_2D, tex_id);
+    if (bytes_per_pixel != 4)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, padded_width, padded_height, gl_format, gl_type,
+                    zeros.data());
+
+    if (bytes_per_pixel != 4)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void
+Resource::release_from_atlas()
+{
+    atlas_page->allocator.release(tex_x - kBitmapAtlasPadding, tex_y - kBitmapAtlasPadding);
+
+    if (!atlas_page->allocator.empty())
+        return;
+
+    // one empty page of a format is kept, so a single bitmap created and destroyed over and
+    // over doesn't create a texture each time
+    auto &pages = device->bitmap_atlas;
+    const auto spare = std::find_if(pages.begin(), pages.end(),
+        [this](const std::unique_ptr<BitmapAtlasPage> &page) {
+            return page.get() != atlas_page && page->rgba_format == rgba_format &&
+                   page->allocator.empty();
+        });
+
+    if (spare != pages.end()) {
+        glDeleteTextures(1, &atlas_page->tex_id);
+        pages.erase(std::find_if(pages.begin(), pages.end(),
+            [this](const std::unique_ptr<BitmapAtlasPage> &page) {
+                return page.get() == atlas_page;
+            }));
+    }
+
+    atlas_page = nullptr;
+}
+
+void
+Resource::upload(const VdpRect &rect, const void *data, uint32_t pitch)
+{
+    const uint32_t w = rect.x1 - rect.x0;
+    const uint32_t h = rect.y1 - rect.y0;
+    if (w == 0 || h == 0)
+        return;
+
+    // recorded draws may still need previous contents, including border, and texels next to
+    // changed area, which are picked by linear filtering
+    const uint32_t margin = kBitmapAtlasPadding + 1;
+    const uint32_t ax0 = tex_x + rect.x0;
+    const uint32_t ay0 = tex_y + rect.y0;
+    const VdpRect read_area = {ax0 > margin ? ax0 - margin : 0, ay0 > margin ? ay0 - margin : 0,
+                               tex_x + rect.x1 + margin, tex_y + rect.y1 + margin};
+    vdp::OutputSurface::flush_pending_draws_reading(*device, tex_id, read_area, tex_width,
+                                                    tex_height);
+
+    glBindTexture(GL_TEXTURE_2D, tex_id);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, pitch / bytes_per_pixel);
+
+    if (bytes_per_pixel != 4)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // puts area of data starting at (src_x, src_y) of rect to (x, y) of texture
+    auto put = [&](uint32_t x, uint32_t y, uint32_t put_width, uint32_t put_height,
+                   uint32_t src_x, uint32_t src_y)
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, put_width, put_height, gl_format, gl_type,
+                        static_cast<const char *>(data) + src_y * pitch + src_x * bytes_per_pixel);
+    };
+
+    put(tex_x + rect.x0, tex_y + rect.y0, w, h, 0, 0);
+
+    if (atlas_page) {
+        // border repeats edge texels, so filtering gives the same result as GL_CLAMP_TO_EDGE
+        // of a texture of its own would
+        const bool left = (rect.x0 == 0);
+        const bool top = (rect.y0 == 0);
+        const bool right = (rect.x1 == width);
+        const bool bottom = (rect.y1 == height);
+
+        for (uint32_t p = 1; p <= static_cast<uint32_t>(kBitmapAtlasPadding); p ++) {
+            if (left)
+                put(tex_x - p, tex_y + rect.y0, 1, h, 0, 0);
+            if (right)
+                put(tex_x + width - 1 + p, tex_y + rect.y0, 1, h, w - 1, 0);
+            if (top)
+                put(tex_x + rect.x0, tex_y - p, w, 1, 0, 0);
+            if (bottom)
+                put(tex_x + rect.x0, tex_y + height - 1 + p, w, 1, 0, h - 1);
+
+            for (uint32_t q = 1; q <= static_cast<uint32_t>(kBitmapAtlasPadding); q ++) {
+                if (left && top)
+                    put(tex_x - p, tex_y - q, 1, 1, 0, 0);
+                if (right && top)
+                    put(tex_x + width - 1 + p, tex_y - q, 1, 1, w - 1, 0);
+                if (left && bottom)
+                    put(tex_x - p, tex_y + height - 1 + q, 1, 1, 0, h - 1);
+                if (right && bottom)
+                    put(tex_x + width - 1 + p, tex_y + height - 1 + q, 1, 1, w - 1, h - 1);
+            }
+        }
+    }
+
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+    if (bytes_per_pixel != 4)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
 VdpStatus
 CreateImpl(VdpDevice device_id, VdpRGBAFormat rgba_format, uint32_t width, uint32_t height,
            VdpBool frequently_accessed, VdpBitmapSurface *surface)
@@ -158,6 +341,13 @@ DestroyImpl(VdpBitmapSurface surface_id)
 {
     vdp::ResourceRef<vdp::BitmapSurface::Resource> surface{surface_id};
 
+    {
+        GLXThreadLocalContext glc_guard{surface->device};
+        vdp::OutputSurface::flush_pending_draws_reading(*surface->device, surface->tex_id,
+                                                        surface->texture_area(),
+                                                        surface->tex_width, surface->tex_height);
+    }
+
     ResourceStorage<Resource>::instance().drop(surface_id);
     return VDP_STATUS_OK;
 }
@@ -206,8 +396,33 @@ PutBitsNativeImpl(VdpBitmapSurface surface_id, void const *const *source_data,
     if (destination_rect)
         d_rect = *destination_rect;
 
+    if (global.quirks.dedup_bitmaps) {
+        // renderers tend to resend the same glyphs every frame. Hashing is cheaper than either
+        // copying or uploading, so content unchanged since the last call can be skipped
+        const uint64_t hash = vdp::hash_rect(source_data[0], source_pitches[0],
+                                             (d_rect.x1 - d_rect.x0) * dst_surf->bytes_per_pixel,
+                                             d_rect.y1 - d_rect.y0);
+        const VdpRect &last = dst_surf->last_put_rect;
+        const bool unchanged = dst_surf->has_last_put && dst_surf->last_put_hash == hash &&
+                               last.x0 == d_rect.x0 && last.y0 == d_rect.y0 &&
+                               last.x1 == d_rect.x1 && last.y1 == d_rect.y1;
+
+        auto &stats = dst_surf->device->bitmap_put_stats;
+        stats.puts ++;
+        if (unchanged) {
+            stats.unchanged ++;
+            return VDP_STATUS_OK;
+        }
+
+        dst_surf->has_last_put = true;
+        dst_surf->last_put_rect = d_rect;
+        dst_surf->last_put_hash = hash;
+    }
+
     if (dst_surf->frequently_accessed) {
-        if (d_rect.x0 == 0 && dst_surf->width == d_rect.x1 && source_pitches[0] == d_rect.x1) {
+        if (d_rect.x0 == 0 && dst_surf->width == d_rect.x1 &&
+            source_pitches[0] == d_rect.x1 * dst_surf->bytes_per_pixel)
+        {
             // full width, can copy all lines with a single memcpy
             const size_t bytes_to_copy = (d_rect.x1 - d_rect.x0) * (d_rect.y1 - d_rect.y0) *
                                          dst_surf->bytes_per_pixel;
@@ -226,26 +441,13 @@ PutBitsNativeImpl(VdpBitmapSurface surface_id, void const *const *source_data,
             }
         }
 
-        dst_surf->dirty = true;
+        // only changed areas are uploaded before the bitmap is drawn
+        dst_surf->dirty_region.add(d_rect);
 
     } else {
         GLXThreadLocalContext glc_guard{dst_surf->device};
 
-        glBindTexture(GL_TEXTURE_2D, dst_surf->tex_id);
-        glPixelStorei(GL_UNPACK_ROW_LENGTH,
-                      source_pitches[0] / dst_surf->bytes_per_pixel);
-
-        if (dst_surf->bytes_per_pixel != 4)
-            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-        glTexSubImage2D(GL_TEXTURE_2D, 0, d_rect.x0, d_rect.y0,
-                        d_rect.x1 - d_rect.x0, d_rect.y1 - d_rect.y0,
-                        dst_surf->gl_format, dst_surf->gl_type, source_data[0]);
-        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-
-        if (dst_surf->bytes_per_pixel != 4)
-            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-
+        dst_surf->upload(d_rect, source_data[0], source_pitches[0]);
         glFinish();
 
         const auto gl_error = glGetError();
@@ -26,6 +26,8 @@
 
 #include "api-device.hh"
 #include "api.hh"
+#include "bitmap-atlas.hh"
+#include "dirty-region.hh"
 #include <GL/gl.h>
 #include <vdpau/vdpau.h>
 #include <vector>
@@ -41,17 +43,50 @@ struct Resource: public vdp::GenericResource
     ~Resource();
 
     VdpRGBAFormat   rgba_format;        ///< RGBA format of data stored
-    GLuint          tex_id;             ///< GL texture id
+    GLuint          tex_id;             ///< GL texture id, may be shared with other bitmaps
     uint32_t        width;
     uint32_t        height;
+    BitmapAtlasPage *atlas_page;        ///< atlas page holding the bitmap, or nullptr if bitmap
+                                        ///< has texture of its own
+    uint32_t        tex_x;              ///< position of bitmap in texture
+    uint32_t        tex_y;
+    uint32_t        tex_width;          ///< size of texture
+    uint32_t        tex_height;
     VdpBool         frequently_accessed;///< 1 if surface should be optimized for frequent access
     unsigned int    bytes_per_pixel;    ///< number of bytes per bitmap pixel
     GLuint          gl_internal_format; ///< GL texture format: internal format
     GLuint          gl_format;          ///< GL texture format: preferred external format
     GLuint          gl_type;            ///< GL texture format: pixel type
     std::vector<char>   bitmap_data;    ///< system-memory buffer for frequently accessed bitmaps
-    bool                dirty;          ///< dirty flag. True if system-memory buffer contains data
+    DirtyRegion         dirty_region;   ///< areas where system-memory buffer contains data
                                         ///< newer than GPU texture contents
+    bool                has_last_put;   ///< last_put_rect and last_put_hash are valid
+    VdpRect             last_put_rect;  ///< area updated by last PutBitsNative
+    uint64_t            last_put_hash;  ///< content hash of data passed to last PutBitsNative
+
+    /// area of texture occupied by the bitmap, including atlas border filtering reads
+    VdpRect
+    texture_area() const
+    {
+        const uint32_t border = atlas_page ? kBitmapAtlasPadding : 0;
+        return VdpRect{tex_x - border, tex_y - border, tex_x + width + border,
+                       tex_y + height + border};
+    }
+
+    /// copies rect of bitmap to texture from data, which has pitch bytes between lines. Atlas
+    /// border next to the rect is updated too. Recorded draws still needing previous contents
+    /// are flushed first. Must be called under GLX lock
+    void
+    upload(const VdpRect &rect, const void *data, uint32_t pitch);
+
+private:
+    /// finds place for the bitmap in an atlas page of its format, creating one if needed.
+    /// Must be called under GLX lock
+    void
+    place_into_atlas();
+
+    void
+    release_from_atlas();
 };
 
 VdpBitmapSurfaceQueryCapabilities   QueryCapabilities;
@@ -23,11 +23,132 @@
  */
 
 #include "api-csc-matrix.hh"
+#include <math.h>
 #include <vdpau/vdpau.h>
 
 
 namespace vdp {
 
+void
+compute_csc_matrix(const VdpProcamp *procamp, ColorStandard standard, bool full_range,
+                   VdpCSCMatrix *csc_matrix)
+{
+    // luma coefficients of red and blue
+    float kr, kb;
+    switch (standard) {
+    case ColorStandard::bt601:      kr = 0.299f;  kb = 0.114f;  break;
+    case ColorStandard::bt709:      kr = 0.2126f; kb = 0.0722f; break;
+    case ColorStandard::smpte240m:  kr = 0.212f;  kb = 0.087f;  break;
+    case ColorStandard::bt2020:     kr = 0.2627f; kb = 0.0593f; break;
+    default:                        kr = 0.299f;  kb = 0.114f;  break;
+    }
+    const float kg = 1.0f - kr - kb;
+
+    const float brightness = procamp ? procamp->brightness : 0.0f;
+    const float contrast = procamp ? procamp->contrast : 1.0f;
+    const float saturation = procamp ? procamp->saturation : 1.0f;
+    const float hue = procamp ? procamp->hue : 0.0f;
+
+    // expansion of luma and chroma to [0, 1] and [-0.5, 0.5] respectively
+    const float y_scale = full_range ? 1.0f : 255.0f / 219.0f;
+    const float y_offset = full_range ? 0.0f : 16.0f / 255.0f;
+    const float c_scale = full_range ? 1.0f : 255.0f / 224.0f;
+    const float c_offset = 128.0f / 255.0f;
+
+    // procamp: contrast and brightness are applied to luma, saturation and hue rotate and scale
+    // chroma plane
+    const float ys = contrast * y_scale;
+    const float cs = contrast * saturation * c_scale;
+    const float cb_from_cb = cs * cosf(hue);
+    const float cb_from_cr = -cs * sinf(hue);
+    const float cr_from_cb = cs * sinf(hue);
+    const float cr_from_cr = cs * cosf(hue);
+
+    // R = Y + r_cr * Cr, G = Y + g_cb * Cb + g_cr * Cr, B = Y + b_cb * Cb
+    const float r_cr = 2.0f * (1.0f - kr);
+    const float g_cb = -2.0f * kb * (1.0f - kb) / kg;
+    const float g_cr = -2.0f * kr * (1.0f - kr) / kg;
+    const float b_cb = 2.0f * (1.0f - kb);
+
+    const float rgb_cb[3] = {
+        r_cr * cr_from_cb,
+        g_cb * cb_from_cb + g_cr * cr_from_cb,
+        b_cb * cb_from_cb,
+    };
+    const float rgb_cr[3] = {
+        r_cr * cr_from_cr,
+        g_cb * cb_from_cr + g_cr * cr_from_cr,
+        b_cb * cb_from_cr,
+    };
+
+    VdpCSCMatrix &m = *csc_matrix;
+    for (int k = 0; k < 3; k ++) {
+        m[k][0] = ys;
+        m[k][1] = rgb_cb[k];
+        m[k][2] = rgb_cr[k];
+        m[k][3] = brightness - ys * y_offset - (rgb_cb[k] + rgb_cr[k]) * c_offset;
+    }
+}
+
+void
+compute_csc_correction(const VdpCSCMatrix &target, const VdpCSCMatrix &applied,
+                       VdpCSCMatrix *correction)
+{
+    // inverse of the 3x3 part of applied matrix, by cofactors
+    const auto &a = applied;
+    float inv[3][3];
+    inv[0][0] = a[1][1] * a[2][2] - a[1][2] * a[2][1];
+    inv[0][1] = a[0][2] * a[2][1] - a[0][1] * a[2][2];
+    inv[0][2] = a[0][1] * a[1][2] - a[0][2] * a[1][1];
+    inv[1][0] = a[1][2] * a[2][0] - a[1][0] * a[2][2];
+    inv[1][1] = a[0][0] * a[2][2] - a[0][2] * a[2][0];
+    inv[1][2] = a[0][2] * a[1][0] - a[0][0] * a[1][2];
+    inv[2][0] = a[1][0] * a[2][1] - a[1][1] * a[2][0];
+    inv[2][1] = a[0][1] * a[2][0] - a[0][0] * a[2][1];
+    inv[2][2] = a[0][0] * a[1][1] - a[0][1] * a[1][0];
+
+    const float det = a[0][0] * inv[0][0] + a[0][1] * inv[1][0] + a[0][2] * inv[2][0];
+    for (int r = 0; r < 3; r ++)
+        for (int c = 0; c < 3; c ++)
+            inv[r][c] /= det;
+
+    // correction(x) = target(applied^-1(x)), applied^-1(x) = inv * (x - offset)
+    VdpCSCMatrix &res = *correction;
+    for (int r = 0; r < 3; r ++) {
+        res[r][3] = target[r][3];
+        for (int c = 0; c < 3; c ++) {
+            float v = 0.0f;
+            for (int k = 0; k < 3; k ++)
+                v += target[r][k] * inv[k][c];
+            res[r][c] = v;
+            res[r][3] -= v * a[c][3];
+        }
+    }
+}
+
+bool
+is_identity_csc(const VdpCSCMatrix &m)
+{
+    for (int r = 0; r < 3; r ++) {
+        for (int c = 0; c < 4; c ++) {
+            if (fabsf(m[r][c] - (r == c ? 1.0f : 0.0f)) > 1e-4f)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+void
+csc_matrix_to_gl(const VdpCSCMatrix &m, float gl_matrix[16])
+{
+    for (int c = 0; c < 4; c ++) {
+        for (int r = 0; r < 3; r ++)
+            gl_matrix[c * 4 + r] = m[r][c];
+        gl_matrix[c * 4 + 3] = (c == 3) ? 1.0f : 0.0f;
+    }
+}
+
 VdpStatus
 GenerateCSCMatrix(VdpProcamp *procamp, VdpColorStandard standard, VdpCSCMatrix *csc_matrix)
 {
@@ -36,23 +157,16 @@ GenerateCSCMatrix(VdpProcamp *procamp, VdpColorStandard standard, VdpCSCMatrix *
     if (procamp && VDP_PROCAMP_VERSION != procamp->struct_version)
         return VDP_STATUS_INVALID_VALUE;
 
-    // TODO: do correct matricies calculation
-    VdpCSCMatrix *m = csc_matrix;
+    // VDPAU color standards are for limited range video
     switch (standard) {
     case VDP_COLOR_STANDARD_ITUR_BT_601:
-        (*m)[0][0] = 1.164f; (*m)[0][1] =  0.0f;   (*m)[0][2] =  1.596f; (*m)[0][3] = -222.9f;
-        (*m)[1][0] = 1.164f; (*m)[1][1] = -0.392f; (*m)[1][2] = -0.813f; (*m)[1][3] =  135.6f;
-        (*m)[2][0] = 1.164f; (*m)[2][1] =  2.017f; (*m)[2][2] =  0.0f;   (*m)[2][3] = -276.8f;
+        compute_csc_matrix(procamp, ColorStandard::bt601, false, csc_matrix);
         break;
     case VDP_COLOR_STANDARD_ITUR_BT_709:
-        (*m)[0][0] =  1.0f; (*m)[0][1] =  0.0f;   (*m)[0][2] =  1.402f; (*m)[0][3] = -179.4f;
-        (*m)[1][0] =  1.0f; (*m)[1][1] = -0.344f; (*m)[1][2] = -0.714f; (*m)[1][3] =  135.5f;
-        (*m)[2][0] =  1.0f; (*m)[2][1] =  1.772f; (*m)[2][2] =  0.0f;   (*m)[2][3] = -226.8f;
+        compute_csc_matrix(procamp, ColorStandard::bt709, false, csc_matrix);
         break;
     case VDP_COLOR_STANDARD_SMPTE_240M:
-        (*m)[0][0] =  0.581f; (*m)[0][1] = -0.764f; (*m)[0][2] =  1.576f; (*m)[0][3] = 0.0f;
-        (*m)[1][0] =  0.581f; (*m)[1][1] = -0.991f; (*m)[1][2] = -0.477f; (*m)[1][3] = 0.0f;
-        (*m)[2][0] =  0.581f; (*m)[2][1] =  1.062f; (*m)[2][2] =  0.000f; (*m)[2][3] = 0.0f;
+        compute_csc_matrix(procamp, ColorStandard::smpte240m, false, csc_matrix);
         break;
     default:
         return VDP_STATUS_INVALID_COLOR_STANDARD;
@@ -29,6 +29,36 @@
 
 namespace vdp {
 
+/// color standards conversion matrices can be computed for. VDPAU only has identifiers for the
+/// first three
+enum class ColorStandard
+{
+    bt601,
+    bt709,
+    smpte240m,
+    bt2020,
+};
+
+/// computes matrix converting Y, Cb, Cr normalized to [0, 1] to R, G, B in [0, 1]. Full range
+/// video uses whole [0, 255] for luma, limited one uses [16, 235]. procamp may be nullptr
+void
+compute_csc_matrix(const VdpProcamp *procamp, ColorStandard standard, bool full_range,
+                   VdpCSCMatrix *csc_matrix);
+
+/// computes matrix which converts result of applied matrix to result of target one. Used
+/// when video was already converted to RGB with another matrix
+void
+compute_csc_correction(const VdpCSCMatrix &target, const VdpCSCMatrix &applied,
+                       VdpCSCMatrix *correction);
+
+/// true if matrix doesn't change its input
+bool
+is_identity_csc(const VdpCSCMatrix &m);
+
+/// expands matrix to 4x4 one, in column-major order GL uses. Alpha is passed through
+void
+csc_matrix_to_gl(const VdpCSCMatrix &m, float gl_matrix[16]);
+
 VdpGenerateCSCMatrix GenerateCSCMatrix;
 
 } // namespace vdp
@@ -24,11 +24,20 @@
 
 #include "api-decoder.hh"
 #include "api-video-surface.hh"
+#include "decoder-capture.hh"
+#include "globals.hh"
 #include "glx-context.hh"
 #include "h264-parse.hh"
 #include "handle-storage.hh"
+#include "hevc-parse.hh"
+#include "mpeg2-parse.hh"
 #include "reverse-constant.hh"
 #include "trace.hh"
+#include "vc1-parse.hh"
+#include "worker-pool.hh"
+#include <algorithm>
+#include <chrono>
+#include <iterator>
 #include <stdlib.h>
 #include <string.h>
 
@@ -40,12 +49,376 @@ using std::vector;
 
 namespace vdp { namespace Decoder {
 
+// pictures with that many slices get their slice headers parsed in parallel
+const size_t kParallelSliceParseThreshold = 8;
+
+namespace {
+
+/// Maps VDPAU profile to VA-API one. If there is more advanced profile able to decode the
+/// same streams, stores it in next_profile and returns true.
+///
+/// throws vdp::invalid_decoder_profile for profiles without implementation
+bool
+map_decoder_profile(VdpDecoderProfile profile, VAProfile *va_profile,
+                    VdpDecoderProfile *next_profile)
+{
+    switch (profile) {
+    case VDP_DECODER_PROFILE_MPEG2_SIMPLE:
+        *va_profile = VAProfileMPEG2Simple;
+        *next_profile = VDP_DECODER_PROFILE_MPEG2_MAIN;
+        return true;
+
+    case VDP_DECODER_PROFILE_MPEG2_MAIN:
+        *va_profile = VAProfileMPEG2Main;
+        return false;
+
+    case VDP_DECODER_PROFILE_H264_CONSTRAINED_BASELINE:
+        *va_profile = VAProfileH264ConstrainedBaseline;
+        *next_profile = VDP_DECODER_PROFILE_H264_BASELINE;
+        return true;
+
+    case VDP_DECODER_PROFILE_H264_BASELINE:
+        *va_profile = VAProfileH264Baseline;
+        *next_profile = VDP_DECODER_PROFILE_H264_MAIN;
+        return true;
+
+    case VDP_DECODER_PROFILE_H264_MAIN:
+        *va_profile = VAProfileH264Main;
+        *next_profile = VDP_DECODER_PROFILE_H264_HIGH;
+        return true;
+
+    case VDP_DECODER_PROFILE_H264_HIGH:
+        *va_profile = VAProfileH264High;
+        // there is no more advanced profile
+        return false;
+
+    case VDP_DECODER_PROFILE_VC1_SIMPLE:
+        *va_profile = VAProfileVC1Simple;
+        *next_profile = VDP_DECODER_PROFILE_VC1_MAIN;
+        return true;
+
+    case VDP_DECODER_PROFILE_VC1_MAIN:
+        *va_profile = VAProfileVC1Main;
+        return false;
+
+    case VDP_DECODER_PROFILE_VC1_ADVANCED:
+        // Advanced profile streams may have interlaced pictures, which are not implemented.
+        // It's better to let player choose another decoder than to fail in the middle of stream.
+        throw vdp::invalid_decoder_profile();
+
+    case VDP_DECODER_PROFILE_HEVC_MAIN:
+        *va_profile = VAProfileHEVCMain;
+        *next_profile = VDP_DECODER_PROFILE_HEVC_MAIN_10;
+        return true;
+
+    case VDP_DECODER_PROFILE_HEVC_MAIN_10:
+        *va_profile = VAProfileHEVCMain10;
+        return false;
+
+    default:
+        throw vdp::invalid_decoder_profile();
+    }
+}
+
+uint32_t
+max_decoder_level(VdpDecoderProfile profile)
+{
+    switch (profile) {
+    case VDP_DECODER_PROFILE_MPEG2_SIMPLE:
+    case VDP_DECODER_PROFILE_MPEG2_MAIN:
+        return VDP_DECODER_LEVEL_MPEG2_HL;
+
+    case VDP_DECODER_PROFILE_VC1_SIMPLE:
+        return VDP_DECODER_LEVEL_VC1_SIMPLE_MEDIUM;
+
+    case VDP_DECODER_PROFILE_VC1_MAIN:
+        return VDP_DECODER_LEVEL_VC1_MAIN_HIGH;
+
+    case VDP_DECODER_PROFILE_VC1_ADVANCED:
+        return VDP_DECODER_LEVEL_VC1_ADVANCED_L4;
+
+    case VDP_DECODER_PROFILE_HEVC_MAIN:
+    case VDP_DECODER_PROFILE_HEVC_MAIN_10:
+        return VDP_DECODER_LEVEL_HEVC_5_1;
+
+    default:
+        // VA-API doesn't report levels. TODO: Does underlying libva really support 5.1?
+        return VDP_DECODER_LEVEL_H264_5_1;
+    }
+}
+
+/// finds largest surface size the decoder config supports, or 0x0 if driver doesn't tell
+void
+query_max_dimensions(VADisplay va_dpy, VAConfigID config_id, uint32_t *max_width,
+                     uint32_t *max_height)
+{
+    *max_width = 0;
+    *max_height = 0;
+
+    unsigned int num_attribs = 0;
+    if (vaQuerySurfaceAttributes(va_dpy, config_id, nullptr, &num_attribs) == VA_STATUS_SUCCESS &&
+        num_attribs > 0)
+    {
+        vector<VASurfaceAttrib> attribs(num_attribs);
+
+        if (vaQuerySurfaceAttributes(va_dpy, config_id, attribs.data(), &num_attribs) ==
+            VA_STATUS_SUCCESS)
+        {
+            for (unsigned int k = 0; k < num_attribs; k ++) {
+                if (attribs[k].value.type != VAGenericValueTypeInteger)
+                    continue;
+
+                if (attribs[k].type == VASurfaceAttribMaxWidth)
+                    *max_width = attribs[k].value.value.i;
+                else if (attribs[k].type == VASurfaceAttribMaxHeight)
+                    *max_height = attribs[k].value.value.i;
+            }
+        }
+    }
+}
+
+#if VA_CHECK_VERSION(1, 0, 0)
+/// finds largest picture size the profile supports, leaves arguments intact if driver doesn't
+/// tell
+void
+query_max_picture_size(VADisplay va_dpy, VAProfile va_profile, uint32_t *max_width,
+                       uint32_t *max_height)
+{
+    VAConfigAttrib attribs[2] = {
+        {VAConfigAttribMaxPictureWidth, 0},
+        {VAConfigAttribMaxPictureHeight, 0},
+    };
+
+    if (vaGetConfigAttributes(va_dpy, va_profile, VAEntrypointVLD, attribs, 2) ==
+            VA_STATUS_SUCCESS &&
+        attribs[0].value != VA_ATTRIB_NOT_SUPPORTED &&
+        attribs[1].value != VA_ATTRIB_NOT_SUPPORTED)
+    {
+        *max_width = attribs[0].value;
+        *max_height = attribs[1].value;
+    }
+}
+#endif
+
+/// returns render target formats of decoder config
+uint32_t
+query_rt_formats(VADisplay va_dpy, VAConfigID config_id)
+{
+    VAProfile profile;
+    VAEntrypoint entrypoint;
+    int num_attribs = 0;
+    vector<VAConfigAttrib> attribs(vaMaxNumConfigAttributes(va_dpy));
+
+    if (vaQueryConfigAttributes(va_dpy, config_id, &profile, &entrypoint, attribs.data(),
+                                &num_attribs) != VA_STATUS_SUCCESS)
+    {
+        return 0;
+    }
+
+    for (int k = 0; k < num_attribs; k ++) {
+        if (attribs[k].type == VAConfigAttribRTFormat)
+            return attribs[k].value;
+    }
+
+    // drivers which don't list render target formats support at least 4:2:0
+    return VA_RT_FORMAT_YUV420;
+}
+
+void
+destroy_cached_context(VADisplay va_dpy, vdp::Device::CachedDecoderContext &entry)
+{
+    vaDestroyContext(va_dpy, entry.context_id);
+    vaDestroySurfaces(va_dpy, entry.render_targets.data(), entry.render_targets.size());
+    vaDestroyConfig(va_dpy, entry.config_id);
+}
+
+/// destroys cached contexts which are too old or don't fit into max_size. Entries are only
+/// examined here, so stale ones may linger until next decoder creation or destruction, or until
+/// device is destroyed. Cache mutex must be held.
+void
+evict_cached_contexts(vdp::Device::Resource &device, size_t max_size)
+{
+    auto &cache = device.decoder_cache;
+    const auto now = std::chrono::steady_clock::now();
+    const auto max_age = std::chrono::seconds(vdp::kDecoderCacheMaxAge);
+
+    // entries are ordered by release time, oldest first
+    size_t n_evict = 0;
+    while (n_evict < cache.size() &&
+           (cache.size() - n_evict > max_size || now - cache[n_evict].release_time > max_age))
+    {
+        n_evict ++;
+    }
+
+    for (size_t k = 0; k < n_evict; k ++)
+        destroy_cached_context(device.va_dpy, cache[k]);
+
+    cache.erase(cache.begin(), cache.begin() + n_evict);
+}
+
+/// moves VA objects of matching cached context out of the cache. Returns false on cache miss
+bool
+take_cached_context(vdp::Device::Resource &device, VdpDecoderProfile profile, uint32_t width,
+                    uint32_t height, VAConfigID *config_id, VAContextID *context_id,
+                    vector<VASurfaceID> *render_targets)
+{
+    std::unique_lock<std::mutex> lock{device.decoder_cache_mtx};
+
+    evict_cached_contexts(device, vdp::kDecoderCacheSize);
+
+    auto &cache = device.decoder_cache;
+
+    // most recently released first
+    for (auto it = cache.rbegin(); it != cache.rend(); ++ it) {
+        if (it->profile != profile || it->width != width || it->height != height)
+            continue;
+
+        *config_id = it->config_id;
+        *context_id = it->context_id;
+        *render_targets = std::move(it->render_targets);
+        cache.erase(std::next(it).base());
+
+        return true;
+    }
+
+    return false;
+}
+
+} // anonymous namespace
+
+vector<vdp::Device::DecoderCaps>
+discover_capabilities(VADisplay va_dpy)
+{
+    static const VdpDecoderProfile all_profiles[] = {
+        VDP_DECODER_PROFILE_MPEG2_SIMPLE,
+        VDP_DECODER_PROFILE_MPEG2_MAIN,
+        VDP_DECODER_PROFILE_H264_CONSTRAINED_BASELINE,
+        VDP_DECODER_PROFILE_H264_BASELINE,
+        VDP_DECODER_PROFILE_H264_MAIN,
+        VDP_DECODER_PROFILE_H264_HIGH,
+        VDP_DECODER_PROFILE_VC1_SIMPLE,
+        VDP_DECODER_PROFILE_VC1_MAIN,
+        VDP_DECODER_PROFILE_HEVC_MAIN,
+        VDP_DECODER_PROFILE_HEVC_MAIN_10,
+    };
+
+    vector<VAProfile> va_profile_list(vaMaxNumProfiles(va_dpy));
+    int num_profiles = 0;
+
+    if (vaQueryConfigProfiles(va_dpy, va_profile_list.data(), &num_profiles) !=
+        VA_STATUS_SUCCESS)
+    {
+        traceError("Decoder::discover_capabilities(): can't query VA profiles\n");
+        return {};
+    }
+
+    va_profile_list.resize(num_profiles);
+
+    vector<vdp::Device::DecoderCaps> result;
+
+    for (const auto asked_profile: all_profiles) {
+        VdpDecoderProfile profile = asked_profile;
+        VdpDecoderProfile next_profile = profile;
+        VAProfile va_profile;
+        bool has_next;
+
+        // same fallback to more advanced profiles as in decoder creation
+        do {
+            has_next = map_decoder_profile(profile, &va_profile, &next_profile);
+
+            const bool listed = std::find(va_profile_list.begin(), va_profile_list.end(),
+                                          va_profile) != va_profile_list.end();
+            if (!listed) {
+                profile = next_profile;
+                continue;
+            }
+
+            VAConfigID config_id;
+            if (vaCreateConfig(va_dpy, va_profile, VAEntrypointVLD, nullptr, 0, &config_id) !=
+                VA_STATUS_SUCCESS)
+            {
+                profile = next_profile;
+                continue;
+            }
+
+            const uint32_t rt_format = (asked_profile == VDP_DECODER_PROFILE_HEVC_MAIN_10)
+                                       ? VA_RT_FORMAT_YUV420_10BPP : VA_RT_FORMAT_YUV420;
+
+            if (query_rt_formats(va_dpy, config_id) & rt_format) {
+                vdp::Device::DecoderCaps caps = {};
+
+                caps.profile = asked_profile;
+                caps.decoder_profile = profile;
+                caps.va_profile = va_profile;
+                caps.max_level = max_decoder_level(asked_profile);
+                query_max_dimensions(va_dpy, config_id, &caps.max_width, &caps.max_height);
+#if VA_CHECK_VERSION(1, 0, 0)
+                if (caps.max_width == 0 || caps.max_height == 0) {
+                    query_max_picture_size(va_dpy, va_profile, &caps.max_width,
+                                           &caps.max_height);
+                }
+#endif
+
+                if (caps.max_width == 0 || caps.max_height == 0) {
+                    // driver doesn't tell, so stay on the safe side
+                    caps.max_width = 2048;
+                    caps.max_height = 2048;
+                }
+
+                caps.max_macroblocks = (caps.max_width / 16) * (caps.max_height / 16);
+                result.push_back(caps);
+            }
+
+            vaDestroyConfig(va_dpy, config_id);
+            break;
+
+        } while (has_next);
+    }
+
+    return result;
+}
+
+void
+flush_context_cache(vdp::Device::Resource &device)
+{
+    std::unique_lock<std::mutex> lock{device.decoder_cache_mtx};
+
+    for (auto &entry: device.decoder_cache)
+        destroy_cached_context(device.va_dpy, entry);
+
+    device.decoder_cache.clear();
+}
+
+const vdp::Device::DecoderCaps *
+find_capabilities(const vdp::Device::Resource &device, VdpDecoderProfile profile)
+{
+    for (const auto &caps: device.decoder_caps) {
+        if (caps.profile == profile)
+            return &caps;
+    }
+
+    return nullptr;
+}
+
 Resource::Resource(shared_ptr<vdp::Device::Resource> a_device, VdpDecoderProfile a_profile,
                    uint32_t a_width, uint32_t a_height, uint32_t n_max_references)
     : profile{a_profile}
     , width{a_width}
     , height{a_height}
     , max_references{n_max_references}
+    , config_id{VA_INVALID_ID}
+    , context_id{VA_INVALID_ID}
+    , first_field_surf{VA_INVALID_SURFACE}
+    , vc1_rnd{0}
+    , slice_count_mismatch_logged{false}
+    , asked_profile_{a_profile}
+    , rt_format_{VA_RT_FORMAT_YUV420}
+    , idle_frames_{0}
+    , stats_{}
+    , async_{global.quirks.async_decode != 0}
+    , submitted_seq_{0}
+    , completed_seq_{0}
+    , submit_shutdown_{false}
 {
     device = a_device;
     VADisplay va_dpy = device->va_dpy;
@@ -53,94 +426,433 @@ Resource::Resource(shared_ptr<vdp::Device::Resource> a_device, VdpDecoderProfile
     if (!device->va_available)
         throw vdp::invalid_decoder_profile();
 
-    // initialize free_list. Initially they all free
-    for (int k = 0; k < vdp::kMaxRenderTargets; k ++)
-        free_list.push_back(k);
-
-    VAProfile va_profile;
-    VAStatus status;
-    bool final_try = false;
-    VdpDecoderProfile next_profile = profile;
-
-    // Try to create decoder for asked profile. On failure try to create more advanced one
-    while (not final_try) {
-        profile = next_profile;
-        switch (profile) {
-        case VDP_DECODER_PROFILE_H264_CONSTRAINED_BASELINE:
-            va_profile = VAProfileH264ConstrainedBaseline;
-            render_targets.resize(vdp::kNumRenderTargets);
-            next_profile = VDP_DECODER_PROFILE_H264_BASELINE;
-            break;
+    // Profile was resolved on device creation, falling back to more advanced profiles if
+    // asked one is absent.
+    const auto *caps = find_capabilities(*device, profile);
+    if (!caps) {
+        traceError("Decoder::Resource::Resource(): decoder %s not available\n",
+                   reverse_decoder_profile(profile));
+        throw vdp::invalid_decoder_profile();
+    }
 
-        case VDP_DECODER_PROFILE_H264_BASELINE:
-            va_profile = VAProfileH264Baseline;
-            render_targets.resize(vdp::kNumRenderTargets);
-            next_profile = VDP_DECODER_PROFILE_H264_MAIN;
-            break;
+    profile = caps->decoder_profile;
 
-        case VDP_DECODER_PROFILE_H264_MAIN:
-            va_profile = VAProfileH264Main;
-            render_targets.resize(vdp::kNumRenderTargets);
-            next_profile = VDP_DECODER_PROFILE_H264_HIGH;
-            break;
+    // Main profile streams decoded with Main 10 decoder still fit into 8-bit surfaces, so
+    // it's the asked profile that matters here
+    if (a_profile == VDP_DECODER_PROFILE_HEVC_MAIN_10)
+        rt_format_ = VA_RT_FORMAT_YUV420_10BPP;
 
-        case VDP_DECODER_PROFILE_H264_HIGH:
-            va_profile = VAProfileH264High;
-            render_targets.resize(vdp::kNumRenderTargets);
-            // there is no more advanced profile, so it's final try
-            final_try = true;
-            break;
+    // Create surfaces. All video surfaces created here, rather than in VdpVideoSurfaceCreate.
+    // VAAPI requires surfaces to be bound with context on its creation time, while VDPAU allows
+    // to do it later. So here is a trick: VDP video surfaces get their va_surf dynamically in
+    // DecoderRender.
+    //
+    // Only as many surfaces as stream references require (plus some for the picture being
+    // decoded and ones held by the application) are created upfront. Pool grows on demand.
+
+    const uint32_t n_references = std::max(max_references, 1u);
+
+    base_render_targets_ = std::min(n_references + vdp::kRenderTargetsPipelineDepth,
+                                    static_cast<uint32_t>(vdp::kMaxRenderTargets));
+
+    // Context of recently destroyed decoder with the same parameters is reused as is. Pool may
+    // be larger or smaller than needed, but it's trimmed or grown on demand anyway.
+    if (take_cached_context(*device, asked_profile_, width, height, &config_id, &context_id,
+                            &render_targets))
+    {
+        for (uint32_t k = 0; k < render_targets.size(); k ++)
+            free_list.push_back(k);
+
+        stats_.allocated = render_targets.size();
+        stats_.bytes_allocated = stats_.allocated * render_target_size();
+        stats_.bytes_high_water_mark = stats_.bytes_allocated;
 
-        default:
-            traceError("Decoder::Resource::Resource(): decoder %s not implemented\n",
-                       reverse_decoder_profile(profile));
-            throw vdp::invalid_decoder_profile();
+        if (async_)
+            submit_thread_ = std::thread(&Resource::submission_thread_body, this);
+
+        return;
+    }
+
+    const VAStatus status = vaCreateConfig(va_dpy, caps->va_profile, VAEntrypointVLD, nullptr, 0,
+                                           &config_id);
+    if (status != VA_STATUS_SUCCESS)
+        throw vdp::generic_error();
+
+    try {
+        grow_render_targets(base_render_targets_);
+        recreate_context();
+
+    } catch (...) {
+        if (!render_targets.empty())
+            vaDestroySurfaces(va_dpy, render_targets.data(), render_targets.size());
+
+        vaDestroyConfig(va_dpy, config_id);
+        throw;
+    }
+
+    // initial allocation is not growth
+    stats_.grow_count = 0;
+
+    if (async_)
+        submit_thread_ = std::thread(&Resource::submission_thread_body, this);
+}
+
+Resource::~Resource()
+{
+    try {
+        // queued pictures are submitted before thread exits
+        if (submit_thread_.joinable()) {
+            {
+                std::unique_lock<std::mutex> lock{submit_mtx_};
+                submit_shutdown_ = true;
+            }
+            submit_cv_.notify_all();
+            submit_thread_.join();
+        }
+
+        // Video surfaces keep decoder alive, so by now all render targets are back in the pool
+        if (device->va_available)
+            release_to_cache();
+
+        if (global.quirks.log_stats) {
+            const auto &st = stats_;
+            traceInfo("Decoder %u: %u render targets (%.1f MiB), high-water mark %u surfaces "
+                      "(%.1f MiB), grown %u times, trimmed %u times\n", id, st.allocated,
+                      st.bytes_allocated / 1048576.0, st.high_water_mark,
+                      st.bytes_high_water_mark / 1048576.0, st.grow_count, st.trim_count);
+        }
+
+    } catch (...) {
+        traceError("Decoder::Resource::~Resource(): caught exception\n");
+    }
+}
+
+void
+Resource::release_to_cache()
+{
+    vdp::Device::CachedDecoderContext entry;
+
+    entry.profile = asked_profile_;
+    entry.width = width;
+    entry.height = height;
+    entry.config_id = config_id;
+    entry.context_id = context_id;
+    entry.render_targets = std::move(render_targets);
+    entry.release_time = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock{device->decoder_cache_mtx};
+
+    device->decoder_cache.push_back(std::move(entry));
+    evict_cached_contexts(*device, vdp::kDecoderCacheSize);
+}
+
+uint64_t
+Resource::render_target_size() const
+{
+    // NV12 or P010 is assumed, with dimensions aligned to macroblock size
+    const uint64_t aligned_width = (width + 15) & ~15u;
+    const uint64_t aligned_height = (height + 15) & ~15u;
+    const uint64_t bytes_per_sample = (rt_format_ == VA_RT_FORMAT_YUV420_10BPP) ? 2 : 1;
+
+    return aligned_width * aligned_height * 3 / 2 * bytes_per_sample;
+}
+
+void
+Resource::grow_render_targets(uint32_t count)
+{
+    const VADisplay va_dpy = device->va_dpy;
+    vector<VASurfaceID> new_surfaces(count);
+
+#if VA_CHECK_VERSION(0, 34, 0)
+    const VAStatus status = vaCreateSurfaces(va_dpy, rt_format_, width, height,
+                                             new_surfaces.data(), new_surfaces.size(), nullptr, 0);
+#else
+    const VAStatus status = vaCreateSurfaces(va_dpy, width, height, rt_format_,
+                                             new_surfaces.size(), new_surfaces.data());
+#endif
+    if (status != VA_STATUS_SUCCESS) {
+        traceError("Decoder::Resource::grow_render_targets(): can't create %u surfaces, %s\n",
+                   count, vaErrorStr(status));
+        throw vdp::generic_error();
+    }
+
+    for (const auto va_surf: new_surfaces) {
+        free_list.push_back(render_targets.size());
+        render_targets.push_back(va_surf);
+    }
+
+    stats_.allocated = render_targets.size();
+    stats_.bytes_allocated = stats_.allocated * render_target_size();
+    stats_.bytes_high_water_mark = std::max(stats_.bytes_high_water_mark, stats_.bytes_allocated);
+    stats_.grow_count += 1;
+}
+
+void
+Resource::recreate_context()
+{
+    const VADisplay va_dpy = device->va_dpy;
+
+    // Some drivers only accept surfaces which were passed on context creation, so context is
+    // recreated each time surface set changes. Decoded data lives in surfaces, so no reference
+    // pictures are lost. Previous context is kept until the new one exists, so decoder remains
+    // usable with the previous surface set if creation fails.
+    VAContextID new_context_id;
+    const VAStatus status = vaCreateContext(va_dpy, config_id, width, height, VA_PROGRESSIVE,
+                                            render_targets.data(), render_targets.size(),
+                                            &new_context_id);
+    if (status != VA_STATUS_SUCCESS) {
+        traceError("Decoder::Resource::recreate_context(): vaCreateContext failed, %s\n",
+                   vaErrorStr(status));
+        throw vdp::generic_error();
+    }
+
+    if (context_id != VA_INVALID_ID)
+        vaDestroyContext(va_dpy, context_id);
+
+    context_id = new_context_id;
+}
+
+int32_t
+Resource::acquire_render_target()
+{
+    std::unique_lock<decltype(mtx)> lock{mtx};
+
+    if (free_list.size() == 0) {
+        const uint32_t allocated = render_targets.size();
+        const uint32_t to_add = std::min(static_cast<uint32_t>(vdp::kRenderTargetsGrowStep),
+                                         vdp::kMaxRenderTargets - allocated);
+        if (to_add == 0)
+            return -1;
+
+        drain_submission_queue();
+        GLXLockGuard guard;
+
+        try {
+            grow_render_targets(to_add);
+
+        } catch (const vdp::generic_error &) {
+            return -1;
+        }
+
+        try {
+            recreate_context();
+
+        } catch (const vdp::generic_error &) {
+            // previous context is still there, so get back to the surface set it was made for
+            vaDestroySurfaces(device->va_dpy, render_targets.data() + allocated, to_add);
+            render_targets.resize(allocated);
+            free_list.clear();
+
+            stats_.allocated = render_targets.size();
+            stats_.bytes_allocated = stats_.allocated * render_target_size();
+            stats_.grow_count -= 1;
+            return -1;
+        }
+    }
+
+    const auto idx = free_list.back();
+    free_list.pop_back();
+
+    stats_.in_use = render_targets.size() - free_list.size();
+    stats_.high_water_mark = std::max(stats_.high_water_mark, stats_.in_use);
+    idle_frames_ = 0;
+
+    return idx;
+}
+
+void
+Resource::release_render_target(int32_t idx)
+{
+    std::unique_lock<decltype(mtx)> lock{mtx};
+
+    free_list.push_back(idx);
+    stats_.in_use = render_targets.size() - free_list.size();
+}
+
+void
+Resource::trim_render_targets_if_idle()
+{
+    std::unique_lock<decltype(mtx)> lock{mtx};
+
+    if (render_targets.size() <= base_render_targets_ || free_list.size() == 0) {
+        idle_frames_ = 0;
+        return;
+    }
+
+    idle_frames_ += 1;
+    if (idle_frames_ < static_cast<uint32_t>(vdp::kRenderTargetsTrimDelay))
+        return;
+
+    idle_frames_ = 0;
+
+    // Indices are stored in video surfaces, so only surfaces from the tail can be released.
+    // Stop at the first one which is still in use.
+    std::sort(free_list.begin(), free_list.end());
+
+    uint32_t new_size = render_targets.size();
+    while (new_size > base_render_targets_ && free_list.size() > 0 &&
+           free_list.back() == static_cast<int32_t>(new_size - 1))
+    {
+        free_list.pop_back();
+        new_size -= 1;
+    }
+
+    if (new_size == render_targets.size())
+        return;
+
+    drain_submission_queue();
+    GLXLockGuard guard;
+
+    // Surplus surfaces are destroyed only after context without them exists. Trimming is
+    // optional, so if that fails, pool stays as it was.
+    const uint32_t old_size = render_targets.size();
+    vector<VASurfaceID> surplus(render_targets.begin() + new_size, render_targets.end());
+    render_targets.resize(new_size);
+
+    try {
+        recreate_context();
+
+    } catch (const vdp::generic_error &) {
+        render_targets.insert(render_targets.end(), surplus.begin(), surplus.end());
+        for (uint32_t k = new_size; k < old_size; k ++)
+            free_list.push_back(k);
+
+        return;
+    }
+
+    vaDestroySurfaces(device->va_dpy, surplus.data(), surplus.size());
+
+    stats_.allocated = render_targets.size();
+    stats_.bytes_allocated = stats_.allocated * render_target_size();
+    stats_.trim_count += 1;
+}
+
+RenderTargetStats
+Resource::get_render_target_stats()
+{
+    std::unique_lock<decltype(mtx)> lock{mtx};
+
+    return stats_;
+}
+
+VdpStatus
+Resource::execute_picture(const PictureJob &job)
+{
+    const VADisplay va_dpy = device->va_dpy;
+    GLXLockGuard guard;
+
+    VAStatus status = vaBeginPicture(va_dpy, job.context_id, job.target);
+    if (status != VA_STATUS_SUCCESS)
+        return VDP_STATUS_ERROR;
+
+    // Once begun, picture is ended and created buffers are destroyed whatever fails in between.
+    // Otherwise buffers leak, and context remains in the middle of a picture.
+    vector<VABufferID> buf_ids;
+    buf_ids.reserve(job.buffers.size());
+    bool failed = false;
+
+    for (const auto &buf: job.buffers) {
+        VABufferID buf_id;
+        auto *data = const_cast<uint8_t *>(job.storage.data() + buf.offset);
+
+        status = vaCreateBuffer(va_dpy, job.context_id, buf.type, buf.size, 1, data, &buf_id);
+        if (status != VA_STATUS_SUCCESS) {
+            failed = true;
+            break;
         }
 
-        status = vaCreateConfig(va_dpy, va_profile, VAEntrypointVLD, nullptr, 0,
-                                &config_id);
-        if (status == VA_STATUS_SUCCESS)        // break loop if decoder created
+        buf_ids.push_back(buf_id);
+
+        status = vaRenderPicture(va_dpy, job.context_id, &buf_id, 1);
+        if (status != VA_STATUS_SUCCESS) {
+            failed = true;
             break;
+        }
     }
 
+    status = vaEndPicture(va_dpy, job.context_id);
     if (status != VA_STATUS_SUCCESS)
-        throw vdp::generic_error();
+        failed = true;
 
-    // Create surfaces. All video surfaces created here, rather than in VdpVideoSurfaceCreate.
-    // VAAPI requires surfaces to be bound with context on its creation time, while VDPAU allows
-    // to do it later. So here is a trick: VDP video surfaces get their va_surf dynamically in
-    // DecoderRender.
+    for (const auto buf_id: buf_ids)
+        vaDestroyBuffer(va_dpy, buf_id);
+
+    return failed ? VDP_STATUS_ERROR : VDP_STATUS_OK;
+}
+
+VdpStatus
+Resource::submit_picture(std::unique_ptr<PictureJob> job, uint64_t *seq)
+{
+    job->context_id = context_id;
+
+    if (!async_) {
+        const auto status = execute_picture(*job);
+
+        std::unique_lock<std::mutex> lock{submit_mtx_};
+        submitted_seq_ += 1;
+        completed_seq_ = submitted_seq_;
+        *seq = submitted_seq_;
+
+        return status;
+    }
+
+    std::unique_lock<std::mutex> lock{submit_mtx_};
+
+    // limit amount of memory occupied by pending bitstreams
+    completed_cv_.wait(lock, [this] {
+        return submit_queue_.size() < static_cast<size_t>(vdp::kMaxQueuedPictures);
+    });
+
+    submit_queue_.push_back(std::move(job));
+    submitted_seq_ += 1;
+    *seq = submitted_seq_;
+
+    submit_cv_.notify_one();
+    return VDP_STATUS_OK;
+}
 
-    // TODO: check format of surfaces created
-#if VA_CHECK_VERSION(0, 34, 0)
-    status = vaCreateSurfaces(va_dpy, VA_RT_FORMAT_YUV420, width, height, render_targets.data(),
-                              render_targets.size(), nullptr, 0);
-#else
-    status = vaCreateSurfaces(va_dpy, width, height, VA_RT_FORMAT_YUV420, render_targets.size(),
-                              render_targets.data());
-#endif
-    if (status != VA_STATUS_SUCCESS)
-        throw vdp::generic_error();
+void
+Resource::wait_for_picture(uint64_t seq)
+{
+    std::unique_lock<std::mutex> lock{submit_mtx_};
 
-    status = vaCreateContext(va_dpy, config_id, width, height, VA_PROGRESSIVE,
-                             render_targets.data(), render_targets.size(), &context_id);
+    completed_cv_.wait(lock, [this, seq] { return completed_seq_ >= seq; });
+}
 
-    if (status != VA_STATUS_SUCCESS)
-        throw vdp::generic_error();
+void
+Resource::drain_submission_queue()
+{
+    std::unique_lock<std::mutex> lock{submit_mtx_};
+
+    completed_cv_.wait(lock, [this] { return completed_seq_ >= submitted_seq_; });
 }
 
-Resource::~Resource()
+void
+Resource::submission_thread_body()
 {
-    try {
-        if (device->va_available) {
-            const VADisplay va_dpy = device->va_dpy;
-            vaDestroySurfaces(va_dpy, render_targets.data(), render_targets.size());
-            vaDestroyContext(va_dpy, context_id);
-            vaDestroyConfig(va_dpy, config_id);
+    std::unique_lock<std::mutex> lock{submit_mtx_};
+
+    while (true) {
+        submit_cv_.wait(lock, [this] { return submit_shutdown_ || !submit_queue_.empty(); });
+
+        if (submit_queue_.empty())
+            break;  // shutdown requested and nothing left to do
+
+        auto job = std::move(submit_queue_.front());
+        submit_queue_.pop_front();
+        lock.unlock();
+
+        // there is no one to report errors to, Render has already returned
+        if (execute_picture(*job) != VDP_STATUS_OK) {
+            traceError("Decoder::Resource::submission_thread_body(): failed to submit picture "
+                       "for decoder %u\n", id);
         }
 
-    } catch (...) {
-        traceError("Decoder::Resource::~Resource(): caught exception\n");
+        job.reset();
+        lock.lock();
+
+        completed_seq_ += 1;
+        completed_cv_.notify_all();
     }
 }
 
@@ -156,6 +868,11 @@ CreateImpl(VdpDevice device_id, VdpDecoderProfile profile, uint32_t width, uint3
     auto data = make_shared<Resource>(device, profile, width, height, max_references);
 
     *decoder = ResourceStorage<Resource>::instance().insert(data);
+
+    auto &capture = DecoderCapture::instance();
+    if (capture.enabled())
+        capture.decoder_created(*decoder, profile, width, height, max_references);
+
     return VDP_STATUS_OK;
 }
 
@@ -173,6 +890,11 @@ DestroyImpl(VdpDecoder decoder_id)
     ResourceRef<Resource> decoder{decoder_id};
 
     ResourceStorage<Resource>::instance().drop(decoder_id);
+
+    auto &capture = DecoderCapture::instance();
+    if (capture.enabled())
+        capture.decoder_destroyed(decoder_id);
+
     return VDP_STATUS_OK;
 }
 
@@ -206,6 +928,24 @@ GetParameters(VdpDecoder decoder_id, VdpDecoderProfile *profile, uint32_t *width
     return check_for_exceptions(GetParametersImpl, decoder_id, profile, width, height);
 }
 
+/// makes sure video surface has VA surface from decoder's pool attached
+bool
+bind_render_target(shared_ptr<Resource> &decoder, shared_ptr<vdp::VideoSurface::Resource> surf)
+{
+    if (surf->va_surf != VA_INVALID_SURFACE)
+        return true;
+
+    const auto idx = decoder->acquire_render_target();
+    if (idx < 0)
+        return false;
+
+    surf->decoder = decoder;
+    surf->va_surf = decoder->render_targets[idx];
+    surf->rt_idx  = idx;
+
+    return true;
+}
+
 VdpStatus
 h264_translate_reference_frames(shared_ptr<vdp::VideoSurface::Resource> &dst_surf,
                                 shared_ptr<Resource> &decoder,
@@ -213,17 +953,8 @@ h264_translate_reference_frames(shared_ptr<vdp::VideoSurface::Resource> &dst_sur
                                 const VdpPictureInfoH264 *vdppi)
 {
     // take new VA surface from buffer if needed
-    if (dst_surf->va_surf == VA_INVALID_SURFACE) {
-        if (decoder->free_list.size() == 0)
-            return VDP_STATUS_RESOURCES;
-
-        auto idx = decoder->free_list.back();
-        decoder->free_list.pop_back();
-
-        dst_surf->decoder = decoder;
-        dst_surf->va_surf = decoder->render_targets[idx];
-        dst_surf->rt_idx  = idx;
-    }
+    if (!bind_render_target(decoder, dst_surf))
+        return VDP_STATUS_RESOURCES;
 
     // current frame
     pic_param->CurrPic.picture_id   = dst_surf->va_surf;
@@ -255,17 +986,8 @@ h264_translate_reference_frames(shared_ptr<vdp::VideoSurface::Resource> &dst_sur
         VAPictureH264 *va_ref = &pic_param->ReferenceFrames[k];
 
         // take new VA surface from buffer if needed
-        if (video_surf->va_surf == VA_INVALID_SURFACE) {
-            if (decoder->free_list.size() == 0)
-                return VDP_STATUS_RESOURCES;
-
-            const auto idx = decoder->free_list.back();
-            decoder->free_list.pop_back();
-
-            dst_surf->decoder = decoder;
-            dst_surf->va_surf = decoder->render_targets[idx];
-            dst_surf->rt_idx  = idx;
-        }
+        if (!bind_render_target(decoder, video_surf))
+            return VDP_STATUS_RESOURCES;
 
         va_ref->picture_id = video_surf->va_surf;
         va_ref->frame_idx = vdp_ref->frame_idx;
@@ -304,150 +1026,26 @@ QueryCapabilitiesImpl(VdpDevice device_id, VdpDecoderProfile profile, VdpBool *i
     if (!is_supported || !max_level || !max_macroblocks || !max_width || !max_height)
         return VDP_STATUS_INVALID_POINTER;
 
-    ResourceRef<vdp::Device::Resource> device{device_id};
-
-    set_ptr_val(max_level, 0);
-    set_ptr_val(max_macroblocks, 0);
-    set_ptr_val(max_width, 0);
-    set_ptr_val(max_height, 0);
-    set_ptr_val(is_supported, 0);
-
-    if (!device->va_available)
+    // Capabilities are discovered on device creation and never change afterwards, so device
+    // itself is not locked, only the handle lookup briefly takes the storage mutex. Players
+    // probe all profiles at startup, while decoding may be already going on in other threads.
+    const auto device = ResourceStorage<vdp::Device::Resource>::instance().find(device_id);
+    const auto *caps = find_capabilities(*device, profile);
+
+    if (!caps) {
+        set_ptr_val(is_supported, 0);
+        set_ptr_val(max_level, 0);
+        set_ptr_val(max_macroblocks, 0);
+        set_ptr_val(max_width, 0);
+        set_ptr_val(max_height, 0);
         return VDP_STATUS_OK;
-
-    vector<VAProfile> va_profile_list(vaMaxNumProfiles(device->va_dpy));
-
-    int num_profiles;
-    VAStatus status = vaQueryConfigProfiles(device->va_dpy, va_profile_list.data(),
-                                            &num_profiles);
-    if (status != VA_STATUS_SUCCESS)
-        return VDP_STATUS_ERROR;
-
-    struct {
-        int mpeg2_simple;
-        int mpeg2_main;
-        int h264_baseline;
-        int h264_main;
-        int h264_high;
-        int vc1_simple;
-        int vc1_main;
-        int vc1_advanced;
-    } available_profiles = {};
-
-    for (int k = 0; k < num_profiles; k ++) {
-        switch (va_profile_list[k]) {
-        case VAProfileMPEG2Main:
-            available_profiles.mpeg2_main = 0;
-            // fall through
-
-        case VAProfileMPEG2Simple:
-            available_profiles.mpeg2_simple = 0;
-            break;
-
-        case VAProfileH264High:
-            available_profiles.h264_high = 1;
-            // fall through
-
-        case VAProfileH264Main:
-            available_profiles.h264_main = 1;
-            // fall through
-
-        case VAProfileH264Baseline:
-            available_profiles.h264_baseline = 1;
-            // fall though
-
-        case VAProfileH264ConstrainedBaseline:
-            break;
-
-        case VAProfileVC1Advanced:
-            available_profiles.vc1_advanced = 0;
-            // fall though
-
-        case VAProfileVC1Main:
-            available_profiles.vc1_main = 0;
-            // fall though
-
-        case VAProfileVC1Simple:
-            available_profiles.vc1_simple = 0;
-            break;
-
-        // unhandled profiles
-        case VAProfileH263Baseline:
-        case VAProfileJPEGBaseline:
-        default:
-            // do nothing
-            break;
-        }
     }
 
-    // TODO: How to determine max width and height width libva?
-    set_ptr_val(max_width, 2048);
-    set_ptr_val(max_height, 2048);
-    set_ptr_val(max_macroblocks, 16384);
-
-    switch (profile) {
-    case VDP_DECODER_PROFILE_MPEG2_SIMPLE:
-        set_ptr_val(is_supported, available_profiles.mpeg2_simple);
-        set_ptr_val(max_level, VDP_DECODER_LEVEL_MPEG2_HL);
-        break;
-
-    case VDP_DECODER_PROFILE_MPEG2_MAIN:
-        set_ptr_val(is_supported, available_profiles.mpeg2_main);
-        set_ptr_val(max_level, VDP_DECODER_LEVEL_MPEG2_HL);
-        break;
-
-    case VDP_DECODER_PROFILE_H264_CONSTRAINED_BASELINE:
-        set_ptr_val(is_supported, available_profiles.h264_baseline ||
-                                  available_profiles.h264_main);
-        set_ptr_val(max_level, VDP_DECODER_LEVEL_H264_5_1);
-        break;
-
-    case VDP_DECODER_PROFILE_H264_BASELINE:
-        set_ptr_val(is_supported, available_profiles.h264_baseline);
-        // TODO: Does underlying libva really support 5.1?
-        set_ptr_val(max_level, VDP_DECODER_LEVEL_H264_5_1);
-        break;
-
-    case VDP_DECODER_PROFILE_H264_MAIN:
-        set_ptr_val(is_supported, available_profiles.h264_main);
-        set_ptr_val(max_level, VDP_DECODER_LEVEL_H264_5_1);
-        break;
-
-    case VDP_DECODER_PROFILE_H264_HIGH:
-        set_ptr_val(is_supported, available_profiles.h264_high);
-        set_ptr_val(max_level, VDP_DECODER_LEVEL_H264_5_1);
-        break;
-
-    case VDP_DECODER_PROFILE_VC1_SIMPLE:
-        set_ptr_val(is_supported, available_profiles.vc1_simple);
-        set_ptr_val(max_level, VDP_DECODER_LEVEL_VC1_SIMPLE_MEDIUM);
-        break;
-
-    case VDP_DECODER_PROFILE_VC1_MAIN:
-        set_ptr_val(is_supported, available_profiles.vc1_main);
-        set_ptr_val(max_level, VDP_DECODER_LEVEL_VC1_MAIN_HIGH);
-        break;
-
-    case VDP_DECODER_PROFILE_VC1_ADVANCED:
-        set_ptr_val(is_supported, available_profiles.vc1_advanced);
-        set_ptr_val(max_level, VDP_DECODER_LEVEL_VC1_ADVANCED_L4);
-        break;
-
-    // unsupported
-    case VDP_DECODER_PROFILE_MPEG1:
-    case VDP_DECODER_PROFILE_MPEG4_PART2_SP:
-    case VDP_DECODER_PROFILE_MPEG4_PART2_ASP:
-    case VDP_DECODER_PROFILE_DIVX4_QMOBILE:
-    case VDP_DECODER_PROFILE_DIVX4_MOBILE:
-    case VDP_DECODER_PROFILE_DIVX4_HOME_THEATER:
-    case VDP_DECODER_PROFILE_DIVX4_HD_1080P:
-    case VDP_DECODER_PROFILE_DIVX5_QMOBILE:
-    case VDP_DECODER_PROFILE_DIVX5_MOBILE:
-    case VDP_DECODER_PROFILE_DIVX5_HOME_THEATER:
-    case VDP_DECODER_PROFILE_DIVX5_HD_1080P:
-    default:
-        break;
-    }
+    set_ptr_val(is_supported, 1);
+    set_ptr_val(max_level, caps->max_level);
+    set_ptr_val(max_macroblocks, caps->max_macroblocks);
+    set_ptr_val(max_width, caps->max_width);
+    set_ptr_val(max_height, caps->max_height);
 
     return VDP_STATUS_OK;
 }
@@ -526,8 +1124,6 @@ Render_h264(shared_ptr<Resource> decoder, shared_ptr<vdp::VideoSurface::Resource
             VdpPictureInfo const *picture_info, uint32_t bitstream_buffer_count,
             VdpBitstreamBuffer const *bitstream_buffers)
 {
-    VADisplay va_dpy = decoder->device->va_dpy;
-    VAStatus status;
     const auto *vdppi = static_cast<VdpPictureInfoH264 const *>(picture_info);
 
     // TODO: figure out where to get level
@@ -550,40 +1146,6 @@ Render_h264(shared_ptr<Resource> decoder, shared_ptr<vdp::VideoSurface::Resource
     h264_translate_pic_param(&pic_param, decoder->width, decoder->height, vdppi, level);
     h264_translate_iq_matrix(&iq_matrix, vdppi);
 
-    {
-        GLXLockGuard guard;
-        VABufferID pic_param_buf, iq_matrix_buf;
-
-
-        status = vaCreateBuffer(va_dpy, decoder->context_id, VAPictureParameterBufferType,
-                                sizeof(VAPictureParameterBufferH264), 1, &pic_param,
-                                &pic_param_buf);
-
-        if (status != VA_STATUS_SUCCESS)
-            return VDP_STATUS_ERROR;
-
-        status = vaCreateBuffer(va_dpy, decoder->context_id, VAIQMatrixBufferType,
-                                sizeof(VAIQMatrixBufferH264), 1, &iq_matrix, &iq_matrix_buf);
-        if (status != VA_STATUS_SUCCESS)
-            return VDP_STATUS_ERROR;
-
-        // send data to decoding hardware
-        status = vaBeginPicture(va_dpy, decoder->context_id, dst_surf->va_surf);
-        if (status != VA_STATUS_SUCCESS)
-            return VDP_STATUS_ERROR;
-
-        status = vaRenderPicture(va_dpy, decoder->context_id, &pic_param_buf, 1);
-        if (status != VA_STATUS_SUCCESS)
-            return VDP_STATUS_ERROR;
-
-        status = vaRenderPicture(va_dpy, decoder->context_id, &iq_matrix_buf, 1);
-        if (status != VA_STATUS_SUCCESS)
-            return VDP_STATUS_ERROR;
-
-        vaDestroyBuffer(va_dpy, pic_param_buf);
-        vaDestroyBuffer(va_dpy, iq_matrix_buf);
-    }
-
     // merge bitstream buffers
     vector<uint8_t> merged_bitstream;
 
@@ -601,89 +1163,390 @@ Render_h264(shared_ptr<Resource> decoder, shared_ptr<vdp::VideoSurface::Resource
     // requires bitstream buffers to include slice start code (0x00 0x00 0x01). Those
     // will be used to calculate offsets and sizes of slice data in code below.
 
-    RBSPState st_g{merged_bitstream};      // reference, global state
-    int64_t nal_offset;
+    vector<size_t> nal_offsets;
 
     try {
-        nal_offset = st_g.navigate_to_nal_unit();
+        RBSPState st_g{merged_bitstream};   // used for start code search only
+        size_t pos = 0;
+
+        while (true) {
+            pos += st_g.navigate_to_nal_unit();
+            nal_offsets.push_back(pos);
+        }
 
     } catch (const RBSPState::error &) {
+        // no more start codes
+    }
+
+    if (nal_offsets.size() == 0) {
         traceError("Decoder::Render_h264(): no NAL header\n");
         return VDP_STATUS_ERROR;
     }
 
-    do {
-        VASliceParameterBufferH264 sp_h264 = {};
+    const size_t slice_count = nal_offsets.size();
+    vector<VASliceParameterBufferH264> slice_params(slice_count);
 
-        // make a copy of global rbsp state for using in slice header parser
-        RBSPState st{st_g};
-        int64_t nal_offset_next;
+    // TODO: this may be not entirely true for YUV444
+    // but if we limiting to YUV420, that's ok
+    const int ChromaArrayType = pic_param.seq_fields.bits.chroma_format_idc;
 
-        st.reset_bit_counter();
-
-        try {
-            nal_offset_next = st_g.navigate_to_nal_unit();
-
-        } catch (const RBSPState::error &) {
-            nal_offset_next = -1;
-        }
+    auto parse_slice = [&] (size_t k) {
+        VASliceParameterBufferH264 &sp_h264 = slice_params[k];
 
         // calculate end of current slice. Note (-3). It's slice start code length.
-        const unsigned int end_pos = (nal_offset_next > 0) ? (nal_offset_next - 3)
-                                                           : merged_bitstream.size();
-        sp_h264.slice_data_size     = end_pos - nal_offset;
+        const size_t end_pos = (k + 1 < slice_count) ? (nal_offsets[k + 1] - 3)
+                                                     : merged_bitstream.size();
+        sp_h264 = {};
+        sp_h264.slice_data_size     = end_pos - nal_offsets[k];
         sp_h264.slice_data_offset   = 0;
         sp_h264.slice_data_flag     = VA_SLICE_DATA_FLAG_ALL;
 
-        // TODO: this may be not entirely true for YUV444
-        // but if we limiting to YUV420, that's ok
-        int ChromaArrayType = pic_param.seq_fields.bits.chroma_format_idc;
+        // Header parser reads through a view limited by the slice boundaries. Only bytes
+        // of the header itself are touched, and bit counter starts at the NAL header.
+        RBSPState st{merged_bitstream.data() + nal_offsets[k], sp_h264.slice_data_size};
 
         // parse slice header and use its data to fill slice parameter buffer
         parse_slice_header(st, &pic_param, ChromaArrayType, vdppi->num_ref_idx_l0_active_minus1,
                            vdppi->num_ref_idx_l1_active_minus1, &sp_h264);
+    };
 
-        VABufferID slice_parameters_buf;
+    if (slice_count >= kParallelSliceParseThreshold) {
+        WorkerPool::instance().run(slice_count, parse_slice);
+    } else {
+        for (size_t k = 0; k < slice_count; k ++)
+            parse_slice(k);
+    }
 
-        GLXLockGuard guard;
+    // Everything is translated. Sending to the hardware happens either here, or in the
+    // submission thread, so the picture is packed with copies of all data it refers to.
+    std::unique_ptr<PictureJob> job{new PictureJob};
+
+    job->target = dst_surf->va_surf;
+    job->storage.reserve(sizeof(pic_param) + sizeof(iq_matrix) + merged_bitstream.size() +
+                         slice_count * sizeof(VASliceParameterBufferH264));
+
+    job->add_buffer(VAPictureParameterBufferType, &pic_param, sizeof(pic_param));
+    job->add_buffer(VAIQMatrixBufferType, &iq_matrix, sizeof(iq_matrix));
+
+    for (size_t k = 0; k < slice_count; k ++) {
+        job->add_buffer(VASliceParameterBufferType, &slice_params[k],
+                        sizeof(VASliceParameterBufferH264));
+        job->add_buffer(VASliceDataBufferType, merged_bitstream.data() + nal_offsets[k],
+                        slice_params[k].slice_data_size);
+    }
+
+    const auto status = decoder->submit_picture(std::move(job), &dst_surf->decode_seq);
+    if (status != VDP_STATUS_OK)
+        return status;
+
+    dst_surf->sync_va_to_glx = true;
+    decoder->trim_render_targets_if_idle();
+
+    return VDP_STATUS_OK;
+}
+
+VdpStatus
+Render_mpeg2(shared_ptr<Resource> decoder, shared_ptr<vdp::VideoSurface::Resource> dst_surf,
+             VdpPictureInfo const *picture_info, uint32_t bitstream_buffer_count,
+             VdpBitstreamBuffer const *bitstream_buffers)
+{
+    const auto *vdppi = static_cast<VdpPictureInfoMPEG1Or2 const *>(picture_info);
+
+    if (!bind_render_target(decoder, dst_surf)) {
+        traceError("Decoder::Render_mpeg2(): no surfaces left in buffer\n");
+        return VDP_STATUS_RESOURCES;
+    }
+
+    // reference pictures must have been decoded already, so they have VA surfaces
+    VASurfaceID forward_ref = VA_INVALID_SURFACE;
+    VASurfaceID backward_ref = VA_INVALID_SURFACE;
+
+    if (vdppi->forward_reference != VDP_INVALID_HANDLE) {
+        ResourceRef<vdp::VideoSurface::Resource> ref_surf{vdppi->forward_reference};
+        forward_ref = ref_surf->va_surf;
+    }
+
+    if (vdppi->backward_reference != VDP_INVALID_HANDLE) {
+        ResourceRef<vdp::VideoSurface::Resource> ref_surf{vdppi->backward_reference};
+        backward_ref = ref_surf->va_surf;
+    }
+
+    // Both fields of a frame are decoded into the same surface by consecutive calls. VDPAU
+    // doesn't tell which one goes first, so it's tracked here.
+    bool is_first_field = true;
+
+    if (vdppi->picture_structure != 3) {     // field picture
+        is_first_field = (decoder->first_field_surf != dst_surf->va_surf);
+        decoder->first_field_surf = is_first_field ? dst_surf->va_surf : VA_INVALID_SURFACE;
+    } else {
+        decoder->first_field_surf = VA_INVALID_SURFACE;
+    }
+
+    VAPictureParameterBufferMPEG2 pic_param = {};
+    VAIQMatrixBufferMPEG2 iq_matrix = {};
+
+    mpeg2_translate_pic_param(&pic_param, decoder->width, decoder->height, vdppi, forward_ref,
+                              backward_ref, is_first_field);
+    mpeg2_translate_iq_matrix(&iq_matrix, vdppi);
+
+    vector<uint8_t> merged_bitstream;
+
+    for (uint32_t k = 0; k < bitstream_buffer_count; k ++) {
+        const auto *buf = static_cast<const uint8_t *>(bitstream_buffers[k].bitstream);
+        const auto buf_len = bitstream_buffers[k].bitstream_bytes;
+
+        merged_bitstream.insert(merged_bitstream.end(), buf, buf + buf_len);
+    }
+
+    const auto slice_offsets = mpeg2_find_slices(merged_bitstream.data(),
+                                                 merged_bitstream.size());
+    if (slice_offsets.size() == 0) {
+        traceError("Decoder::Render_mpeg2(): no slice start code\n");
+        return VDP_STATUS_ERROR;
+    }
+
+    // streams which have it usually have it in every picture, and decoding goes on anyway
+    if (slice_offsets.size() != vdppi->slice_count && !decoder->slice_count_mismatch_logged) {
+        traceInfo("Decoder::Render_mpeg2(): %u slices expected, %u found. Further mismatches "
+                  "are not reported\n", vdppi->slice_count,
+                  static_cast<uint32_t>(slice_offsets.size()));
+        decoder->slice_count_mismatch_logged = true;
+    }
+
+    std::unique_ptr<PictureJob> job{new PictureJob};
+
+    job->target = dst_surf->va_surf;
+    job->storage.reserve(sizeof(pic_param) + sizeof(iq_matrix) + merged_bitstream.size() +
+                         slice_offsets.size() * sizeof(VASliceParameterBufferMPEG2));
+
+    job->add_buffer(VAPictureParameterBufferType, &pic_param, sizeof(pic_param));
+    job->add_buffer(VAIQMatrixBufferType, &iq_matrix, sizeof(iq_matrix));
+
+    for (size_t k = 0; k < slice_offsets.size(); k ++) {
+        const size_t end_pos = (k + 1 < slice_offsets.size()) ? slice_offsets[k + 1]
+                                                               : merged_bitstream.size();
+        const uint8_t *slice_data = merged_bitstream.data() + slice_offsets[k];
+        const size_t slice_size = end_pos - slice_offsets[k];
+        VASliceParameterBufferMPEG2 slice_param = {};
+
+        if (!mpeg2_parse_slice_header(slice_data, slice_size, decoder->height, &slice_param)) {
+            traceError("Decoder::Render_mpeg2(): slice %u truncated, skipping\n",
+                       static_cast<uint32_t>(k));
+            continue;
+        }
+
+        job->add_buffer(VASliceParameterBufferType, &slice_param, sizeof(slice_param));
+        job->add_buffer(VASliceDataBufferType, slice_data, slice_size);
+    }
 
-        status = vaCreateBuffer(va_dpy, decoder->context_id, VASliceParameterBufferType,
-                                sizeof(VASliceParameterBufferH264), 1, &sp_h264,
-                                &slice_parameters_buf);
-        if (status != VA_STATUS_SUCCESS)
-            return VDP_STATUS_ERROR;
+    const auto status = decoder->submit_picture(std::move(job), &dst_surf->decode_seq);
+    if (status != VDP_STATUS_OK)
+        return status;
 
-        status = vaRenderPicture(va_dpy, decoder->context_id, &slice_parameters_buf, 1);
-        if (status != VA_STATUS_SUCCESS)
-            return VDP_STATUS_ERROR;
+    dst_surf->sync_va_to_glx = true;
+    decoder->trim_render_targets_if_idle();
+
+    return VDP_STATUS_OK;
+}
+
+VdpStatus
+Render_vc1(shared_ptr<Resource> decoder, shared_ptr<vdp::VideoSurface::Resource> dst_surf,
+           VdpPictureInfo const *picture_info, uint32_t bitstream_buffer_count,
+           VdpBitstreamBuffer const *bitstream_buffers)
+{
+    const auto *vdppi = static_cast<VdpPictureInfoVC1 const *>(picture_info);
+
+    if (!bind_render_target(decoder, dst_surf)) {
+        traceError("Decoder::Render_vc1(): no surfaces left in buffer\n");
+        return VDP_STATUS_RESOURCES;
+    }
+
+    VASurfaceID forward_ref = VA_INVALID_SURFACE;
+    VASurfaceID backward_ref = VA_INVALID_SURFACE;
+
+    if (vdppi->forward_reference != VDP_INVALID_HANDLE) {
+        ResourceRef<vdp::VideoSurface::Resource> ref_surf{vdppi->forward_reference};
+        forward_ref = ref_surf->va_surf;
+    }
 
-        VABufferID slice_buf;
-        status = vaCreateBuffer(va_dpy, decoder->context_id, VASliceDataBufferType,
-                                sp_h264.slice_data_size, 1, merged_bitstream.data() + nal_offset,
-                                &slice_buf);
-        if (status != VA_STATUS_SUCCESS)
-            return VDP_STATUS_ERROR;
+    if (vdppi->backward_reference != VDP_INVALID_HANDLE) {
+        ResourceRef<vdp::VideoSurface::Resource> ref_surf{vdppi->backward_reference};
+        backward_ref = ref_surf->va_surf;
+    }
+
+    // Advanced profile is not advertised, see map_decoder_profile()
+    const uint32_t vc1_profile = (decoder->profile == VDP_DECODER_PROFILE_VC1_SIMPLE)
+                                 ? VC1_PROFILE_SIMPLE : VC1_PROFILE_MAIN;
+
+    vector<uint8_t> merged_bitstream;
 
-        status = vaRenderPicture(va_dpy, decoder->context_id, &slice_buf, 1);
-        if (status != VA_STATUS_SUCCESS)
-            return VDP_STATUS_ERROR;
+    for (uint32_t k = 0; k < bitstream_buffer_count; k ++) {
+        const auto *buf = static_cast<const uint8_t *>(bitstream_buffers[k].bitstream);
+        const auto buf_len = bitstream_buffers[k].bitstream_bytes;
 
-        vaDestroyBuffer(va_dpy, slice_parameters_buf);
-        vaDestroyBuffer(va_dpy, slice_buf);
+        merged_bitstream.insert(merged_bitstream.end(), buf, buf + buf_len);
+    }
 
-        if (nal_offset_next < 0)        // nal_offset_next equals -1 when there is no slice
-            break;                      // start code found. Thus that was the final slice.
-        nal_offset = nal_offset_next;
-    } while (1);
+    VAPictureParameterBufferVC1 pic_param;
+    vector<uint8_t> bitplane;
+    vector<VC1Slice> slices;
 
+    if (!vc1_translate_picture(vdppi, vc1_profile, decoder->width, decoder->height, forward_ref,
+                               backward_ref, merged_bitstream.data(), merged_bitstream.size(),
+                               &decoder->vc1_rnd, &pic_param, &bitplane, &slices))
     {
-        GLXLockGuard guard;
-        status = vaEndPicture(va_dpy, decoder->context_id);
-        if (status != VA_STATUS_SUCCESS)
-            return VDP_STATUS_ERROR;
+        traceError("Decoder::Render_vc1(): can't parse picture header\n");
+        return VDP_STATUS_ERROR;
+    }
+
+    // streams which have it usually have it in every picture, and decoding goes on anyway
+    if (slices.size() != vdppi->slice_count && !decoder->slice_count_mismatch_logged) {
+        traceInfo("Decoder::Render_vc1(): %u slices expected, %u found. Further mismatches "
+                  "are not reported\n", vdppi->slice_count, static_cast<uint32_t>(slices.size()));
+        decoder->slice_count_mismatch_logged = true;
+    }
+
+    std::unique_ptr<PictureJob> job{new PictureJob};
+
+    job->target = dst_surf->va_surf;
+    job->storage.reserve(sizeof(pic_param) + bitplane.size() + merged_bitstream.size() +
+                         slices.size() * sizeof(VASliceParameterBufferVC1));
+
+    job->add_buffer(VAPictureParameterBufferType, &pic_param, sizeof(pic_param));
+
+    if (!bitplane.empty())
+        job->add_buffer(VABitPlaneBufferType, bitplane.data(), bitplane.size());
+
+    for (const auto &slice: slices) {
+        job->add_buffer(VASliceParameterBufferType, &slice.param, sizeof(slice.param));
+        job->add_buffer(VASliceDataBufferType, merged_bitstream.data() + slice.offset,
+                        slice.param.slice_data_size);
+    }
+
+    const auto status = decoder->submit_picture(std::move(job), &dst_surf->decode_seq);
+    if (status != VDP_STATUS_OK)
+        return status;
+
+    dst_surf->sync_va_to_glx = true;
+    decoder->trim_render_targets_if_idle();
+
+    return VDP_STATUS_OK;
+}
+
+VdpStatus
+Render_hevc(shared_ptr<Resource> decoder, shared_ptr<vdp::VideoSurface::Resource> dst_surf,
+            VdpPictureInfo const *picture_info, uint32_t bitstream_buffer_count,
+            VdpBitstreamBuffer const *bitstream_buffers)
+{
+    const auto *vdppi = static_cast<VdpPictureInfoHEVC const *>(picture_info);
+
+    if (!bind_render_target(decoder, dst_surf)) {
+        traceError("Decoder::Render_hevc(): no surfaces left in buffer\n");
+        return VDP_STATUS_RESOURCES;
+    }
+
+    VASurfaceID ref_surfaces[16];
+
+    for (int k = 0; k < 16; k ++) {
+        ref_surfaces[k] = VA_INVALID_SURFACE;
+
+        if (vdppi->RefPics[k] != VDP_INVALID_HANDLE) {
+            ResourceRef<vdp::VideoSurface::Resource> ref_surf{vdppi->RefPics[k]};
+            ref_surfaces[k] = ref_surf->va_surf;
+        }
+    }
+
+    VAPictureParameterBufferHEVC pic_param;
+    VAIQMatrixBufferHEVC iq_matrix;
+
+    hevc_translate_pic_param(&pic_param, vdppi, dst_surf->va_surf, ref_surfaces);
+    hevc_translate_iq_matrix(&iq_matrix, vdppi);
+
+    vector<uint8_t> merged_bitstream;
+
+    for (uint32_t k = 0; k < bitstream_buffer_count; k ++) {
+        const auto *buf = static_cast<const uint8_t *>(bitstream_buffers[k].bitstream);
+        const auto buf_len = bitstream_buffers[k].bitstream_bytes;
+
+        merged_bitstream.insert(merged_bitstream.end(), buf, buf + buf_len);
+    }
+
+    // NAL units are delimited by start codes, same as in H.264
+    vector<size_t> nal_offsets;
+
+    try {
+        RBSPState st_g{merged_bitstream};
+        size_t pos = 0;
+
+        while (true) {
+            pos += st_g.navigate_to_nal_unit();
+            nal_offsets.push_back(pos);
+        }
+
+    } catch (const RBSPState::error &) {
+        // no more start codes
+    }
+
+    // Slice segment headers are parsed one by one, since dependent slice segments inherit
+    // fields of preceding ones.
+    vector<VASliceParameterBufferHEVC> slice_params;
+    vector<size_t> slice_offsets;
+
+    slice_params.reserve(nal_offsets.size());
+
+    for (size_t k = 0; k < nal_offsets.size(); k ++) {
+        const size_t end_pos = (k + 1 < nal_offsets.size()) ? (nal_offsets[k + 1] - 3)
+                                                             : merged_bitstream.size();
+        const uint8_t *nal_data = merged_bitstream.data() + nal_offsets[k];
+        const size_t nal_size = end_pos - nal_offsets[k];
+
+        if (!hevc_is_slice_nal_unit(nal_data, nal_size))
+            continue;
+
+        VASliceParameterBufferHEVC sp;
+        const auto *prev = slice_params.empty() ? nullptr : &slice_params.back();
+
+        if (!hevc_parse_slice_header(nal_data, nal_size, vdppi, prev, &sp)) {
+            traceError("Decoder::Render_hevc(): malformed slice segment header, skipping\n");
+            continue;
+        }
+
+        slice_params.push_back(sp);
+        slice_offsets.push_back(nal_offsets[k]);
+    }
+
+    if (slice_params.empty()) {
+        traceError("Decoder::Render_hevc(): no slice segments\n");
+        return VDP_STATUS_ERROR;
+    }
+
+    slice_params.back().LongSliceFlags.fields.LastSliceOfPic = 1;
+
+    std::unique_ptr<PictureJob> job{new PictureJob};
+
+    job->target = dst_surf->va_surf;
+    job->storage.reserve(sizeof(pic_param) + sizeof(iq_matrix) + merged_bitstream.size() +
+                         slice_params.size() * sizeof(VASliceParameterBufferHEVC));
+
+    job->add_buffer(VAPictureParameterBufferType, &pic_param, sizeof(pic_param));
+
+    if (vdppi->scaling_list_enabled_flag)
+        job->add_buffer(VAIQMatrixBufferType, &iq_matrix, sizeof(iq_matrix));
+
+    for (size_t k = 0; k < slice_params.size(); k ++) {
+        job->add_buffer(VASliceParameterBufferType, &slice_params[k],
+                        sizeof(VASliceParameterBufferHEVC));
+        job->add_buffer(VASliceDataBufferType, merged_bitstream.data() + slice_offsets[k],
+                        slice_params[k].slice_data_size);
     }
 
+    const auto status = decoder->submit_picture(std::move(job), &dst_surf->decode_seq);
+    if (status != VDP_STATUS_OK)
+        return status;
+
     dst_surf->sync_va_to_glx = true;
+    decoder->trim_render_targets_if_idle();
+
     return VDP_STATUS_OK;
 }
 
@@ -697,6 +1560,12 @@ RenderImpl(VdpDecoder decoder_id, VdpVideoSurface target, VdpPictureInfo const *
     ResourceRef<Resource> decoder{decoder_id};
     ResourceRef<vdp::VideoSurface::Resource> dst_surf{target};
 
+    auto &capture = DecoderCapture::instance();
+    if (capture.enabled()) {
+        capture.picture_rendered(decoder_id, target, decoder->profile, picture_info,
+                                 bitstream_buffer_count, bitstream_buffers);
+    }
+
     if (decoder->profile == VDP_DECODER_PROFILE_H264_CONSTRAINED_BASELINE ||
         decoder->profile == VDP_DECODER_PROFILE_H264_BASELINE ||
         decoder->profile == VDP_DECODER_PROFILE_H264_MAIN ||
@@ -704,6 +1573,24 @@ RenderImpl(VdpDecoder decoder_id, VdpVideoSurface target, VdpPictureInfo const *
     {
         // TODO: check exit code
         Render_h264(decoder, dst_surf, picture_info, bitstream_buffer_count, bitstream_buffers);
+    } else
+    if (decoder->profile == VDP_DECODER_PROFILE_MPEG2_SIMPLE ||
+        decoder->profile == VDP_DECODER_PROFILE_MPEG2_MAIN)
+    {
+        return Render_mpeg2(decoder, dst_surf, picture_info, bitstream_buffer_count,
+                            bitstream_buffers);
+    } else
+    if (decoder->profile == VDP_DECODER_PROFILE_VC1_SIMPLE ||
+        decoder->profile == VDP_DECODER_PROFILE_VC1_MAIN)
+    {
+        return Render_vc1(decoder, dst_surf, picture_info, bitstream_buffer_count,
+                          bitstream_buffers);
+    } else
+    if (decoder->profile == VDP_DECODER_PROFILE_HEVC_MAIN ||
+        decoder->profile == VDP_DECODER_PROFILE_HEVC_MAIN_10)
+    {
+        return Render_hevc(decoder, dst_surf, picture_info, bitstream_buffer_count,
+                           bitstream_buffers);
     } else {
         traceError("Decoder::RenderImpl(): no implementation for profile %s\n",
                    reverse_decoder_profile(decoder->profile));
@@ -24,9 +24,14 @@
 
 #pragma once
 
+#include "api-device.hh"
 #include "api.hh"
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <stdint.h>
+#include <thread>
 #include <va/va.h>
 #include <vdpau/vdpau.h>
 #include <vector>
@@ -34,6 +39,43 @@
 
 namespace vdp { namespace Decoder {
 
+struct RenderTargetStats
+{
+    uint32_t    allocated;          ///< VA surfaces currently allocated
+    uint32_t    in_use;             ///< VA surfaces currently bound to video surfaces
+    uint32_t    high_water_mark;    ///< maximum of in_use seen so far
+    uint64_t    bytes_allocated;    ///< estimated memory occupied by allocated surfaces
+    uint64_t    bytes_high_water_mark;  ///< maximum of bytes_allocated seen so far
+    uint32_t    grow_count;         ///< times pool was grown
+    uint32_t    trim_count;         ///< times pool was trimmed
+};
+
+/// VA-API buffers of a single picture, translated and ready to be sent to the hardware
+struct PictureJob
+{
+    struct Buffer
+    {
+        VABufferType    type;
+        size_t          offset;     ///< offset of buffer contents in storage
+        size_t          size;
+    };
+
+    /// copies buffer contents. Buffers are rendered in order they were added
+    void
+    add_buffer(VABufferType type, const void *data, size_t size)
+    {
+        const auto *bytes = static_cast<const uint8_t *>(data);
+
+        buffers.push_back(Buffer{type, storage.size(), size});
+        storage.insert(storage.end(), bytes, bytes + size);
+    }
+
+    VASurfaceID             target;     ///< surface to decode into
+    VAContextID             context_id;
+    std::vector<Buffer>     buffers;
+    std::vector<uint8_t>    storage;
+};
+
 struct Resource: public vdp::GenericResource
 {
     Resource(std::shared_ptr<vdp::Device::Resource> a_device, VdpDecoderProfile a_profile,
@@ -41,6 +83,31 @@ struct Resource: public vdp::GenericResource
 
     ~Resource();
 
+    /// takes free VA surface, growing the pool if needed. Returns index in render_targets, or
+    /// -1 if pool can't grow anymore
+    int32_t
+    acquire_render_target();
+
+    /// returns VA surface back to the pool. Called by video surfaces
+    void
+    release_render_target(int32_t idx);
+
+    /// releases surplus surfaces if they were unused for a long time. Called after each picture
+    void
+    trim_render_targets_if_idle();
+
+    RenderTargetStats
+    get_render_target_stats();
+
+    /// sends picture to the hardware. In asynchronous mode picture is only queued, and errors
+    /// are reported to the log. Sets seq to the sequence number of the picture
+    VdpStatus
+    submit_picture(std::unique_ptr<PictureJob> job, uint64_t *seq);
+
+    /// blocks until picture with given sequence number is handed to the hardware
+    void
+    wait_for_picture(uint64_t seq);
+
     VdpDecoderProfile   profile;        ///< decoder profile
     uint32_t            width;
     uint32_t            height;
@@ -50,8 +117,63 @@ struct Resource: public vdp::GenericResource
 
     std::vector<VASurfaceID>    render_targets; ///< spare VA surfaces
     std::vector<int32_t>        free_list;
+    VASurfaceID                 first_field_surf;   ///< field picture awaiting its second field
+    uint8_t                     vc1_rnd;    ///< VC-1 simple/main rounding control state
+    bool                        slice_count_mismatch_logged;    ///< reported once per decoder
+
+private:
+    void
+    grow_render_targets(uint32_t count);
+
+    void
+    recreate_context();
+
+    uint64_t
+    render_target_size() const;
+
+    VdpStatus
+    execute_picture(const PictureJob &job);
+
+    void
+    submission_thread_body();
+
+    /// waits for all queued pictures. Must be called before VA context is recreated
+    void
+    drain_submission_queue();
+
+    /// puts VA objects into device cache instead of destroying them
+    void
+    release_to_cache();
+
+    VdpDecoderProfile   asked_profile_;         ///< profile asked by application, a cache key
+    uint32_t            rt_format_;             ///< VA render target format of pool surfaces
+    uint32_t            base_render_targets_;   ///< pool size derived from max_references
+    uint32_t            idle_frames_;           ///< pictures decoded while having spare surfaces
+    RenderTargetStats   stats_;
+
+    bool                        async_;         ///< pictures are submitted by a separate thread
+    std::thread                 submit_thread_;
+    std::mutex                  submit_mtx_;
+    std::condition_variable     submit_cv_;     ///< signaled on new job or shutdown
+    std::condition_variable     completed_cv_;  ///< signaled on each completed job
+    std::deque<std::unique_ptr<PictureJob>> submit_queue_;
+    uint64_t                    submitted_seq_; ///< sequence number of the last queued picture
+    uint64_t                    completed_seq_; ///< sequence number of the last handed picture
+    bool                        submit_shutdown_;
 };
 
+/// probes decoder profiles available through VA-API. Called once, on device creation
+std::vector<vdp::Device::DecoderCaps>
+discover_capabilities(VADisplay va_dpy);
+
+/// returns capabilities of profile, or nullptr if it's not supported
+const vdp::Device::DecoderCaps *
+find_capabilities(const vdp::Device::Resource &device, VdpDecoderProfile profile);
+
+/// destroys decoder contexts cached by device. Called on device destruction
+void
+flush_context_cache(vdp::Device::Resource &device);
+
 VdpDecoderQueryCapabilities QueryCapabilities;
 VdpDecoderCreate            Create;
 VdpDecoderDestroy           Destroy;
@@ -34,13 +34,18 @@
 #include "globals.hh"
 #include "glx-context.hh"
 #include "handle-storage.hh"
+#include "quad-renderer.hh"
 #include "reverse-constant.hh"
 #include "trace.hh"
 #include "watermark.hh"
 #include <GL/gl.h>
+#include <X11/extensions/sync.h>
+#include <algorithm>
+#include <iterator>
 #include <map>
 #include <mutex>
 #include <stdlib.h>
+#include <string.h>
 #include <string>
 #include <va/va_x11.h>
 #include <vdpau/vdpau_x11.h>
@@ -391,6 +396,30 @@ Resource::Resource(Display *a_display, int a_screen)
             (PFNGLXBINDTEXIMAGEEXTPROC)glXGetProcAddress((GLubyte *)"glXBindTexImageEXT");
         fn.glXReleaseTexImageEXT =
             (PFNGLXRELEASETEXIMAGEEXTPROC)glXGetProcAddress((GLubyte *)"glXReleaseTexImageEXT");
+
+        int fbconfig_attrs[] = {
+            GLX_DRAWABLE_TYPE,  GLX_PIXMAP_BIT,
+            GLX_RENDER_TYPE,    GLX_RGBA_BIT,
+            GLX_X_RENDERABLE,   GL_TRUE,
+            GLX_Y_INVERTED_EXT, GL_TRUE,
+            GLX_RED_SIZE,       8,
+            GLX_GREEN_SIZE,     8,
+            GLX_BLUE_SIZE,      8,
+            GLX_ALPHA_SIZE,     8,
+            GLX_DEPTH_SIZE,     16,
+            GLX_BIND_TO_TEXTURE_RGBA_EXT,     GL_TRUE,
+            GL_NONE
+        };
+
+        int nconfigs = 0;
+        GLXFBConfig *fbconfig = glXChooseFBConfig(dpy.get(), screen, fbconfig_attrs, &nconfigs);
+        pixmap_fbconfig = (fbconfig && nconfigs > 0) ? fbconfig[0] : nullptr;
+        XFree(fbconfig);
+    }
+
+    if (!pixmap_fbconfig) {
+        traceError("error (%s): no suitable FBConfig for texture-from-pixmap\n", __func__);
+        throw std::bad_alloc();
     }
 
     if (!fn.glXBindTexImageEXT || !fn.glXReleaseTexImageEXT) {
@@ -402,11 +431,31 @@ Resource::Resource(Display *a_display, int a_screen)
 
     glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
+    // X fences let GL wait for X server rendering without blocking round trips
+    fn.glImportSyncEXT = nullptr;
+    const char *gl_extensions = reinterpret_cast<const char *>(glGetString(GL_EXTENSIONS));
+    int sync_event_base, sync_error_base, sync_major, sync_minor;
+    if (gl_extensions && strstr(gl_extensions, "GL_EXT_x11_sync_object") &&
+        XSyncQueryExtension(dpy.get(), &sync_event_base, &sync_error_base) &&
+        XSyncInitialize(dpy.get(), &sync_major, &sync_minor) &&
+        (sync_major > 3 || (sync_major == 3 && sync_minor >= 1)))
+    {
+        fn.glImportSyncEXT =
+            (PFNGLIMPORTSYNCEXTPROC)glXGetProcAddress((GLubyte *)"glImportSyncEXT");
+    }
+
+    // per-instance attributes let batched output surface draws go in a single call
+    GLint gl_major = 0, gl_minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &gl_major);
+    glGetIntegerv(GL_MINOR_VERSION, &gl_minor);
+    has_instanced_arrays = gl_major > 3 || (gl_major == 3 && gl_minor >= 3);
+
+    pending_draws.fbo_id = 0;
+    pending_draws.width = 0;
+    pending_draws.height = 0;
 
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+    bitmap_put_stats.puts = 0;
+    bitmap_put_stats.unchanged = 0;
 
     // initialize VAAPI
     va_available = 0;
@@ -417,10 +466,31 @@ Resource::Resource(Display *a_display, int a_screen)
         va_dpy = vaGetDisplay(dpy.get());
 
         VAStatus status = vaInitialize(va_dpy, &va_version_major, &va_version_minor);
-        if (status == VA_STATUS_SUCCESS)
+        if (status == VA_STATUS_SUCCESS) {
             va_available = 1;
+            decoder_caps = vdp::Decoder::discover_capabilities(va_dpy);
+        }
     }
 
+    // video surfaces are GL textures backed by VA surfaces, so both limit their size
+    GLint max_texture_size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+    max_video_width = max_texture_size;
+    max_video_height = max_texture_size;
+
+    if (!decoder_caps.empty()) {
+        uint32_t va_max_width = 0;
+        uint32_t va_max_height = 0;
+        for (const auto &caps: decoder_caps) {
+            va_max_width = std::max(va_max_width, caps.max_width);
+            va_max_height = std::max(va_max_height, caps.max_height);
+        }
+        max_video_width = std::min(max_video_width, va_max_width);
+        max_video_height = std::min(max_video_height, va_max_height);
+    }
+
+    init_dmabuf_import();
+
     compile_shaders();
 
     glGenTextures(1, &watermark_tex_id);
@@ -463,6 +533,10 @@ Resource::~Resource()
 {
     try {
         // cleaup libva
+        if (va_available)
+            vdp::Decoder::flush_context_cache(*this);
+
+        terminate_dmabuf_import();
         vaTerminate(va_dpy);
 
         {
@@ -471,6 +545,22 @@ Resource::~Resource()
             glDeleteTextures(1, &watermark_tex_id);
             glBindFramebuffer(GL_FRAMEBUFFER, 0);
             destroy_shaders();
+
+            // bitmaps are gone already, but one empty page of each format is kept for reuse
+            for (const auto &page: bitmap_atlas)
+                glDeleteTextures(1, &page->tex_id);
+            bitmap_atlas.clear();
+
+            for (const auto &palette: palettes)
+                glDeleteTextures(1, &palette.tex_id);
+            palettes.clear();
+        }
+
+        if (global.quirks.log_stats && global.quirks.dedup_bitmaps) {
+            const uint32_t puts = bitmap_put_stats.puts;
+            const uint32_t unchanged = bitmap_put_stats.unchanged;
+            traceInfo("Device %u: %u of %u bitmap updates had unchanged content (%.1f%%)\n", id,
+                      unchanged, puts, puts > 0 ? 100.0 * unchanged / puts : 0.0);
         }
 
         {
@@ -488,32 +578,109 @@ Resource::~Resource()
 }
 
 void
-Resource::compile_shaders()
+Resource::init_dmabuf_import()
 {
-    for (int k = 0; k < SHADER_COUNT; k ++) {
-        struct shader_s *s = &glsl_shaders[k];
-        int ok;
+    dmabuf.available = false;
+
+#ifdef HAVE_EGL
+    // set even when import can't be used, terminate_dmabuf_import() looks at them
+    dmabuf.egl_dpy = EGL_NO_DISPLAY;
+    dmabuf.has_modifiers = false;
+    dmabuf.eglCreateImageKHR = nullptr;
+    dmabuf.eglDestroyImageKHR = nullptr;
+    dmabuf.glEGLImageTargetTexture2DOES = nullptr;
+#endif
+
+#if defined(HAVE_EGL) && VA_CHECK_VERSION(1, 1, 0)
+    if (!va_available || global.quirks.avoid_dmabuf)
+        return;
+
+    // EGL is used for importing buffers only, drawing still happens in GLX contexts
+    const EGLDisplay egl_dpy = eglGetDisplay(reinterpret_cast<EGLNativeDisplayType>(dpy.get()));
+    if (egl_dpy == EGL_NO_DISPLAY || !eglInitialize(egl_dpy, nullptr, nullptr))
+        return;
+
+    const char *extensions = eglQueryString(egl_dpy, EGL_EXTENSIONS);
+    if (!extensions || !strstr(extensions, "EGL_EXT_image_dma_buf_import")) {
+        eglTerminate(egl_dpy);
+        return;
+    }
 
-        const GLuint f_shader = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(f_shader, 1, &s->body, &s->len);
-        glCompileShader(f_shader);
-        glGetShaderiv(f_shader, GL_COMPILE_STATUS, &ok);
+    dmabuf.egl_dpy = egl_dpy;
+    dmabuf.has_modifiers = strstr(extensions, "EGL_EXT_image_dma_buf_import_modifiers");
+    dmabuf.eglCreateImageKHR =
+        (PFNEGLCREATEIMAGEKHRPROC)eglGetProcAddress("eglCreateImageKHR");
+    dmabuf.eglDestroyImageKHR =
+        (PFNEGLDESTROYIMAGEKHRPROC)eglGetProcAddress("eglDestroyImageKHR");
+    dmabuf.glEGLImageTargetTexture2DOES =
+        (void (*)(GLenum, void *))eglGetProcAddress("glEGLImageTargetTexture2DOES");
+
+    dmabuf.available = dmabuf.eglCreateImageKHR && dmabuf.eglDestroyImageKHR &&
+                       dmabuf.glEGLImageTargetTexture2DOES;
+#endif
+}
 
-        if (!ok) {
-            GLint errmsg_len;
-            glGetShaderiv(f_shader, GL_INFO_LOG_LENGTH, &errmsg_len);
+void
+Resource::terminate_dmabuf_import()
+{
+#ifdef HAVE_EGL
+    if (dmabuf.egl_dpy != EGL_NO_DISPLAY)
+        eglTerminate(dmabuf.egl_dpy);
+#endif
+}
 
-            std::vector<char> errmsg(errmsg_len);
-            glGetShaderInfoLog(f_shader, errmsg.size(), nullptr, errmsg.data());
-            traceError("Device::Resource::compile_shaders(): compilation of shader #%d failed with "
-                       "'%s'\n", k, errmsg.data());
-            glDeleteShader(f_shader);
-            throw shader_compilation_failed();
-        }
+GLuint
+Resource::compile_shader(GLenum type, int k)
+{
+    const struct shader_s *s = &glsl_shaders[k];
+    int ok;
+
+    const GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &s->body, &s->len);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+
+    if (!ok) {
+        GLint errmsg_len;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &errmsg_len);
+
+        std::vector<char> errmsg(errmsg_len);
+        glGetShaderInfoLog(shader, errmsg.size(), nullptr, errmsg.data());
+        traceError("Device::Resource::compile_shader(): compilation of shader #%d failed with "
+                   "'%s'\n", k, errmsg.data());
+        glDeleteShader(shader);
+        throw shader_compilation_failed();
+    }
+
+    return shader;
+}
 
+void
+Resource::compile_shaders()
+{
+    quad_vertex_shader = compile_shader(GL_VERTEX_SHADER, glsl_quad_vertex);
+
+    for (int k = 0; k < SHADER_COUNT; k ++) {
+        shaders[k].f_shader = 0;
+        shaders[k].program = 0;
+        if (k == glsl_quad_vertex)
+            continue;
+
+        const GLuint f_shader = compile_shader(GL_FRAGMENT_SHADER, k);
+
+        // every program draws the same unit quad, placed by quad_vertex shader attributes
         const GLuint program = glCreateProgram();
+        glAttachShader(program, quad_vertex_shader);
         glAttachShader(program, f_shader);
+        glBindAttribLocation(program, kQuadCornerAttrib, "corner");
+        glBindAttribLocation(program, kQuadDstAttrib, "dst_rect");
+        glBindAttribLocation(program, kQuadSrcAttrib, "src_rect");
+        glBindAttribLocation(program, kQuadRotationAttrib, "rotation");
+        glBindAttribLocation(program, kQuadColorsAttrib, "colors");
+        glBindFragDataLocation(program, 0, "frag_color");
         glLinkProgram(program);
+
+        int ok;
         glGetProgramiv(program, GL_LINK_STATUS, &ok);
 
         if (!ok) {
@@ -531,19 +698,102 @@ Resource::compile_shaders()
 
         shaders[k].f_shader = f_shader;
         shaders[k].program = program;
+        shaders[k].uniform.tex_0 = -1;
+        shaders[k].uniform.tex_1 = -1;
+        shaders[k].uniform.tex_2 = -1;
+        shaders[k].uniform.csc = -1;
+        std::fill(std::begin(shaders[k].csc_value), std::end(shaders[k].csc_value), 0.0f);
+
+        shaders[k].uniform.target_size = glGetUniformLocation(program, "target_size");
 
         switch (k) {
         case glsl_YV12_RGBA:
         case glsl_NV12_RGBA:
             shaders[k].uniform.tex_0 = glGetUniformLocation(program, "tex[0]");
             shaders[k].uniform.tex_1 = glGetUniformLocation(program, "tex[1]");
+            shaders[k].uniform.csc = glGetUniformLocation(program, "csc");
+            break;
+
+        case glsl_csc:
+            shaders[k].uniform.tex_0 = glGetUniformLocation(program, "tex_0");
+            shaders[k].uniform.csc = glGetUniformLocation(program, "csc");
+            break;
+
+        case glsl_deinterlace:
+            shaders[k].uniform.tex_0 = glGetUniformLocation(program, "tex[0]");
+            shaders[k].uniform.tex_1 = glGetUniformLocation(program, "tex[1]");
+            shaders[k].uniform.tex_2 = glGetUniformLocation(program, "tex[2]");
+            shaders[k].uniform.texel_size = glGetUniformLocation(program, "texel_size");
+            shaders[k].uniform.parity = glGetUniformLocation(program, "parity");
+            shaders[k].uniform.mode = glGetUniformLocation(program, "mode");
+            break;
+
+        case glsl_indexed_RGBA:
+            shaders[k].uniform.tex_0 = glGetUniformLocation(program, "tex[0]");
+            shaders[k].uniform.tex_1 = glGetUniformLocation(program, "tex[1]");
+            shaders[k].uniform.mode = glGetUniformLocation(program, "mode");
             break;
 
         case glsl_red_to_alpha_swizzle:
+        case glsl_texture_color:
             shaders[k].uniform.tex_0 = glGetUniformLocation(program, "tex_0");
             break;
+
+        case glsl_scale:
+            shaders[k].uniform.tex_0 = glGetUniformLocation(program, "tex[0]");
+            shaders[k].uniform.tex_1 = glGetUniformLocation(program, "tex[1]");
+            shaders[k].uniform.src_size = glGetUniformLocation(program, "src_size");
+            shaders[k].uniform.src_origin = glGetUniformLocation(program, "src_origin");
+            shaders[k].uniform.src_length = glGetUniformLocation(program, "src_length");
+            shaders[k].uniform.dst_origin = glGetUniformLocation(program, "dst_origin");
+            shaders[k].uniform.dst_length = glGetUniformLocation(program, "dst_length");
+            shaders[k].uniform.taps = glGetUniformLocation(program, "taps");
+            shaders[k].uniform.axis = glGetUniformLocation(program, "axis");
+            shaders[k].uniform.csc = glGetUniformLocation(program, "csc");
+            break;
         }
     }
+
+    // conversion shaders produce full range BT.601 RGB, the reference video mixer corrects
+    // from. Other users of csc uniform start with identity
+    VdpCSCMatrix reference;
+    compute_csc_matrix(nullptr, ColorStandard::bt601, true, &reference);
+
+    const VdpCSCMatrix identity = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}};
+
+    for (int k = 0; k < SHADER_COUNT; k ++) {
+        if (k == glsl_quad_vertex)
+            continue;
+
+        // samplers always refer to the same texture units, so they are set once
+        glUseProgram(shaders[k].program);
+        glUniform1i(shaders[k].uniform.tex_0, 0);
+        glUniform1i(shaders[k].uniform.tex_1, 1);
+        glUniform1i(shaders[k].uniform.tex_2, 2);
+
+        if (shaders[k].uniform.csc < 0)
+            continue;
+
+        if (k == glsl_NV12_RGBA || k == glsl_YV12_RGBA)
+            set_csc_uniform(k, reference);
+        else
+            set_csc_uniform(k, identity);
+    }
+    glUseProgram(0);
+}
+
+void
+Resource::set_csc_uniform(int shader, const VdpCSCMatrix &csc_matrix)
+{
+    float gl_matrix[16];
+    csc_matrix_to_gl(csc_matrix, gl_matrix);
+
+    auto &value = shaders[shader].csc_value;
+    if (std::equal(std::begin(gl_matrix), std::end(gl_matrix), std::begin(value)))
+        return;
+
+    std::copy(std::begin(gl_matrix), std::end(gl_matrix), std::begin(value));
+    glUniformMatrix4fv(shaders[shader].uniform.csc, 1, GL_FALSE, gl_matrix);
 }
 
 void
@@ -553,6 +803,7 @@ Resource::destroy_shaders()
         glDeleteProgram(shaders[k].program);
         glDeleteShader(shaders[k].f_shader);
     }
+    glDeleteShader(quad_vertex_shader);
 }
 
 VdpStatus
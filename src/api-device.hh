@@ -25,18 +25,61 @@
 #pragma once
 
 #include "api.hh"
+#include "bitmap-atlas.hh"
 #include "glx-context.hh"
+#include "quad-renderer.hh"
 #include "shaders.h"
 #include "x-display-ref.hh"
 #include <GL/glx.h>
+#include <atomic>
+#include <chrono>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <va/va_x11.h>
 #include <vdpau/vdpau.h>
+#include <vector>
+
+#ifdef HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
 
 
 namespace vdp { namespace Device {
 
+/// decoder profile capabilities, as found on device creation
+struct DecoderCaps
+{
+    VdpDecoderProfile   profile;            ///< profile asked by application
+    VdpDecoderProfile   decoder_profile;    ///< profile actually used, may be more advanced
+    VAProfile           va_profile;
+    uint32_t            max_level;
+    uint32_t            max_macroblocks;
+    uint32_t            max_width;
+    uint32_t            max_height;
+};
+
+/// color table of indexed pictures, uploaded as 256x1 texture
+struct PaletteTexture
+{
+    std::vector<uint32_t>   colors;     ///< B8G8R8X8 entries, as passed by application
+    GLuint                  tex_id;
+};
+
+/// VA-API objects of a destroyed decoder, kept for reuse by a new decoder with the same
+/// parameters. Players re-create decoders on each seek or stream switch.
+struct CachedDecoderContext
+{
+    VdpDecoderProfile           profile;        ///< profile asked by application
+    uint32_t                    width;
+    uint32_t                    height;
+    VAConfigID                  config_id;
+    VAContextID                 context_id;
+    std::vector<VASurfaceID>    render_targets;
+    std::chrono::steady_clock::time_point   release_time;
+};
+
 struct Resource: public vdp::GenericResource
 {
     Resource(Display *a_dpy, int a_screen);
@@ -52,6 +95,11 @@ struct Resource: public vdp::GenericResource
     int                 va_available;   ///< 1 if VA-API available
     int                 va_version_major;
     int                 va_version_minor;
+    std::vector<DecoderCaps>    decoder_caps;   ///< supported profiles, immutable after creation
+    uint32_t            max_video_width;    ///< largest video surface GL and VA-API can handle
+    uint32_t            max_video_height;
+    std::mutex                  decoder_cache_mtx;
+    std::vector<CachedDecoderContext>   decoder_cache;  ///< most recently released last
     GLuint              watermark_tex_id;   ///< GL texture id for watermark
     struct {
         GLuint      f_shader;
@@ -59,17 +107,89 @@ struct Resource: public vdp::GenericResource
         struct {
             int     tex_0;
             int     tex_1;
+            int     tex_2;
+            int     texel_size;
+            int     parity;
+            int     mode;
+            int     src_size;
+            int     src_origin;
+            int     src_length;
+            int     dst_origin;
+            int     dst_length;
+            int     taps;
+            int     axis;
+            int     csc;
+            int     target_size;    ///< quad_vertex shader uniform, present in every program
         } uniform;
-    } shaders[SHADER_COUNT];
+        float       csc_value[16];  ///< last value of csc uniform, as GL matrix
+    } shaders[SHADER_COUNT];        ///< programs, made of fragment shaders and quad_vertex one
+    GLuint          quad_vertex_shader; ///< vertex shader shared by all programs
+    bool            has_instanced_arrays;   ///< GL 3.3, vertex attributes may advance per instance
+    GLXFBConfig     pixmap_fbconfig;    ///< config for texture-from-pixmap GLX pixmaps
+
+    /// shared textures of small bitmap surfaces. Page is destroyed with its last bitmap.
+    /// Accessed under GLX lock only
+    std::vector<std::unique_ptr<BitmapAtlasPage>>   bitmap_atlas;
+
+    /// palettes of recent OutputSurface::PutBitsIndexed calls, most recently used first.
+    /// Overlays tend to keep their palette for many frames. Accessed under GLX lock only
+    std::vector<PaletteTexture>     palettes;
+
+    /// output surface draws recorded but not yet sent to GL. They are collected for a single
+    /// target surface at a time, see OutputSurface::flush_pending_draws(). Accessed under GLX
+    /// lock only
+    struct {
+        GLuint                  fbo_id;     ///< framebuffer of target surface
+        uint32_t                width;
+        uint32_t                height;
+        std::vector<QuadDraw>   draws;
+    } pending_draws;
+
+    /// bitmap surface update counters, for DedupBitmaps quirk
+    struct {
+        std::atomic<uint32_t>   puts;       ///< PutBitsNative calls hashed
+        std::atomic<uint32_t>   unchanged;  ///< of them, calls skipped as content was the same
+    } bitmap_put_stats;
+
     struct {
         PFNGLXBINDTEXIMAGEEXTPROC       glXBindTexImageEXT;
         PFNGLXRELEASETEXIMAGEEXTPROC    glXReleaseTexImageEXT;
+        PFNGLIMPORTSYNCEXTPROC          glImportSyncEXT;    ///< nullptr if X fences can't be
+                                                            ///< waited for in GL
     } fn;
 
+    /// import of decoded surfaces into GL through DMA-BUF, bypassing vaPutSurface into pixmap.
+    /// Modified under GLX lock only
+    struct {
+        bool            available;      ///< supported, and haven't failed so far
+#ifdef HAVE_EGL
+        EGLDisplay      egl_dpy;
+        bool            has_modifiers;  ///< EGL_EXT_image_dma_buf_import_modifiers present
+        PFNEGLCREATEIMAGEKHRPROC        eglCreateImageKHR;
+        PFNEGLDESTROYIMAGEKHRPROC       eglDestroyImageKHR;
+        void          (*glEGLImageTargetTexture2DOES)(GLenum target, void *image);
+#endif
+    } dmabuf;
+
+    /// sets csc uniform of shader, which must be in use. GL is called only if the value differs
+    /// from the previous one, so unchanged matrices cost nothing per frame
+    void
+    set_csc_uniform(int shader, const VdpCSCMatrix &csc_matrix);
+
 private:
+    /// compiles k-th bundled shader as shader of given type
+    GLuint
+    compile_shader(GLenum type, int k);
+
     void
     compile_shaders();
 
+    void
+    init_dmabuf_import();
+
+    void
+    terminate_dmabuf_import();
+
     void
     destroy_shaders();
 };
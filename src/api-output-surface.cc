@@ -24,13 +24,16 @@
 
 #define GL_GLEXT_PROTOTYPES
 #include "api-bitmap-surface.hh"
+#include "api-csc-matrix.hh"
 #include "api-device.hh"
 #include "api-output-surface.hh"
 #include "glx-context.hh"
 #include "handle-storage.hh"
+#include "quad-renderer.hh"
 #include "reverse-constant.hh"
 #include "trace.hh"
 #include <GL/gl.h>
+#include <algorithm>
 #include <stdlib.h>
 #include <vdpau/vdpau.h>
 #include <vector>
@@ -112,83 +115,51 @@ vdpBlendEquationToGLEquation(VdpOutputSurfaceRenderBlendEquation blend_equation)
     }
 }
 
+/// records drawing of srcRect area of texture of given size into dstRect area of destination
+/// surface. Without source texture, colors are drawn alone. Draws recorded for other surface
+/// are flushed first
 static
 void
-compose_surfaces(struct blend_state_struct bs, VdpRect srcRect, VdpRect dstRect,
-                 VdpColor const *colors, int flags, bool has_src_surf)
-{
-    glBlendFuncSeparate(bs.srcFuncRGB, bs.dstFuncRGB, bs.srcFuncAlpha, bs.dstFuncAlpha);
-    glBlendEquationSeparate(bs.modeRGB, bs.modeAlpha);
-
-    glColor4f(1, 1, 1, 1);
-    glBegin(GL_QUADS);
-
-    if (has_src_surf) {
-        switch (flags & 3) {
-        case VDP_OUTPUT_SURFACE_RENDER_ROTATE_0:
-            glTexCoord2i(srcRect.x0, srcRect.y0); break;
-        case VDP_OUTPUT_SURFACE_RENDER_ROTATE_90:
-            glTexCoord2i(srcRect.x0, srcRect.y1); break;
-        case VDP_OUTPUT_SURFACE_RENDER_ROTATE_180:
-            glTexCoord2i(srcRect.x1, srcRect.y1); break;
-        case VDP_OUTPUT_SURFACE_RENDER_ROTATE_270:
-            glTexCoord2i(srcRect.x1, srcRect.y0); break;
-        }
-    }
-    if (colors)
-        glColor4f(colors[0].red, colors[0].green, colors[0].blue, colors[0].alpha);
-    glVertex2f(dstRect.x0, dstRect.y0);
-
-    if (has_src_surf) {
-        switch (flags & 3) {
-        case VDP_OUTPUT_SURFACE_RENDER_ROTATE_0:
-            glTexCoord2i(srcRect.x1, srcRect.y0); break;
-        case VDP_OUTPUT_SURFACE_RENDER_ROTATE_90:
-            glTexCoord2i(srcRect.x0, srcRect.y0); break;
-        case VDP_OUTPUT_SURFACE_RENDER_ROTATE_180:
-            glTexCoord2i(srcRect.x0, srcRect.y1); break;
-        case VDP_OUTPUT_SURFACE_RENDER_ROTATE_270:
-            glTexCoord2i(srcRect.x1, srcRect.y1); break;
-        }
-    }
-    if (colors && (flags & VDP_OUTPUT_SURFACE_RENDER_COLOR_PER_VERTEX))
-        glColor4f(colors[1].red, colors[1].green, colors[1].blue, colors[1].alpha);
-    glVertex2f(dstRect.x1, dstRect.y0);
-
-    if (has_src_surf) {
-        switch (flags & 3) {
-        case VDP_OUTPUT_SURFACE_RENDER_ROTATE_0:
-            glTexCoord2i(srcRect.x1, srcRect.y1); break;
-        case VDP_OUTPUT_SURFACE_RENDER_ROTATE_90:
-            glTexCoord2i(srcRect.x1, srcRect.y0); break;
-        case VDP_OUTPUT_SURFACE_RENDER_ROTATE_180:
-            glTexCoord2i(srcRect.x0, srcRect.y0); break;
-        case VDP_OUTPUT_SURFACE_RENDER_ROTATE_270:
-            glTexCoord2i(srcRect.x0, srcRect.y1); break;
-        }
+record_draw(const shared_ptr<Resource> &dst_surf, struct blend_state_struct bs, GLuint tex_id,
+            VdpRect srcRect, uint32_t tex_width, uint32_t tex_height, VdpRect dstRect,
+            VdpColor const *colors, int flags, int shader)
+{
+    Quad quad{dst_surf->width, dst_surf->height, dstRect};
+
+    if (tex_id != 0) {
+        quad.set_source(srcRect, tex_width, tex_height);
+        quad.rotation = flags & 3;
+    } else {
+        shader = glsl_solid_color;
     }
-    if (colors && (flags & VDP_OUTPUT_SURFACE_RENDER_COLOR_PER_VERTEX))
-        glColor4f(colors[2].red, colors[2].green, colors[2].blue, colors[2].alpha);
-    glVertex2f(dstRect.x1, dstRect.y1);
-
-    if (has_src_surf) {
-        switch (flags & 3) {
-        case VDP_OUTPUT_SURFACE_RENDER_ROTATE_0:
-            glTexCoord2i(srcRect.x0, srcRect.y1); break;
-        case VDP_OUTPUT_SURFACE_RENDER_ROTATE_90:
-            glTexCoord2i(srcRect.x1, srcRect.y1); break;
-        case VDP_OUTPUT_SURFACE_RENDER_ROTATE_180:
-            glTexCoord2i(srcRect.x1, srcRect.y0); break;
-        case VDP_OUTPUT_SURFACE_RENDER_ROTATE_270:
-            glTexCoord2i(srcRect.x0, srcRect.y0); break;
+
+    if (colors) {
+        for (int k = 0; k < 4; k ++) {
+            const VdpColor &c = (flags & VDP_OUTPUT_SURFACE_RENDER_COLOR_PER_VERTEX) ? colors[k]
+                                                                                     : colors[0];
+            quad.colors[k][0] = c.red;
+            quad.colors[k][1] = c.green;
+            quad.colors[k][2] = c.blue;
+            quad.colors[k][3] = c.alpha;
         }
     }
-    if (colors && (flags & VDP_OUTPUT_SURFACE_RENDER_COLOR_PER_VERTEX))
-        glColor4f(colors[3].red, colors[3].green, colors[3].blue, colors[3].alpha);
-    glVertex2f(dstRect.x0, dstRect.y1);
 
-    glEnd();
-    glColor4f(1, 1, 1, 1);
+    const BlendState blend = {bs.srcFuncRGB, bs.dstFuncRGB, bs.srcFuncAlpha, bs.dstFuncAlpha,
+                              bs.modeRGB, bs.modeAlpha};
+
+    auto &device = *dst_surf->device;
+    auto &pending = device.pending_draws;
+    if (pending.fbo_id != dst_surf->fbo_id)
+        flush_pending_draws(device);
+
+    pending.fbo_id = dst_surf->fbo_id;
+    pending.width = dst_surf->width;
+    pending.height = dst_surf->height;
+
+    pending.draws.push_back(QuadDraw{shader, tex_id, blend, quad});
+
+    if (pending.draws.size() >= kMaxPendingDraws)
+        flush_pending_draws(device);
 }
 
 static
@@ -229,6 +200,48 @@ vdpBlendStateToGLBlendState(VdpOutputSurfaceRenderBlendState const *blend_state)
     return bs;
 }
 
+void
+flush_pending_draws(vdp::Device::Resource &device)
+{
+    auto &pending = device.pending_draws;
+    if (pending.draws.empty())
+        return;
+
+    bind_render_target(pending.fbo_id, pending.width, pending.height);
+    glEnable(GL_BLEND);
+    draw_quads(device, pending.draws.data(), pending.draws.size());
+    pending.draws.clear();
+    glFinish();
+
+    const auto gl_error = glGetError();
+    if (gl_error != GL_NO_ERROR)
+        traceError("OutputSurface::flush_pending_draws(): gl error %d\n", gl_error);
+}
+
+void
+flush_pending_draws_reading(vdp::Device::Resource &device, GLuint tex_id, const VdpRect &area,
+                            uint32_t tex_width, uint32_t tex_height)
+{
+    // textures are shared by several bitmaps, so areas are compared, in normalized coordinates
+    const float x0 = static_cast<float>(area.x0) / tex_width;
+    const float y0 = static_cast<float>(area.y0) / tex_height;
+    const float x1 = static_cast<float>(area.x1) / tex_width;
+    const float y1 = static_cast<float>(area.y1) / tex_height;
+
+    for (const auto &draw: device.pending_draws.draws) {
+        if (draw.tex_id != tex_id)
+            continue;
+
+        const float *src = draw.quad.src;
+        if (std::min(src[0], src[2]) < x1 && std::max(src[0], src[2]) > x0 &&
+            std::min(src[1], src[3]) < y1 && std::max(src[1], src[3]) > y0)
+        {
+            flush_pending_draws(device);
+            return;
+        }
+    }
+}
+
 Resource::Resource(shared_ptr<vdp::Device::Resource> a_device, VdpRGBAFormat a_rgba_format,
                    uint32_t a_width, uint32_t a_height)
     : rgba_format{a_rgba_format}
@@ -363,6 +376,11 @@ DestroyImpl(VdpOutputSurface surface_id)
 {
     ResourceRef<Resource> surface{surface_id};
 
+    {
+        GLXThreadLocalContext guard{surface->device};
+        flush_pending_draws(*surface->device);
+    }
+
     ResourceStorage<Resource>::instance().drop(surface_id);
     return VDP_STATUS_OK;
 }
@@ -387,6 +405,7 @@ GetBitsNativeImpl(VdpOutputSurface surface_id, VdpRect const *source_rect,
         src_rect = *source_rect;
 
     GLXThreadLocalContext guard{surface->device};
+    flush_pending_draws(*surface->device);
 
     glBindFramebuffer(GL_FRAMEBUFFER, surface->fbo_id);
     glReadBuffer(GL_COLOR_ATTACHMENT0);
@@ -444,6 +463,59 @@ GetParameters(VdpOutputSurface surface_id, VdpRGBAFormat *rgba_format, uint32_t
     return check_for_exceptions(GetParametersImpl, surface_id, rgba_format, width, height);
 }
 
+/// true if output surfaces of the format can be created
+static
+bool
+is_supported_rgba_format(VdpRGBAFormat rgba_format)
+{
+    switch (rgba_format) {
+    case VDP_RGBA_FORMAT_B8G8R8A8:
+    case VDP_RGBA_FORMAT_R8G8B8A8:
+    case VDP_RGBA_FORMAT_R10G10B10A2:
+    case VDP_RGBA_FORMAT_B10G10R10A2:
+    case VDP_RGBA_FORMAT_A8:
+        return true;                // all these formats should be supported by OpenGL
+    default:                        // implementation
+        return false;
+    }
+}
+
+/// finds palette texture with given colors in device cache, uploading it if there is none.
+/// Must be called under GLX lock
+static
+GLuint
+acquire_palette(vdp::Device::Resource &device, const uint32_t *colors, uint32_t count)
+{
+    auto &palettes = device.palettes;
+
+    for (auto it = palettes.begin(); it != palettes.end(); ++ it) {
+        if (it->colors.size() == count && std::equal(colors, colors + count, it->colors.begin()))
+        {
+            std::rotate(palettes.begin(), it, it + 1);
+            return palettes.front().tex_id;
+        }
+    }
+
+    if (palettes.size() >= static_cast<size_t>(kPaletteCacheSize)) {
+        glDeleteTextures(1, &palettes.back().tex_id);
+        palettes.pop_back();
+    }
+
+    vdp::Device::PaletteTexture palette{std::vector<uint32_t>(colors, colors + count), 0};
+    glGenTextures(1, &palette.tex_id);
+    glBindTexture(GL_TEXTURE_2D, palette.tex_id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 256, 1, 0, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+
+    // entries are native endian 32-bit words
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, count, 1, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV,
+                    colors);
+
+    palettes.insert(palettes.begin(), std::move(palette));
+    return palettes.front().tex_id;
+}
+
 VdpStatus
 PutBitsIndexedImpl(VdpOutputSurface surface_id, VdpIndexedFormat source_indexed_format,
                    void const *const *source_data, uint32_t const *source_pitch,
@@ -465,43 +537,27 @@ PutBitsIndexedImpl(VdpOutputSurface surface_id, VdpIndexedFormat source_indexed_
         return VDP_STATUS_INVALID_COLOR_TABLE_FORMAT;
     }
 
-    const auto color_table32 = static_cast<const uint32_t *>(color_table);
-
-    GLXThreadLocalContext guard{surface->device};
+    // index texture keeps bytes as they are, shader picks index and alpha from them
+    uint32_t bytes_per_pixel;
+    uint32_t palette_size;
+    GLenum index_internal_format;
+    GLenum index_format;
 
     switch (source_indexed_format) {
-    case VDP_INDEXED_FORMAT_I8A8:
-        // TODO: use shader?
-        do {
-            const uint32_t dstRectWidth = dst_rect.x1 - dst_rect.x0;
-            const uint32_t dstRectHeight = dst_rect.y1 - dst_rect.y0;
-
-            std::vector<uint32_t> unpacked_buf(dstRectWidth * dstRectHeight);
-
-            for (uint32_t y = 0; y < dstRectHeight; y ++) {
-                auto src_ptr = static_cast<const uint8_t *>(source_data[0]);
-                src_ptr += y * source_pitch[0];
-                uint32_t *dst_ptr = unpacked_buf.data() + y * dstRectWidth;
-
-                for (uint32_t x = 0; x < dstRectWidth; x ++) {
-                    const uint8_t i = *src_ptr++;
-                    const uint32_t a = (*src_ptr++) << 24;
-                    dst_ptr[x] = (color_table32[i] & 0x00ffffff) + a;
-                }
-            }
-
-            glBindTexture(GL_TEXTURE_2D, surface->tex_id);
-            glTexSubImage2D(GL_TEXTURE_2D, 0, dst_rect.x0, dst_rect.y0,
-                            dst_rect.x1 - dst_rect.x0, dst_rect.y1 - dst_rect.y0,
-                            GL_BGRA, GL_UNSIGNED_BYTE, unpacked_buf.data());
-            glFinish();
+    case VDP_INDEXED_FORMAT_A4I4:
+    case VDP_INDEXED_FORMAT_I4A4:
+        bytes_per_pixel = 1;
+        palette_size = 16;
+        index_internal_format = GL_R8;
+        index_format = GL_RED;
+        break;
 
-            const auto gl_error = glGetError();
-            if (gl_error != GL_NO_ERROR) {
-                traceError("OutputSurface::PutBitsIndexedImpl(): gl error %d\n", gl_error);
-                return VDP_STATUS_ERROR;
-            }
-        } while (0);
+    case VDP_INDEXED_FORMAT_A8I8:
+    case VDP_INDEXED_FORMAT_I8A8:
+        bytes_per_pixel = 2;
+        palette_size = 256;
+        index_internal_format = GL_RG8;
+        index_format = GL_RG;
         break;
 
     default:
@@ -510,6 +566,54 @@ PutBitsIndexedImpl(VdpOutputSurface surface_id, VdpIndexedFormat source_indexed_
         return VDP_STATUS_INVALID_INDEXED_FORMAT;
     }
 
+    const uint32_t width = dst_rect.x1 - dst_rect.x0;
+    const uint32_t height = dst_rect.y1 - dst_rect.y0;
+    if (width == 0 || height == 0)
+        return VDP_STATUS_OK;
+
+    auto &device = *surface->device;
+
+    GLXThreadLocalContext guard{surface->device};
+    flush_pending_draws(device);
+
+    const GLuint palette_tex_id =
+        acquire_palette(device, static_cast<const uint32_t *>(color_table), palette_size);
+
+    GLuint index_tex_id;
+    glGenTextures(1, &index_tex_id);
+    glBindTexture(GL_TEXTURE_2D, index_tex_id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, source_pitch[0] / bytes_per_pixel);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, index_internal_format, width, height, 0, index_format,
+                 GL_UNSIGNED_BYTE, source_data[0]);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, palette_tex_id);
+    glActiveTexture(GL_TEXTURE0);
+
+    bind_render_target(surface->fbo_id, surface->width, surface->height);
+    glDisable(GL_BLEND);
+
+    glUseProgram(device.shaders[glsl_indexed_RGBA].program);
+    glUniform1i(device.shaders[glsl_indexed_RGBA].uniform.mode, source_indexed_format);
+    draw_quad(device, glsl_indexed_RGBA, Quad{surface->width, surface->height, dst_rect});
+    glUseProgram(0);
+
+    glFinish();
+    glDeleteTextures(1, &index_tex_id);
+
+    const auto gl_error = glGetError();
+    if (gl_error != GL_NO_ERROR) {
+        traceError("OutputSurface::PutBitsIndexedImpl(): gl error %d\n", gl_error);
+        return VDP_STATUS_ERROR;
+    }
+
     return VDP_STATUS_OK;
 }
 
@@ -537,6 +641,7 @@ PutBitsNativeImpl(VdpOutputSurface surface_id, void const *const *source_data,
         dst_rect = *destination_rect;
 
     GLXThreadLocalContext guard{surface->device};
+    flush_pending_draws(*surface->device);
 
     glBindTexture(GL_TEXTURE_2D, surface->tex_id);
 
@@ -573,18 +678,119 @@ PutBitsNative(VdpOutputSurface surface_id, void const *const *source_data,
 }
 
 VdpStatus
-PutBitsYCbCrImpl(VdpOutputSurface surface, VdpYCbCrFormat source_ycbcr_format,
+PutBitsYCbCrImpl(VdpOutputSurface surface_id, VdpYCbCrFormat source_ycbcr_format,
                  void const *const *source_data, uint32_t const *source_pitches,
                  VdpRect const *destination_rect, VdpCSCMatrix const *csc_matrix)
 {
-    std::ignore = surface;
-    std::ignore = source_ycbcr_format;
-    std::ignore = source_data;
-    std::ignore = source_pitches;
-    std::ignore = destination_rect;
-    std::ignore = csc_matrix;
+    if (!source_data || !source_pitches)
+        return VDP_STATUS_INVALID_POINTER;
 
-    return VDP_STATUS_NO_IMPLEMENTATION;
+    ResourceRef<Resource> surface{surface_id};
+
+    // TODO: implement VDP_YCBCR_FORMAT_UYVY
+    // TODO: implement VDP_YCBCR_FORMAT_YUYV
+    // TODO: implement VDP_YCBCR_FORMAT_Y8U8V8A8
+    // TODO: implement VDP_YCBCR_FORMAT_V8U8Y8A8
+    switch (source_ycbcr_format) {
+    case VDP_YCBCR_FORMAT_NV12:
+    case VDP_YCBCR_FORMAT_YV12:
+        break;
+    default:
+        traceError("OutputSurface::PutBitsYCbCrImpl(): not implemented source YCbCr format "
+                   "'%s'\n", reverse_ycbcr_format(source_ycbcr_format));
+        return VDP_STATUS_INVALID_Y_CB_CR_FORMAT;
+    }
+
+    VdpRect dst_rect = {0, 0, surface->width, surface->height};
+    if (destination_rect)
+        dst_rect = *destination_rect;
+
+    // source picture is of destination rectangle size
+    const uint32_t width = dst_rect.x1 - dst_rect.x0;
+    const uint32_t height = dst_rect.y1 - dst_rect.y0;
+    const uint32_t chroma_width = (width + 1) / 2;
+    const uint32_t chroma_height = (height + 1) / 2;
+    if (width == 0 || height == 0)
+        return VDP_STATUS_OK;
+
+    auto &device = *surface->device;
+
+    GLXThreadLocalContext guard{surface->device};
+    flush_pending_draws(device);
+
+    GLuint tex_id[2];
+    glGenTextures(2, tex_id);
+
+    // planes are uploaded the same way VideoSurface::PutBitsYCbCr does it, so conversion
+    // programs are shared. YV12 chroma planes are stacked, Cb above Cr
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, tex_id[1]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+    if (source_ycbcr_format == VDP_YCBCR_FORMAT_NV12) {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, source_pitches[1] / 2);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG8, chroma_width, chroma_height, 0, GL_RG,
+                     GL_UNSIGNED_BYTE, source_data[1]);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, chroma_width, 2 * chroma_height, 0, GL_RED,
+                     GL_UNSIGNED_BYTE, nullptr);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, source_pitches[2]);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, chroma_width, chroma_height, GL_RED,
+                        GL_UNSIGNED_BYTE, source_data[2]);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, source_pitches[1]);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, chroma_height, chroma_width, chroma_height, GL_RED,
+                        GL_UNSIGNED_BYTE, source_data[1]);
+    }
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, tex_id[0]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, source_pitches[0]);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE,
+                 source_data[0]);
+
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    bind_render_target(surface->fbo_id, surface->width, surface->height);
+    glDisable(GL_BLEND);
+
+    const int shader = (source_ycbcr_format == VDP_YCBCR_FORMAT_NV12) ? glsl_NV12_RGBA
+                                                                       : glsl_YV12_RGBA;
+
+    // conversion programs are shared with video surfaces, which expect full range BT.601
+    VdpCSCMatrix reference;
+    compute_csc_matrix(nullptr, ColorStandard::bt601, true, &reference);
+
+    // NULL stands for BT.601 without procamp, which is what VdpGenerateCSCMatrix gives, so it's
+    // studio range
+    VdpCSCMatrix default_matrix;
+    compute_csc_matrix(nullptr, ColorStandard::bt601, false, &default_matrix);
+
+    glUseProgram(device.shaders[shader].program);
+    device.set_csc_uniform(shader, csc_matrix ? *csc_matrix : default_matrix);
+    draw_quad(device, shader, Quad{surface->width, surface->height, dst_rect});
+    device.set_csc_uniform(shader, reference);
+    glUseProgram(0);
+
+    glFinish();
+    glDeleteTextures(2, tex_id);
+
+    const auto gl_error = glGetError();
+    if (gl_error != GL_NO_ERROR) {
+        traceError("OutputSurface::PutBitsYCbCrImpl(): gl error %d\n", gl_error);
+        return VDP_STATUS_ERROR;
+    }
+
+    return VDP_STATUS_OK;
 }
 
 VdpStatus
@@ -605,18 +811,7 @@ QueryCapabilitiesImpl(VdpDevice device_id, VdpRGBAFormat surface_rgba_format, Vd
 
     ResourceRef<vdp::Device::Resource> device{device_id};
 
-    switch (surface_rgba_format) {
-    case VDP_RGBA_FORMAT_B8G8R8A8:
-    case VDP_RGBA_FORMAT_R8G8B8A8:
-    case VDP_RGBA_FORMAT_R10G10B10A2:
-    case VDP_RGBA_FORMAT_B10G10R10A2:
-    case VDP_RGBA_FORMAT_A8:
-        *is_supported = 1;          // All these formats should be supported by OpenGL
-        break;                      // implementation.
-    default:
-        *is_supported = 0;
-        break;
-    }
+    *is_supported = is_supported_rgba_format(surface_rgba_format);
 
     GLXThreadLocalContext guard{device};
 
@@ -663,17 +858,33 @@ QueryGetPutBitsNativeCapabilities(VdpDevice device, VdpRGBAFormat surface_rgba_f
 }
 
 VdpStatus
-QueryPutBitsIndexedCapabilitiesImpl(VdpDevice device, VdpRGBAFormat surface_rgba_format,
+QueryPutBitsIndexedCapabilitiesImpl(VdpDevice device_id, VdpRGBAFormat surface_rgba_format,
                                     VdpIndexedFormat bits_indexed_format,
                                     VdpColorTableFormat color_table_format, VdpBool *is_supported)
 {
-    std::ignore = device;
-    std::ignore = surface_rgba_format;
-    std::ignore = bits_indexed_format;
-    std::ignore = color_table_format;
-    std::ignore = is_supported;
+    if (!is_supported)
+        return VDP_STATUS_INVALID_POINTER;
 
-    return VDP_STATUS_NO_IMPLEMENTATION;
+    ResourceRef<vdp::Device::Resource> device{device_id};
+
+    *is_supported = 0;
+
+    if (!is_supported_rgba_format(surface_rgba_format))
+        return VDP_STATUS_OK;
+
+    switch (bits_indexed_format) {
+    case VDP_INDEXED_FORMAT_A4I4:
+    case VDP_INDEXED_FORMAT_I4A4:
+    case VDP_INDEXED_FORMAT_A8I8:
+    case VDP_INDEXED_FORMAT_I8A8:
+        // expanded by indexed_RGBA shader
+        *is_supported = (color_table_format == VDP_COLOR_TABLE_FORMAT_B8G8R8X8);
+        break;
+    default:
+        break;
+    }
+
+    return VDP_STATUS_OK;
 }
 
 VdpStatus
@@ -686,15 +897,29 @@ QueryPutBitsIndexedCapabilities(VdpDevice device, VdpRGBAFormat surface_rgba_for
 }
 
 VdpStatus
-QueryPutBitsYCbCrCapabilitiesImpl(VdpDevice device, VdpRGBAFormat surface_rgba_format,
+QueryPutBitsYCbCrCapabilitiesImpl(VdpDevice device_id, VdpRGBAFormat surface_rgba_format,
                                   VdpYCbCrFormat bits_ycbcr_format, VdpBool *is_supported)
 {
-    std::ignore = device;
-    std::ignore = surface_rgba_format;
-    std::ignore = bits_ycbcr_format;
-    std::ignore = is_supported;
+    if (!is_supported)
+        return VDP_STATUS_INVALID_POINTER;
 
-    return VDP_STATUS_NO_IMPLEMENTATION;
+    ResourceRef<vdp::Device::Resource> device{device_id};
+
+    *is_supported = 0;
+
+    if (!is_supported_rgba_format(surface_rgba_format))
+        return VDP_STATUS_OK;
+
+    switch (bits_ycbcr_format) {
+    case VDP_YCBCR_FORMAT_NV12:
+    case VDP_YCBCR_FORMAT_YV12:
+        *is_supported = 1;  // converted by NV12_RGBA and YV12_RGBA shaders
+        break;
+    default:
+        break;
+    }
+
+    return VDP_STATUS_OK;
 }
 
 VdpStatus
@@ -729,18 +954,13 @@ RenderBitmapSurfaceImpl(VdpOutputSurface destination_surface, VdpRect const *des
 
     GLXThreadLocalContext guard{dst_surf->device};
 
-    glBindFramebuffer(GL_FRAMEBUFFER, dst_surf->fbo_id);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0, dst_surf->width, 0, dst_surf->height, -1.0f, 1.0f);
-    glViewport(0, 0, dst_surf->width, dst_surf->height);
-    glEnable(GL_TEXTURE_2D);
-    glEnable(GL_BLEND);
-
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-
     VdpRect s_rect = {0, 0, 1, 1};
+    uint32_t tex_width = 1;
+    uint32_t tex_height = 1;
+    GLuint tex_id = 0;
+    uint32_t tex_x = 0;
+    uint32_t tex_y = 0;
+    int shader = glsl_texture_color;
 
     if (source_surface != VDP_INVALID_HANDLE) {
         ResourceRef<vdp::BitmapSurface::Resource> src_surf{source_surface};
@@ -751,30 +971,25 @@ RenderBitmapSurfaceImpl(VdpOutputSurface destination_surface, VdpRect const *des
         s_rect.x1 = src_surf->width;
         s_rect.y1 = src_surf->height;
 
-        glBindTexture(GL_TEXTURE_2D, src_surf->tex_id);
+        if (!src_surf->dirty_region.empty()) {
+            const uint32_t pitch = src_surf->width * src_surf->bytes_per_pixel;
 
-        if (src_surf->dirty) {
-            if (src_surf->bytes_per_pixel != 4)
-                glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, src_surf->width, src_surf->height,
-                            src_surf->gl_format, src_surf->gl_type,
-                            src_surf->bitmap_data.data());
-
-            if (src_surf->bytes_per_pixel != 4)
-                glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            for (const auto &r: src_surf->dirty_region.rects()) {
+                const size_t ofs = r.y0 * pitch + r.x0 * src_surf->bytes_per_pixel;
+                src_surf->upload(r, src_surf->bitmap_data.data() + ofs, pitch);
+            }
 
-            src_surf->dirty = false;
+            src_surf->dirty_region.clear();
         }
 
-        glMatrixMode(GL_TEXTURE);
-        glLoadIdentity();
-        glScalef(1.0f / src_surf->width, 1.0f / src_surf->height, 1.0f);
+        tex_id = src_surf->tex_id;
+        tex_x = src_surf->tex_x;
+        tex_y = src_surf->tex_y;
+        tex_width = src_surf->tex_width;
+        tex_height = src_surf->tex_height;
 
-        if (src_surf->rgba_format == VDP_RGBA_FORMAT_A8) {
-            glUseProgram(src_surf->device->shaders[glsl_red_to_alpha_swizzle].program);
-            glUniform1i(src_surf->device->shaders[glsl_red_to_alpha_swizzle].uniform.tex_0, 0);
-        }
+        if (src_surf->rgba_format == VDP_RGBA_FORMAT_A8)
+            shader = glsl_red_to_alpha_swizzle;
     }
 
     VdpRect d_rect = {0, 0, dst_surf->width, dst_surf->height};
@@ -784,10 +999,14 @@ RenderBitmapSurfaceImpl(VdpOutputSurface destination_surface, VdpRect const *des
     if (source_rect)
         s_rect = *source_rect;
 
-    compose_surfaces(bs, s_rect, d_rect, colors, flags, source_surface != VDP_INVALID_HANDLE);
+    // bitmap may be a part of atlas texture
+    s_rect.x0 += tex_x;
+    s_rect.y0 += tex_y;
+    s_rect.x1 += tex_x;
+    s_rect.y1 += tex_y;
 
-    glUseProgram(0);
-    glFinish();
+    record_draw(dst_surf, bs, tex_id, s_rect, tex_width, tex_height, d_rect, colors, flags,
+                shader);
 
     const auto gl_error = glGetError();
     if (gl_error != GL_NO_ERROR) {
@@ -832,18 +1051,10 @@ RenderOutputSurfaceImpl(VdpOutputSurface destination_surface, VdpRect const *des
 
     GLXThreadLocalContext guard{dst_surf->device};
 
-    glBindFramebuffer(GL_FRAMEBUFFER, dst_surf->fbo_id);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0, dst_surf->width, 0, dst_surf->height, -1.0f, 1.0f);
-    glViewport(0, 0, dst_surf->width, dst_surf->height);
-    glEnable(GL_TEXTURE_2D);
-    glEnable(GL_BLEND);
-
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-
     VdpRect s_rect = {0, 0, 1, 1};
+    uint32_t tex_width = 1;
+    uint32_t tex_height = 1;
+    GLuint tex_id = 0;
 
     if (source_surface != VDP_INVALID_HANDLE) {
         ResourceRef<vdp::OutputSurface::Resource> src_surf{source_surface};
@@ -854,11 +1065,9 @@ RenderOutputSurfaceImpl(VdpOutputSurface destination_surface, VdpRect const *des
         s_rect.x1 = src_surf->width;
         s_rect.y1 = src_surf->height;
 
-        glBindTexture(GL_TEXTURE_2D, src_surf->tex_id);
-
-        glMatrixMode(GL_TEXTURE);
-        glLoadIdentity();
-        glScalef(1.0f / src_surf->width, 1.0f / src_surf->height, 1.0f);
+        tex_id = src_surf->tex_id;
+        tex_width = src_surf->width;
+        tex_height = src_surf->height;
     }
 
     VdpRect d_rect = {0, 0, dst_surf->width, dst_surf->height};
@@ -867,8 +1076,8 @@ RenderOutputSurfaceImpl(VdpOutputSurface destination_surface, VdpRect const *des
     if (source_rect)
         s_rect = *source_rect;
 
-    compose_surfaces(bs, s_rect, d_rect, colors, flags, source_surface != VDP_INVALID_HANDLE);
-    glFinish();
+    record_draw(dst_surf, bs, tex_id, s_rect, tex_width, tex_height, d_rect, colors, flags,
+                glsl_texture_color);
 
     const auto gl_error = glGetError();
     if (gl_error != GL_NO_ERROR) {
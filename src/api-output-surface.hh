@@ -52,6 +52,18 @@ struct Resource: public vdp::GenericResource
     VdpPresentationQueueStatus  status; ///< status in presentation queue
 };
 
+/// sends draws recorded by RenderOutputSurface and RenderBitmapSurface to GL, and waits for
+/// them to complete. Must be called with device GLX context current, before contents of any
+/// output surface are used or changed by other means
+void
+flush_pending_draws(vdp::Device::Resource &device);
+
+/// flushes recorded draws only if some of them read given area of texture of given size,
+/// which is about to change
+void
+flush_pending_draws_reading(vdp::Device::Resource &device, GLuint tex_id, const VdpRect &area,
+                            uint32_t tex_width, uint32_t tex_height);
+
 VdpOutputSurfaceQueryCapabilities                   QueryCapabilities;
 VdpOutputSurfaceQueryGetPutBitsNativeCapabilities   QueryGetPutBitsNativeCapabilities;
 VdpOutputSurfaceQueryPutBitsIndexedCapabilities     QueryPutBitsIndexedCapabilities;
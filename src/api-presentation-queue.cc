@@ -28,6 +28,7 @@
 #include "globals.hh"
 #include "glx-context.hh"
 #include "handle-storage.hh"
+#include "quad-renderer.hh"
 #include "trace.hh"
 #include "watermark.hh"
 #include <GL/gl.h>
@@ -197,54 +198,36 @@ do_presentation_queue_display(const Task &task)
         const uint32_t target_width  = (clip_width > 0)  ? clip_width  : surface->width;
         const uint32_t target_height = (clip_height > 0) ? clip_height : surface->height;
 
-        glMatrixMode(GL_PROJECTION);
-        glLoadIdentity();
-        glOrtho(0, target_width, target_height, 0, -1.0, 1.0);
-        glViewport(0, 0, target_width, target_height);
+        // output surfaces are stored top line first, while window origin is at bottom
+        const auto &device = *pq->device;
+        const VdpRect src_rect = {0, 0, target_width, target_height};
+        const VdpRect dst_rect = {0, target_height, target_width, 0};
 
-        glMatrixMode(GL_MODELVIEW);
-        glLoadIdentity();
+        Quad quad{target_width, target_height, dst_rect};
+        quad.set_source(src_rect, surface->width, surface->height);
 
-        glMatrixMode(GL_TEXTURE);
-        glLoadIdentity();
-        glScalef(1.0f/surface->width, 1.0f/surface->height, 1.0f);
-
-        glEnable(GL_TEXTURE_2D);
+        bind_render_target(0, target_width, target_height);
         glDisable(GL_BLEND);
+        glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, surface->tex_id);
-        glColor4f(1, 1, 1, 1);
-        glBegin(GL_QUADS);
-            glTexCoord2i(0, 0);                        glVertex2i(0, 0);
-            glTexCoord2i(target_width, 0);             glVertex2i(target_width, 0);
-            glTexCoord2i(target_width, target_height); glVertex2i(target_width, target_height);
-            glTexCoord2i(0, target_height);            glVertex2i(0, target_height);
-        glEnd();
+        glUseProgram(device.shaders[glsl_texture_color].program);
+        draw_quad(device, glsl_texture_color, quad);
 
         if (global.quirks.show_watermark) {
+            const uint32_t wm_width = watermark_width;
+            const uint32_t wm_height = watermark_height;
+            const VdpRect wm_rect = {target_width - wm_width, wm_height, target_width, 0};
+            Quad wm_quad{target_width, target_height, wm_rect};
+            wm_quad.set_color(1.0f, 1.0f, 1.0f, 0.2f);
+
             glEnable(GL_BLEND);
             glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
             glBlendEquation(GL_FUNC_ADD);
-            glBindTexture(GL_TEXTURE_2D, pq->device->watermark_tex_id);
-
-            glMatrixMode(GL_TEXTURE);
-            glLoadIdentity();
-
-            glColor4f(1.0, 1.0, 1.0, 0.2);
-            glBegin(GL_QUADS);
-                glTexCoord2i(0, 0);
-                glVertex2i(target_width - watermark_width, target_height - watermark_height);
-
-                glTexCoord2i(1, 0);
-                glVertex2i(target_width, target_height - watermark_height);
-
-                glTexCoord2i(1, 1);
-                glVertex2i(target_width, target_height);
-
-                glTexCoord2i(0, 1);
-                glVertex2i(target_width - watermark_width, target_height);
-            glEnd();
+            glBindTexture(GL_TEXTURE_2D, device.watermark_tex_id);
+            draw_quad(device, glsl_texture_color, wm_quad);
         }
 
+        glUseProgram(0);
         glFinish();
 
         x11_push_eh();
@@ -437,6 +420,7 @@ TargetResource::~TargetResource()
         // drawable may be destroyed already, so it's a global context that should be activated
         {
             GLXThreadLocalContext guard{device, false}; // keep that context set afterwards
+            forget_quad_vao(glc);
             glXDestroyContext(device->dpy.get(), glc);  // since previous was just destroyed
             free_glx_pixmaps();
 
@@ -632,6 +616,12 @@ DisplayImpl(VdpPresentationQueue presentation_queue, VdpOutputSurface surface_id
     if (pq->device->id != surface->device->id)
         return VDP_STATUS_HANDLE_DEVICE_MISMATCH;
 
+    {
+        // queue thread reads the surface later, with its own context
+        GLXThreadLocalContext guard{surface->device};
+        vdp::OutputSurface::flush_pending_draws(*surface->device);
+    }
+
     Task task;
 
     task.when =        vdptime2timespec(earliest_presentation_time);
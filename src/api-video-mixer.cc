@@ -23,18 +23,29 @@
  */
 
 #define GL_GLEXT_PROTOTYPES
+#include "api-csc-matrix.hh"
 #include "api-device.hh"
 #include "api-output-surface.hh"
 #include "api-video-mixer.hh"
 #include "api-video-surface.hh"
 #include "glx-context.hh"
 #include "handle-storage.hh"
+#include "quad-renderer.hh"
 #include "trace.hh"
 #include <GL/gl.h>
+#include <algorithm>
+#include <memory>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <va/va_x11.h>
 #include <vdpau/vdpau.h>
+#include <vector>
+
+#if defined(HAVE_EGL) && VA_CHECK_VERSION(1, 1, 0)
+#include <va/va_drmcommon.h>
+#define USE_DMABUF_IMPORT 1
+#endif
 
 
 using std::make_shared;
@@ -43,95 +54,356 @@ using std::shared_ptr;
 
 namespace vdp { namespace VideoMixer {
 
+namespace {
+
+void
+destroy_mixer_pixmap(Display *dpy, const MixerPixmap &mp)
+{
+    glXDestroyPixmap(dpy, mp.glx_pixmap);
+    XFreePixmap(dpy, mp.pixmap);
+}
+
+} // anonymous namespace
+
 void
 Resource::free_video_mixer_pixmaps()
 {
     Display *dpy = device->dpy.get();
 
-    if (glx_pixmap != None) {
-        glXDestroyGLXPixmap(dpy, glx_pixmap);
-        glx_pixmap = None;
+    for (const auto &mp: pixmaps)
+        destroy_mixer_pixmap(dpy, mp);
+
+    pixmaps.clear();
+}
+
+const MixerPixmap &
+Resource::acquire_pixmap(uint32_t width, uint32_t height)
+{
+    for (auto it = pixmaps.begin(); it != pixmaps.end(); ++ it) {
+        if (it->width == width && it->height == height) {
+            // move to front, keeping the rest in order
+            std::rotate(pixmaps.begin(), it, it + 1);
+            return pixmaps.front();
+        }
     }
 
-    if (pixmap != None) {
-        XFreePixmap(dpy, pixmap);
-        pixmap = None;
+    Display *dpy = device->dpy.get();
+
+    if (pixmaps.size() >= static_cast<size_t>(kMixerPixmapCacheSize)) {
+        destroy_mixer_pixmap(dpy, pixmaps.back());
+        pixmaps.pop_back();
     }
+
+    int pixmap_attrs[] = {
+        GLX_TEXTURE_TARGET_EXT, GLX_TEXTURE_2D_EXT,
+        GLX_MIPMAP_TEXTURE_EXT, GL_FALSE,
+        GLX_TEXTURE_FORMAT_EXT, GLX_TEXTURE_FORMAT_RGB_EXT,
+        GL_NONE
+    };
+
+    MixerPixmap mp;
+    mp.width = width;
+    mp.height = height;
+    mp.pixmap = XCreatePixmap(dpy, device->root, width, height, device->color_depth);
+    mp.glx_pixmap = glXCreatePixmap(dpy, device->pixmap_fbconfig, mp.pixmap, pixmap_attrs);
+
+    pixmaps.insert(pixmaps.begin(), mp);
+    return pixmaps.front();
 }
 
+#ifdef USE_DMABUF_IMPORT
+
+namespace {
+
+const uint64_t kDrmFormatModInvalid = 0x00ffffffffffffffull;
+
+EGLImageKHR
+create_layer_image(const vdp::Device::Resource &device, const VADRMPRIMESurfaceDescriptor &desc,
+                   uint32_t layer_idx, uint32_t width, uint32_t height)
+{
+    const auto &layer = desc.layers[layer_idx];
+    const auto &object = desc.objects[layer.object_index[0]];
+
+    EGLint attrs[] = {
+        EGL_WIDTH,                      static_cast<EGLint>(width),
+        EGL_HEIGHT,                     static_cast<EGLint>(height),
+        EGL_LINUX_DRM_FOURCC_EXT,       static_cast<EGLint>(layer.drm_format),
+        EGL_DMA_BUF_PLANE0_FD_EXT,      object.fd,
+        EGL_DMA_BUF_PLANE0_OFFSET_EXT,  static_cast<EGLint>(layer.offset[0]),
+        EGL_DMA_BUF_PLANE0_PITCH_EXT,   static_cast<EGLint>(layer.pitch[0]),
+        EGL_NONE,                       EGL_NONE,
+        EGL_NONE,                       EGL_NONE,
+        EGL_NONE
+    };
+
+    if (device.dmabuf.has_modifiers && object.drm_format_modifier != kDrmFormatModInvalid) {
+        const uint64_t modifier = object.drm_format_modifier;
+        attrs[12] = EGL_DMA_BUF_PLANE0_MODIFIER_LO_EXT;
+        attrs[13] = static_cast<EGLint>(modifier & 0xffffffff);
+        attrs[14] = EGL_DMA_BUF_PLANE0_MODIFIER_HI_EXT;
+        attrs[15] = static_cast<EGLint>(modifier >> 32);
+    }
+
+    return device.dmabuf.eglCreateImageKHR(device.dmabuf.egl_dpy, EGL_NO_CONTEXT,
+                                           EGL_LINUX_DMA_BUF_EXT, nullptr, attrs);
+}
+
+} // anonymous namespace
+
+/// converts decoded surface to RGBA without going through X server. Both planes of exported
+/// NV12 or P010 surface are imported as textures, then converted by the same shader PutBitsYCbCr uses.
+/// Returns false if import has failed, and pixmap path should be used instead
+bool
+import_va_surf_dmabuf(shared_ptr<Resource> mixer, shared_ptr<vdp::VideoSurface::Resource> src_surf)
+{
+    auto &device = *mixer->device;
+
+    // exported buffer is read by GL directly, so decoding must be complete
+    if (vaSyncSurface(device.va_dpy, src_surf->va_surf) != VA_STATUS_SUCCESS)
+        return false;
+
+    VADRMPRIMESurfaceDescriptor desc;
+    VAStatus status = vaExportSurfaceHandle(device.va_dpy, src_surf->va_surf,
+                                            VA_SURFACE_ATTRIB_MEM_TYPE_DRM_PRIME_2,
+                                            VA_EXPORT_SURFACE_READ_ONLY |
+                                                VA_EXPORT_SURFACE_SEPARATE_LAYERS,
+                                            &desc);
+    if (status != VA_STATUS_SUCCESS) {
+        traceError("VideoMixer::import_va_surf_dmabuf(): vaExportSurfaceHandle failed, "
+                   "status = %d. Falling back to pixmap\n", status);
+        device.dmabuf.available = false;
+        return false;
+    }
+
+    // P010 layers come as R16 and GR1616, which sample the same way as NV12 R8 and GR88 ones.
+    // 10-bit values in upper bits read 0.1% darker than exact, which is below 8-bit precision
+    // of the converted surface
+    if ((desc.fourcc != VA_FOURCC_NV12 && desc.fourcc != VA_FOURCC_P010) ||
+        desc.num_layers != 2)
+    {
+        // that's about this surface only, others may still be imported
+        if (mixer->dmabuf_skipped_fourcc != desc.fourcc) {
+            traceInfo("VideoMixer::import_va_surf_dmabuf(): surfaces of format 0x%08x are not "
+                      "imported, copying them through pixmap\n", desc.fourcc);
+            mixer->dmabuf_skipped_fourcc = desc.fourcc;
+        }
+
+        for (uint32_t k = 0; k < desc.num_objects; k ++)
+            close(desc.objects[k].fd);
+
+        return false;
+    }
+
+    EGLImageKHR images[2];
+    images[0] = create_layer_image(device, desc, 0, src_surf->width, src_surf->height);
+    images[1] = create_layer_image(device, desc, 1, (src_surf->width + 1) / 2,
+                                   (src_surf->height + 1) / 2);
+    bool ok = (images[0] != EGL_NO_IMAGE_KHR && images[1] != EGL_NO_IMAGE_KHR);
+
+    if (ok) {
+        for (int k = 0; k < 2; k ++) {
+            glActiveTexture(GL_TEXTURE0 + k);
+            glBindTexture(GL_TEXTURE_2D, mixer->dmabuf_tex_id[k]);
+            device.dmabuf.glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, images[k]);
+        }
+
+        // EGL images may be rejected by GLX context. That's only seen as GL error
+        ok = (glGetError() == GL_NO_ERROR);
+    }
+
+    if (ok) {
+        const VdpRect dst_rect = {0, 0, src_surf->width, src_surf->height};
+
+        bind_render_target(src_surf->fbo_id, src_surf->width, src_surf->height);
+        glDisable(GL_BLEND);
+
+        // raw Y, Cb, Cr are at hand, so mixer matrix is applied directly, rather than
+        // corrected for on already clipped RGB. Program is shared with video surfaces, which
+        // expect the reference matrix
+        VdpCSCMatrix reference;
+        compute_csc_matrix(nullptr, ColorStandard::bt601, true, &reference);
+
+        glUseProgram(device.shaders[glsl_NV12_RGBA].program);
+        device.set_csc_uniform(glsl_NV12_RGBA, mixer->csc_matrix);
+        draw_quad(device, glsl_NV12_RGBA, Quad{src_surf->width, src_surf->height, dst_rect});
+        device.set_csc_uniform(glsl_NV12_RGBA, reference);
+        glUseProgram(0);
+        glFinish();
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        memcpy(src_surf->applied_csc, mixer->csc_matrix, sizeof(VdpCSCMatrix));
+    } else {
+        traceError("VideoMixer::import_va_surf_dmabuf(): can't import surface of format "
+                   "0x%08x. Falling back to pixmap\n", desc.fourcc);
+        device.dmabuf.available = false;
+    }
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    for (auto image: images) {
+        if (image != EGL_NO_IMAGE_KHR)
+            device.dmabuf.eglDestroyImageKHR(device.dmabuf.egl_dpy, image);
+    }
+
+    for (uint32_t k = 0; k < desc.num_objects; k ++)
+        close(desc.objects[k].fd);
+
+    return ok;
+}
+
+#endif // USE_DMABUF_IMPORT
+
 void
 render_va_surf_to_texture(shared_ptr<Resource> mixer,
                           shared_ptr<vdp::VideoSurface::Resource> src_surf)
 {
+#ifdef USE_DMABUF_IMPORT
+    if (mixer->device->dmabuf.available && import_va_surf_dmabuf(mixer, src_surf))
+        return;
+#endif
+
     auto deviceData = mixer->device;
     Display *dpy = mixer->device->dpy.get();
 
-    if (src_surf->width != mixer->pixmap_width || src_surf->height != mixer->pixmap_height) {
-        mixer->free_video_mixer_pixmaps();
-        mixer->pixmap = XCreatePixmap(dpy, mixer->device->root, src_surf->width, src_surf->height,
-                                      mixer->device->color_depth);
-
-        int fbconfig_attrs[] = {
-            GLX_DRAWABLE_TYPE,  GLX_PIXMAP_BIT,
-            GLX_RENDER_TYPE,    GLX_RGBA_BIT,
-            GLX_X_RENDERABLE,   GL_TRUE,
-            GLX_Y_INVERTED_EXT, GL_TRUE,
-            GLX_RED_SIZE,       8,
-            GLX_GREEN_SIZE,     8,
-            GLX_BLUE_SIZE,      8,
-            GLX_ALPHA_SIZE,     8,
-            GLX_DEPTH_SIZE,     16,
-            GLX_BIND_TO_TEXTURE_RGBA_EXT,     GL_TRUE,
-            GL_NONE
-        };
-
-        int nconfigs;
-        GLXFBConfig *fbconfig = glXChooseFBConfig(dpy, mixer->device->screen, fbconfig_attrs,
-                                                  &nconfigs);
-        int pixmap_attrs[] = {
-            GLX_TEXTURE_TARGET_EXT, GLX_TEXTURE_2D_EXT,
-            GLX_MIPMAP_TEXTURE_EXT, GL_FALSE,
-            GLX_TEXTURE_FORMAT_EXT, GLX_TEXTURE_FORMAT_RGB_EXT,
-            GL_NONE
-        };
-
-        mixer->glx_pixmap = glXCreatePixmap(dpy, fbconfig[0], mixer->pixmap, pixmap_attrs);
-        free(fbconfig);
-        mixer->pixmap_width = src_surf->width;
-        mixer->pixmap_height = src_surf->height;
-    }
-
-    glBindTexture(GL_TEXTURE_2D, mixer->tex_id);
-    mixer->device->fn.glXBindTexImageEXT(dpy, mixer->glx_pixmap, GLX_FRONT_EXT, NULL);
-    XSync(dpy, False); // TODO: avoid XSync
-
-    vaPutSurface(mixer->device->va_dpy, src_surf->va_surf, mixer->pixmap,
-                 0, 0, src_surf->width, src_surf->height,
-                 0, 0, src_surf->width, src_surf->height,
-                 nullptr, 0, VA_FRAME_PICTURE);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, src_surf->fbo_id);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0, src_surf->width, 0, src_surf->height, -1.0, 1.0);
-    glViewport(0, 0, src_surf->width, src_surf->height);
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-    glMatrixMode(GL_TEXTURE);
-    glLoadIdentity();
+    const MixerPixmap &mp = mixer->acquire_pixmap(src_surf->width, src_surf->height);
+
+    GLsync x11_sync = nullptr;
+
+    if (mixer->x11_fence != None) {
+        // X server triggers the fence after all previous requests, including ones made by
+        // vaPutSurface, are done. GL waits for it on GPU side, so CPU never blocks on X
+        vaPutSurface(mixer->device->va_dpy, src_surf->va_surf, mp.pixmap,
+                     0, 0, src_surf->width, src_surf->height,
+                     0, 0, src_surf->width, src_surf->height,
+                     nullptr, 0, VA_FRAME_PICTURE);
+        XSyncTriggerFence(dpy, mixer->x11_fence);
+        XFlush(dpy);
 
+        x11_sync = mixer->device->fn.glImportSyncEXT(GL_SYNC_X11_FENCE_EXT, mixer->x11_fence, 0);
+        glWaitSync(x11_sync, 0, GL_TIMEOUT_IGNORED);
+
+        glBindTexture(GL_TEXTURE_2D, mixer->tex_id);
+        mixer->device->fn.glXBindTexImageEXT(dpy, mp.glx_pixmap, GLX_FRONT_EXT, NULL);
+
+    } else {
+        glBindTexture(GL_TEXTURE_2D, mixer->tex_id);
+        mixer->device->fn.glXBindTexImageEXT(dpy, mp.glx_pixmap, GLX_FRONT_EXT, NULL);
+        XSync(dpy, False);
+
+        vaPutSurface(mixer->device->va_dpy, src_surf->va_surf, mp.pixmap,
+                     0, 0, src_surf->width, src_surf->height,
+                     0, 0, src_surf->width, src_surf->height,
+                     nullptr, 0, VA_FRAME_PICTURE);
+    }
+
+    const VdpRect dst_rect = {0, 0, src_surf->width, src_surf->height};
+
+    bind_render_target(src_surf->fbo_id, src_surf->width, src_surf->height);
     glDisable(GL_BLEND);
 
-    glBegin(GL_QUADS);
-        glTexCoord2f(0, 0); glVertex2f(0,               0);
-        glTexCoord2f(1, 0); glVertex2f(src_surf->width, 0);
-        glTexCoord2f(1, 1); glVertex2f(src_surf->width, src_surf->height);
-        glTexCoord2f(0, 1); glVertex2f(0,               src_surf->height);
-    glEnd();
+    glUseProgram(deviceData->shaders[glsl_texture_color].program);
+    draw_quad(*deviceData, glsl_texture_color, Quad{src_surf->width, src_surf->height, dst_rect});
+    glUseProgram(0);
     glFinish();
 
-    mixer->device->fn.glXReleaseTexImageEXT(dpy, mixer->glx_pixmap, GLX_FRONT_EXT);
+    mixer->device->fn.glXReleaseTexImageEXT(dpy, mp.glx_pixmap, GLX_FRONT_EXT);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // VA-API drivers are assumed to treat video as limited range BT.601, as most of them do
+    compute_csc_matrix(nullptr, ColorStandard::bt601, false, &src_surf->applied_csc);
+
+    if (x11_sync) {
+        // GL is done waiting after glFinish(), fence can be reused for the next frame
+        glDeleteSync(x11_sync);
+        XSyncResetFence(dpy, mixer->x11_fence);
+    }
+}
+
+/// draws src area of texture into dst area of current framebuffer, which has given size, with
+/// program of device shader. Program must be in use. Both rectangles are in pixels
+void
+draw_texture_rect(const vdp::Device::Resource &device, int shader, uint32_t target_width,
+                  uint32_t target_height, GLuint tex_id, uint32_t tex_width, uint32_t tex_height,
+                  const VdpRect &src, const VdpRect &dst)
+{
+    Quad quad{target_width, target_height, dst};
+    quad.set_source(src, tex_width, tex_height);
+
+    glBindTexture(GL_TEXTURE_2D, tex_id);
+    draw_quad(device, shader, quad);
+}
+
+/// one pass of separable high quality scaling. Scales area of texture starting at src_origin
+/// along axis (0 for horizontal, 1 for vertical) from src_length to length of dst area of
+/// current framebuffer, which has given size. Size across the axis is kept. Result is color
+/// corrected with csc
+void
+draw_scaling_pass(shared_ptr<Resource> mixer, ScalingKernel kernel, GLuint tex_id,
+                  uint32_t tex_width, uint32_t tex_height, uint32_t src_x0, uint32_t src_y0,
+                  uint32_t src_length, uint32_t target_width, uint32_t target_height,
+                  const VdpRect &dst, int axis, const VdpCSCMatrix &csc)
+{
+    const auto &shader = mixer->device->shaders[glsl_scale];
+    const uint32_t dst_length = (axis == 0) ? dst.x1 - dst.x0 : dst.y1 - dst.y0;
+    const auto &weights = mixer->acquire_scaling_weights(kernel, src_length, dst_length);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, weights.tex_id);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, tex_id);
+
+    glUseProgram(shader.program);
+    glUniform2f(shader.uniform.src_size, tex_width, tex_height);
+    glUniform2f(shader.uniform.src_origin, src_x0, src_y0);
+    glUniform1f(shader.uniform.src_length, src_length);
+    glUniform2f(shader.uniform.dst_origin, dst.x0, dst.y0);
+    glUniform1f(shader.uniform.dst_length, dst_length);
+    glUniform1f(shader.uniform.taps, weights.taps);
+    glUniform2f(shader.uniform.axis, axis == 0 ? 1.0f : 0.0f, axis == 0 ? 0.0f : 1.0f);
+    mixer->device->set_csc_uniform(glsl_scale, csc);
+
+    draw_quad(*mixer->device, glsl_scale, Quad{target_width, target_height, dst});
+    glUseProgram(0);
+}
+
+enum class DeinterlaceMode
+{
+    bob =               0,  ///< interpolation within current field
+    temporal =          1,  ///< motion adaptive, using neighbouring fields
+    temporal_spatial =  2,  ///< motion adaptive, with edge-directed interpolation
+};
+
+/// renders frame made of the current field and interpolated missing lines into mixer's
+/// deinterlacing target. surfaces are current, past and future frames; only the current one
+/// is needed for bob
+void
+deinterlace_field(shared_ptr<Resource> mixer,
+                  const std::vector<shared_ptr<vdp::VideoSurface::Resource>> &surfaces,
+                  bool bottom_field, DeinterlaceMode mode)
+{
+    const auto &shader = mixer->device->shaders[glsl_deinterlace];
+    const uint32_t width = surfaces[0]->width;
+    const uint32_t height = surfaces[0]->height;
+
+    bind_render_target(mixer->deint_target.fbo_id, width, height);
+    glDisable(GL_BLEND);
+
+    // past and future frames are only sampled by temporal modes. Bind current frame in their
+    // place for bob, so all samplers refer to valid textures
+    for (int k = 2; k >= 0; k --) {
+        glActiveTexture(GL_TEXTURE0 + k);
+        glBindTexture(GL_TEXTURE_2D, surfaces[k < (int)surfaces.size() ? k : 0]->tex_id);
+    }
+
+    glUseProgram(shader.program);
+    glUniform2f(shader.uniform.texel_size, 1.0f / width, 1.0f / height);
+    glUniform1f(shader.uniform.parity, bottom_field ? 1.0f : 0.0f);
+    glUniform1i(shader.uniform.mode, static_cast<int>(mode));
+
+    const VdpRect dst_rect = {0, 0, width, height};
+    draw_quad(*mixer->device, glsl_deinterlace, Quad{width, height, dst_rect});
+    glUseProgram(0);
 }
 
 Resource::Resource(shared_ptr<vdp::Device::Resource> a_device, uint32_t a_feature_count,
@@ -139,17 +411,69 @@ Resource::Resource(shared_ptr<vdp::Device::Resource> a_device, uint32_t a_featur
                    VdpVideoMixerParameter const *a_parameters,
                    void const *const *a_parameter_values)
 {
-    std::ignore = a_feature_count;
-    std::ignore = a_features;             // TODO: mixer features
-    std::ignore = a_parameter_count;
-    std::ignore = a_parameters;
-    std::ignore = a_parameter_values;     // TODO: mixer parameters
-
     device =        a_device;
-    pixmap =        None;
-    glx_pixmap =    None;
-    pixmap_width =  (uint32_t)(-1); // set knowingly invalid geometry
-    pixmap_height = (uint32_t)(-1); // to force pixmap recreation
+    x11_fence =     None;
+    video_width =   0;
+    video_height =  0;
+    chroma_type =   VDP_CHROMA_TYPE_420;
+    layers =        0;
+    deint_target =  RenderTarget{0, 0, 0, 0};
+    scale_target =  RenderTarget{0, 0, 0, 0};
+
+    // VDPAU default is BT.601
+    compute_csc_matrix(nullptr, ColorStandard::bt601, false, &csc_matrix);
+    csc_correction_valid = false;
+
+    if (a_feature_count > 0 && !a_features)
+        throw vdp::invalid_value();
+
+    // unsupported features are ignored, applications are expected to query support first
+    for (uint32_t k = 0; k < a_feature_count; k ++) {
+        if (is_feature_supported(a_features[k]))
+            features[a_features[k]] = false;
+    }
+
+    if (a_parameter_count > 0 && (!a_parameters || !a_parameter_values))
+        throw vdp::invalid_value();
+
+    for (uint32_t k = 0; k < a_parameter_count; k ++) {
+        const void *value = a_parameter_values[k];
+        if (!value)
+            throw vdp::invalid_value();
+
+        switch (a_parameters[k]) {
+        case VDP_VIDEO_MIXER_PARAMETER_VIDEO_SURFACE_WIDTH:
+            video_width = *static_cast<const uint32_t *>(value);
+            if (video_width < kMixerMinVideoSize || video_width > device->max_video_width)
+                throw vdp::invalid_value();
+            break;
+
+        case VDP_VIDEO_MIXER_PARAMETER_VIDEO_SURFACE_HEIGHT:
+            video_height = *static_cast<const uint32_t *>(value);
+            if (video_height < kMixerMinVideoSize || video_height > device->max_video_height)
+                throw vdp::invalid_value();
+            break;
+
+        case VDP_VIDEO_MIXER_PARAMETER_CHROMA_TYPE:
+            chroma_type = *static_cast<const VdpChromaType *>(value);
+            if (chroma_type != VDP_CHROMA_TYPE_420 &&
+                chroma_type != VDP_CHROMA_TYPE_422 &&
+                chroma_type != VDP_CHROMA_TYPE_444)
+            {
+                throw vdp::invalid_value();
+            }
+            break;
+
+        case VDP_VIDEO_MIXER_PARAMETER_LAYERS:
+            layers = *static_cast<const uint32_t *>(value);
+            if (layers > kMixerMaxLayers)
+                throw vdp::invalid_value();
+            break;
+
+        default:
+            throw vdp::invalid_video_mixer_parameter();
+        }
+    }
 
     {
         GLXThreadLocalContext guard{device};
@@ -161,12 +485,188 @@ Resource::Resource(shared_ptr<vdp::Device::Resource> a_device, uint32_t a_featur
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
+        if (device->fn.glImportSyncEXT)
+            x11_fence = XSyncCreateFence(device->dpy.get(), device->root, False);
+
+        glGenTextures(2, dmabuf_tex_id);
+        dmabuf_skipped_fourcc = 0;
+        for (auto dmabuf_tex: dmabuf_tex_id) {
+            glBindTexture(GL_TEXTURE_2D, dmabuf_tex);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        }
+
         const auto gl_error = glGetError();
         if (gl_error != GL_NO_ERROR) {
             traceError("VideoMixer::Resource::Resource(): gl error %d\n", gl_error);
             throw vdp::generic_error();
         }
+
+        warm_up();
+    }
+}
+
+bool
+is_feature_supported(VdpVideoMixerFeature feature)
+{
+    switch (feature) {
+    case VDP_VIDEO_MIXER_FEATURE_DEINTERLACE_TEMPORAL:
+    case VDP_VIDEO_MIXER_FEATURE_DEINTERLACE_TEMPORAL_SPATIAL:
+    case VDP_VIDEO_MIXER_FEATURE_HIGH_QUALITY_SCALING_L1:
+    case VDP_VIDEO_MIXER_FEATURE_HIGH_QUALITY_SCALING_L2:
+    case VDP_VIDEO_MIXER_FEATURE_HIGH_QUALITY_SCALING_L3:
+    case VDP_VIDEO_MIXER_FEATURE_HIGH_QUALITY_SCALING_L4:
+    case VDP_VIDEO_MIXER_FEATURE_HIGH_QUALITY_SCALING_L5:
+    case VDP_VIDEO_MIXER_FEATURE_HIGH_QUALITY_SCALING_L6:
+    case VDP_VIDEO_MIXER_FEATURE_HIGH_QUALITY_SCALING_L7:
+    case VDP_VIDEO_MIXER_FEATURE_HIGH_QUALITY_SCALING_L8:
+    case VDP_VIDEO_MIXER_FEATURE_HIGH_QUALITY_SCALING_L9:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+const VdpCSCMatrix *
+Resource::csc_correction_for(const VdpCSCMatrix &applied)
+{
+    // surfaces imported through DMA-BUF are converted with csc_matrix itself
+    if (memcmp(applied, csc_matrix, sizeof(VdpCSCMatrix)) == 0)
+        return nullptr;
+
+    if (!csc_correction_valid ||
+        memcmp(applied, csc_correction_applied, sizeof(VdpCSCMatrix)) != 0)
+    {
+        compute_csc_correction(csc_matrix, applied, &csc_correction);
+        memcpy(csc_correction_applied, applied, sizeof(VdpCSCMatrix));
+        csc_is_identity = is_identity_csc(csc_correction);
+        csc_correction_valid = true;
+    }
+
+    return csc_is_identity ? nullptr : &csc_correction;
+}
+
+bool
+Resource::feature_enabled(VdpVideoMixerFeature feature) const
+{
+    const auto it = features.find(feature);
+    return it != features.end() && it->second;
+}
+
+void
+Resource::ensure_render_target(RenderTarget &target, uint32_t width, uint32_t height)
+{
+    if (width == target.width && height == target.height)
+        return;
+
+    if (target.tex_id == 0) {
+        glGenTextures(1, &target.tex_id);
+        glGenFramebuffers(1, &target.fbo_id);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, target.tex_id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, target.fbo_id);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.tex_id, 0);
+    const GLenum fb_status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (fb_status != GL_FRAMEBUFFER_COMPLETE) {
+        traceError("VideoMixer::Resource::ensure_render_target(): framebuffer not ready, %d\n",
+                   fb_status);
+        throw vdp::generic_error();
+    }
+
+    target.width = width;
+    target.height = height;
+}
+
+const ScalingWeightsTexture &
+Resource::acquire_scaling_weights(ScalingKernel kernel, uint32_t src_length, uint32_t dst_length)
+{
+    for (auto it = scaling_weights.begin(); it != scaling_weights.end(); ++ it) {
+        if (it->kernel == kernel && it->src_length == src_length &&
+            it->dst_length == dst_length)
+        {
+            std::rotate(scaling_weights.begin(), it, it + 1);
+            return scaling_weights.front();
+        }
+    }
+
+    if (scaling_weights.size() >= static_cast<size_t>(kMixerScalingWeightsCacheSize)) {
+        glDeleteTextures(1, &scaling_weights.back().tex_id);
+        scaling_weights.pop_back();
+    }
+
+    const ScalingWeights weights = compute_scaling_weights(kernel, src_length, dst_length);
+
+    ScalingWeightsTexture swt{kernel, src_length, dst_length, weights.taps, 0};
+    glGenTextures(1, &swt.tex_id);
+    glBindTexture(GL_TEXTURE_2D, swt.tex_id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16, dst_length, weights.taps + 1, 0, GL_RED,
+                 GL_UNSIGNED_SHORT, weights.texels.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    scaling_weights.insert(scaling_weights.begin(), swt);
+    return scaling_weights.front();
+}
+
+int
+Resource::scaling_level() const
+{
+    for (int level = 9; level >= 1; level --) {
+        const auto feature = static_cast<VdpVideoMixerFeature>(
+            VDP_VIDEO_MIXER_FEATURE_HIGH_QUALITY_SCALING_L1 + level - 1);
+
+        if (feature_enabled(feature))
+            return level;
+    }
+
+    return 0;
+}
+
+void
+Resource::warm_up()
+{
+    if (video_width != 0 && video_height != 0 &&
+        (features.count(VDP_VIDEO_MIXER_FEATURE_DEINTERLACE_TEMPORAL) > 0 ||
+         features.count(VDP_VIDEO_MIXER_FEATURE_DEINTERLACE_TEMPORAL_SPATIAL) > 0))
+    {
+        ensure_render_target(deint_target, video_width, video_height);
     }
+
+    // surfaces decoded by VA-API reach GL through pixmap unless DMA-BUF import works
+    if (video_width == 0 || video_height == 0 || !device->va_available ||
+        device->dmabuf.available)
+    {
+        return;
+    }
+
+    Display *dpy = device->dpy.get();
+    const MixerPixmap &mp = acquire_pixmap(video_width, video_height);
+
+    // first bind makes driver fetch pixmap buffers from X server, do it now instead of in Render
+    glBindTexture(GL_TEXTURE_2D, tex_id);
+    device->fn.glXBindTexImageEXT(dpy, mp.glx_pixmap, GLX_FRONT_EXT, nullptr);
+    device->fn.glXReleaseTexImageEXT(dpy, mp.glx_pixmap, GLX_FRONT_EXT);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    const auto gl_error = glGetError();
+    if (gl_error != GL_NO_ERROR)
+        traceError("VideoMixer::Resource::warm_up(): gl error %d\n", gl_error);
 }
 
 Resource::~Resource()
@@ -175,12 +675,26 @@ Resource::~Resource()
         {
             GLXLockGuard guard;
             free_video_mixer_pixmaps();
+
+            if (x11_fence != None)
+                XSyncDestroyFence(device->dpy.get(), x11_fence);
         }
 
         {
             GLXThreadLocalContext guard{device};
 
             glDeleteTextures(1, &tex_id);
+            glDeleteTextures(2, dmabuf_tex_id);
+
+            for (auto *target: {&deint_target, &scale_target}) {
+                if (target->tex_id != 0) {
+                    glDeleteFramebuffers(1, &target->fbo_id);
+                    glDeleteTextures(1, &target->tex_id);
+                }
+            }
+
+            for (const auto &swt: scaling_weights)
+                glDeleteTextures(1, &swt.tex_id);
 
             const auto gl_error = glGetError();
             if (gl_error != GL_NO_ERROR)
@@ -234,15 +748,29 @@ Destroy(VdpVideoMixer mixer_id)
 }
 
 VdpStatus
-GetAttributeValuesImpl(VdpVideoMixer mixer, uint32_t attribute_count,
+GetAttributeValuesImpl(VdpVideoMixer mixer_id, uint32_t attribute_count,
                        VdpVideoMixerAttribute const *attributes, void *const *attribute_values)
 {
-    std::ignore = mixer;
-    std::ignore = attribute_count;
-    std::ignore = attributes;
-    std::ignore = attribute_values;
+    if (attribute_count > 0 && (!attributes || !attribute_values))
+        return VDP_STATUS_INVALID_POINTER;
 
-    return VDP_STATUS_NO_IMPLEMENTATION;
+    ResourceRef<Resource> mixer{mixer_id};
+
+    for (uint32_t k = 0; k < attribute_count; k ++) {
+        if (!attribute_values[k])
+            return VDP_STATUS_INVALID_POINTER;
+
+        switch (attributes[k]) {
+        case VDP_VIDEO_MIXER_ATTRIBUTE_CSC_MATRIX:
+            memcpy(attribute_values[k], mixer->csc_matrix, sizeof(VdpCSCMatrix));
+            break;
+
+        default:
+            return VDP_STATUS_INVALID_VIDEO_MIXER_ATTRIBUTE;
+        }
+    }
+
+    return VDP_STATUS_OK;
 }
 
 VdpStatus
@@ -254,15 +782,18 @@ GetAttributeValues(VdpVideoMixer mixer, uint32_t attribute_count,
 }
 
 VdpStatus
-GetFeatureEnablesImpl(VdpVideoMixer mixer, uint32_t feature_count,
+GetFeatureEnablesImpl(VdpVideoMixer mixer_id, uint32_t feature_count,
                       VdpVideoMixerFeature const *features, VdpBool *feature_enables)
 {
-    std::ignore = mixer;
-    std::ignore = feature_count;
-    std::ignore = features;
-    std::ignore = feature_enables;
+    if (feature_count > 0 && (!features || !feature_enables))
+        return VDP_STATUS_INVALID_POINTER;
 
-    return VDP_STATUS_NO_IMPLEMENTATION;
+    ResourceRef<Resource> mixer{mixer_id};
+
+    for (uint32_t k = 0; k < feature_count; k ++)
+        feature_enables[k] = mixer->feature_enabled(features[k]) ? VDP_TRUE : VDP_FALSE;
+
+    return VDP_STATUS_OK;
 }
 
 VdpStatus
@@ -274,15 +805,18 @@ GetFeatureEnables(VdpVideoMixer mixer, uint32_t feature_count, VdpVideoMixerFeat
 }
 
 VdpStatus
-GetFeatureSupportImpl(VdpVideoMixer mixer, uint32_t feature_count,
+GetFeatureSupportImpl(VdpVideoMixer mixer_id, uint32_t feature_count,
                       VdpVideoMixerFeature const *features, VdpBool *feature_supports)
 {
-    std::ignore = mixer;
-    std::ignore = feature_count;
-    std::ignore = features;
-    std::ignore = feature_supports;
+    if (feature_count > 0 && (!features || !feature_supports))
+        return VDP_STATUS_INVALID_POINTER;
 
-    return VDP_STATUS_NO_IMPLEMENTATION;
+    ResourceRef<Resource> mixer{mixer_id};
+
+    for (uint32_t k = 0; k < feature_count; k ++)
+        feature_supports[k] = mixer->features.count(features[k]) > 0 ? VDP_TRUE : VDP_FALSE;
+
+    return VDP_STATUS_OK;
 }
 
 VdpStatus
@@ -294,15 +828,41 @@ GetFeatureSupport(VdpVideoMixer mixer, uint32_t feature_count, VdpVideoMixerFeat
 }
 
 VdpStatus
-GetParameterValuesImpl(VdpVideoMixer mixer, uint32_t parameter_count,
+GetParameterValuesImpl(VdpVideoMixer mixer_id, uint32_t parameter_count,
                        VdpVideoMixerParameter const *parameters, void *const *parameter_values)
 {
-    std::ignore = mixer;
-    std::ignore = parameter_count;
-    std::ignore = parameters;
-    std::ignore = parameter_values;
+    if (parameter_count > 0 && (!parameters || !parameter_values))
+        return VDP_STATUS_INVALID_POINTER;
 
-    return VDP_STATUS_NO_IMPLEMENTATION;
+    ResourceRef<Resource> mixer{mixer_id};
+
+    for (uint32_t k = 0; k < parameter_count; k ++) {
+        if (!parameter_values[k])
+            return VDP_STATUS_INVALID_POINTER;
+
+        switch (parameters[k]) {
+        case VDP_VIDEO_MIXER_PARAMETER_VIDEO_SURFACE_WIDTH:
+            memcpy(parameter_values[k], &mixer->video_width, sizeof(mixer->video_width));
+            break;
+
+        case VDP_VIDEO_MIXER_PARAMETER_VIDEO_SURFACE_HEIGHT:
+            memcpy(parameter_values[k], &mixer->video_height, sizeof(mixer->video_height));
+            break;
+
+        case VDP_VIDEO_MIXER_PARAMETER_CHROMA_TYPE:
+            memcpy(parameter_values[k], &mixer->chroma_type, sizeof(mixer->chroma_type));
+            break;
+
+        case VDP_VIDEO_MIXER_PARAMETER_LAYERS:
+            memcpy(parameter_values[k], &mixer->layers, sizeof(mixer->layers));
+            break;
+
+        default:
+            return VDP_STATUS_INVALID_VIDEO_MIXER_PARAMETER;
+        }
+    }
+
+    return VDP_STATUS_OK;
 }
 
 VdpStatus
@@ -314,13 +874,25 @@ GetParameterValues(VdpVideoMixer mixer, uint32_t parameter_count,
 }
 
 VdpStatus
-QueryAttributeSupportImpl(VdpDevice device, VdpVideoMixerAttribute attribute, VdpBool *is_supported)
+QueryAttributeSupportImpl(VdpDevice device_id, VdpVideoMixerAttribute attribute,
+                          VdpBool *is_supported)
 {
-    std::ignore = device;
-    std::ignore = attribute;
-    std::ignore = is_supported;
+    if (!is_supported)
+        return VDP_STATUS_INVALID_POINTER;
 
-    return VDP_STATUS_NO_IMPLEMENTATION;
+    ResourceRef<vdp::Device::Resource> device{device_id};
+
+    switch (attribute) {
+    case VDP_VIDEO_MIXER_ATTRIBUTE_CSC_MATRIX:
+        *is_supported = VDP_TRUE;
+        break;
+
+    default:
+        *is_supported = VDP_FALSE;
+        break;
+    }
+
+    return VDP_STATUS_OK;
 }
 
 VdpStatus
@@ -350,13 +922,15 @@ QueryAttributeValueRange(VdpDevice device, VdpVideoMixerAttribute attribute, voi
 }
 
 VdpStatus
-QueryFeatureSupportImpl(VdpDevice device, VdpVideoMixerFeature feature, VdpBool *is_supported)
+QueryFeatureSupportImpl(VdpDevice device_id, VdpVideoMixerFeature feature, VdpBool *is_supported)
 {
-    std::ignore = device;
-    std::ignore = feature;
-    std::ignore = is_supported;
+    if (!is_supported)
+        return VDP_STATUS_INVALID_POINTER;
 
-    return VDP_STATUS_NO_IMPLEMENTATION;
+    ResourceRef<vdp::Device::Resource> device{device_id};
+
+    *is_supported = is_feature_supported(feature) ? VDP_TRUE : VDP_FALSE;
+    return VDP_STATUS_OK;
 }
 
 VdpStatus
@@ -366,13 +940,28 @@ QueryFeatureSupport(VdpDevice device, VdpVideoMixerFeature feature, VdpBool *is_
 }
 
 VdpStatus
-QueryParameterSupportImpl(VdpDevice device, VdpVideoMixerParameter parameter, VdpBool *is_supported)
+QueryParameterSupportImpl(VdpDevice device_id, VdpVideoMixerParameter parameter,
+                          VdpBool *is_supported)
 {
-    std::ignore = device;
-    std::ignore = parameter;
-    std::ignore = is_supported;
+    if (!is_supported)
+        return VDP_STATUS_INVALID_POINTER;
 
-    return VDP_STATUS_NO_IMPLEMENTATION;
+    ResourceRef<vdp::Device::Resource> device{device_id};
+
+    switch (parameter) {
+    case VDP_VIDEO_MIXER_PARAMETER_VIDEO_SURFACE_WIDTH:
+    case VDP_VIDEO_MIXER_PARAMETER_VIDEO_SURFACE_HEIGHT:
+    case VDP_VIDEO_MIXER_PARAMETER_CHROMA_TYPE:
+    case VDP_VIDEO_MIXER_PARAMETER_LAYERS:
+        *is_supported = VDP_TRUE;
+        break;
+
+    default:
+        *is_supported = VDP_FALSE;
+        break;
+    }
+
+    return VDP_STATUS_OK;
 }
 
 VdpStatus
@@ -382,28 +971,39 @@ QueryParameterSupport(VdpDevice device, VdpVideoMixerParameter parameter, VdpBoo
 }
 
 VdpStatus
-QueryParameterValueRangeImpl(VdpDevice device, VdpVideoMixerParameter parameter, void *min_value,
-                             void *max_value)
+QueryParameterValueRangeImpl(VdpDevice device_id, VdpVideoMixerParameter parameter,
+                             void *min_value, void *max_value)
 {
+    if (!min_value || !max_value)
+        return VDP_STATUS_INVALID_POINTER;
+
+    ResourceRef<vdp::Device::Resource> device{device_id};
+
     uint32_t uint32_value;
 
     switch (parameter) {
-    case VDP_VIDEO_MIXER_PARAMETER_VIDEO_SURFACE_WIDTH: // TODO: get actual limits
-        uint32_value = 16;
+    case VDP_VIDEO_MIXER_PARAMETER_VIDEO_SURFACE_WIDTH:
+        uint32_value = kMixerMinVideoSize;
+        memcpy(min_value, &uint32_value, sizeof(uint32_value));
+        uint32_value = device->max_video_width;
+        memcpy(max_value, &uint32_value, sizeof(uint32_value));
+        return VDP_STATUS_OK;
+
+    case VDP_VIDEO_MIXER_PARAMETER_VIDEO_SURFACE_HEIGHT:
+        uint32_value = kMixerMinVideoSize;
         memcpy(min_value, &uint32_value, sizeof(uint32_value));
-        uint32_value = 4096;
+        uint32_value = device->max_video_height;
         memcpy(max_value, &uint32_value, sizeof(uint32_value));
         return VDP_STATUS_OK;
 
-    case VDP_VIDEO_MIXER_PARAMETER_VIDEO_SURFACE_HEIGHT: // TODO: get actual limits
-        uint32_value = 16;
+    case VDP_VIDEO_MIXER_PARAMETER_LAYERS:
+        uint32_value = 0;
         memcpy(min_value, &uint32_value, sizeof(uint32_value));
-        uint32_value = 4096;
+        uint32_value = kMixerMaxLayers;
         memcpy(max_value, &uint32_value, sizeof(uint32_value));
         return VDP_STATUS_OK;
 
-    case VDP_VIDEO_MIXER_PARAMETER_CHROMA_TYPE: // TODO
-    case VDP_VIDEO_MIXER_PARAMETER_LAYERS:      // TODO
+    case VDP_VIDEO_MIXER_PARAMETER_CHROMA_TYPE: // VDPAU defines no range for chroma type
     default:
         return VDP_STATUS_NO_IMPLEMENTATION;
     }
@@ -427,19 +1027,8 @@ RenderImpl(VdpVideoMixer mixer_id, VdpOutputSurface background_surface,
            VdpOutputSurface destination_surface, VdpRect const *destination_rect,
            VdpRect const *destination_video_rect, uint32_t layer_count, VdpLayer const *layers)
 {
-    std::ignore = mixer_id;    // TODO: mixer should be used to get mixing parameters
-    // TODO: current implementation ignores previous and future surfaces, using only current.
-    // Is that acceptable for interlaced video? Will VAAPI handle deinterlacing?
-
-    std::ignore = background_surface;   // TODO: background_surface. Is it safe to just ignore it?
-    std::ignore = background_source_rect;
-    std::ignore = current_picture_structure;
-    std::ignore = video_surface_past_count;
-    std::ignore = video_surface_past;
-    std::ignore = video_surface_future_count;
-    std::ignore = video_surface_future;
-    std::ignore = layer_count;
-    std::ignore = layers;
+    if (layer_count > 0 && !layers)
+        return VDP_STATUS_INVALID_POINTER;
 
     ResourceRef<Resource> mixer{mixer_id};
     ResourceRef<vdp::VideoSurface::Resource> src_surf{video_surface_current};
@@ -451,6 +1040,27 @@ RenderImpl(VdpVideoMixer mixer_id, VdpOutputSurface background_surface,
         return VDP_STATUS_HANDLE_DEVICE_MISMATCH;
     }
 
+    if (layer_count > mixer->layers)
+        return VDP_STATUS_INVALID_VALUE;
+
+    std::unique_ptr<ResourceRef<vdp::OutputSurface::Resource>> bg_surf;
+    if (background_surface != VDP_INVALID_HANDLE) {
+        bg_surf.reset(new ResourceRef<vdp::OutputSurface::Resource>{background_surface});
+        if ((*bg_surf)->device->id != mixer->device->id)
+            return VDP_STATUS_HANDLE_DEVICE_MISMATCH;
+    }
+
+    std::vector<std::unique_ptr<ResourceRef<vdp::OutputSurface::Resource>>> layer_surfs;
+    for (uint32_t k = 0; k < layer_count; k ++) {
+        if (layers[k].struct_version > VDP_LAYER_VERSION)
+            return VDP_STATUS_INVALID_STRUCT_VERSION;
+
+        layer_surfs.emplace_back(
+            new ResourceRef<vdp::OutputSurface::Resource>{layers[k].source_surface});
+        if ((*layer_surfs.back())->device->id != mixer->device->id)
+            return VDP_STATUS_HANDLE_DEVICE_MISMATCH;
+    }
+
     VdpRect srcVideoRect = {0, 0, src_surf->width, src_surf->height};
     if (video_source_rect)
         srcVideoRect = *video_source_rect;
@@ -469,54 +1079,169 @@ RenderImpl(VdpVideoMixer mixer_id, VdpOutputSurface background_surface,
 
     // TODO: dstRect should clip dstVideoRect
 
+    // field pictures are always deinterlaced, with bob if no better algorithm is enabled or
+    // neighbouring fields are missing
+    const bool is_field =
+        (current_picture_structure == VDP_VIDEO_MIXER_PICTURE_STRUCTURE_TOP_FIELD ||
+         current_picture_structure == VDP_VIDEO_MIXER_PICTURE_STRUCTURE_BOTTOM_FIELD);
+    DeinterlaceMode deint_mode = DeinterlaceMode::bob;
+    if (mixer->feature_enabled(VDP_VIDEO_MIXER_FEATURE_DEINTERLACE_TEMPORAL_SPATIAL))
+        deint_mode = DeinterlaceMode::temporal_spatial;
+    else if (mixer->feature_enabled(VDP_VIDEO_MIXER_FEATURE_DEINTERLACE_TEMPORAL))
+        deint_mode = DeinterlaceMode::temporal;
+
+    std::unique_ptr<ResourceRef<vdp::VideoSurface::Resource>> past_surf;
+    std::unique_ptr<ResourceRef<vdp::VideoSurface::Resource>> future_surf;
+
+    if (is_field && deint_mode != DeinterlaceMode::bob &&
+        video_surface_past_count > 0 && video_surface_past &&
+        video_surface_past[0] != VDP_INVALID_HANDLE &&
+        video_surface_future_count > 0 && video_surface_future &&
+        video_surface_future[0] != VDP_INVALID_HANDLE)
+    {
+        past_surf.reset(new ResourceRef<vdp::VideoSurface::Resource>{video_surface_past[0]});
+        future_surf.reset(new ResourceRef<vdp::VideoSurface::Resource>{video_surface_future[0]});
+
+        for (const auto *neighbour: {past_surf.get(), future_surf.get()}) {
+            if ((*neighbour)->device->id != mixer->device->id)
+                return VDP_STATUS_HANDLE_DEVICE_MISMATCH;
+
+            if ((*neighbour)->width != src_surf->width ||
+                (*neighbour)->height != src_surf->height)
+            {
+                deint_mode = DeinterlaceMode::bob;
+            }
+        }
+    } else {
+        deint_mode = DeinterlaceMode::bob;
+    }
+
+    std::vector<shared_ptr<vdp::VideoSurface::Resource>> used_surfaces{src_surf};
+    if (deint_mode != DeinterlaceMode::bob) {
+        used_surfaces.push_back(*past_surf);
+        used_surfaces.push_back(*future_surf);
+    }
+
+    // decoding may still be in progress. Wait before taking GLX lock, submission thread needs it
+    for (auto &surf: used_surfaces) {
+        if (surf->sync_va_to_glx)
+            surf->wait_for_decoding();
+    }
+
     GLXThreadLocalContext guard{mixer->device};
 
-    if (src_surf->sync_va_to_glx) {
-        render_va_surf_to_texture(mixer, src_surf);
-        src_surf->sync_va_to_glx = false;
+    // layers, background and destination may have draws recorded
+    vdp::OutputSurface::flush_pending_draws(*mixer->device);
+
+    for (auto &surf: used_surfaces) {
+        if (surf->sync_va_to_glx) {
+            render_va_surf_to_texture(mixer, surf);
+            surf->sync_va_to_glx = false;
+        }
     }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, dst_surf->fbo_id);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0, dst_surf->width, 0, dst_surf->height, -1.0f, 1.0f);
-    glViewport(0, 0, dst_surf->width, dst_surf->height);
-    glDisable(GL_BLEND);
+    // video converted with other matrix than csc_matrix, like by VA-API driver, is corrected
+    // by the last pass drawing video, at no extra cost
+    const VdpCSCMatrix identity = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}};
+    const VdpCSCMatrix *correction = mixer->csc_correction_for(src_surf->applied_csc);
+    const bool csc_needed = (correction != nullptr);
+    const VdpCSCMatrix &csc = correction ? *correction : identity;
+
+    GLuint video_tex_id = src_surf->tex_id;
+    if (is_field) {
+        mixer->ensure_render_target(mixer->deint_target, src_surf->width, src_surf->height);
+        const bool bottom_field =
+            (current_picture_structure == VDP_VIDEO_MIXER_PICTURE_STRUCTURE_BOTTOM_FIELD);
+        deinterlace_field(mixer, used_surfaces, bottom_field, deint_mode);
+        video_tex_id = mixer->deint_target.tex_id;
+    }
+
+    // high quality scaling is done in two passes. Horizontal one goes to intermediate texture,
+    // vertical one is a part of composition below
+    const int scaling_level = mixer->scaling_level();
+    const bool hq_scaling = scaling_level > 0 &&
+        srcVideoRect.x1 > srcVideoRect.x0 && srcVideoRect.y1 > srcVideoRect.y0 &&
+        dstVideoRect.x1 > dstVideoRect.x0 && dstVideoRect.y1 > dstVideoRect.y0 &&
+        (srcVideoRect.x1 - srcVideoRect.x0 != dstVideoRect.x1 - dstVideoRect.x0 ||
+         srcVideoRect.y1 - srcVideoRect.y0 != dstVideoRect.y1 - dstVideoRect.y0);
+    const ScalingKernel scaling_kernel = scaling_kernel_for_level(scaling_level);
+
+    if (hq_scaling) {
+        const VdpRect intermediate = {0, 0, dstVideoRect.x1 - dstVideoRect.x0,
+                                      srcVideoRect.y1 - srcVideoRect.y0};
+        auto &target = mixer->scale_target;
+        mixer->ensure_render_target(target, intermediate.x1, intermediate.y1);
+
+        bind_render_target(target.fbo_id, target.width, target.height);
+        glDisable(GL_BLEND);
+
+        draw_scaling_pass(mixer, scaling_kernel, video_tex_id, src_surf->width, src_surf->height,
+                          srcVideoRect.x0, srcVideoRect.y0, srcVideoRect.x1 - srcVideoRect.x0,
+                          target.width, target.height, intermediate, 0, identity);
+    }
 
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+    // background, video and layers are composed in one pass, with a single wait at the end
+    auto &device = *mixer->device;
+    const uint32_t dst_width = dst_surf->width;
+    const uint32_t dst_height = dst_surf->height;
 
-    glMatrixMode(GL_TEXTURE);
-    glLoadIdentity();
-    glScalef(1.0f/src_surf->width, 1.0f/src_surf->height, 1.0f);
+    bind_render_target(dst_surf->fbo_id, dst_width, dst_height);
+    glDisable(GL_BLEND);
 
-    // Clear dstRect area
-    glDisable(GL_TEXTURE_2D);
-    glColor4f(0, 0, 0, 1);
-    glBegin(GL_QUADS);
-        glVertex2f(dstRect.x0, dstRect.y0);
-        glVertex2f(dstRect.x1, dstRect.y0);
-        glVertex2f(dstRect.x1, dstRect.y1);
-        glVertex2f(dstRect.x0, dstRect.y1);
-    glEnd();
+    if (bg_surf) {
+        VdpRect bg_rect = {0, 0, (*bg_surf)->width, (*bg_surf)->height};
+        if (background_source_rect)
+            bg_rect = *background_source_rect;
+
+        glUseProgram(device.shaders[glsl_texture_color].program);
+        draw_texture_rect(device, glsl_texture_color, dst_width, dst_height, (*bg_surf)->tex_id,
+                          (*bg_surf)->width, (*bg_surf)->height, bg_rect, dstRect);
+    } else {
+        // Clear dstRect area
+        Quad quad{dst_width, dst_height, dstRect};
+        quad.set_color(0.0f, 0.0f, 0.0f, 1.0f);
+
+        glUseProgram(device.shaders[glsl_solid_color].program);
+        draw_quad(device, glsl_solid_color, quad);
+    }
 
     // Render (maybe scaled) data from video surface
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, src_surf->tex_id);
-    glColor4f(1, 1, 1, 1);
-    glBegin(GL_QUADS);
-        glTexCoord2i(srcVideoRect.x0, srcVideoRect.y0);
-        glVertex2f(dstVideoRect.x0, dstVideoRect.y0);
-
-        glTexCoord2i(srcVideoRect.x1, srcVideoRect.y0);
-        glVertex2f(dstVideoRect.x1, dstVideoRect.y0);
-
-        glTexCoord2i(srcVideoRect.x1, srcVideoRect.y1);
-        glVertex2f(dstVideoRect.x1, dstVideoRect.y1);
-
-        glTexCoord2i(srcVideoRect.x0, srcVideoRect.y1);
-        glVertex2f(dstVideoRect.x0, dstVideoRect.y1);
-    glEnd();
+    if (hq_scaling) {
+        const auto &target = mixer->scale_target;
+        draw_scaling_pass(mixer, scaling_kernel, target.tex_id, target.width, target.height, 0, 0,
+                          target.height, dst_width, dst_height, dstVideoRect, 1, csc);
+    } else if (csc_needed) {
+        glUseProgram(device.shaders[glsl_csc].program);
+        device.set_csc_uniform(glsl_csc, csc);
+        draw_texture_rect(device, glsl_csc, dst_width, dst_height, video_tex_id, src_surf->width,
+                          src_surf->height, srcVideoRect, dstVideoRect);
+    } else {
+        glUseProgram(device.shaders[glsl_texture_color].program);
+        draw_texture_rect(device, glsl_texture_color, dst_width, dst_height, video_tex_id,
+                          src_surf->width, src_surf->height, srcVideoRect, dstVideoRect);
+    }
+
+    // layers are blended over video in order they are given
+    glUseProgram(device.shaders[glsl_texture_color].program);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    for (uint32_t k = 0; k < layer_count; k ++) {
+        const auto &layer_surf = *layer_surfs[k];
+
+        VdpRect layer_src_rect = {0, 0, layer_surf->width, layer_surf->height};
+        if (layers[k].source_rect)
+            layer_src_rect = *layers[k].source_rect;
+
+        VdpRect layer_dst_rect = {0, 0, dst_width, dst_height};
+        if (layers[k].destination_rect)
+            layer_dst_rect = *layers[k].destination_rect;
+
+        draw_texture_rect(device, glsl_texture_color, dst_width, dst_height, layer_surf->tex_id,
+                          layer_surf->width, layer_surf->height, layer_src_rect, layer_dst_rect);
+    }
+    glDisable(GL_BLEND);
+    glUseProgram(0);
+
     glFinish();
 
     const auto gl_error = glGetError();
@@ -547,14 +1272,32 @@ Render(VdpVideoMixer mixer_id, VdpOutputSurface background_surface,
 }
 
 VdpStatus
-SetAttributeValuesImpl(VdpVideoMixer mixer, uint32_t attribute_count,
+SetAttributeValuesImpl(VdpVideoMixer mixer_id, uint32_t attribute_count,
                        VdpVideoMixerAttribute const *attributes,
                        void const *const *attribute_values)
 {
-    std::ignore = mixer;
-    std::ignore = attribute_count;
-    std::ignore = attributes;
-    std::ignore = attribute_values;
+    if (attribute_count > 0 && (!attributes || !attribute_values))
+        return VDP_STATUS_INVALID_POINTER;
+
+    ResourceRef<Resource> mixer{mixer_id};
+
+    for (uint32_t k = 0; k < attribute_count; k ++) {
+        switch (attributes[k]) {
+        case VDP_VIDEO_MIXER_ATTRIBUTE_CSC_MATRIX:
+            // NULL restores default matrix
+            if (attribute_values[k]) {
+                memcpy(mixer->csc_matrix, attribute_values[k], sizeof(VdpCSCMatrix));
+            } else {
+                compute_csc_matrix(nullptr, ColorStandard::bt601, false, &mixer->csc_matrix);
+            }
+            mixer->csc_correction_valid = false;
+            break;
+
+        default:
+            // other attributes are accepted, but have no effect
+            break;
+        }
+    }
 
     return VDP_STATUS_OK;
 }
@@ -568,13 +1311,20 @@ SetAttributeValues(VdpVideoMixer mixer, uint32_t attribute_count,
 }
 
 VdpStatus
-SetFeatureEnablesImpl(VdpVideoMixer mixer, uint32_t feature_count,
+SetFeatureEnablesImpl(VdpVideoMixer mixer_id, uint32_t feature_count,
                       VdpVideoMixerFeature const *features, VdpBool const *feature_enables)
 {
-    std::ignore = mixer;
-    std::ignore = feature_count;
-    std::ignore = features;
-    std::ignore = feature_enables;
+    if (feature_count > 0 && (!features || !feature_enables))
+        return VDP_STATUS_INVALID_POINTER;
+
+    ResourceRef<Resource> mixer{mixer_id};
+
+    // features which weren't requested on creation, or aren't supported, are silently ignored
+    for (uint32_t k = 0; k < feature_count; k ++) {
+        auto it = mixer->features.find(features[k]);
+        if (it != mixer->features.end())
+            it->second = (feature_enables[k] == VDP_TRUE);
+    }
 
     return VDP_STATUS_OK;
 }
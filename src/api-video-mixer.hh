@@ -25,11 +25,44 @@
 #pragma once
 
 #include "api.hh"
+#include "scaling-weights.hh"
+#include <X11/Xlib.h>
+#include <X11/extensions/sync.h>
+#include <map>
 #include <memory>
+#include <vector>
 
 
 namespace vdp { namespace VideoMixer {
 
+/// texture which can be rendered into
+struct RenderTarget
+{
+    uint32_t        width;          ///< 0 if not allocated
+    uint32_t        height;
+    GLuint          tex_id;
+    GLuint          fbo_id;
+};
+
+/// filter weights for scaling along one axis, uploaded as texture
+struct ScalingWeightsTexture
+{
+    ScalingKernel   kernel;
+    uint32_t        src_length;
+    uint32_t        dst_length;
+    uint32_t        taps;
+    GLuint          tex_id;
+};
+
+/// target of vaPutSurface, together with its texture-from-pixmap proxy
+struct MixerPixmap
+{
+    uint32_t        width;
+    uint32_t        height;
+    Pixmap          pixmap;
+    GLXPixmap       glx_pixmap;
+};
+
 struct Resource: public vdp::GenericResource
 {
     Resource(std::shared_ptr<vdp::Device::Resource> a_device, uint32_t a_feature_count,
@@ -41,13 +74,70 @@ struct Resource: public vdp::GenericResource
     void
     free_video_mixer_pixmaps();
 
-    uint32_t        pixmap_width;       ///< last seen width
-    uint32_t        pixmap_height;      ///< last seen height
-    Pixmap          pixmap;             ///< target pixmap for vaPutSurface
-    GLXPixmap       glx_pixmap;         ///< associated glx pixmap for texture-from-pixmap
+    /// returns pixmap of given size, creating it if there is no such one in cache. Must be
+    /// called under GLX lock
+    const MixerPixmap &
+    acquire_pixmap(uint32_t width, uint32_t height);
+
+    /// creates resources Render will need for video of size given in parameters, so the first
+    /// frame costs no more than the following ones. Must be called with GL context current
+    void
+    warm_up();
+
+    /// (re)allocates render target if its size differs. Must be called with GL context current
+    void
+    ensure_render_target(RenderTarget &target, uint32_t width, uint32_t height);
+
+    /// returns weights texture for given scaling, computing it if there is no such one in cache.
+    /// Must be called with GL context current
+    const ScalingWeightsTexture &
+    acquire_scaling_weights(ScalingKernel kernel, uint32_t src_length, uint32_t dst_length);
+
+    /// true if feature was requested on creation, is supported, and is currently enabled
+    bool
+    feature_enabled(VdpVideoMixerFeature feature) const;
+
+    /// highest enabled high quality scaling level, 1 to 9, or 0 if none is enabled
+    int
+    scaling_level() const;
+
+    /// matrix turning video converted to RGB with applied matrix into what csc_matrix would
+    /// give, or nullptr if colors are right already. The last result is cached
+    const VdpCSCMatrix *
+    csc_correction_for(const VdpCSCMatrix &applied);
+
+    std::vector<MixerPixmap>    pixmaps;    ///< recently used pixmaps, most recent first
+
+    uint32_t        video_width;        ///< VIDEO_SURFACE_WIDTH parameter, 0 if not given
+    uint32_t        video_height;       ///< VIDEO_SURFACE_HEIGHT parameter, 0 if not given
+    VdpChromaType   chroma_type;        ///< CHROMA_TYPE parameter
+    uint32_t        layers;             ///< LAYERS parameter
+
+    /// supported features requested on creation, and whether they are enabled
+    std::map<VdpVideoMixerFeature, bool>    features;
+
+    VdpCSCMatrix    csc_matrix;         ///< CSC_MATRIX attribute
+    VdpCSCMatrix    csc_correction;     ///< last result of csc_correction_for()
+    VdpCSCMatrix    csc_correction_applied; ///< matrix csc_correction was computed for
+    bool            csc_correction_valid;   ///< false after csc_matrix change
+    bool            csc_is_identity;    ///< csc_correction doesn't change colors
+
+    RenderTarget    deint_target;       ///< deinterlaced frame
+    RenderTarget    scale_target;       ///< result of horizontal pass of high quality scaling
+
+    /// recently used scaling weights, most recent first
+    std::vector<ScalingWeightsTexture>  scaling_weights;
     GLuint          tex_id;             ///< texture for texture-from-pixmap
+    GLuint          dmabuf_tex_id[2];   ///< luma and chroma textures for DMA-BUF import
+    uint32_t        dmabuf_skipped_fourcc;  ///< last surface format DMA-BUF import can't take,
+                                            ///< so it's reported once
+    XSyncFence      x11_fence;          ///< triggered by X server after vaPutSurface, or None
 };
 
+/// true for features this implementation can do
+bool
+is_feature_supported(VdpVideoMixerFeature feature);
+
 VdpVideoMixerQueryFeatureSupport        QueryFeatureSupport;
 VdpVideoMixerQueryParameterSupport      QueryParameterSupport;
 VdpVideoMixerQueryAttributeSupport      QueryAttributeSupport;
@@ -23,11 +23,14 @@
  */
 
 #define GL_GLEXT_PROTOTYPES
+#include "api-csc-matrix.hh"
 #include "api-video-surface.hh"
 #include "api.hh"
 #include "compat.hh"
+#include "decoder-capture.hh"
 #include "glx-context.hh"
 #include "handle-storage.hh"
+#include "quad-renderer.hh"
 #include "reverse-constant.hh"
 #include "shaders.h"
 #include "trace.hh"
@@ -50,6 +53,7 @@ Resource::Resource(std::shared_ptr<vdp::Device::Resource> a_device, VdpChromaTyp
     , width{a_width}
     , height{a_height}
     , rt_idx{0}
+    , decode_seq{0}
 {
     device = a_device;
 
@@ -86,6 +90,9 @@ Resource::Resource(std::shared_ptr<vdp::Device::Resource> a_device, VdpChromaTyp
     tex_id =         0;
     sync_va_to_glx = false;
 
+    // the same as PutBitsYCbCr conversion gives
+    compute_csc_matrix(nullptr, ColorStandard::bt601, true, &applied_csc);
+
     GLXThreadLocalContext guard{device};
 
     glGenTextures(1, &tex_id);
@@ -135,7 +142,7 @@ Resource::~Resource()
         if (device->va_available) {
             // return VA surface to the free list, decoder owns them
             if (decoder)
-                decoder->free_list.push_back(rt_idx);
+                decoder->release_render_target(rt_idx);
         }
 
     } catch (...) {
@@ -143,6 +150,27 @@ Resource::~Resource()
     }
 }
 
+void
+Resource::wait_for_decoding()
+{
+    if (!decoder || decode_seq == 0)
+        return;
+
+    // picture may still wait in submission queue
+    decoder->wait_for_picture(decode_seq);
+    decode_seq = 0;
+
+    // VA display is shared with GLX, so calls to it are serialized. Lock is taken only after
+    // queue is drained, as submission thread needs it too
+    GLXLockGuard guard;
+
+    const VAStatus status = vaSyncSurface(device->va_dpy, va_surf);
+    if (status != VA_STATUS_SUCCESS) {
+        traceError("VideoSurface::Resource::wait_for_decoding(): vaSyncSurface failed, %s\n",
+                   vaErrorStr(status));
+    }
+}
+
 VdpStatus
 CreateImpl(VdpDevice device_id, VdpChromaType chroma_type, uint32_t width, uint32_t height,
            VdpVideoSurface *surface)
@@ -155,6 +183,11 @@ CreateImpl(VdpDevice device_id, VdpChromaType chroma_type, uint32_t width, uint3
     auto data = make_shared<Resource>(device, chroma_type, width, height);
 
     *surface = ResourceStorage<Resource>::instance().insert(data);
+
+    auto &capture = DecoderCapture::instance();
+    if (capture.enabled())
+        capture.surface_created(*surface, chroma_type, width, height);
+
     return VDP_STATUS_OK;
 }
 
@@ -171,6 +204,11 @@ DestroyImpl(VdpVideoSurface surface_id)
     ResourceRef<Resource> surf{surface_id};
 
     ResourceStorage<Resource>::instance().drop(surface_id);
+
+    auto &capture = DecoderCapture::instance();
+    if (capture.enabled())
+        capture.surface_destroyed(surface_id);
+
     return VDP_STATUS_OK;
 }
 
@@ -191,6 +229,8 @@ GetBitsYCbCrImpl(VdpVideoSurface surface_id, VdpYCbCrFormat destination_ycbcr_fo
     VADisplay va_dpy = surf->device->va_dpy;
 
     if (surf->device->va_available) {
+        surf->wait_for_decoding();
+
         VAImage q;
         vaDeriveImage(va_dpy, surf->va_surf, &q);
         if (q.format.fourcc == VA_FOURCC('N', 'V', '1', '2') &&
@@ -255,6 +295,49 @@ GetBitsYCbCrImpl(VdpVideoSurface surface_id, VdpYCbCrFormat destination_ycbcr_fo
                 }
             }
 
+            vaUnmapBuffer(va_dpy, q.buf);
+        } else if (q.format.fourcc == VA_FOURCC('P', '0', '1', '0') &&
+                   (destination_ycbcr_format == VDP_YCBCR_FORMAT_NV12 ||
+                    destination_ycbcr_format == VDP_YCBCR_FORMAT_YV12))
+        {
+            // 10-bit samples are stored in upper bits of 16-bit words, so the high byte of
+            // each is an 8-bit sample
+            uint8_t *img_data;
+            vaMapBuffer(va_dpy, q.buf, (void **)&img_data);
+
+            for (unsigned int y = 0; y < q.height; y ++) {  // Y plane
+                const auto *src = reinterpret_cast<const uint16_t *>(img_data + q.offsets[0] +
+                                                                     y * q.pitches[0]);
+                uint8_t *dst = static_cast<uint8_t *>(destination_data[0]) +
+                               y * destination_pitches[0];
+
+                for (unsigned int x = 0; x < q.width; x ++)
+                    dst[x] = src[x] >> 8;
+            }
+
+            for (unsigned int y = 0; y < q.height / 2; y ++) {  // UV plane
+                const auto *src = reinterpret_cast<const uint16_t *>(img_data + q.offsets[1] +
+                                                                     y * q.pitches[1]);
+
+                if (destination_ycbcr_format == VDP_YCBCR_FORMAT_NV12) {
+                    uint8_t *dst = static_cast<uint8_t *>(destination_data[1]) +
+                                   y * destination_pitches[1];
+
+                    for (unsigned int x = 0; x < q.width; x ++)
+                        dst[x] = src[x] >> 8;
+                } else {
+                    uint8_t *dst_u = static_cast<uint8_t *>(destination_data[1]) +
+                                     y * destination_pitches[1];
+                    uint8_t *dst_v = static_cast<uint8_t *>(destination_data[2]) +
+                                     y * destination_pitches[2];
+
+                    for (unsigned int x = 0; x < q.width / 2; x ++) {
+                        *dst_v++ = *src++ >> 8;
+                        *dst_u++ = *src++ >> 8;
+                    }
+                }
+            }
+
             vaUnmapBuffer(va_dpy, q.buf);
         } else {
             const char *c = (const char *)&q.format.fourcc;
@@ -347,11 +430,8 @@ PutBitsYCbCr_glsl(VdpVideoSurface surface_id, VdpYCbCrFormat source_ycbcr_format
 
     GLXThreadLocalContext guard{surf->device};
 
-    glBindFramebuffer(GL_FRAMEBUFFER, surf->fbo_id);
-
     GLuint tex_id[2];
     glGenTextures(2, tex_id);
-    glEnable(GL_TEXTURE_2D);
 
     switch (source_ycbcr_format) {
     case VDP_YCBCR_FORMAT_NV12:
@@ -402,44 +482,21 @@ PutBitsYCbCr_glsl(VdpVideoSurface surface_id, VdpYCbCrFormat source_ycbcr_format
     }
     glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0, surf->width, 0, surf->height, -1.0f, 1.0f);
-    glViewport(0, 0, surf->width, surf->height);
-
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-
-    glMatrixMode(GL_TEXTURE);
-    glLoadIdentity();
-
+    bind_render_target(surf->fbo_id, surf->width, surf->height);
     glDisable(GL_BLEND);
 
-    switch (source_ycbcr_format) {
-    case VDP_YCBCR_FORMAT_NV12:
-        glUseProgram(surf->device->shaders[glsl_NV12_RGBA].program);
-        glUniform1i(surf->device->shaders[glsl_NV12_RGBA].uniform.tex_0, 0);
-        glUniform1i(surf->device->shaders[glsl_NV12_RGBA].uniform.tex_1, 1);
-        break;
-
-    case VDP_YCBCR_FORMAT_YV12:
-        glUseProgram(surf->device->shaders[glsl_YV12_RGBA].program);
-        glUniform1i(surf->device->shaders[glsl_YV12_RGBA].uniform.tex_0, 0);
-        glUniform1i(surf->device->shaders[glsl_YV12_RGBA].uniform.tex_1, 1);
-        break;
-    }
+    const int shader = (source_ycbcr_format == VDP_YCBCR_FORMAT_NV12) ? glsl_NV12_RGBA
+                                                                       : glsl_YV12_RGBA;
+    const VdpRect dst_rect = {0, 0, surf->width, surf->height};
 
-    glBegin(GL_QUADS);
-        glTexCoord2f(0, 0); glVertex2f(0,           0);
-        glTexCoord2f(1, 0); glVertex2f(surf->width, 0);
-        glTexCoord2f(1, 1); glVertex2f(surf->width, surf->height);
-        glTexCoord2f(0, 1); glVertex2f(0,           surf->height);
-    glEnd();
+    glUseProgram(surf->device->shaders[shader].program);
+    draw_quad(*surf->device, shader, Quad{surf->width, surf->height, dst_rect});
 
     glUseProgram(0);
     glFinish();
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     glDeleteTextures(2, tex_id);
+    compute_csc_matrix(nullptr, ColorStandard::bt601, true, &surf->applied_csc);
 
     const auto gl_error = glGetError();
     if (gl_error != GL_NO_ERROR) {
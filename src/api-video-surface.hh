@@ -39,6 +39,11 @@ struct Resource: public vdp::GenericResource
 
     ~Resource();
 
+    /// blocks until picture decoded into va_surf is ready to be read. Must be called without
+    /// holding GLX lock
+    void
+    wait_for_decoding();
+
     VdpChromaType   chroma_type;    ///< video chroma type
     uint32_t        width;
     uint32_t        height;
@@ -48,9 +53,11 @@ struct Resource: public vdp::GenericResource
     uint32_t        chroma_stride;
     VASurfaceID     va_surf;        ///< VA-API surface
     bool            sync_va_to_glx; ///< whenever VA-API surface should be converted to GL texture
+    VdpCSCMatrix    applied_csc;    ///< matrix texture contents were converted to RGB with
     GLuint          tex_id;         ///< GL texture id (RGBA)
     GLuint          fbo_id;         ///< framebuffer object id
     int32_t         rt_idx;         ///< index in VdpDecoder's render_targets
+    uint64_t        decode_seq;     ///< decoder picture sequence number pending on va_surf, or 0
     std::vector<uint8_t>    y_plane;
     std::vector<uint8_t>    u_plane;
     std::vector<uint8_t>    v_plane;
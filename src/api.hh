@@ -30,8 +30,23 @@
 
 namespace vdp {
 
-const int kMaxRenderTargets = 21;
-const int kNumRenderTargets = 21;
+const int kMaxRenderTargets = 32;           ///< upper limit of VA surfaces per decoder
+const int kRenderTargetsPipelineDepth = 4;  ///< surfaces needed in addition to references
+const int kRenderTargetsGrowStep = 2;       ///< surfaces added when decoder runs out of them
+const int kRenderTargetsTrimDelay = 300;    ///< frames with spare surfaces before releasing them
+const int kMaxQueuedPictures = 4;           ///< pictures waiting for asynchronous submission
+const int kDecoderCacheSize = 2;            ///< destroyed decoder contexts kept per device
+const int kDecoderCacheMaxAge = 10;         ///< seconds destroyed decoder context is kept for
+const int kMixerPixmapCacheSize = 3;        ///< pixmaps of distinct sizes kept by video mixer
+const int kMixerMinVideoSize = 16;          ///< smallest video surface size mixer accepts
+const int kMixerMaxLayers = 4;              ///< maximum count of layers mixer accepts
+const int kMixerScalingWeightsCacheSize = 4;    ///< scaling weight textures kept by video mixer
+const int kMaxPendingDraws = 1024;          ///< output surface draws recorded before forced flush
+const int kBitmapAtlasPageSize = 1024;      ///< width and height of bitmap atlas textures
+const int kBitmapAtlasMaxItemSize = 128;    ///< largest bitmap side that goes into atlas
+const int kBitmapAtlasPadding = 1;          ///< edge-repeating border around bitmaps in atlas
+const int kBitmapMaxDirtyRects = 8;         ///< separately uploaded areas of changed bitmap
+const int kPaletteCacheSize = 4;            ///< indexed picture palette textures kept by device
 
 namespace Device {
 struct Resource;
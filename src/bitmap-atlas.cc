@@ -0,0 +1,102 @@
+/*
+ * Copyright 2013-2016  Rinat Ibragimov
+ *
+ * This file is part of libvdpau-va-gl
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bitmap-atlas.hh"
+#include <algorithm>
+
+
+namespace {
+
+/// shelf heights are rounded up to this, so glyphs of slightly different sizes share shelves
+const uint32_t kShelfHeightGranularity = 4;
+
+} // anonymous namespace
+
+
+namespace vdp {
+
+ShelfAllocator::ShelfAllocator(uint32_t width, uint32_t height)
+    : width_{width}
+    , height_{height}
+{}
+
+bool
+ShelfAllocator::allocate(uint32_t width, uint32_t height, uint32_t *x, uint32_t *y)
+{
+    if (width == 0 || height == 0 || width > width_ || height > height_)
+        return false;
+
+    // lowest shelf that fits, to waste less space
+    Shelf *best = nullptr;
+    for (auto &shelf: shelves_) {
+        if (shelf.height < height || width_ - shelf.used_width < width)
+            continue;
+
+        if (!best || shelf.height < best->height)
+            best = &shelf;
+    }
+
+    // too tall shelf wastes space, starting a new one is better while there is room for it
+    if (!best || best->height > height + height / 2) {
+        const uint32_t top = shelves_.empty() ? 0 : shelves_.back().y + shelves_.back().height;
+
+        if (height <= height_ - top) {
+            const uint32_t rounded = (height + kShelfHeightGranularity - 1) /
+                                     kShelfHeightGranularity * kShelfHeightGranularity;
+
+            shelves_.push_back(Shelf{top, std::min(rounded, height_ - top), 0, 0});
+            best = &shelves_.back();
+        }
+    }
+
+    if (!best)
+        return false;
+
+    *x = best->used_width;
+    *y = best->y;
+    best->used_width += width;
+    best->items += 1;
+
+    return true;
+}
+
+void
+ShelfAllocator::release(uint32_t x, uint32_t y)
+{
+    for (auto &shelf: shelves_) {
+        if (shelf.y != y || x >= shelf.used_width || shelf.items == 0)
+            continue;
+
+        shelf.items -= 1;
+        if (shelf.items == 0)
+            shelf.used_width = 0;
+        break;
+    }
+
+    // empty shelves at the top are dropped, so the next shelf can be of any height
+    while (!shelves_.empty() && shelves_.back().items == 0)
+        shelves_.pop_back();
+}
+
+} // namespace vdp
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2013-2016  Rinat Ibragimov
+ *
+ * This file is part of libvdpau-va-gl
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "api.hh"
+#include <GL/gl.h>
+#include <stdint.h>
+#include <vdpau/vdpau.h>
+#include <vector>
+
+
+namespace vdp {
+
+/// packs rectangles into an area of fixed size, placing them in horizontal shelves. Space of a
+/// shelf is reused once all its rectangles are released, which suits glyph caches, where
+/// bitmaps come and go in generations. Does bookkeeping only, no GL calls
+class ShelfAllocator
+{
+public:
+    ShelfAllocator(uint32_t width, uint32_t height);
+
+    /// finds place for rectangle of given size. Returns false if there is none
+    bool
+    allocate(uint32_t width, uint32_t height, uint32_t *x, uint32_t *y);
+
+    /// releases rectangle previously allocated at (x, y)
+    void
+    release(uint32_t x, uint32_t y);
+
+    /// true if no rectangles are allocated
+    bool
+    empty() const
+    {
+        return shelves_.empty();
+    }
+
+private:
+    struct Shelf
+    {
+        uint32_t    y;
+        uint32_t    height;
+        uint32_t    used_width; ///< rectangles are placed left to right, without gaps
+        uint32_t    items;      ///< rectangles not yet released
+    };
+
+    uint32_t            width_;
+    uint32_t            height_;
+    std::vector<Shelf>  shelves_;   ///< sorted by y, without gaps between them
+};
+
+/// GL texture shared by small bitmap surfaces of the same format. Each bitmap is surrounded by
+/// a border of kBitmapAtlasPadding pixels repeating its edge texels, so filtering doesn't pick
+/// neighbors and behaves as GL_CLAMP_TO_EDGE
+struct BitmapAtlasPage
+{
+    BitmapAtlasPage(VdpRGBAFormat a_rgba_format, GLuint a_tex_id)
+        : rgba_format{a_rgba_format}
+        , tex_id{a_tex_id}
+        , allocator{kBitmapAtlasPageSize, kBitmapAtlasPageSize}
+    {}
+
+    VdpRGBAFormat   rgba_format;
+    GLuint          tex_id;
+    ShelfAllocator  allocator;
+};
+
+} // namespace vdp
@@ -34,6 +34,9 @@ namespace vdp {
 
 /// Raw byte sequence payload state
 ///
+/// Reads from a non-owning view of the buffer, so creating or copying a state is cheap. Bytes
+/// are fetched only when bits are requested.
+///
 /// throws ByteReader::error()
 
 class RBSPState
@@ -53,29 +56,25 @@ private:
     class ByteReader
     {
     public:
-        explicit
-        ByteReader(const std::vector<uint8_t> &buffer)
-            : data_{buffer}
+        ByteReader(const uint8_t *data, size_t size)
+            : data_{data}
+            , size_{size}
             , byte_ofs_{0}
             , zeros_in_row_{0}
         {}
 
-        ByteReader(const ByteReader &other)
-            : data_{other.data_}
-            , byte_ofs_{other.byte_ofs_}
-            , zeros_in_row_{other.zeros_in_row_}
-        {}
+        ByteReader(const ByteReader &other) = default;
 
         uint8_t
         get_byte()
         {
-            if (byte_ofs_ >= data_.size())
+            if (byte_ofs_ >= size_)
                 throw error("ByteReader: trying to read beyond bounds");
 
             const uint8_t current_byte = data_[byte_ofs_ ++];
 
             if (zeros_in_row_ >= 2 && current_byte == 3) {
-                if (byte_ofs_ >= data_.size())
+                if (byte_ofs_ >= size_)
                     throw error("ByteReader: trying to read beyond bounds");
 
                 const uint8_t another_byte = data_[byte_ofs_ ++];
@@ -107,7 +106,7 @@ private:
 
             uint32_t window = ~0u;
             do {
-                if (byte_ofs_ >= data_.size())
+                if (byte_ofs_ >= size_)
                     throw error("ByteReader: no more bytes");
 
                 const uint32_t c = data_[byte_ofs_++];
@@ -122,15 +121,21 @@ private:
         ByteReader &
         operator=(const ByteReader &) = delete;
 
-        const std::vector<uint8_t>  &data_;
-        size_t byte_ofs_;
-        size_t zeros_in_row_;
+        const uint8_t  *data_;
+        size_t          size_;
+        size_t          byte_ofs_;
+        size_t          zeros_in_row_;
     };
 
 public:
+    /// buffer must outlive the state
     explicit
     RBSPState(const std::vector<uint8_t> &buffer)
-        : byte_reader_{buffer}
+        : RBSPState(buffer.data(), buffer.size())
+    {}
+
+    RBSPState(const uint8_t *data, size_t size)
+        : byte_reader_{data, size}
         , bits_eaten_{0}
         , current_byte_{0}
         , bit_ofs_{7}
@@ -138,12 +143,7 @@ public:
 
     ~RBSPState() = default;
 
-    RBSPState(const RBSPState &other)
-        : byte_reader_{other.byte_reader_}
-        , bits_eaten_{other.bits_eaten_}
-        , current_byte_{other.current_byte_}
-        , bit_ofs_{other.bit_ofs_}
-    {}
+    RBSPState(const RBSPState &other) = default;
 
     int64_t
     navigate_to_nal_unit()
@@ -239,4 +239,64 @@ private:
     uint8_t     bit_ofs_;
 };
 
+/// Plain bit reader, for bitstreams without emulation prevention bytes
+///
+/// Reading past the end yields zero bits and sets overrun flag, so parsers check for truncated
+/// data once, after the whole header is read.
+
+class BitReader
+{
+public:
+    BitReader(const uint8_t *data, size_t size)
+        : data_{data}
+        , size_{size}
+        , bit_pos_{0}
+        , overrun_{false}
+    {}
+
+    uint32_t
+    peek_u(size_t bitcount) const
+    {
+        uint32_t res = 0;
+
+        for (size_t k = 0; k < bitcount; k ++) {
+            const size_t pos = bit_pos_ + k;
+            const uint32_t bit = (pos / 8 < size_) ? (data_[pos / 8] >> (7 - pos % 8)) & 1 : 0;
+            res = (res << 1) | bit;
+        }
+
+        return res;
+    }
+
+    uint32_t
+    get_u(size_t bitcount)
+    {
+        const uint32_t res = peek_u(bitcount);
+
+        bit_pos_ += bitcount;
+        if (bit_pos_ > size_ * 8)
+            overrun_ = true;
+
+        return res;
+    }
+
+    size_t
+    bits_eaten() const
+    {
+        return bit_pos_;
+    }
+
+    bool
+    overrun() const
+    {
+        return overrun_;
+    }
+
+private:
+    const uint8_t  *data_;
+    size_t          size_;
+    size_t          bit_pos_;
+    bool            overrun_;
+};
+
 } // namespace vdp
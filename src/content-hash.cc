@@ -0,0 +1,189 @@
+/*
+ * Copyright 2013-2016  Rinat Ibragimov
+ *
+ * This file is part of libvdpau-va-gl
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "content-hash.hh"
+#include <string.h>
+
+
+namespace {
+
+const uint64_t kPrime1 = 0x9e3779b185ebca87ULL;
+const uint64_t kPrime2 = 0xc2b2ae3d27d4eb4fULL;
+const uint64_t kPrime3 = 0x165667b19e3779f9ULL;
+const uint64_t kPrime4 = 0x85ebca77c2b2ae63ULL;
+const uint64_t kPrime5 = 0x27d4eb2f165667c5ULL;
+
+inline uint64_t
+rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t
+read64(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t
+read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t
+lane_round(uint64_t acc, uint64_t input)
+{
+    acc += input * kPrime2;
+    acc = rotl(acc, 31);
+    return acc * kPrime1;
+}
+
+inline uint64_t
+merge_round(uint64_t acc, uint64_t val)
+{
+    acc ^= lane_round(0, val);
+    return acc * kPrime1 + kPrime4;
+}
+
+} // anonymous namespace
+
+
+namespace vdp {
+
+ContentHash::ContentHash()
+    : acc_{kPrime1 + kPrime2, kPrime2, 0, 0 - kPrime1}
+    , stripe_len_{0}
+    , total_len_{0}
+{}
+
+void
+ContentHash::update(const void *data, size_t size)
+{
+    auto p = static_cast<const uint8_t *>(data);
+    total_len_ += size;
+
+    if (stripe_len_ > 0) {
+        const size_t n = (size < 32 - stripe_len_) ? size : 32 - stripe_len_;
+        memcpy(stripe_ + stripe_len_, p, n);
+        stripe_len_ += n;
+        p += n;
+        size -= n;
+
+        if (stripe_len_ < 32)
+            return;
+
+        for (int k = 0; k < 4; k ++)
+            acc_[k] = lane_round(acc_[k], read64(stripe_ + 8 * k));
+        stripe_len_ = 0;
+    }
+
+    // lanes are independent, so their multiplications overlap
+    uint64_t a0 = acc_[0], a1 = acc_[1], a2 = acc_[2], a3 = acc_[3];
+    while (size >= 32) {
+        a0 = lane_round(a0, read64(p));
+        a1 = lane_round(a1, read64(p + 8));
+        a2 = lane_round(a2, read64(p + 16));
+        a3 = lane_round(a3, read64(p + 24));
+        p += 32;
+        size -= 32;
+    }
+    acc_[0] = a0;
+    acc_[1] = a1;
+    acc_[2] = a2;
+    acc_[3] = a3;
+
+    memcpy(stripe_, p, size);
+    stripe_len_ = size;
+}
+
+uint64_t
+ContentHash::digest() const
+{
+    uint64_t h;
+
+    if (total_len_ >= 32) {
+        h = rotl(acc_[0], 1) + rotl(acc_[1], 7) + rotl(acc_[2], 12) + rotl(acc_[3], 18);
+        for (int k = 0; k < 4; k ++)
+            h = merge_round(h, acc_[k]);
+    } else {
+        h = acc_[2] + kPrime5;
+    }
+
+    h += total_len_;
+
+    const uint8_t *p = stripe_;
+    size_t len = stripe_len_;
+
+    while (len >= 8) {
+        h ^= lane_round(0, read64(p));
+        h = rotl(h, 27) * kPrime1 + kPrime4;
+        p += 8;
+        len -= 8;
+    }
+
+    if (len >= 4) {
+        h ^= read32(p) * kPrime1;
+        h = rotl(h, 23) * kPrime2 + kPrime3;
+        p += 4;
+        len -= 4;
+    }
+
+    while (len > 0) {
+        h ^= *p * kPrime5;
+        h = rotl(h, 11) * kPrime1;
+        p += 1;
+        len -= 1;
+    }
+
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+uint64_t
+hash_rect(const void *data, uint32_t pitch, uint32_t row_bytes, uint32_t rows)
+{
+    ContentHash hash;
+    auto p = static_cast<const uint8_t *>(data);
+
+    if (pitch == row_bytes) {
+        hash.update(p, static_cast<size_t>(row_bytes) * rows);
+    } else {
+        for (uint32_t k = 0; k < rows; k ++)
+            hash.update(p + static_cast<size_t>(k) * pitch, row_bytes);
+    }
+
+    return hash.digest();
+}
+
+} // namespace vdp
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2013-2016  Rinat Ibragimov
+ *
+ * This file is part of libvdpau-va-gl
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace vdp {
+
+/// 64-bit xxHash (XXH64) of data fed in pieces, so rows of a picture can be hashed in place,
+/// skipping padding at their ends. Four independent accumulators keep multipliers busy, and
+/// no saved copy of data is needed to detect changes
+class ContentHash
+{
+public:
+    ContentHash();
+
+    void
+    update(const void *data, size_t size);
+
+    /// hash of all data fed so far
+    uint64_t
+    digest() const;
+
+private:
+    uint64_t    acc_[4];
+    uint8_t     stripe_[32];    ///< bytes not yet consumed by accumulators
+    size_t      stripe_len_;
+    uint64_t    total_len_;
+};
+
+/// hash of rect of rows bytes long, lines apart by pitch bytes
+uint64_t
+hash_rect(const void *data, uint32_t pitch, uint32_t row_bytes, uint32_t rows);
+
+} // namespace vdp
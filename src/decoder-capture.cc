@@ -0,0 +1,212 @@
+/*
+ * Copyright 2013-2016  Rinat Ibragimov
+ *
+ * This file is part of libvdpau-va-gl
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "decoder-capture.hh"
+#include "trace.hh"
+#include <stdlib.h>
+#include <string.h>
+
+
+namespace vdp {
+
+namespace {
+
+const uint32_t kCaptureMagic = 0x43504456;      // 'VDPC'
+const uint32_t kCaptureVersion = 1;
+
+const uint32_t kTagSurfaceCreate = 0x45524353;  // 'SCRE'
+const uint32_t kTagSurfaceDestroy = 0x53454453; // 'SDES'
+const uint32_t kTagDecoderCreate = 0x45524344;  // 'DCRE'
+const uint32_t kTagDecoderDestroy = 0x53454444; // 'DDES'
+const uint32_t kTagDecoderRender = 0x4e455244;  // 'DREN'
+
+void
+append_u32(std::vector<uint8_t> &payload, uint32_t value)
+{
+    const auto *bytes = reinterpret_cast<const uint8_t *>(&value);
+    payload.insert(payload.end(), bytes, bytes + sizeof(value));
+}
+
+/// appends data, padded with zeros to the 4-byte boundary
+void
+append_padded(std::vector<uint8_t> &payload, const void *data, size_t size)
+{
+    const auto *bytes = static_cast<const uint8_t *>(data);
+
+    payload.insert(payload.end(), bytes, bytes + size);
+    payload.resize(payload.size() + (4 - size % 4) % 4, 0);
+}
+
+} // anonymous namespace
+
+DecoderCapture &
+DecoderCapture::instance()
+{
+    static DecoderCapture capture;
+    return capture;
+}
+
+DecoderCapture::DecoderCapture()
+    : fp_{nullptr}
+{
+    const char *path = getenv("VDPAU_CAPTURE");
+    if (!path)
+        return;
+
+    fp_ = fopen(path, "wb");
+    if (!fp_) {
+        traceError("DecoderCapture::DecoderCapture(): can't open %s\n", path);
+        return;
+    }
+
+    const uint32_t header[] = {kCaptureMagic, kCaptureVersion};
+    fwrite(header, sizeof(header), 1, fp_);
+}
+
+DecoderCapture::~DecoderCapture()
+{
+    if (fp_)
+        fclose(fp_);
+}
+
+void
+DecoderCapture::write_record(uint32_t tag, const std::vector<uint8_t> &payload)
+{
+    const uint32_t header[] = {tag, static_cast<uint32_t>(payload.size())};
+
+    std::unique_lock<decltype(mtx_)> lock{mtx_};
+
+    fwrite(header, sizeof(header), 1, fp_);
+    fwrite(payload.data(), 1, payload.size(), fp_);
+}
+
+void
+DecoderCapture::surface_created(VdpVideoSurface surface, VdpChromaType chroma_type,
+                                uint32_t width, uint32_t height)
+{
+    std::vector<uint8_t> payload;
+
+    append_u32(payload, surface);
+    append_u32(payload, chroma_type);
+    append_u32(payload, width);
+    append_u32(payload, height);
+    write_record(kTagSurfaceCreate, payload);
+}
+
+void
+DecoderCapture::surface_destroyed(VdpVideoSurface surface)
+{
+    std::vector<uint8_t> payload;
+
+    append_u32(payload, surface);
+    write_record(kTagSurfaceDestroy, payload);
+}
+
+void
+DecoderCapture::decoder_created(VdpDecoder decoder, VdpDecoderProfile profile, uint32_t width,
+                                uint32_t height, uint32_t max_references)
+{
+    std::vector<uint8_t> payload;
+
+    append_u32(payload, decoder);
+    append_u32(payload, profile);
+    append_u32(payload, width);
+    append_u32(payload, height);
+    append_u32(payload, max_references);
+    write_record(kTagDecoderCreate, payload);
+}
+
+void
+DecoderCapture::decoder_destroyed(VdpDecoder decoder)
+{
+    std::vector<uint8_t> payload;
+
+    append_u32(payload, decoder);
+    write_record(kTagDecoderDestroy, payload);
+
+    // stream is likely over, so make the file usable even if process dies later
+    std::unique_lock<decltype(mtx_)> lock{mtx_};
+    fflush(fp_);
+}
+
+void
+DecoderCapture::picture_rendered(VdpDecoder decoder, VdpVideoSurface target,
+                                 VdpDecoderProfile profile, VdpPictureInfo const *picture_info,
+                                 uint32_t bitstream_buffer_count,
+                                 VdpBitstreamBuffer const *bitstream_buffers)
+{
+    const size_t info_size = picture_info_size(profile);
+    size_t total_size = info_size;
+
+    for (uint32_t k = 0; k < bitstream_buffer_count; k ++)
+        total_size += bitstream_buffers[k].bitstream_bytes;
+
+    std::vector<uint8_t> payload;
+    payload.reserve(total_size + 4 * (bitstream_buffer_count * 2 + 4));
+
+    append_u32(payload, decoder);
+    append_u32(payload, target);
+    append_u32(payload, info_size);
+    append_padded(payload, picture_info, info_size);
+    append_u32(payload, bitstream_buffer_count);
+
+    for (uint32_t k = 0; k < bitstream_buffer_count; k ++) {
+        append_u32(payload, bitstream_buffers[k].bitstream_bytes);
+        append_padded(payload, bitstream_buffers[k].bitstream,
+                      bitstream_buffers[k].bitstream_bytes);
+    }
+
+    write_record(kTagDecoderRender, payload);
+}
+
+size_t
+picture_info_size(VdpDecoderProfile profile)
+{
+    switch (profile) {
+    case VDP_DECODER_PROFILE_MPEG1:
+    case VDP_DECODER_PROFILE_MPEG2_SIMPLE:
+    case VDP_DECODER_PROFILE_MPEG2_MAIN:
+        return sizeof(VdpPictureInfoMPEG1Or2);
+
+    case VDP_DECODER_PROFILE_H264_CONSTRAINED_BASELINE:
+    case VDP_DECODER_PROFILE_H264_BASELINE:
+    case VDP_DECODER_PROFILE_H264_MAIN:
+    case VDP_DECODER_PROFILE_H264_HIGH:
+        return sizeof(VdpPictureInfoH264);
+
+    case VDP_DECODER_PROFILE_VC1_SIMPLE:
+    case VDP_DECODER_PROFILE_VC1_MAIN:
+    case VDP_DECODER_PROFILE_VC1_ADVANCED:
+        return sizeof(VdpPictureInfoVC1);
+
+    case VDP_DECODER_PROFILE_HEVC_MAIN:
+    case VDP_DECODER_PROFILE_HEVC_MAIN_10:
+        return sizeof(VdpPictureInfoHEVC);
+
+    default:
+        return 0;
+    }
+}
+
+} // namespace vdp
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2013-2016  Rinat Ibragimov
+ *
+ * This file is part of libvdpau-va-gl
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <vdpau/vdpau.h>
+#include <vector>
+
+
+namespace vdp {
+
+/// Writes decoder calls to a file named by VDPAU_CAPTURE environment variable, so decoding can
+/// be replayed later by vdpau-replay without a player. Does nothing if variable is not set.
+///
+/// File is a sequence of native-endian uint32_t fields. Header is magic 'VDPC' and version.
+/// Each record starts with a tag and payload size in bytes:
+///
+///   'SCRE'  video surface created: surface, chroma type, width, height
+///   'SDES'  video surface destroyed: surface
+///   'DCRE'  decoder created: decoder, profile, width, height, max references
+///   'DDES'  decoder destroyed: decoder
+///   'DREN'  picture rendered: decoder, target surface, picture info size, picture info
+///           (padded to 4 bytes), bitstream buffer count, then size and padded contents of
+///           each buffer
+///
+/// Picture info is stored as is, so it refers to surface handles of the capturing process.
+class DecoderCapture
+{
+public:
+    static DecoderCapture &
+    instance();
+
+    ~DecoderCapture();
+
+    bool
+    enabled() const { return fp_ != nullptr; }
+
+    void
+    surface_created(VdpVideoSurface surface, VdpChromaType chroma_type, uint32_t width,
+                    uint32_t height);
+
+    void
+    surface_destroyed(VdpVideoSurface surface);
+
+    void
+    decoder_created(VdpDecoder decoder, VdpDecoderProfile profile, uint32_t width,
+                    uint32_t height, uint32_t max_references);
+
+    void
+    decoder_destroyed(VdpDecoder decoder);
+
+    void
+    picture_rendered(VdpDecoder decoder, VdpVideoSurface target, VdpDecoderProfile profile,
+                     VdpPictureInfo const *picture_info, uint32_t bitstream_buffer_count,
+                     VdpBitstreamBuffer const *bitstream_buffers);
+
+private:
+    DecoderCapture();
+
+    DecoderCapture(const DecoderCapture &) = delete;
+
+    DecoderCapture &
+    operator=(const DecoderCapture &) = delete;
+
+    void
+    write_record(uint32_t tag, const std::vector<uint8_t> &payload);
+
+    std::mutex  mtx_;
+    FILE       *fp_;
+};
+
+/// size of picture info structure used by decoders of given profile, 0 if unknown
+size_t
+picture_info_size(VdpDecoderProfile profile);
+
+} // namespace vdp
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2013-2016  Rinat Ibragimov
+ *
+ * This file is part of libvdpau-va-gl
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "dirty-region.hh"
+#include <algorithm>
+
+
+namespace {
+
+uint64_t
+area(const VdpRect &r)
+{
+    return static_cast<uint64_t>(r.x1 - r.x0) * (r.y1 - r.y0);
+}
+
+VdpRect
+bounding_box(const VdpRect &a, const VdpRect &b)
+{
+    return VdpRect{std::min(a.x0, b.x0), std::min(a.y0, b.y0), std::max(a.x1, b.x1),
+                   std::max(a.y1, b.y1)};
+}
+
+/// area covered by bounding box of two rectangles, but by neither of them. Overlap is counted
+/// once for each rectangle, so contained and adjacent rectangles waste nothing
+int64_t
+merge_waste(const VdpRect &a, const VdpRect &b)
+{
+    return static_cast<int64_t>(area(bounding_box(a, b))) - area(a) - area(b);
+}
+
+} // anonymous namespace
+
+
+namespace vdp {
+
+DirtyRegion::DirtyRegion(size_t max_rects)
+    : max_rects_{std::max<size_t>(max_rects, 1)}
+{}
+
+void
+DirtyRegion::add(const VdpRect &rect)
+{
+    if (rect.x0 >= rect.x1 || rect.y0 >= rect.y1)
+        return;
+
+    VdpRect r = rect;
+
+    // grown rectangle may become mergeable with others, so repeat until nothing changes
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (auto it = rects_.begin(); it != rects_.end(); ++ it) {
+            if (merge_waste(*it, r) <= 0) {
+                r = bounding_box(*it, r);
+                rects_.erase(it);
+                merged = true;
+                break;
+            }
+        }
+
+        if (!merged && rects_.size() >= max_rects_) {
+            auto best = rects_.begin();
+            for (auto it = rects_.begin(); it != rects_.end(); ++ it) {
+                if (merge_waste(*it, r) < merge_waste(*best, r))
+                    best = it;
+            }
+
+            r = bounding_box(*best, r);
+            rects_.erase(best);
+            merged = true;
+        }
+    }
+
+    rects_.push_back(r);
+}
+
+} // namespace vdp
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2013-2016  Rinat Ibragimov
+ *
+ * This file is part of libvdpau-va-gl
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vdpau/vdpau.h>
+#include <vector>
+
+
+namespace vdp {
+
+/// area of a picture changed since it was last synchronized, as a short list of rectangles.
+/// Rectangles are merged when their bounding box wastes no area, and forcibly once there are
+/// too many of them, merging the pair that wastes the least. Does bookkeeping only, no GL calls
+class DirtyRegion
+{
+public:
+    explicit DirtyRegion(size_t max_rects);
+
+    void
+    add(const VdpRect &rect);
+
+    void
+    clear()
+    {
+        rects_.clear();
+    }
+
+    bool
+    empty() const
+    {
+        return rects_.empty();
+    }
+
+    /// rectangles covering the region. They may overlap
+    const std::vector<VdpRect> &
+    rects() const
+    {
+        return rects_;
+    }
+
+private:
+    size_t                  max_rects_;
+    std::vector<VdpRect>    rects_;
+};
+
+} // namespace vdp
@@ -43,6 +43,11 @@ initialize_quirks()
     global.quirks.buggy_XCloseDisplay = 0;
     global.quirks.show_watermark = 0;
     global.quirks.avoid_va = 0;
+    global.quirks.log_stats = 0;
+    global.quirks.async_decode = 0;
+    global.quirks.avoid_dmabuf = 0;
+    global.quirks.avoid_bitmap_atlas = 0;
+    global.quirks.dedup_bitmaps = 0;
 
     const char *value = getenv("VDPAU_QUIRKS");
     if (!value)
@@ -72,6 +77,21 @@ initialize_quirks()
             } else
             if (!strcmp("avoidva", item_start)) {
                 global.quirks.avoid_va = 1;
+            } else
+            if (!strcmp("logstats", item_start)) {
+                global.quirks.log_stats = 1;
+            } else
+            if (!strcmp("asyncdecode", item_start)) {
+                global.quirks.async_decode = 1;
+            } else
+            if (!strcmp("avoiddmabuf", item_start)) {
+                global.quirks.avoid_dmabuf = 1;
+            } else
+            if (!strcmp("avoidbitmapatlas", item_start)) {
+                global.quirks.avoid_bitmap_atlas = 1;
+            } else
+            if (!strcmp("dedupbitmaps", item_start)) {
+                global.quirks.dedup_bitmaps = 1;
             }
 
             item_start = ptr + 1;
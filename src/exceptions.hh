@@ -33,5 +33,8 @@ class invalid_size:         public std::exception {};   // VDP_STATUS_INVALID_SI
 class invalid_rgba_format:  public std::exception {};   // VDP_STATUS_INVALID_RGBA_FORMAT
 class invalid_decoder_profile: public std::exception {};// VDP_INVALID_DECODER_PROFILE
 class invalid_chroma_type:  public std::exception {};   // VDP_INVALID_CHROMA_TYPE
+class invalid_value:        public std::exception {};   // VDP_STATUS_INVALID_VALUE
+class invalid_video_mixer_parameter: public std::exception {};
+                                                        // VDP_INVALID_VIDEO_MIXER_PARAMETER
 
 } // namespace vdp
@@ -33,6 +33,11 @@ struct global_data {
         int show_watermark;         ///< show picture over output
         int avoid_va;               ///< do not use VA-API video decoding acceleration even if
                                     ///< available
+        int log_stats;              ///< print resource usage statistics on resource destruction
+        int async_decode;           ///< submit decoded pictures to VA-API from a separate thread
+        int avoid_dmabuf;           ///< transfer decoded pictures to GL through X pixmap
+        int avoid_bitmap_atlas;     ///< give each bitmap surface its own texture
+        int dedup_bitmaps;          ///< skip bitmap updates with unchanged content
     } quirks;
 };
 
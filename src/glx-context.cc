@@ -30,6 +30,7 @@
 #include "compat.hh"
 #include "globals.hh"
 #include "glx-context.hh"
+#include "quad-renderer.hh"
 #include "trace.hh"
 #include <assert.h>
 #include <map>
@@ -84,6 +85,7 @@ GLXManagedContext::destroy()
     if (glc_ == glXGetCurrentContext())
         glXMakeCurrent(dpy_.get(), None, nullptr);
 
+    forget_quad_vao(glc_);
     glXDestroyContext(dpy_.get(), glc_);
 
     glc_ = nullptr;
@@ -193,6 +195,7 @@ GLXGlobalContext::~GLXGlobalContext()
 
             // destroying all per-thread GL contexts
             g_glc_map.clear();
+            forget_quad_vbo();
         }
 
     } catch (...) {
@@ -64,6 +64,12 @@ check_for_exceptions(callable fwd, Args... args)
     } catch (const vdp::invalid_chroma_type &) {
         return VDP_STATUS_INVALID_CHROMA_TYPE;
 
+    } catch (const vdp::invalid_value &) {
+        return VDP_STATUS_INVALID_VALUE;
+
+    } catch (const vdp::invalid_video_mixer_parameter &) {
+        return VDP_STATUS_INVALID_VIDEO_MIXER_PARAMETER;
+
     } catch (...) {
         return VDP_STATUS_ERROR;
     }
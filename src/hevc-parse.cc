@@ -0,0 +1,657 @@
+/*
+ * Copyright 2013-2016  Rinat Ibragimov
+ *
+ * This file is part of libvdpau-va-gl
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "hevc-parse.hh"
+#include "bitstream.hh"
+#include <algorithm>
+#include <string.h>
+
+
+namespace vdp {
+
+namespace {
+
+enum {
+    SLICE_TYPE_B =  0,
+    SLICE_TYPE_P =  1,
+    SLICE_TYPE_I =  2,
+};
+
+enum {
+    NAL_BLA_W_LP =      16,
+    NAL_IDR_W_RADL =    19,
+    NAL_IDR_N_LP =      20,
+    NAL_RSV_IRAP_23 =   23,
+    NAL_VPS =           32,     ///< first non-VCL NAL unit type
+};
+
+const uint8_t kNoReference = 0xff;
+
+// position of n-th coefficient of 4x4 up-right diagonal scan in raster order, H.265 6.5.3
+const uint8_t kDiagonalScan4x4[16] = {
+     0,  4,  1,  8,  5,  2, 12,  9,
+     6,  3, 13, 10,  7, 14, 11, 15,
+};
+
+// position of n-th coefficient of 8x8 up-right diagonal scan in raster order
+const uint8_t kDiagonalScan8x8[64] = {
+     0,  8,  1, 16,  9,  2, 24, 17,
+    10,  3, 32, 25, 18, 11,  4, 40,
+    33, 26, 19, 12,  5, 48, 41, 34,
+    27, 20, 13,  6, 56, 49, 42, 35,
+    28, 21, 14,  7, 57, 50, 43, 36,
+    29, 22, 15, 58, 51, 44, 37, 30,
+    23, 59, 52, 45, 38, 31, 60, 53,
+    46, 39, 61, 54, 47, 62, 55, 63,
+};
+
+/// Ceil(Log2(v))
+uint32_t
+ceil_log2(uint32_t v)
+{
+    uint32_t res = 0;
+
+    while ((1u << res) < v)
+        res ++;
+
+    return res;
+}
+
+/// converts offset in unescaped data to offset in data with emulation prevention bytes
+size_t
+escaped_offset(const uint8_t *data, size_t size, size_t unescaped)
+{
+    size_t pos = 0;
+    size_t produced = 0;
+    uint32_t zeros = 0;
+
+    while (produced < unescaped && pos < size) {
+        const uint8_t b = data[pos ++];
+
+        if (zeros >= 2 && b == 3) {
+            zeros = 0;
+            continue;
+        }
+
+        zeros = (b == 0) ? zeros + 1 : 0;
+        produced ++;
+    }
+
+    return pos;
+}
+
+/// pred_weight_table(), 7.3.6.3
+void
+parse_pred_weight_table(RBSPState &st, const VdpPictureInfoHEVC *vdppi, uint32_t slice_type,
+                        VASliceParameterBufferHEVC *vasp)
+{
+    const int ChromaArrayType = vdppi->separate_colour_plane_flag ? 0
+                                                                  : vdppi->chroma_format_idc;
+
+    vasp->luma_log2_weight_denom = st.get_uev();
+    if (ChromaArrayType != 0)
+        vasp->delta_chroma_log2_weight_denom = st.get_sev();
+
+    const int32_t ChromaLog2WeightDenom = vasp->luma_log2_weight_denom +
+                                          vasp->delta_chroma_log2_weight_denom;
+
+    const int lists = (slice_type == SLICE_TYPE_B) ? 2 : 1;
+
+    for (int list = 0; list < lists; list ++) {
+        const uint32_t num_refs = (list == 0) ? vasp->num_ref_idx_l0_active_minus1 + 1
+                                              : vasp->num_ref_idx_l1_active_minus1 + 1;
+        int8_t *delta_luma_weight = (list == 0) ? vasp->delta_luma_weight_l0
+                                                : vasp->delta_luma_weight_l1;
+        int8_t *luma_offset = (list == 0) ? vasp->luma_offset_l0 : vasp->luma_offset_l1;
+        int8_t (*delta_chroma_weight)[2] = (list == 0) ? vasp->delta_chroma_weight_l0
+                                                       : vasp->delta_chroma_weight_l1;
+        int8_t (*chroma_offset)[2] = (list == 0) ? vasp->ChromaOffsetL0 : vasp->ChromaOffsetL1;
+
+        uint8_t luma_weight_flag[15] = {};
+        uint8_t chroma_weight_flag[15] = {};
+
+        for (uint32_t i = 0; i < num_refs; i ++)
+            luma_weight_flag[i] = st.get_u(1);
+
+        if (ChromaArrayType != 0) {
+            for (uint32_t i = 0; i < num_refs; i ++)
+                chroma_weight_flag[i] = st.get_u(1);
+        }
+
+        for (uint32_t i = 0; i < num_refs; i ++) {
+            if (luma_weight_flag[i]) {
+                delta_luma_weight[i] = st.get_sev();
+                luma_offset[i] = st.get_sev();
+            }
+
+            if (chroma_weight_flag[i]) {
+                for (int j = 0; j < 2; j ++) {
+                    delta_chroma_weight[i][j] = st.get_sev();
+                    const int32_t delta_chroma_offset = st.get_sev();
+
+                    // derivation of ChromaOffset, 7.4.7.3
+                    const int32_t ChromaWeight = (1 << ChromaLog2WeightDenom) +
+                                                 delta_chroma_weight[i][j];
+                    const int32_t offset = 128 + delta_chroma_offset -
+                                           ((128 * ChromaWeight) >> ChromaLog2WeightDenom);
+                    chroma_offset[i][j] = std::min(std::max(offset, -128), 127);
+                }
+            }
+        }
+    }
+}
+
+/// fills RefPicList0 and RefPicList1, 8.3.4. Entries are indices in ReferenceFrames
+bool
+fill_ref_pic_lists(const VdpPictureInfoHEVC *vdppi, uint32_t slice_type,
+                   const uint32_t list_entry[2][16], const bool modification_flag[2],
+                   VASliceParameterBufferHEVC *vasp)
+{
+    memset(vasp->RefPicList, kNoReference, sizeof(vasp->RefPicList));
+
+    if (slice_type == SLICE_TYPE_I)
+        return true;
+
+    if (vdppi->NumPocTotalCurr == 0)
+        return false;
+
+    // inconsistent picture info would make the list building loop below endless
+    if (vdppi->NumPocStCurrBefore + vdppi->NumPocStCurrAfter + vdppi->NumPocLtCurr == 0)
+        return false;
+
+    const int lists = (slice_type == SLICE_TYPE_B) ? 2 : 1;
+
+    for (int list = 0; list < lists; list ++) {
+        const uint32_t num_active = (list == 0) ? vasp->num_ref_idx_l0_active_minus1 + 1
+                                                : vasp->num_ref_idx_l1_active_minus1 + 1;
+        const uint32_t NumRpsCurrTempList = std::min(std::max(num_active,
+                                                              vdppi->NumPocTotalCurr), 16u);
+
+        // List 0 starts with pictures preceding current one, list 1 with following ones
+        const uint8_t *first = (list == 0) ? vdppi->RefPicSetStCurrBefore
+                                           : vdppi->RefPicSetStCurrAfter;
+        const uint8_t *second = (list == 0) ? vdppi->RefPicSetStCurrAfter
+                                            : vdppi->RefPicSetStCurrBefore;
+        const uint32_t first_count = (list == 0) ? vdppi->NumPocStCurrBefore
+                                                 : vdppi->NumPocStCurrAfter;
+        const uint32_t second_count = (list == 0) ? vdppi->NumPocStCurrAfter
+                                                  : vdppi->NumPocStCurrBefore;
+
+        uint8_t temp[16];
+        uint32_t r_idx = 0;
+
+        while (r_idx < NumRpsCurrTempList) {
+            for (uint32_t i = 0; i < first_count && r_idx < NumRpsCurrTempList; i ++)
+                temp[r_idx ++] = first[i];
+            for (uint32_t i = 0; i < second_count && r_idx < NumRpsCurrTempList; i ++)
+                temp[r_idx ++] = second[i];
+            for (uint32_t i = 0; i < vdppi->NumPocLtCurr && r_idx < NumRpsCurrTempList; i ++)
+                temp[r_idx ++] = vdppi->RefPicSetLtCurr[i];
+        }
+
+        for (uint32_t i = 0; i < std::min(num_active, 15u); i ++) {
+            const uint32_t idx = modification_flag[list] ? list_entry[list][i] : i;
+            if (idx >= NumRpsCurrTempList)
+                return false;
+
+            vasp->RefPicList[list][i] = temp[idx];
+        }
+    }
+
+    return true;
+}
+
+void
+do_parse_slice_header(RBSPState &st, const VdpPictureInfoHEVC *vdppi,
+                      const VASliceParameterBufferHEVC *prev, VASliceParameterBufferHEVC *vasp)
+{
+    st.get_u(1);                                // forbidden_zero_bit
+    const uint32_t nal_unit_type = st.get_u(6);
+    st.get_u(6);                                // nuh_layer_id
+    st.get_u(3);                                // nuh_temporal_id_plus1
+
+    const uint32_t first_slice_segment_in_pic_flag = st.get_u(1);
+    if (nal_unit_type >= NAL_BLA_W_LP && nal_unit_type <= NAL_RSV_IRAP_23)
+        st.get_u(1);                            // no_output_of_prior_pics_flag
+
+    st.get_uev();                               // slice_pic_parameter_set_id
+
+    uint32_t dependent_slice_segment_flag = 0;
+    uint32_t slice_segment_address = 0;
+
+    if (!first_slice_segment_in_pic_flag) {
+        if (vdppi->dependent_slice_segments_enabled_flag)
+            dependent_slice_segment_flag = st.get_u(1);
+
+        const uint32_t CtbLog2SizeY = vdppi->log2_min_luma_coding_block_size_minus3 + 3 +
+                                      vdppi->log2_diff_max_min_luma_coding_block_size;
+        const uint32_t CtbSizeY = 1u << CtbLog2SizeY;
+        const uint32_t PicWidthInCtbsY = (vdppi->pic_width_in_luma_samples + CtbSizeY - 1) /
+                                         CtbSizeY;
+        const uint32_t PicHeightInCtbsY = (vdppi->pic_height_in_luma_samples + CtbSizeY - 1) /
+                                          CtbSizeY;
+
+        slice_segment_address = st.get_u(ceil_log2(PicWidthInCtbsY * PicHeightInCtbsY));
+    }
+
+    if (dependent_slice_segment_flag) {
+        if (!prev)
+            throw RBSPState::error("dependent slice segment without preceding one");
+
+        // everything up to entry points is inherited from the independent slice segment
+        *vasp = *prev;
+        vasp->LongSliceFlags.fields.LastSliceOfPic = 0;
+
+    } else {
+        *vasp = {};
+
+        for (uint32_t i = 0; i < vdppi->num_extra_slice_header_bits; i ++)
+            st.get_u(1);                        // slice_reserved_flag
+
+        const uint32_t slice_type = st.get_uev();
+        if (slice_type > SLICE_TYPE_I)
+            throw RBSPState::error("wrong slice_type");
+
+        auto &flags = vasp->LongSliceFlags.fields;
+        flags.slice_type = slice_type;
+
+        if (vdppi->output_flag_present_flag)
+            st.get_u(1);                        // pic_output_flag
+
+        if (vdppi->separate_colour_plane_flag)
+            flags.color_plane_id = st.get_u(2);
+
+        if (nal_unit_type != NAL_IDR_W_RADL && nal_unit_type != NAL_IDR_N_LP) {
+            st.get_u(vdppi->log2_max_pic_order_cnt_lsb_minus4 + 4);  // slice_pic_order_cnt_lsb
+
+            const uint32_t short_term_ref_pic_set_sps_flag = st.get_u(1);
+            if (!short_term_ref_pic_set_sps_flag) {
+                // st_ref_pic_set() itself is already parsed by the application
+                st.get_u(vdppi->NumShortTermPictureSliceHeaderBits);
+            } else if (vdppi->num_short_term_ref_pic_sets > 1) {
+                st.get_u(ceil_log2(vdppi->num_short_term_ref_pic_sets)); // short_term_ref_pic_set_idx
+            }
+
+            if (vdppi->long_term_ref_pics_present_flag)
+                st.get_u(vdppi->NumLongTermPictureSliceHeaderBits);
+
+            if (vdppi->sps_temporal_mvp_enabled_flag)
+                flags.slice_temporal_mvp_enabled_flag = st.get_u(1);
+        }
+
+        if (vdppi->sample_adaptive_offset_enabled_flag) {
+            const int ChromaArrayType = vdppi->separate_colour_plane_flag
+                                        ? 0 : vdppi->chroma_format_idc;
+
+            flags.slice_sao_luma_flag = st.get_u(1);
+            if (ChromaArrayType != 0)
+                flags.slice_sao_chroma_flag = st.get_u(1);
+        }
+
+        uint32_t list_entry[2][16] = {};
+        bool modification_flag[2] = {false, false};
+
+        flags.collocated_from_l0_flag = 1;
+
+        if (slice_type == SLICE_TYPE_P || slice_type == SLICE_TYPE_B) {
+            vasp->num_ref_idx_l0_active_minus1 = vdppi->num_ref_idx_l0_default_active_minus1;
+            vasp->num_ref_idx_l1_active_minus1 = vdppi->num_ref_idx_l1_default_active_minus1;
+
+            if (st.get_u(1)) {                  // num_ref_idx_active_override_flag
+                vasp->num_ref_idx_l0_active_minus1 = st.get_uev();
+                if (slice_type == SLICE_TYPE_B)
+                    vasp->num_ref_idx_l1_active_minus1 = st.get_uev();
+            }
+
+            if (vasp->num_ref_idx_l0_active_minus1 > 14 ||
+                vasp->num_ref_idx_l1_active_minus1 > 14)
+            {
+                throw RBSPState::error("too many active references");
+            }
+
+            // ref_pic_lists_modification(), 7.3.6.2
+            if (vdppi->lists_modification_present_flag && vdppi->NumPocTotalCurr > 1) {
+                const uint32_t entry_bits = ceil_log2(vdppi->NumPocTotalCurr);
+                const int lists = (slice_type == SLICE_TYPE_B) ? 2 : 1;
+
+                for (int list = 0; list < lists; list ++) {
+                    const uint32_t num_active = (list == 0)
+                                                ? vasp->num_ref_idx_l0_active_minus1 + 1
+                                                : vasp->num_ref_idx_l1_active_minus1 + 1;
+
+                    modification_flag[list] = st.get_u(1);
+                    if (modification_flag[list]) {
+                        for (uint32_t i = 0; i < num_active; i ++)
+                            list_entry[list][i] = st.get_u(entry_bits);
+                    }
+                }
+            }
+
+            if (slice_type == SLICE_TYPE_B)
+                flags.mvd_l1_zero_flag = st.get_u(1);
+
+            if (vdppi->cabac_init_present_flag)
+                flags.cabac_init_flag = st.get_u(1);
+
+            if (flags.slice_temporal_mvp_enabled_flag) {
+                if (slice_type == SLICE_TYPE_B)
+                    flags.collocated_from_l0_flag = st.get_u(1);
+
+                // present only if chosen list has more than one entry
+                const uint32_t num_in_list_minus1 = flags.collocated_from_l0_flag
+                                                    ? vasp->num_ref_idx_l0_active_minus1
+                                                    : vasp->num_ref_idx_l1_active_minus1;
+                if (num_in_list_minus1 > 0)
+                    vasp->collocated_ref_idx = st.get_uev();
+            } else {
+                vasp->collocated_ref_idx = kNoReference;
+            }
+
+            if ((vdppi->weighted_pred_flag && slice_type == SLICE_TYPE_P) ||
+                (vdppi->weighted_bipred_flag && slice_type == SLICE_TYPE_B))
+            {
+                parse_pred_weight_table(st, vdppi, slice_type, vasp);
+            }
+
+            vasp->five_minus_max_num_merge_cand = st.get_uev();
+
+        } else {
+            vasp->collocated_ref_idx = kNoReference;
+        }
+
+        if (slice_type == SLICE_TYPE_P)
+            vasp->num_ref_idx_l1_active_minus1 = 0;
+
+        if (!fill_ref_pic_lists(vdppi, slice_type, list_entry, modification_flag, vasp))
+            throw RBSPState::error("reference picture list refers outside of RPS");
+
+        vasp->slice_qp_delta = st.get_sev();
+
+        if (vdppi->pps_slice_chroma_qp_offsets_present_flag) {
+            vasp->slice_cb_qp_offset = st.get_sev();
+            vasp->slice_cr_qp_offset = st.get_sev();
+        }
+
+        uint32_t deblocking_filter_override_flag = 0;
+        if (vdppi->deblocking_filter_override_enabled_flag)
+            deblocking_filter_override_flag = st.get_u(1);
+
+        if (deblocking_filter_override_flag) {
+            flags.slice_deblocking_filter_disabled_flag = st.get_u(1);
+            if (!flags.slice_deblocking_filter_disabled_flag) {
+                vasp->slice_beta_offset_div2 = st.get_sev();
+                vasp->slice_tc_offset_div2 = st.get_sev();
+            }
+        } else {
+            flags.slice_deblocking_filter_disabled_flag = vdppi->pps_deblocking_filter_disabled_flag;
+            vasp->slice_beta_offset_div2 = vdppi->pps_beta_offset_div2;
+            vasp->slice_tc_offset_div2 = vdppi->pps_tc_offset_div2;
+        }
+
+        if (vdppi->pps_loop_filter_across_slices_enabled_flag &&
+            (flags.slice_sao_luma_flag || flags.slice_sao_chroma_flag ||
+             !flags.slice_deblocking_filter_disabled_flag))
+        {
+            flags.slice_loop_filter_across_slices_enabled_flag = st.get_u(1);
+        } else {
+            flags.slice_loop_filter_across_slices_enabled_flag =
+                vdppi->pps_loop_filter_across_slices_enabled_flag;
+        }
+    }
+
+    vasp->LongSliceFlags.fields.dependent_slice_segment_flag = dependent_slice_segment_flag;
+    vasp->slice_segment_address = slice_segment_address;
+    vasp->num_entry_point_offsets = 0;
+    vasp->entry_offset_to_subset_array = 0;
+
+    if (vdppi->tiles_enabled_flag || vdppi->entropy_coding_sync_enabled_flag) {
+        vasp->num_entry_point_offsets = st.get_uev();
+        if (vasp->num_entry_point_offsets > 0) {
+            const uint32_t offset_len = st.get_uev() + 1;
+
+            // entry points are found by hardware itself
+            for (uint32_t i = 0; i < vasp->num_entry_point_offsets; i ++)
+                st.get_u(offset_len);
+        }
+    }
+
+    if (vdppi->slice_segment_header_extension_present_flag) {
+        const uint32_t length = st.get_uev();
+
+        for (uint32_t i = 0; i < length; i ++)
+            st.get_u(8);                        // slice_segment_header_extension_data_byte
+    }
+
+    // byte_alignment()
+    if (st.get_u(1) != 1)
+        throw RBSPState::error("wrong alignment bit");
+
+    while (st.bits_eaten() % 8 != 0) {
+        if (st.get_u(1) != 0)
+            throw RBSPState::error("wrong alignment bit");
+    }
+}
+
+} // anonymous namespace
+
+void
+hevc_translate_pic_param(VAPictureParameterBufferHEVC *pic_param, const VdpPictureInfoHEVC *vdppi,
+                         VASurfaceID target, const VASurfaceID ref_surfaces[16])
+{
+    *pic_param = {};
+
+    pic_param->CurrPic.picture_id       = target;
+    pic_param->CurrPic.pic_order_cnt    = vdppi->CurrPicOrderCntVal;
+    pic_param->CurrPic.flags            = 0;
+
+    // VA-API has one entry less, and the last one is not needed: the current picture takes
+    // place in the DPB too.
+    for (int k = 0; k < 15; k ++) {
+        auto &ref = pic_param->ReferenceFrames[k];
+
+        if (ref_surfaces[k] == VA_INVALID_SURFACE) {
+            ref.picture_id = VA_INVALID_SURFACE;
+            ref.flags = VA_PICTURE_HEVC_INVALID;
+            continue;
+        }
+
+        ref.picture_id = ref_surfaces[k];
+        ref.pic_order_cnt = vdppi->PicOrderCntVal[k];
+        ref.flags = vdppi->IsLongTerm[k] ? VA_PICTURE_HEVC_LONG_TERM_REFERENCE : 0;
+    }
+
+    for (int k = 0; k < std::min<int>(vdppi->NumPocStCurrBefore, 8); k ++) {
+        if (vdppi->RefPicSetStCurrBefore[k] < 15)
+            pic_param->ReferenceFrames[vdppi->RefPicSetStCurrBefore[k]].flags |=
+                VA_PICTURE_HEVC_RPS_ST_CURR_BEFORE;
+    }
+
+    for (int k = 0; k < std::min<int>(vdppi->NumPocStCurrAfter, 8); k ++) {
+        if (vdppi->RefPicSetStCurrAfter[k] < 15)
+            pic_param->ReferenceFrames[vdppi->RefPicSetStCurrAfter[k]].flags |=
+                VA_PICTURE_HEVC_RPS_ST_CURR_AFTER;
+    }
+
+    for (int k = 0; k < std::min<int>(vdppi->NumPocLtCurr, 8); k ++) {
+        if (vdppi->RefPicSetLtCurr[k] < 15)
+            pic_param->ReferenceFrames[vdppi->RefPicSetLtCurr[k]].flags |=
+                VA_PICTURE_HEVC_RPS_LT_CURR;
+    }
+
+    pic_param->pic_width_in_luma_samples    = vdppi->pic_width_in_luma_samples;
+    pic_param->pic_height_in_luma_samples   = vdppi->pic_height_in_luma_samples;
+
+#define PIC_FIELDS(fieldname) pic_param->pic_fields.bits.fieldname
+    PIC_FIELDS(chroma_format_idc)                   = vdppi->chroma_format_idc;
+    PIC_FIELDS(separate_colour_plane_flag)          = vdppi->separate_colour_plane_flag;
+    PIC_FIELDS(pcm_enabled_flag)                    = vdppi->pcm_enabled_flag;
+    PIC_FIELDS(scaling_list_enabled_flag)           = vdppi->scaling_list_enabled_flag;
+    PIC_FIELDS(transform_skip_enabled_flag)         = vdppi->transform_skip_enabled_flag;
+    PIC_FIELDS(amp_enabled_flag)                    = vdppi->amp_enabled_flag;
+    PIC_FIELDS(strong_intra_smoothing_enabled_flag) = vdppi->strong_intra_smoothing_enabled_flag;
+    PIC_FIELDS(sign_data_hiding_enabled_flag)       = vdppi->sign_data_hiding_enabled_flag;
+    PIC_FIELDS(constrained_intra_pred_flag)         = vdppi->constrained_intra_pred_flag;
+    PIC_FIELDS(cu_qp_delta_enabled_flag)            = vdppi->cu_qp_delta_enabled_flag;
+    PIC_FIELDS(weighted_pred_flag)                  = vdppi->weighted_pred_flag;
+    PIC_FIELDS(weighted_bipred_flag)                = vdppi->weighted_bipred_flag;
+    PIC_FIELDS(transquant_bypass_enabled_flag)      = vdppi->transquant_bypass_enabled_flag;
+    PIC_FIELDS(tiles_enabled_flag)                  = vdppi->tiles_enabled_flag;
+    PIC_FIELDS(entropy_coding_sync_enabled_flag)    = vdppi->entropy_coding_sync_enabled_flag;
+    PIC_FIELDS(pps_loop_filter_across_slices_enabled_flag) =
+        vdppi->pps_loop_filter_across_slices_enabled_flag;
+    PIC_FIELDS(loop_filter_across_tiles_enabled_flag) = vdppi->loop_filter_across_tiles_enabled_flag;
+    PIC_FIELDS(pcm_loop_filter_disabled_flag)       = vdppi->pcm_loop_filter_disabled_flag;
+    // reordering and bi-prediction restrictions are not passed through VDPAU
+    PIC_FIELDS(NoPicReorderingFlag)                 = 0;
+    PIC_FIELDS(NoBiPredFlag)                        = 0;
+#undef PIC_FIELDS
+
+    pic_param->sps_max_dec_pic_buffering_minus1     = vdppi->sps_max_dec_pic_buffering_minus1;
+    pic_param->bit_depth_luma_minus8                = vdppi->bit_depth_luma_minus8;
+    pic_param->bit_depth_chroma_minus8              = vdppi->bit_depth_chroma_minus8;
+    pic_param->pcm_sample_bit_depth_luma_minus1     = vdppi->pcm_sample_bit_depth_luma_minus1;
+    pic_param->pcm_sample_bit_depth_chroma_minus1   = vdppi->pcm_sample_bit_depth_chroma_minus1;
+    pic_param->log2_min_luma_coding_block_size_minus3 =
+        vdppi->log2_min_luma_coding_block_size_minus3;
+    pic_param->log2_diff_max_min_luma_coding_block_size =
+        vdppi->log2_diff_max_min_luma_coding_block_size;
+    pic_param->log2_min_transform_block_size_minus2 = vdppi->log2_min_transform_block_size_minus2;
+    pic_param->log2_diff_max_min_transform_block_size =
+        vdppi->log2_diff_max_min_transform_block_size;
+    pic_param->log2_min_pcm_luma_coding_block_size_minus3 =
+        vdppi->log2_min_pcm_luma_coding_block_size_minus3;
+    pic_param->log2_diff_max_min_pcm_luma_coding_block_size =
+        vdppi->log2_diff_max_min_pcm_luma_coding_block_size;
+    pic_param->max_transform_hierarchy_depth_intra  = vdppi->max_transform_hierarchy_depth_intra;
+    pic_param->max_transform_hierarchy_depth_inter  = vdppi->max_transform_hierarchy_depth_inter;
+    pic_param->init_qp_minus26                      = vdppi->init_qp_minus26;
+    pic_param->diff_cu_qp_delta_depth               = vdppi->diff_cu_qp_delta_depth;
+    pic_param->pps_cb_qp_offset                     = vdppi->pps_cb_qp_offset;
+    pic_param->pps_cr_qp_offset                     = vdppi->pps_cr_qp_offset;
+    pic_param->log2_parallel_merge_level_minus2     = vdppi->log2_parallel_merge_level_minus2;
+
+    if (vdppi->tiles_enabled_flag) {
+        pic_param->num_tile_columns_minus1  = vdppi->num_tile_columns_minus1;
+        pic_param->num_tile_rows_minus1     = vdppi->num_tile_rows_minus1;
+
+        // VA-API arrays are shorter by one; the last column and row sizes are implied
+        for (int k = 0; k < 19; k ++)
+            pic_param->column_width_minus1[k] = vdppi->column_width_minus1[k];
+        for (int k = 0; k < 21; k ++)
+            pic_param->row_height_minus1[k] = vdppi->row_height_minus1[k];
+    }
+
+#define SLICE_FIELDS(fieldname) pic_param->slice_parsing_fields.bits.fieldname
+    SLICE_FIELDS(lists_modification_present_flag)   = vdppi->lists_modification_present_flag;
+    SLICE_FIELDS(long_term_ref_pics_present_flag)   = vdppi->long_term_ref_pics_present_flag;
+    SLICE_FIELDS(sps_temporal_mvp_enabled_flag)     = vdppi->sps_temporal_mvp_enabled_flag;
+    SLICE_FIELDS(cabac_init_present_flag)           = vdppi->cabac_init_present_flag;
+    SLICE_FIELDS(output_flag_present_flag)          = vdppi->output_flag_present_flag;
+    SLICE_FIELDS(dependent_slice_segments_enabled_flag) =
+        vdppi->dependent_slice_segments_enabled_flag;
+    SLICE_FIELDS(pps_slice_chroma_qp_offsets_present_flag) =
+        vdppi->pps_slice_chroma_qp_offsets_present_flag;
+    SLICE_FIELDS(sample_adaptive_offset_enabled_flag) = vdppi->sample_adaptive_offset_enabled_flag;
+    SLICE_FIELDS(deblocking_filter_override_enabled_flag) =
+        vdppi->deblocking_filter_override_enabled_flag;
+    SLICE_FIELDS(pps_disable_deblocking_filter_flag) = vdppi->pps_deblocking_filter_disabled_flag;
+    SLICE_FIELDS(slice_segment_header_extension_present_flag) =
+        vdppi->slice_segment_header_extension_present_flag;
+    SLICE_FIELDS(RapPicFlag)                        = vdppi->RAPPicFlag;
+    SLICE_FIELDS(IdrPicFlag)                        = vdppi->IDRPicFlag;
+    SLICE_FIELDS(IntraPicFlag)                      = vdppi->RAPPicFlag;
+#undef SLICE_FIELDS
+
+    pic_param->log2_max_pic_order_cnt_lsb_minus4    = vdppi->log2_max_pic_order_cnt_lsb_minus4;
+    pic_param->num_short_term_ref_pic_sets          = vdppi->num_short_term_ref_pic_sets;
+    pic_param->num_long_term_ref_pic_sps            = vdppi->num_long_term_ref_pics_sps;
+    pic_param->num_ref_idx_l0_default_active_minus1 = vdppi->num_ref_idx_l0_default_active_minus1;
+    pic_param->num_ref_idx_l1_default_active_minus1 = vdppi->num_ref_idx_l1_default_active_minus1;
+    pic_param->pps_beta_offset_div2                 = vdppi->pps_beta_offset_div2;
+    pic_param->pps_tc_offset_div2                   = vdppi->pps_tc_offset_div2;
+    pic_param->num_extra_slice_header_bits          = vdppi->num_extra_slice_header_bits;
+    pic_param->st_rps_bits                          = vdppi->NumShortTermPictureSliceHeaderBits;
+}
+
+void
+hevc_translate_iq_matrix(VAIQMatrixBufferHEVC *iq_matrix, const VdpPictureInfoHEVC *vdppi)
+{
+    // VDPAU keeps scaling lists in up-right diagonal order, while VA-API wants them in raster
+    // order. Lists of 16x16 and 32x32 blocks are 8x8 lists upsampled by the decoder, so they
+    // are scanned as 8x8 ones.
+    for (int m = 0; m < 6; m ++) {
+        for (int k = 0; k < 16; k ++)
+            iq_matrix->ScalingList4x4[m][kDiagonalScan4x4[k]] = vdppi->ScalingList4x4[m][k];
+
+        for (int k = 0; k < 64; k ++) {
+            iq_matrix->ScalingList8x8[m][kDiagonalScan8x8[k]] = vdppi->ScalingList8x8[m][k];
+            iq_matrix->ScalingList16x16[m][kDiagonalScan8x8[k]] = vdppi->ScalingList16x16[m][k];
+        }
+    }
+
+    for (int m = 0; m < 2; m ++) {
+        for (int k = 0; k < 64; k ++)
+            iq_matrix->ScalingList32x32[m][kDiagonalScan8x8[k]] = vdppi->ScalingList32x32[m][k];
+    }
+
+    // DC coefficients are single values, there is nothing to reorder
+    memcpy(iq_matrix->ScalingListDC16x16, vdppi->ScalingListDCCoeff16x16,
+           sizeof(iq_matrix->ScalingListDC16x16));
+    memcpy(iq_matrix->ScalingListDC32x32, vdppi->ScalingListDCCoeff32x32,
+           sizeof(iq_matrix->ScalingListDC32x32));
+}
+
+bool
+hevc_is_slice_nal_unit(const uint8_t *data, size_t size)
+{
+    if (size < 2)
+        return false;
+
+    const uint32_t nal_unit_type = (data[0] >> 1) & 0x3f;
+
+    return nal_unit_type < NAL_VPS;
+}
+
+bool
+hevc_parse_slice_header(const uint8_t *data, size_t size, const VdpPictureInfoHEVC *vdppi,
+                        const VASliceParameterBufferHEVC *prev, VASliceParameterBufferHEVC *vasp)
+{
+    RBSPState st{data, size};
+
+    try {
+        do_parse_slice_header(st, vdppi, prev, vasp);
+
+    } catch (const RBSPState::error &) {
+        return false;
+    }
+
+    vasp->slice_data_size           = size;
+    vasp->slice_data_offset         = 0;
+    vasp->slice_data_flag           = VA_SLICE_DATA_FLAG_ALL;
+    vasp->slice_data_byte_offset    = escaped_offset(data, size, st.bits_eaten() / 8);
+
+    return true;
+}
+
+} // namespace vdp
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2013-2016  Rinat Ibragimov
+ *
+ * This file is part of libvdpau-va-gl
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <va/va.h>
+#include <vdpau/vdpau.h>
+
+
+namespace vdp {
+
+/// fills picture parameters. ref_surfaces are VA surfaces of vdppi->RefPics, with
+/// VA_INVALID_SURFACE in unused positions
+void
+hevc_translate_pic_param(VAPictureParameterBufferHEVC *pic_param, const VdpPictureInfoHEVC *vdppi,
+                         VASurfaceID target, const VASurfaceID ref_surfaces[16]);
+
+void
+hevc_translate_iq_matrix(VAIQMatrixBufferHEVC *iq_matrix, const VdpPictureInfoHEVC *vdppi);
+
+/// returns true if NAL unit, starting at its header, contains a slice segment
+bool
+hevc_is_slice_nal_unit(const uint8_t *data, size_t size);
+
+/// Parses slice segment header of NAL unit, starting at its header. Dependent slice segments
+/// take most of their fields from prev, the preceding slice segment of the same picture.
+/// Returns false on truncated or malformed header.
+bool
+hevc_parse_slice_header(const uint8_t *data, size_t size, const VdpPictureInfoHEVC *vdppi,
+                        const VASliceParameterBufferHEVC *prev, VASliceParameterBufferHEVC *vasp);
+
+} // namespace vdp
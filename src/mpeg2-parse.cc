@@ -0,0 +1,219 @@
+/*
+ * Copyright 2013-2016  Rinat Ibragimov
+ *
+ * This file is part of libvdpau-va-gl
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "mpeg2-parse.hh"
+#include "bitstream.hh"
+
+
+namespace vdp {
+
+namespace {
+
+// position of n-th coefficient of zig-zag scan in raster order
+const uint8_t kZigzagScan[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10,
+    17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+// macroblock_address_increment VLC, ISO/IEC 13818-2 table B.1
+struct MBAIncrementCode {
+    uint8_t     length;
+    uint16_t    code;
+    uint8_t     value;
+};
+
+const MBAIncrementCode kMBAIncrementTable[] = {
+    { 1, 0x001,  1},
+    { 3, 0x003,  2}, { 3, 0x002,  3},
+    { 4, 0x003,  4}, { 4, 0x002,  5},
+    { 5, 0x003,  6}, { 5, 0x002,  7},
+    { 7, 0x007,  8}, { 7, 0x006,  9},
+    { 8, 0x00b, 10}, { 8, 0x00a, 11}, { 8, 0x009, 12}, { 8, 0x008, 13}, { 8, 0x007, 14},
+    { 8, 0x006, 15},
+    {10, 0x017, 16}, {10, 0x016, 17}, {10, 0x015, 18}, {10, 0x014, 19}, {10, 0x013, 20},
+    {10, 0x012, 21},
+    {11, 0x023, 22}, {11, 0x022, 23}, {11, 0x021, 24}, {11, 0x020, 25}, {11, 0x01f, 26},
+    {11, 0x01e, 27}, {11, 0x01d, 28}, {11, 0x01c, 29}, {11, 0x01b, 30}, {11, 0x01a, 31},
+    {11, 0x019, 32}, {11, 0x018, 33},
+};
+
+const uint32_t kMBAEscape = 0x008;      // 11 bits, adds 33 to increment
+const uint32_t kMBAStuffing = 0x00f;    // 11 bits, MPEG-1 only, ignored
+
+/// returns 0 on invalid code
+uint32_t
+get_mba_increment(BitReader &br)
+{
+    uint32_t increment = 0;
+
+    while (true) {
+        const uint32_t bits11 = br.peek_u(11);
+
+        if (bits11 == kMBAEscape) {
+            br.get_u(11);
+            increment += 33;
+            continue;
+        }
+
+        if (bits11 == kMBAStuffing) {
+            br.get_u(11);
+            continue;
+        }
+
+        break;
+    }
+
+    for (const auto &entry: kMBAIncrementTable) {
+        if (br.peek_u(entry.length) == entry.code) {
+            br.get_u(entry.length);
+            return increment + entry.value;
+        }
+    }
+
+    return 0;
+}
+
+} // anonymous namespace
+
+void
+mpeg2_translate_pic_param(VAPictureParameterBufferMPEG2 *pic_param, uint32_t width,
+                          uint32_t height, const VdpPictureInfoMPEG1Or2 *vdppi,
+                          VASurfaceID forward_ref, VASurfaceID backward_ref, bool is_first_field)
+{
+    pic_param->horizontal_size              = width;
+    pic_param->vertical_size                = height;
+    pic_param->forward_reference_picture    = forward_ref;
+    pic_param->backward_reference_picture   = backward_ref;
+    pic_param->picture_coding_type          = vdppi->picture_coding_type;
+    pic_param->f_code = (vdppi->f_code[0][0] << 12) | (vdppi->f_code[0][1] << 8) |
+                        (vdppi->f_code[1][0] << 4)  |  vdppi->f_code[1][1];
+
+#define PCE_FIELDS(fieldname) pic_param->picture_coding_extension.bits.fieldname
+
+    pic_param->picture_coding_extension.value   = 0;
+    PCE_FIELDS(intra_dc_precision)              = vdppi->intra_dc_precision;
+    PCE_FIELDS(picture_structure)               = vdppi->picture_structure;
+    PCE_FIELDS(top_field_first)                 = vdppi->top_field_first;
+    PCE_FIELDS(frame_pred_frame_dct)            = vdppi->frame_pred_frame_dct;
+    PCE_FIELDS(concealment_motion_vectors)      = vdppi->concealment_motion_vectors;
+    PCE_FIELDS(q_scale_type)                    = vdppi->q_scale_type;
+    PCE_FIELDS(intra_vlc_format)                = vdppi->intra_vlc_format;
+    PCE_FIELDS(alternate_scan)                  = vdppi->alternate_scan;
+    PCE_FIELDS(repeat_first_field)              = 0; // not passed by VDPAU, display only
+
+    // VDPAU doesn't pass progressive_frame. It implies frame picture with frame prediction,
+    // so that's the best guess.
+    PCE_FIELDS(progressive_frame)               = (vdppi->picture_structure == 3) &&
+                                                  vdppi->frame_pred_frame_dct;
+    PCE_FIELDS(is_first_field)                  = is_first_field;
+#undef PCE_FIELDS
+}
+
+void
+mpeg2_translate_iq_matrix(VAIQMatrixBufferMPEG2 *iq_matrix, const VdpPictureInfoMPEG1Or2 *vdppi)
+{
+    iq_matrix->load_intra_quantiser_matrix              = 1;
+    iq_matrix->load_non_intra_quantiser_matrix          = 1;
+    iq_matrix->load_chroma_intra_quantiser_matrix       = 0;
+    iq_matrix->load_chroma_non_intra_quantiser_matrix   = 0;
+
+    for (int k = 0; k < 64; k ++) {
+        iq_matrix->intra_quantiser_matrix[k] = vdppi->intra_quantizer_matrix[kZigzagScan[k]];
+        iq_matrix->non_intra_quantiser_matrix[k] =
+                                            vdppi->non_intra_quantizer_matrix[kZigzagScan[k]];
+    }
+}
+
+std::vector<size_t>
+mpeg2_find_slices(const uint8_t *data, size_t size)
+{
+    std::vector<size_t> offsets;
+
+    for (size_t k = 0; k + 3 < size; k ++) {
+        if (data[k] != 0 || data[k + 1] != 0 || data[k + 2] != 1)
+            continue;
+
+        const uint8_t start_code = data[k + 3];
+        if (start_code >= 0x01 && start_code <= 0xaf)
+            offsets.push_back(k);
+
+        k += 3;
+    }
+
+    return offsets;
+}
+
+bool
+mpeg2_parse_slice_header(const uint8_t *data, size_t size, uint32_t vertical_size,
+                         VASliceParameterBufferMPEG2 *vasp)
+{
+    // MPEG-2 has no emulation prevention, so plain bit reader is enough
+    BitReader br{data, size};
+
+    const uint32_t start_code = br.get_u(32);
+    uint32_t slice_vertical_position = (start_code & 0xff) - 1;
+
+    if (vertical_size > 2800)
+        slice_vertical_position += br.get_u(3) << 7;
+
+    // priority_breakpoint is present in data partitioning mode only, which VDPAU lacks
+
+    vasp->quantiser_scale_code = br.get_u(5);
+    vasp->intra_slice_flag = 0;
+
+    if (br.peek_u(1)) {
+        vasp->intra_slice_flag = br.get_u(1);
+        br.get_u(1);    // intra_slice
+        br.get_u(7);    // reserved_bits
+
+        while (br.get_u(1))     // extra_bit_slice
+            br.get_u(8);        // extra_information_slice
+
+    } else {
+        br.get_u(1);    // extra_bit_slice
+    }
+
+    // macroblock data begins with first macroblock_address_increment
+    vasp->macroblock_offset = br.bits_eaten();
+
+    const uint32_t mba_increment = get_mba_increment(br);
+    if (mba_increment == 0 || br.overrun())
+        return false;
+
+    vasp->slice_data_size           = size;
+    vasp->slice_data_offset         = 0;
+    vasp->slice_data_flag           = VA_SLICE_DATA_FLAG_ALL;
+    vasp->slice_horizontal_position = mba_increment - 1;
+    vasp->slice_vertical_position   = slice_vertical_position;
+
+    return true;
+}
+
+} // namespace vdp
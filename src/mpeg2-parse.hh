@@ -0,0 +1,56 @@
+/*
+ * Copyright 2013-2016  Rinat Ibragimov
+ *
+ * This file is part of libvdpau-va-gl
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <va/va.h>
+#include <vdpau/vdpau.h>
+#include <vector>
+
+
+namespace vdp {
+
+/// fills VA-API picture parameters. Reference surfaces are VA_INVALID_SURFACE if absent
+void
+mpeg2_translate_pic_param(VAPictureParameterBufferMPEG2 *pic_param, uint32_t width,
+                          uint32_t height, const VdpPictureInfoMPEG1Or2 *vdppi,
+                          VASurfaceID forward_ref, VASurfaceID backward_ref, bool is_first_field);
+
+/// converts raster-order quantizer matrices from VDPAU to zig-zag order expected by VA-API
+void
+mpeg2_translate_iq_matrix(VAIQMatrixBufferMPEG2 *iq_matrix, const VdpPictureInfoMPEG1Or2 *vdppi);
+
+/// returns offsets of slice start codes (0x00 0x00 0x01 0x01..0xaf) in the buffer
+std::vector<size_t>
+mpeg2_find_slices(const uint8_t *data, size_t size);
+
+/// parses slice header. data points to the slice start code, size covers the whole slice.
+/// Returns false if slice is truncated
+bool
+mpeg2_parse_slice_header(const uint8_t *data, size_t size, uint32_t vertical_size,
+                         VASliceParameterBufferMPEG2 *vasp);
+
+} // namespace vdp
@@ -0,0 +1,236 @@
+/*
+ * Copyright 2013-2016  Rinat Ibragimov
+ *
+ * This file is part of libvdpau-va-gl
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define GL_GLEXT_PROTOTYPES
+#include "api-device.hh"
+#include "quad-renderer.hh"
+#include <GL/gl.h>
+#include <initializer_list>
+#include <map>
+
+
+namespace {
+
+/// vertex array objects of a single context
+struct QuadVAOs
+{
+    GLuint  single;     ///< corners only, other attributes are constant
+    GLuint  batch;      ///< corners, and the rest sourced per instance from g_instance_vbo
+};
+
+/// unit quad and instance data buffers are shared by all contexts. Contexts are in the same
+/// share group, but vertex array objects are not shared, so each context gets its own ones
+GLuint                          g_quad_vbo = 0;
+GLuint                          g_instance_vbo = 0;
+std::map<GLXContext, QuadVAOs>  g_quad_vao_map;
+
+/// points per-instance attributes of bound batch vertex array object at QuadDraw array in
+/// g_instance_vbo, starting from first-th element
+void
+set_instance_attrib_pointers(size_t first)
+{
+    const size_t base = first * sizeof(vdp::QuadDraw) + offsetof(vdp::QuadDraw, quad);
+    const GLsizei stride = sizeof(vdp::QuadDraw);
+    const auto ptr = [base](size_t ofs) {
+        return reinterpret_cast<const GLvoid *>(base + ofs);
+    };
+
+    glBindBuffer(GL_ARRAY_BUFFER, g_instance_vbo);
+    glVertexAttribPointer(vdp::kQuadDstAttrib, 4, GL_FLOAT, GL_FALSE, stride,
+                          ptr(offsetof(vdp::Quad, dst)));
+    glVertexAttribPointer(vdp::kQuadSrcAttrib, 4, GL_FLOAT, GL_FALSE, stride,
+                          ptr(offsetof(vdp::Quad, src)));
+    glVertexAttribPointer(vdp::kQuadRotationAttrib, 1, GL_INT, GL_FALSE, stride,
+                          ptr(offsetof(vdp::Quad, rotation)));
+    for (GLuint k = 0; k < 4; k ++) {
+        const size_t column_ofs = offsetof(vdp::Quad, colors) + k * 4 * sizeof(float);
+        glVertexAttribPointer(vdp::kQuadColorsAttrib + k, 4, GL_FLOAT, GL_FALSE, stride,
+                              ptr(column_ofs));
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+const QuadVAOs &
+get_quad_vaos()
+{
+    const GLXContext glc = glXGetCurrentContext();
+    const auto it = g_quad_vao_map.find(glc);
+    if (it != g_quad_vao_map.end())
+        return it->second;
+
+    if (g_quad_vbo == 0) {
+        // vertices in the order of GL_TRIANGLE_FAN, and of colors of VdpOutputSurface rendering
+        const float corners[] = { 0, 0,  1, 0,  1, 1,  0, 1 };
+
+        glGenBuffers(1, &g_quad_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, g_quad_vbo);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glGenBuffers(1, &g_instance_vbo);
+    }
+
+    QuadVAOs vaos;
+    glGenVertexArrays(1, &vaos.single);
+    glGenVertexArrays(1, &vaos.batch);
+
+    for (const GLuint vao: {vaos.single, vaos.batch}) {
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, g_quad_vbo);
+        glVertexAttribPointer(vdp::kQuadCornerAttrib, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+        glEnableVertexAttribArray(vdp::kQuadCornerAttrib);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // glBindVertexArray(vaos.batch) is still in effect
+    for (GLuint k = vdp::kQuadDstAttrib; k < vdp::kQuadColorsAttrib + 4; k ++) {
+        glEnableVertexAttribArray(k);
+        glVertexAttribDivisor(k, 1);
+    }
+
+    return g_quad_vao_map[glc] = vaos;
+}
+
+} // anonymous namespace
+
+
+namespace vdp {
+
+Quad::Quad(uint32_t target_width, uint32_t target_height, const VdpRect &a_dst)
+    : target_size{static_cast<float>(target_width), static_cast<float>(target_height)}
+    , dst{static_cast<float>(a_dst.x0), static_cast<float>(a_dst.y0),
+          static_cast<float>(a_dst.x1), static_cast<float>(a_dst.y1)}
+    , src{0.0f, 0.0f, 1.0f, 1.0f}
+    , rotation{0}
+{
+    set_color(1.0f, 1.0f, 1.0f, 1.0f);
+}
+
+void
+Quad::set_source(const VdpRect &a_src, uint32_t tex_width, uint32_t tex_height)
+{
+    src[0] = static_cast<float>(a_src.x0) / tex_width;
+    src[1] = static_cast<float>(a_src.y0) / tex_height;
+    src[2] = static_cast<float>(a_src.x1) / tex_width;
+    src[3] = static_cast<float>(a_src.y1) / tex_height;
+}
+
+void
+Quad::set_color(float red, float green, float blue, float alpha)
+{
+    for (auto &color: colors) {
+        color[0] = red;
+        color[1] = green;
+        color[2] = blue;
+        color[3] = alpha;
+    }
+}
+
+void
+bind_render_target(GLuint fbo_id, uint32_t width, uint32_t height)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_id);
+    glViewport(0, 0, width, height);
+}
+
+void
+draw_quad(const Device::Resource &device, int shader, const Quad &quad)
+{
+    const auto &uniform = device.shaders[shader].uniform;
+
+    glUniform2fv(uniform.target_size, 1, quad.target_size);
+
+    glBindVertexArray(get_quad_vaos().single);
+    glVertexAttrib4fv(kQuadDstAttrib, quad.dst);
+    glVertexAttrib4fv(kQuadSrcAttrib, quad.src);
+    glVertexAttrib1f(kQuadRotationAttrib, static_cast<float>(quad.rotation));
+    for (GLuint k = 0; k < 4; k ++)
+        glVertexAttrib4fv(kQuadColorsAttrib + k, quad.colors[k]);
+
+    glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+}
+
+void
+draw_quads(const Device::Resource &device, const QuadDraw *draws, size_t count)
+{
+    if (count == 0)
+        return;
+
+    glActiveTexture(GL_TEXTURE0);
+
+    if (device.has_instanced_arrays) {
+        glBindVertexArray(get_quad_vaos().batch);
+        glBindBuffer(GL_ARRAY_BUFFER, g_instance_vbo);
+        glBufferData(GL_ARRAY_BUFFER, count * sizeof(QuadDraw), draws, GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    size_t first = 0;
+    while (first < count) {
+        const QuadDraw &head = draws[first];
+
+        size_t last = first + 1;
+        while (last < count && draws[last].shader == head.shader &&
+               draws[last].tex_id == head.tex_id && draws[last].blend == head.blend)
+        {
+            last ++;
+        }
+
+        const auto &blend = head.blend;
+        glBlendFuncSeparate(blend.src_rgb, blend.dst_rgb, blend.src_alpha, blend.dst_alpha);
+        glBlendEquationSeparate(blend.eq_rgb, blend.eq_alpha);
+        glBindTexture(GL_TEXTURE_2D, head.tex_id);
+        glUseProgram(device.shaders[head.shader].program);
+
+        if (device.has_instanced_arrays) {
+            // quads of a single draw call are rasterized and blended in order
+            glUniform2fv(device.shaders[head.shader].uniform.target_size, 1,
+                         head.quad.target_size);
+            set_instance_attrib_pointers(first);
+            glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, last - first);
+        } else {
+            for (size_t k = first; k < last; k ++)
+                draw_quad(device, head.shader, draws[k].quad);
+        }
+
+        first = last;
+    }
+
+    glUseProgram(0);
+}
+
+void
+forget_quad_vao(GLXContext glc)
+{
+    // vertex array objects are destroyed together with their context
+    g_quad_vao_map.erase(glc);
+}
+
+void
+forget_quad_vbo()
+{
+    g_quad_vbo = 0;
+    g_instance_vbo = 0;
+    g_quad_vao_map.clear();
+}
+
+} // namespace vdp
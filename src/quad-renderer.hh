@@ -0,0 +1,124 @@
+/*
+ * Copyright 2013-2016  Rinat Ibragimov
+ *
+ * This file is part of libvdpau-va-gl
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <GL/glx.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vdpau/vdpau.h>
+
+
+namespace vdp {
+
+namespace Device {
+struct Resource;
+} // namespace Device
+
+/// vertex attributes of quad_vertex shader, the same in every program. Corners come from the
+/// static vertex buffer, the rest is either set as constant attribute values for a single
+/// quad, or is sourced per instance for a batch of quads
+const GLuint kQuadCornerAttrib = 0;
+const GLuint kQuadDstAttrib = 1;
+const GLuint kQuadSrcAttrib = 2;
+const GLuint kQuadRotationAttrib = 3;
+const GLuint kQuadColorsAttrib = 4;     ///< mat4, occupies four locations
+
+/// single quad drawn by one of device programs. Everything but the fragment shader is set by
+/// attributes of quad_vertex shader, so all draws share one static vertex buffer
+struct Quad
+{
+    /// quad covering dst area of framebuffer of given size, with the whole texture mapped to it
+    /// and white color. dst is in pixels, y0 may be larger than y1 to flip the picture
+    Quad(uint32_t target_width, uint32_t target_height, const VdpRect &dst);
+
+    /// maps src area of texture of given size, in pixels
+    void
+    set_source(const VdpRect &src, uint32_t tex_width, uint32_t tex_height);
+
+    void
+    set_color(float red, float green, float blue, float alpha);
+
+    float       target_size[2];
+    float       dst[4];         ///< x0, y0, x1, y1 in pixels
+    float       src[4];         ///< x0, y0, x1, y1 in normalized texture coordinates
+    int         rotation;       ///< quarter turns of source, counter-clockwise
+    float       colors[4][4];   ///< colors of corners (x0, y0), (x1, y0), (x1, y1), (x0, y1)
+};
+
+/// blending of a quad, as arguments of glBlendFuncSeparate and glBlendEquationSeparate
+struct BlendState
+{
+    GLenum      src_rgb;
+    GLenum      dst_rgb;
+    GLenum      src_alpha;
+    GLenum      dst_alpha;
+    GLenum      eq_rgb;
+    GLenum      eq_alpha;
+
+    bool
+    operator==(const BlendState &that) const
+    {
+        return src_rgb == that.src_rgb && dst_rgb == that.dst_rgb &&
+               src_alpha == that.src_alpha && dst_alpha == that.dst_alpha &&
+               eq_rgb == that.eq_rgb && eq_alpha == that.eq_alpha;
+    }
+};
+
+/// quad recorded for drawing later, with all the state it needs
+struct QuadDraw
+{
+    int         shader;
+    GLuint      tex_id;     ///< texture bound to unit 0, or 0 for programs without one
+    BlendState  blend;
+    Quad        quad;
+};
+
+/// binds framebuffer and sets viewport to cover it
+void
+bind_render_target(GLuint fbo_id, uint32_t width, uint32_t height);
+
+/// draws quad with program of given device shader, which must be in use. Program's own
+/// uniforms and textures are set by caller. Must be called with GL context current
+void
+draw_quad(const Device::Resource &device, int shader, const Quad &quad);
+
+/// draws quads in order into the currently bound framebuffer, with blending enabled by caller.
+/// Runs of quads sharing program, texture and blending are drawn by one instanced draw call,
+/// so the result is the same as if quads were drawn one by one. All quads must have the same
+/// target size. Must be called with GL context current
+void
+draw_quads(const Device::Resource &device, const QuadDraw *draws, size_t count);
+
+/// forgets vertex array objects of context which is about to be destroyed. Must be called
+/// under GLX lock
+void
+forget_quad_vao(GLXContext glc);
+
+/// forgets vertex buffers, after all contexts sharing them were destroyed. Must be called under
+/// GLX lock
+void
+forget_quad_vbo();
+
+} // namespace vdp
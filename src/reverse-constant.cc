@@ -71,6 +71,8 @@ reverse_decoder_profile(VdpDecoderProfile profile)
     CASE(VDP_DECODER_PROFILE_VC1_SIMPLE);
     CASE(VDP_DECODER_PROFILE_VC1_MAIN);
     CASE(VDP_DECODER_PROFILE_VC1_ADVANCED);
+    CASE(VDP_DECODER_PROFILE_HEVC_MAIN);
+    CASE(VDP_DECODER_PROFILE_HEVC_MAIN_10);
     CASE(VDP_DECODER_PROFILE_MPEG4_PART2_SP);
     CASE(VDP_DECODER_PROFILE_MPEG4_PART2_ASP);
     CASE(VDP_DECODER_PROFILE_DIVX4_QMOBILE);
@@ -0,0 +1,139 @@
+/*
+ * Copyright 2013-2016  Rinat Ibragimov
+ *
+ * This file is part of libvdpau-va-gl
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "scaling-weights.hh"
+#include <algorithm>
+#include <math.h>
+
+
+namespace vdp {
+
+namespace {
+
+float
+sinc(float x)
+{
+    if (fabsf(x) < 1e-6f)
+        return 1.0f;
+
+    return sinf(M_PI * x) / (M_PI * x);
+}
+
+float
+kernel_radius(ScalingKernel kernel)
+{
+    switch (kernel) {
+    case ScalingKernel::bicubic:    return 2.0f;
+    case ScalingKernel::lanczos2:   return 2.0f;
+    case ScalingKernel::lanczos3:   return 3.0f;
+    }
+
+    return 2.0f;
+}
+
+float
+kernel_value(ScalingKernel kernel, float x)
+{
+    x = fabsf(x);
+
+    switch (kernel) {
+    case ScalingKernel::bicubic:
+        // Catmull-Rom, a = -0.5
+        if (x < 1.0f)
+            return 1.5f * x * x * x - 2.5f * x * x + 1.0f;
+        if (x < 2.0f)
+            return -0.5f * x * x * x + 2.5f * x * x - 4.0f * x + 2.0f;
+        return 0.0f;
+
+    case ScalingKernel::lanczos2:
+        return x < 2.0f ? sinc(x) * sinc(x / 2.0f) : 0.0f;
+
+    case ScalingKernel::lanczos3:
+        return x < 3.0f ? sinc(x) * sinc(x / 3.0f) : 0.0f;
+    }
+
+    return 0.0f;
+}
+
+uint16_t
+encode_weight(float w)
+{
+    const float v = (w - kScalingWeightBias) / kScalingWeightScale;
+    return static_cast<uint16_t>(std::min(std::max(v, 0.0f), 1.0f) * 65535.0f + 0.5f);
+}
+
+} // anonymous namespace
+
+ScalingWeights
+compute_scaling_weights(ScalingKernel kernel, uint32_t src_length, uint32_t dst_length)
+{
+    const float ratio = static_cast<float>(src_length) / dst_length;
+    const float radius = kernel_radius(kernel);
+
+    // when downscaling, kernel is stretched to cover all source pixels, to avoid aliasing
+    float stretch = std::max(ratio, 1.0f);
+    uint32_t taps = 2 * static_cast<uint32_t>(ceilf(radius * stretch));
+    if (taps > kMaxScalingTaps) {
+        taps = kMaxScalingTaps;
+        stretch = (taps / 2) / radius;
+    }
+
+    ScalingWeights res;
+    res.taps = taps;
+    res.texels.resize((taps + 1) * dst_length);
+
+    std::vector<float> w(taps);
+
+    for (uint32_t k = 0; k < dst_length; k ++) {
+        const float center = (k + 0.5f) * ratio - 0.5f;
+        const int32_t first = static_cast<int32_t>(floorf(center)) + 1 -
+                              static_cast<int32_t>(taps / 2);
+
+        float sum = 0.0f;
+        for (uint32_t j = 0; j < taps; j ++) {
+            w[j] = kernel_value(kernel, (first + static_cast<int32_t>(j) - center) / stretch);
+            sum += w[j];
+        }
+
+        res.texels[k] = static_cast<uint16_t>(first + kScalingFirstTapBias);
+        for (uint32_t j = 0; j < taps; j ++)
+            res.texels[(j + 1) * dst_length + k] = encode_weight(w[j] / sum);
+    }
+
+    return res;
+}
+
+ScalingKernel
+scaling_kernel_for_level(int level)
+{
+    if (level <= 3)
+        return ScalingKernel::bicubic;
+
+    if (level <= 6)
+        return ScalingKernel::lanczos2;
+
+    return ScalingKernel::lanczos3;
+}
+
+} // namespace vdp
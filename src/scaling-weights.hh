@@ -0,0 +1,68 @@
+/*
+ * Copyright 2013-2016  Rinat Ibragimov
+ *
+ * This file is part of libvdpau-va-gl
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+
+namespace vdp {
+
+/// filters used for high quality scaling
+enum class ScalingKernel
+{
+    bicubic,        ///< Catmull-Rom spline
+    lanczos2,
+    lanczos3,
+};
+
+/// upper limit of taps per output pixel. Larger downscales widen the kernel until it's reached
+const uint32_t kMaxScalingTaps = 32;
+
+/// weights are stored as 16-bit normalized values, w = value * kScalingWeightScale +
+/// kScalingWeightBias
+const float kScalingWeightScale = 2.0f;
+const float kScalingWeightBias = -0.5f;
+
+/// index of the first tap is stored with this bias added, to keep it non-negative
+const int32_t kScalingFirstTapBias = 1024;
+
+/// filter weights for scaling along one axis, laid out as texture of dst_length columns and
+/// taps + 1 rows. Row 0 contains index of the first source pixel contributing to the output
+/// pixel, with kScalingFirstTapBias added. Row k + 1 contains weight of k-th tap
+struct ScalingWeights
+{
+    uint32_t                taps;
+    std::vector<uint16_t>   texels;
+};
+
+ScalingWeights
+compute_scaling_weights(ScalingKernel kernel, uint32_t src_length, uint32_t dst_length);
+
+/// maps VDP_VIDEO_MIXER_FEATURE_HIGH_QUALITY_SCALING_L1..L9 levels (1..9) to kernels
+ScalingKernel
+scaling_kernel_for_level(int level);
+
+} // namespace vdp
@@ -39,3 +39,13 @@ traceError(const char *fmt, ...)
     vfprintf(stderr, fmt, args);
     va_end(args);
 }
+
+void
+traceInfo(const char *fmt, ...)
+{
+    va_list args;
+    fprintf(stderr, "%s", trace_header);
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+}
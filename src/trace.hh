@@ -27,3 +27,6 @@
 
 void
 traceError(const char *buf, ...);
+
+void
+traceInfo(const char *buf, ...);
@@ -0,0 +1,912 @@
+/*
+ * Copyright 2013-2016  Rinat Ibragimov
+ *
+ * This file is part of libvdpau-va-gl
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "vc1-parse.hh"
+#include "bitstream.hh"
+#include <algorithm>
+
+
+namespace vdp {
+
+namespace {
+
+// picture types, VA-API numbering
+enum {
+    PTYPE_I =       0,
+    PTYPE_P =       1,
+    PTYPE_B =       2,
+    PTYPE_BI =      3,
+    PTYPE_SKIPPED = 4,
+};
+
+// QUANTIZER, 6.2.11
+enum {
+    QUANTIZER_IMPLICIT =    0,
+    QUANTIZER_EXPLICIT =    1,
+    QUANTIZER_NON_UNIFORM = 2,
+    QUANTIZER_UNIFORM =     3,
+};
+
+// bitplane coding modes, 8.7.3.2
+enum {
+    IMODE_RAW,
+    IMODE_NORM2,
+    IMODE_DIFF2,
+    IMODE_NORM6,
+    IMODE_DIFF6,
+    IMODE_ROWSKIP,
+    IMODE_COLSKIP,
+};
+
+// DQPROFILE, 7.1.1.31.3
+enum {
+    DQPROFILE_FOUR_EDGES =  0,
+    DQPROFILE_DOUBLE_EDGES = 1,
+    DQPROFILE_SINGLE_EDGE = 2,
+    DQPROFILE_ALL_MBS =     3,
+};
+
+const uint32_t kCondoverSelect = 2;     // CONDOVER, 7.1.1.17
+const uint32_t kBFractionBI = 22;       // BFRACTION index which marks BI picture
+const uint32_t kFrameStartCode = 0x0d;
+const uint32_t kSliceStartCode = 0x0b;
+
+// PQINDEX to PQUANT for implicit quantizer, table 36
+const uint8_t kImplicitPQuant[32] = {
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  6,  7,  8,  9, 10, 11, 12,
+    13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 27, 29, 31,
+};
+
+// MVMODE, tables 46 and 47. Indexed by [PQUANT <= 12][count of leading zeros]
+const uint8_t kMvModeTable[2][5] = {
+    {VAMvMode1MvHalfPelBilinear, VAMvMode1Mv, VAMvMode1MvHalfPel, VAMvModeIntensityCompensation,
+     VAMvModeMixedMv},
+    {VAMvMode1Mv, VAMvModeMixedMv, VAMvMode1MvHalfPel, VAMvModeIntensityCompensation,
+     VAMvMode1MvHalfPelBilinear},
+};
+
+// MVMODE2, tables 48 and 49
+const uint8_t kMvMode2Table[2][4] = {
+    {VAMvMode1MvHalfPelBilinear, VAMvMode1Mv, VAMvMode1MvHalfPel, VAMvModeMixedMv},
+    {VAMvMode1Mv, VAMvModeMixedMv, VAMvMode1MvHalfPel, VAMvMode1MvHalfPelBilinear},
+};
+
+// Norm-6 bitplane VLC, table 81. Indexed by six bits of a tile
+const uint16_t kNorm6Codes[64] = {
+    0x001, 0x002, 0x003, 0x000, 0x004, 0x001, 0x002, 0x047,
+    0x005, 0x003, 0x004, 0x04b, 0x005, 0x04d, 0x04e, 0x30e,
+    0x006, 0x006, 0x007, 0x053, 0x008, 0x055, 0x056, 0x30d,
+    0x009, 0x059, 0x05a, 0x30c, 0x05c, 0x30b, 0x30a, 0x037,
+    0x007, 0x00a, 0x00b, 0x043, 0x00c, 0x045, 0x046, 0x309,
+    0x00d, 0x049, 0x04a, 0x308, 0x04c, 0x307, 0x306, 0x036,
+    0x00e, 0x051, 0x052, 0x305, 0x054, 0x304, 0x303, 0x035,
+    0x058, 0x302, 0x301, 0x034, 0x300, 0x033, 0x032, 0x007,
+};
+
+const uint8_t kNorm6Lengths[64] = {
+     1,  4,  4,  8,  4,  8,  8, 10,  4,  8,  8, 10,  8, 10, 10, 13,
+     4,  8,  8, 10,  8, 10, 10, 13,  8, 10, 10, 13, 10, 13, 13,  9,
+     4,  8,  8, 10,  8, 10, 10, 13,  8, 10, 10, 13, 10, 13, 13,  9,
+     8, 10, 10, 13, 10, 13, 13,  9, 10, 13, 13,  9, 13,  9,  9,  6,
+};
+
+/// counts bits until stop bit is met, reading no more than len bits
+uint32_t
+get_unary(BitReader &br, uint32_t stop, uint32_t len)
+{
+    uint32_t k = 0;
+
+    while (k < len && br.get_u(1) != stop)
+        k ++;
+
+    return k;
+}
+
+/// 0 -> 0, 10 -> 1, 11 -> 2
+uint32_t
+get_012(BitReader &br)
+{
+    if (!br.get_u(1))
+        return 0;
+
+    return br.get_u(1) + 1;
+}
+
+uint32_t
+get_imode(BitReader &br)
+{
+    if (br.get_u(1))
+        return br.get_u(1) ? IMODE_NORM6 : IMODE_NORM2;
+
+    if (br.get_u(1))
+        return br.get_u(1) ? IMODE_COLSKIP : IMODE_ROWSKIP;
+
+    if (br.get_u(1))
+        return IMODE_DIFF2;
+
+    return br.get_u(1) ? IMODE_DIFF6 : IMODE_RAW;
+}
+
+/// returns two bits of a Norm-2 pair, first one in bit 0
+uint32_t
+get_norm2(BitReader &br)
+{
+    if (!br.get_u(1))
+        return 0;
+
+    if (br.get_u(1))
+        return 3;
+
+    return br.get_u(1) ? 2 : 1;
+}
+
+/// returns six bits of a Norm-6 tile, or -1 on invalid code
+int32_t
+get_norm6(BitReader &br)
+{
+    for (int k = 0; k < 64; k ++) {
+        if (br.peek_u(kNorm6Lengths[k]) == kNorm6Codes[k]) {
+            br.get_u(kNorm6Lengths[k]);
+            return k;
+        }
+    }
+
+    return -1;
+}
+
+/// BFRACTION index, table 40
+uint32_t
+get_bfraction(BitReader &br)
+{
+    const uint32_t code = br.get_u(3);
+
+    if (code < 7)
+        return code;
+
+    return 7 + br.get_u(4);
+}
+
+void
+decode_rowskip(BitReader &br, uint8_t *plane, uint32_t width, uint32_t height, uint32_t stride)
+{
+    for (uint32_t y = 0; y < height; y ++) {
+        const bool coded = br.get_u(1);
+
+        for (uint32_t x = 0; x < width; x ++)
+            plane[y * stride + x] = coded ? br.get_u(1) : 0;
+    }
+}
+
+void
+decode_colskip(BitReader &br, uint8_t *plane, uint32_t width, uint32_t height, uint32_t stride)
+{
+    for (uint32_t x = 0; x < width; x ++) {
+        const bool coded = br.get_u(1);
+
+        for (uint32_t y = 0; y < height; y ++)
+            plane[y * stride + x] = coded ? br.get_u(1) : 0;
+    }
+}
+
+/// Decodes bitplane, 8.7. Returns false if it's coded in raw mode, i.e. on macroblock level.
+bool
+decode_bitplane(BitReader &br, uint32_t width, uint32_t height, std::vector<uint8_t> &plane)
+{
+    const uint32_t stride = width;
+    const uint32_t invert = br.get_u(1);
+    const uint32_t imode = get_imode(br);
+
+    plane.assign(width * height, 0);
+
+    switch (imode) {
+    case IMODE_RAW:
+        return false;
+
+    case IMODE_NORM2:
+    case IMODE_DIFF2:
+        {
+            // plane is coded as one long line, odd first element is coded separately
+            const uint32_t count = width * height;
+            uint32_t k = 0;
+
+            if (count & 1)
+                plane[k ++] = br.get_u(1);
+
+            for (; k < count; k += 2) {
+                const uint32_t pair = get_norm2(br);
+                plane[k] = pair & 1;
+                plane[k + 1] = pair >> 1;
+            }
+        }
+        break;
+
+    case IMODE_NORM6:
+    case IMODE_DIFF6:
+        if (height % 3 == 0 && width % 3 != 0) {
+            // 2x3 tiles, leftmost odd column is coded with column skip
+            for (uint32_t y = 0; y < height; y += 3) {
+                for (uint32_t x = width & 1; x < width; x += 2) {
+                    const int32_t code = get_norm6(br);
+                    if (code < 0)
+                        return false;
+
+                    for (uint32_t j = 0; j < 6; j ++)
+                        plane[(y + j / 2) * stride + x + j % 2] = (code >> j) & 1;
+                }
+            }
+
+            if (width & 1)
+                decode_colskip(br, plane.data(), 1, height, stride);
+
+        } else {
+            // 3x2 tiles, leftover columns and row are coded with column and row skip
+            for (uint32_t y = height & 1; y < height; y += 2) {
+                for (uint32_t x = width % 3; x < width; x += 3) {
+                    const int32_t code = get_norm6(br);
+                    if (code < 0)
+                        return false;
+
+                    for (uint32_t j = 0; j < 6; j ++)
+                        plane[(y + j / 3) * stride + x + j % 3] = (code >> j) & 1;
+                }
+            }
+
+            const uint32_t x0 = width % 3;
+
+            if (x0 > 0)
+                decode_colskip(br, plane.data(), x0, height, stride);
+
+            if (height & 1)
+                decode_rowskip(br, plane.data() + x0, width - x0, 1, stride);
+        }
+        break;
+
+    case IMODE_ROWSKIP:
+        decode_rowskip(br, plane.data(), width, height, stride);
+        break;
+
+    case IMODE_COLSKIP:
+        decode_colskip(br, plane.data(), width, height, stride);
+        break;
+    }
+
+    if (imode == IMODE_DIFF2 || imode == IMODE_DIFF6) {
+        // differential coding, 8.7.3.9
+        for (uint32_t y = 0; y < height; y ++) {
+            for (uint32_t x = 0; x < width; x ++) {
+                uint8_t &b = plane[y * stride + x];
+                uint32_t pred;
+
+                if (x == 0 && y == 0) {
+                    pred = invert;
+                } else if (y == 0) {
+                    pred = plane[x - 1];
+                } else if (x == 0) {
+                    pred = plane[(y - 1) * stride];
+                } else {
+                    const uint32_t left = plane[y * stride + x - 1];
+                    const uint32_t top = plane[(y - 1) * stride + x];
+                    pred = (left == top) ? left : invert;
+                }
+
+                b ^= pred;
+            }
+        }
+
+    } else if (invert) {
+        for (auto &b: plane)
+            b = !b;
+    }
+
+    return true;
+}
+
+/// Picture layer parser. Fills picture-level fields of VA-API picture parameters
+class PictureParser
+{
+public:
+    PictureParser(const VdpPictureInfoVC1 *vdppi, uint32_t profile, uint32_t mb_width,
+                  uint32_t mb_height, const VAPictureParameterBufferVC1 &pic_param, uint8_t rnd)
+        : pp(pic_param)
+        , rnd_{rnd}
+        , vdppi_{vdppi}
+        , profile_{profile}
+        , mb_width_{mb_width}
+        , mb_height_{mb_height}
+        , pq_{0}
+    {}
+
+    bool
+    parse(BitReader &br)
+    {
+        const bool ok = (profile_ == VC1_PROFILE_ADVANCED) ? parse_advanced(br)
+                                                           : parse_simple_main(br);
+        return ok && !br.overrun();
+    }
+
+    uint8_t
+    rnd() const
+    {
+        return rnd_;
+    }
+
+    /// packs bitplanes in VA-API layout, a nibble per macroblock
+    void
+    pack_bitplanes(std::vector<uint8_t> *bitplane) const
+    {
+        bitplane->clear();
+        if (pp.bitplane_present.value == 0)
+            return;
+
+        const uint32_t count = mb_width_ * mb_height_;
+        bitplane->assign((count + 1) / 2, 0);
+
+        for (uint32_t k = 0; k < count; k ++) {
+            uint8_t v = 0;
+
+            for (int j = 0; j < 3; j ++) {
+                if (!planes_[j].empty())
+                    v |= planes_[j][k] << j;
+            }
+
+            (*bitplane)[k / 2] |= (k & 1) ? v : (v << 4);
+        }
+    }
+
+    VAPictureParameterBufferVC1     pp;
+
+private:
+    /// reads bitplane into given slot of packed layout. Returns true if it's coded at
+    /// picture level
+    bool
+    read_bitplane(BitReader &br, int slot)
+    {
+        if (decode_bitplane(br, mb_width_, mb_height_, planes_[slot]))
+            return true;
+
+        planes_[slot].clear();
+        return false;
+    }
+
+    bool
+    parse_simple_main(BitReader &br)
+    {
+        if (vdppi_->finterpflag)
+            br.get_u(1);        // INTERPFRM
+
+        br.get_u(2);            // FRMCNT
+
+        if (vdppi_->rangered & 1)
+            pp.range_reduction_frame = br.get_u(1);
+
+        uint32_t ptype;
+        if (br.get_u(1)) {
+            ptype = PTYPE_P;
+        } else {
+            ptype = (vdppi_->maxbframes && !br.get_u(1)) ? PTYPE_B : PTYPE_I;
+        }
+
+        if (ptype == PTYPE_B) {
+            pp.b_picture_fraction = get_bfraction(br);
+            if (pp.b_picture_fraction == kBFractionBI)
+                ptype = PTYPE_BI;
+        }
+
+        pp.picture_fields.bits.picture_type = ptype;
+
+        if (ptype == PTYPE_I || ptype == PTYPE_BI)
+            br.get_u(7);        // BF
+
+        // rounding control is implicit, 8.3.7
+        if (ptype == PTYPE_I || ptype == PTYPE_BI)
+            rnd_ = 1;
+        if (ptype == PTYPE_P)
+            rnd_ ^= 1;
+
+        pp.rounding_control = rnd_;
+
+        if (!parse_pquant(br))
+            return false;
+
+        if (vdppi_->extended_mv)
+            pp.mv_fields.bits.extended_mv_range = get_unary(br, 0, 3);     // MVRANGE
+
+        if (vdppi_->multires && ptype != PTYPE_B)
+            pp.picture_resolution_index = br.get_u(2);                      // RESPIC
+
+        if (ptype == PTYPE_P)
+            parse_p_picture(br);
+        else if (ptype == PTYPE_B)
+            parse_b_picture(br);
+
+        parse_transform_tables(br, ptype);
+        return true;
+    }
+
+    bool
+    parse_advanced(BitReader &br)
+    {
+        if (vdppi_->interlace && get_012(br) != 0)     // FCM
+            return false;   // interlaced pictures are not supported
+
+        static const uint32_t ptype_map[5] = {PTYPE_P, PTYPE_B, PTYPE_I, PTYPE_BI,
+                                              PTYPE_SKIPPED};
+        uint32_t ptype = ptype_map[get_unary(br, 0, 4)];
+
+        if (vdppi_->tfcntrflag)
+            br.get_u(8);        // TFCNTR
+
+        uint32_t rptfrm = 0;
+        uint32_t rff = 0;
+
+        if (vdppi_->pulldown) {
+            if (!vdppi_->interlace || vdppi_->psf) {
+                rptfrm = br.get_u(2);
+            } else {
+                pp.picture_fields.bits.top_field_first = br.get_u(1);
+                rff = br.get_u(1);
+            }
+        }
+
+        if (vdppi_->panscan_flag && br.get_u(1)) {     // PS_PRESENT
+            uint32_t windows;
+
+            if (vdppi_->interlace && !vdppi_->psf)
+                windows = vdppi_->pulldown ? 2 + rff : 2;
+            else
+                windows = vdppi_->pulldown ? rptfrm + 1 : 1;
+
+            for (uint32_t k = 0; k < windows; k ++)
+                br.get_u(18), br.get_u(18), br.get_u(14), br.get_u(14);
+        }
+
+        pp.picture_fields.bits.picture_type = ptype;
+        if (ptype == PTYPE_SKIPPED)
+            return true;
+
+        pp.rounding_control = br.get_u(1);     // RNDCTRL
+
+        if (vdppi_->interlace)
+            br.get_u(1);        // UVSAMP
+
+        if (vdppi_->finterpflag)
+            br.get_u(1);        // INTERPFRM
+
+        if (ptype == PTYPE_B) {
+            pp.b_picture_fraction = get_bfraction(br);
+            if (pp.b_picture_fraction == kBFractionBI) {
+                ptype = PTYPE_BI;
+                pp.picture_fields.bits.picture_type = ptype;
+            }
+        }
+
+        if (!parse_pquant(br))
+            return false;
+
+        if (vdppi_->postprocflag)
+            pp.post_processing = br.get_u(2);
+
+        switch (ptype) {
+        case PTYPE_I:
+        case PTYPE_BI:
+            if (read_bitplane(br, 1))
+                pp.bitplane_present.flags.bp_ac_pred = 1;
+            else
+                pp.raw_coding.flags.ac_pred = 1;
+
+            pp.conditional_overlap_flag = 0;
+            if (vdppi_->overlap && pq_ <= 8) {
+                pp.conditional_overlap_flag = get_012(br);     // CONDOVER
+
+                if (pp.conditional_overlap_flag == kCondoverSelect) {
+                    if (read_bitplane(br, 2))
+                        pp.bitplane_present.flags.bp_overflags = 1;
+                    else
+                        pp.raw_coding.flags.overflags = 1;
+                }
+            }
+            break;
+
+        case PTYPE_P:
+            if (vdppi_->extended_mv)
+                pp.mv_fields.bits.extended_mv_range = get_unary(br, 0, 3);
+
+            parse_p_picture(br);
+            break;
+
+        case PTYPE_B:
+            if (vdppi_->extended_mv)
+                pp.mv_fields.bits.extended_mv_range = get_unary(br, 0, 3);
+
+            parse_b_picture(br);
+            break;
+        }
+
+        parse_transform_tables(br, ptype);
+
+        if ((ptype == PTYPE_I || ptype == PTYPE_BI) && vdppi_->dquant)
+            parse_vopdquant(br);
+
+        return true;
+    }
+
+    bool
+    parse_pquant(BitReader &br)
+    {
+        auto &q = pp.pic_quantizer_fields.bits;
+        const uint32_t pqindex = br.get_u(5);
+
+        if (pqindex == 0)
+            return false;
+
+        switch (vdppi_->quantizer) {
+        case QUANTIZER_IMPLICIT:
+            pq_ = kImplicitPQuant[pqindex];
+            q.pic_quantizer_type = (pqindex <= 8);
+            break;
+
+        case QUANTIZER_NON_UNIFORM:
+            pq_ = pqindex;
+            q.pic_quantizer_type = 0;
+            break;
+
+        default:
+            pq_ = pqindex;
+            q.pic_quantizer_type = 1;
+            break;
+        }
+
+        q.pic_quantizer_scale = pq_;
+        q.half_qp = (pqindex <= 8) ? br.get_u(1) : 0;
+
+        if (vdppi_->quantizer == QUANTIZER_EXPLICIT)
+            q.pic_quantizer_type = br.get_u(1);        // PQUANTIZER
+
+        return true;
+    }
+
+    void
+    parse_vopdquant(BitReader &br)
+    {
+        auto &q = pp.pic_quantizer_fields.bits;
+
+        if (vdppi_->dquant != 2) {
+            q.dq_frame = br.get_u(1);
+            if (!q.dq_frame)
+                return;
+
+            q.dq_profile = br.get_u(2);
+            switch (q.dq_profile) {
+            case DQPROFILE_SINGLE_EDGE:
+                q.dq_sb_edge = br.get_u(2);
+                break;
+
+            case DQPROFILE_DOUBLE_EDGES:
+                q.dq_db_edge = br.get_u(2);
+                break;
+
+            case DQPROFILE_ALL_MBS:
+                q.dq_binary_level = br.get_u(1);
+                if (!q.dq_binary_level)
+                    return;
+                break;
+            }
+        }
+
+        const uint32_t pqdiff = br.get_u(3);
+        const uint32_t altpq = (pqdiff == 7) ? br.get_u(5) : pq_ + pqdiff + 1;
+
+        q.alt_pic_quantizer = std::min(altpq, 31u);
+    }
+
+    void
+    parse_transform_type(BitReader &br)
+    {
+        auto &t = pp.transform_fields.bits;
+
+        if (vdppi_->vstransform) {
+            t.mb_level_transform_type_flag = br.get_u(1);         // TTMBF
+            if (t.mb_level_transform_type_flag)
+                t.frame_level_transform_type = br.get_u(2);       // TTFRM
+        } else {
+            t.mb_level_transform_type_flag = 1;
+            t.frame_level_transform_type = 0;                     // 8x8
+        }
+    }
+
+    void
+    parse_p_picture(BitReader &br)
+    {
+        auto &mv = pp.mv_fields.bits;
+        const int lowquant = (pq_ > 12) ? 0 : 1;
+
+        mv.mv_mode = kMvModeTable[lowquant][get_unary(br, 1, 4)];
+
+        if (mv.mv_mode == VAMvModeIntensityCompensation) {
+            mv.mv_mode2 = kMvMode2Table[lowquant][get_unary(br, 1, 3)];
+            pp.luma_scale = br.get_u(6);
+            pp.luma_shift = br.get_u(6);
+            pp.picture_fields.bits.intensity_compensation = 1;
+        }
+
+        const bool mixed_mv = (mv.mv_mode == VAMvModeMixedMv) ||
+                              (mv.mv_mode == VAMvModeIntensityCompensation &&
+                               mv.mv_mode2 == VAMvModeMixedMv);
+        if (mixed_mv) {
+            if (read_bitplane(br, 2))
+                pp.bitplane_present.flags.bp_mv_type_mb = 1;
+            else
+                pp.raw_coding.flags.mv_type_mb = 1;
+        }
+
+        if (read_bitplane(br, 1))
+            pp.bitplane_present.flags.bp_skip_mb = 1;
+        else
+            pp.raw_coding.flags.skip_mb = 1;
+
+        mv.mv_table = br.get_u(2);          // MVTAB
+        pp.cbp_table = br.get_u(2);         // CBPTAB
+
+        if (vdppi_->dquant)
+            parse_vopdquant(br);
+
+        parse_transform_type(br);
+    }
+
+    void
+    parse_b_picture(BitReader &br)
+    {
+        auto &mv = pp.mv_fields.bits;
+
+        mv.mv_mode = br.get_u(1) ? VAMvMode1Mv : VAMvMode1MvHalfPelBilinear;
+
+        if (read_bitplane(br, 0))
+            pp.bitplane_present.flags.bp_direct_mb = 1;
+        else
+            pp.raw_coding.flags.direct_mb = 1;
+
+        if (read_bitplane(br, 1))
+            pp.bitplane_present.flags.bp_skip_mb = 1;
+        else
+            pp.raw_coding.flags.skip_mb = 1;
+
+        mv.mv_table = br.get_u(2);          // MVTAB
+        pp.cbp_table = br.get_u(2);         // CBPTAB
+
+        if (vdppi_->dquant)
+            parse_vopdquant(br);
+
+        parse_transform_type(br);
+    }
+
+    void
+    parse_transform_tables(BitReader &br, uint32_t ptype)
+    {
+        auto &t = pp.transform_fields.bits;
+
+        t.transform_ac_codingset_idx1 = get_012(br);              // TRANSACFRM
+        if (ptype == PTYPE_I || ptype == PTYPE_BI)
+            t.transform_ac_codingset_idx2 = get_012(br);          // TRANSACFRM2
+
+        t.intra_transform_dc_table = br.get_u(1);                 // TRANSDCTAB
+    }
+
+    uint8_t                     rnd_;
+    const VdpPictureInfoVC1    *vdppi_;
+    uint32_t                    profile_;
+    uint32_t                    mb_width_;
+    uint32_t                    mb_height_;
+    uint32_t                    pq_;
+    std::vector<uint8_t>        planes_[3];     ///< bitplanes by their bit in packed layout
+};
+
+/// removes emulation prevention bytes of advanced profile, 0x00 0x00 0x03 -> 0x00 0x00
+std::vector<uint8_t>
+unescape(const uint8_t *data, size_t size)
+{
+    std::vector<uint8_t> res;
+    uint32_t zeros = 0;
+
+    res.reserve(size);
+    for (size_t k = 0; k < size; k ++) {
+        if (zeros >= 2 && data[k] == 3 && k + 1 < size && data[k + 1] <= 3) {
+            zeros = 0;
+            continue;
+        }
+
+        zeros = (data[k] == 0) ? zeros + 1 : 0;
+        res.push_back(data[k]);
+    }
+
+    return res;
+}
+
+/// returns offset of the next start code with given suffix, or size if there is none
+size_t
+find_start_code(const uint8_t *data, size_t size, size_t pos, uint32_t suffix)
+{
+    for (size_t k = pos; k + 3 < size; k ++) {
+        if (data[k] == 0 && data[k + 1] == 0 && data[k + 2] == 1 && data[k + 3] == suffix)
+            return k;
+    }
+
+    return size;
+}
+
+} // anonymous namespace
+
+bool
+vc1_translate_picture(const VdpPictureInfoVC1 *vdppi, uint32_t profile, uint32_t width,
+                      uint32_t height, VASurfaceID forward_ref, VASurfaceID backward_ref,
+                      const uint8_t *data, size_t size, uint8_t *rnd,
+                      VAPictureParameterBufferVC1 *pic_param, std::vector<uint8_t> *bitplane,
+                      std::vector<VC1Slice> *slices)
+{
+    // only progressive pictures are handled
+    if (vdppi->frame_coding_mode != 0)
+        return false;
+
+    VAPictureParameterBufferVC1 pp = {};
+
+    pp.forward_reference_picture    = forward_ref;
+    pp.backward_reference_picture   = backward_ref;
+    pp.inloop_decoded_picture       = VA_INVALID_SURFACE;
+
+#define SEQ_FIELDS(fieldname) pp.sequence_fields.bits.fieldname
+    SEQ_FIELDS(pulldown)            = vdppi->pulldown;
+    SEQ_FIELDS(interlace)           = vdppi->interlace;
+    SEQ_FIELDS(tfcntrflag)          = vdppi->tfcntrflag;
+    SEQ_FIELDS(finterpflag)         = vdppi->finterpflag;
+    SEQ_FIELDS(psf)                 = vdppi->psf;
+    SEQ_FIELDS(multires)            = vdppi->multires;
+    SEQ_FIELDS(overlap)             = vdppi->overlap;
+    SEQ_FIELDS(syncmarker)          = vdppi->syncmarker;
+    SEQ_FIELDS(rangered)            = vdppi->rangered & 1;
+    SEQ_FIELDS(max_b_frames)        = vdppi->maxbframes;
+    SEQ_FIELDS(profile)             = profile;
+#undef SEQ_FIELDS
+
+    pp.coded_width                  = width;
+    pp.coded_height                 = height;
+
+    // Entry-point header is not passed through VDPAU. Broken link and closed entry flags
+    // affect only B pictures right after an entry point, and are assumed to be clear.
+    pp.entrypoint_fields.bits.broken_link   = 0;
+    pp.entrypoint_fields.bits.closed_entry  = 1;
+    pp.entrypoint_fields.bits.panscan_flag  = vdppi->panscan_flag;
+    pp.entrypoint_fields.bits.loopfilter    = vdppi->loopfilter;
+    pp.fast_uvmc_flag                       = vdppi->fastuvmc;
+
+    pp.range_mapping_fields.bits.luma_flag      = vdppi->range_mapy_flag;
+    pp.range_mapping_fields.bits.luma           = vdppi->range_mapy;
+    pp.range_mapping_fields.bits.chroma_flag    = vdppi->range_mapuv_flag;
+    pp.range_mapping_fields.bits.chroma         = vdppi->range_mapuv;
+
+    pp.picture_fields.bits.frame_coding_mode    = 0;
+    pp.picture_fields.bits.top_field_first      = 1;
+    pp.picture_fields.bits.is_first_field       = 1;
+
+    pp.reference_fields.bits.reference_distance_flag = vdppi->refdist_flag;
+
+    pp.mv_fields.bits.extended_mv_flag          = vdppi->extended_mv;
+    pp.mv_fields.bits.extended_dmv_flag         = vdppi->extended_dmv;
+
+    pp.pic_quantizer_fields.bits.dquant         = vdppi->dquant;
+    pp.pic_quantizer_fields.bits.quantizer      = vdppi->quantizer;
+
+    pp.transform_fields.bits.variable_sized_transform_flag = vdppi->vstransform;
+
+    const uint32_t mb_width = (width + 15) / 16;
+    const uint32_t mb_height = (height + 15) / 16;
+
+    slices->clear();
+
+    if (profile != VC1_PROFILE_ADVANCED) {
+        // simple and main profiles: whole frame is a single slice without start codes
+        PictureParser parser{vdppi, profile, mb_width, mb_height, pp, *rnd};
+        BitReader br{data, size};
+
+        if (!parser.parse(br))
+            return false;
+
+        *rnd = parser.rnd();
+        *pic_param = parser.pp;
+        parser.pack_bitplanes(bitplane);
+
+        VC1Slice slice = {};
+        slice.offset = 0;
+        slice.param.slice_data_size = size;
+        slice.param.slice_data_flag = VA_SLICE_DATA_FLAG_ALL;
+        slice.param.macroblock_offset = br.bits_eaten();
+        slices->push_back(slice);
+
+        return true;
+    }
+
+    // Advanced profile. Frame may be preceded by sequence and entry-point headers, and
+    // the picture header follows frame start code. Slice data passed to VA-API starts right
+    // after start codes.
+    size_t pic_start = 0;
+
+    if (size >= 3 && data[0] == 0 && data[1] == 0 && data[2] == 1) {
+        pic_start = find_start_code(data, size, 0, kFrameStartCode);
+        if (pic_start == size)
+            return false;
+
+        pic_start += 4;
+    }
+
+    size_t slice_end = find_start_code(data, size, pic_start, kSliceStartCode);
+
+    const auto header = unescape(data + pic_start, slice_end - pic_start);
+    PictureParser parser{vdppi, profile, mb_width, mb_height, pp, *rnd};
+    BitReader br{header.data(), header.size()};
+
+    if (!parser.parse(br))
+        return false;
+
+    *pic_param = parser.pp;
+    parser.pack_bitplanes(bitplane);
+
+    VC1Slice slice = {};
+    slice.offset = pic_start;
+    slice.param.slice_data_size = slice_end - pic_start;
+    slice.param.slice_data_flag = VA_SLICE_DATA_FLAG_ALL;
+    slice.param.macroblock_offset = br.bits_eaten();
+    slice.param.slice_vertical_position = 0;
+    slices->push_back(slice);
+
+    while (slice_end < size) {
+        const size_t slice_start = slice_end + 4;
+
+        slice_end = find_start_code(data, size, slice_start, kSliceStartCode);
+
+        const auto slice_data = unescape(data + slice_start, slice_end - slice_start);
+        BitReader sbr{slice_data.data(), slice_data.size()};
+
+        slice = {};
+        slice.offset = slice_start;
+        slice.param.slice_data_size = slice_end - slice_start;
+        slice.param.slice_data_flag = VA_SLICE_DATA_FLAG_ALL;
+        slice.param.slice_vertical_position = sbr.get_u(9);        // SLICE_ADDR
+
+        if (sbr.get_u(1)) {
+            // PIC_HEADER_FLAG, picture header is repeated. Parse it just to skip.
+            PictureParser repeated{vdppi, profile, mb_width, mb_height, pp, *rnd};
+
+            if (!repeated.parse(sbr))
+                return false;
+        }
+
+        if (sbr.overrun())
+            return false;
+
+        slice.param.macroblock_offset = sbr.bits_eaten();
+        slices->push_back(slice);
+    }
+
+    return true;
+}
+
+} // namespace vdp
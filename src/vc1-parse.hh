@@ -0,0 +1,66 @@
+/*
+ * Copyright 2013-2016  Rinat Ibragimov
+ *
+ * This file is part of libvdpau-va-gl
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <va/va.h>
+#include <vdpau/vdpau.h>
+#include <vector>
+
+
+namespace vdp {
+
+/// VA-API values of sequence_fields.profile
+enum {
+    VC1_PROFILE_SIMPLE =    0,
+    VC1_PROFILE_MAIN =      1,
+    VC1_PROFILE_ADVANCED =  3,
+};
+
+/// slice of a VC-1 picture, as found in the bitstream
+struct VC1Slice
+{
+    size_t                      offset;     ///< slice data offset in the frame buffer
+    VASliceParameterBufferVC1   param;
+};
+
+/// Translates a progressive VC-1 picture.
+///
+/// VDPAU passes sequence and entry-point level fields only, while VA-API also needs the picture
+/// layer, including bitplanes. So picture header is parsed from the frame data here.
+/// Bitplanes coded at picture level are packed into a VA-API bitplane buffer, which is left
+/// empty if there are none.
+///
+/// rnd keeps rounding control between pictures for simple and main profiles, where it's not
+/// coded explicitly. Returns false if picture can't be translated.
+bool
+vc1_translate_picture(const VdpPictureInfoVC1 *vdppi, uint32_t profile, uint32_t width,
+                      uint32_t height, VASurfaceID forward_ref, VASurfaceID backward_ref,
+                      const uint8_t *data, size_t size, uint8_t *rnd,
+                      VAPictureParameterBufferVC1 *pic_param, std::vector<uint8_t> *bitplane,
+                      std::vector<VC1Slice> *slices);
+
+} // namespace vdp
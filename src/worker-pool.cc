@@ -0,0 +1,165 @@
+/*
+ * Copyright 2013-2016  Rinat Ibragimov
+ *
+ * This file is part of libvdpau-va-gl
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "worker-pool.hh"
+#include <algorithm>
+
+
+namespace vdp {
+
+namespace {
+
+// there is little sense in having more helpers for header-sized jobs
+const unsigned int kMaxWorkerThreads = 3;
+
+} // anonymous namespace
+
+WorkerPool &
+WorkerPool::instance()
+{
+    static WorkerPool pool;
+    return pool;
+}
+
+WorkerPool::WorkerPool()
+    : fn_{nullptr}
+    , count_{0}
+    , next_item_{0}
+    , items_done_{0}
+    , generation_{0}
+    , shutdown_{false}
+{
+    const unsigned int hw_threads = std::thread::hardware_concurrency();
+    const unsigned int thread_count = (hw_threads > 1) ? std::min(hw_threads - 1, kMaxWorkerThreads)
+                                                       : 0;
+
+    for (unsigned int k = 0; k < thread_count; k ++)
+        threads_.emplace_back([this] () { thread_body(); });
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::unique_lock<decltype(mtx_)> lock{mtx_};
+        shutdown_ = true;
+    }
+
+    job_cv_.notify_all();
+
+    for (auto &t: threads_)
+        t.join();
+}
+
+void
+WorkerPool::process_items(uint64_t generation)
+{
+    while (true) {
+        size_t k;
+
+        {
+            std::unique_lock<decltype(mtx_)> lock{mtx_};
+
+            // thread may wake up late, when job it was woken for is already finished
+            if (generation_ != generation || next_item_ >= count_)
+                break;
+
+            k = next_item_;
+            next_item_ += 1;
+        }
+
+        try {
+            (*fn_)(k);
+
+        } catch (...) {
+            std::unique_lock<decltype(mtx_)> lock{mtx_};
+            if (!error_)
+                error_ = std::current_exception();
+        }
+
+        std::unique_lock<decltype(mtx_)> lock{mtx_};
+        items_done_ += 1;
+        if (items_done_ == count_)
+            done_cv_.notify_all();
+    }
+}
+
+void
+WorkerPool::thread_body()
+{
+    uint64_t seen_generation = 0;
+
+    while (true) {
+        {
+            std::unique_lock<decltype(mtx_)> lock{mtx_};
+            job_cv_.wait(lock, [this, seen_generation] () {
+                return shutdown_ || generation_ != seen_generation;
+            });
+
+            if (shutdown_)
+                return;
+
+            seen_generation = generation_;
+        }
+
+        process_items(seen_generation);
+    }
+}
+
+void
+WorkerPool::run(size_t count, const std::function<void(size_t)> &fn)
+{
+    if (count == 0)
+        return;
+
+    std::unique_lock<decltype(run_mtx_)> run_lock{run_mtx_};
+
+    uint64_t generation;
+
+    {
+        std::unique_lock<decltype(mtx_)> lock{mtx_};
+        fn_ = &fn;
+        count_ = count;
+        next_item_ = 0;
+        items_done_ = 0;
+        error_ = nullptr;
+        generation_ += 1;
+        generation = generation_;
+    }
+
+    job_cv_.notify_all();
+    process_items(generation);
+
+    std::exception_ptr error;
+
+    {
+        std::unique_lock<decltype(mtx_)> lock{mtx_};
+        done_cv_.wait(lock, [this] () { return items_done_ == count_; });
+        error = error_;
+        error_ = nullptr;
+    }
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+} // namespace vdp
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2013-2016  Rinat Ibragimov
+ *
+ * This file is part of libvdpau-va-gl
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+
+namespace vdp {
+
+/// Small pool of helper threads for splitting short CPU-bound jobs into independent items.
+///
+/// Threads are started on first use and stopped when library is unloaded.
+class WorkerPool
+{
+public:
+    static WorkerPool &
+    instance();
+
+    ~WorkerPool();
+
+    /// Calls fn(k) for each k in [0, count). Calling thread participates in processing too.
+    /// Returns when all items are done. If any of the calls have thrown, first caught exception
+    /// is rethrown.
+    void
+    run(size_t count, const std::function<void(size_t)> &fn);
+
+    size_t
+    thread_count() const { return threads_.size(); }
+
+private:
+    WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+
+    WorkerPool &
+    operator=(const WorkerPool &) = delete;
+
+    void
+    thread_body();
+
+    void
+    process_items(uint64_t generation);
+
+    std::vector<std::thread>            threads_;
+    std::mutex                          run_mtx_;   ///< serializes run() callers
+    std::mutex                          mtx_;
+    std::condition_variable             job_cv_;
+    std::condition_variable             done_cv_;
+    const std::function<void(size_t)>  *fn_;
+    size_t                              count_;
+    size_t                              next_item_;
+    size_t                              items_done_;
+    uint64_t                            generation_;
+    bool                                shutdown_;
+    std::exception_ptr                  error_;
+};
+
+} // namespace vdp
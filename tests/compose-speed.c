@@ -0,0 +1,141 @@
+// compose-speed
+//
+// Measures per-draw overhead of composition. Surfaces are tiny, so time is dominated by state
+// setup and draw call submission rather than by pixel work. Output surface draws may be
+// batched, so each timed loop ends by reading a pixel back, and wall time covers the whole work.
+//
+// usage: compose-speed [iterations]
+
+#include "tests-common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define DST_WIDTH   1280
+#define DST_HEIGHT  720
+#define SMALL_SIZE  32
+
+static double
+elapsed_us(const struct timespec *t_start, const struct timespec *t_end)
+{
+    return (t_end->tv_sec - t_start->tv_sec) * 1.0e6 +
+           (t_end->tv_nsec - t_start->tv_nsec) / 1.0e3;
+}
+
+int main(int argc, char *argv[])
+{
+    VdpDevice device = create_vdp_device();
+    struct timespec t_start, t_end;
+
+    int iterations = 1000;
+    if (argc >= 2)
+        iterations = atoi(argv[1]);
+    if (iterations < 1)
+        iterations = 1;
+
+    VdpOutputSurface dst_surface, src_surface;
+    ASSERT_OK(vdpOutputSurfaceCreate(device, VDP_RGBA_FORMAT_B8G8R8A8, DST_WIDTH, DST_HEIGHT,
+                                     &dst_surface));
+    ASSERT_OK(vdpOutputSurfaceCreate(device, VDP_RGBA_FORMAT_B8G8R8A8, SMALL_SIZE, SMALL_SIZE,
+                                     &src_surface));
+
+    VdpBitmapSurface glyph;
+    ASSERT_OK(vdpBitmapSurfaceCreate(device, VDP_RGBA_FORMAT_A8, SMALL_SIZE, SMALL_SIZE, 0,
+                                     &glyph));
+    static uint8_t glyph_data[SMALL_SIZE * SMALL_SIZE];
+    memset(glyph_data, 0xff, sizeof(glyph_data));
+    const void * const glyph_planes[] = { glyph_data };
+    const uint32_t glyph_pitches[] = { SMALL_SIZE };
+    ASSERT_OK(vdpBitmapSurfacePutBitsNative(glyph, glyph_planes, glyph_pitches, NULL));
+
+    static uint8_t y_plane[SMALL_SIZE * SMALL_SIZE];
+    static uint8_t uv_plane[SMALL_SIZE * SMALL_SIZE / 2];
+    memset(y_plane, 128, sizeof(y_plane));
+    memset(uv_plane, 128, sizeof(uv_plane));
+    const void * const video_planes[] = { y_plane, uv_plane };
+    const uint32_t video_pitches[] = { SMALL_SIZE, SMALL_SIZE };
+
+    VdpVideoSurface video;
+    ASSERT_OK(vdpVideoSurfaceCreate(device, VDP_CHROMA_TYPE_420, SMALL_SIZE, SMALL_SIZE, &video));
+    ASSERT_OK(vdpVideoSurfacePutBitsYCbCr(video, VDP_YCBCR_FORMAT_NV12, video_planes,
+                                          video_pitches));
+
+    VdpVideoMixerParameter params[] = { VDP_VIDEO_MIXER_PARAMETER_LAYERS };
+    const uint32_t layer_count = 2;
+    const void * const param_values[] = { &layer_count };
+    VdpVideoMixer mixer;
+    ASSERT_OK(vdpVideoMixerCreate(device, 0, NULL, 1, params, param_values, &mixer));
+
+    const VdpOutputSurfaceRenderBlendState blend_state = {
+        .struct_version =                   VDP_OUTPUT_SURFACE_RENDER_BLEND_STATE_VERSION,
+        .blend_factor_source_color =        VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_SRC_ALPHA,
+        .blend_factor_destination_color =
+            VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .blend_factor_source_alpha =        VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE,
+        .blend_factor_destination_alpha =   VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ZERO,
+        .blend_equation_color =             VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_ADD,
+        .blend_equation_alpha =             VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_ADD,
+        .blend_constant =                   {0, 0, 0, 0},
+    };
+    const VdpColor color = {1.0f, 1.0f, 0.0f, 0.5f};
+
+    VdpRect dst_rect = {0, 0, SMALL_SIZE, SMALL_SIZE};
+
+    const VdpRect pixel_rect = {0, 0, 1, 1};
+    uint32_t pixel;
+    void * const pixel_data[] = { &pixel };
+    const uint32_t pixel_pitches[] = { sizeof(pixel) };
+
+    printf("%d iterations\n", iterations);
+
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    for (int k = 0; k < iterations; k ++) {
+        dst_rect.x0 = (k * SMALL_SIZE) % (DST_WIDTH - SMALL_SIZE);
+        dst_rect.x1 = dst_rect.x0 + SMALL_SIZE;
+        ASSERT_OK(vdpOutputSurfaceRenderOutputSurface(dst_surface, &dst_rect, src_surface, NULL,
+                                                      NULL, &blend_state, 0));
+    }
+    ASSERT_OK(vdpOutputSurfaceGetBitsNative(dst_surface, &pixel_rect, pixel_data, pixel_pitches));
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+    printf("RenderOutputSurface: %.2f us per call\n",
+           elapsed_us(&t_start, &t_end) / iterations);
+
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    for (int k = 0; k < iterations; k ++) {
+        dst_rect.x0 = (k * SMALL_SIZE) % (DST_WIDTH - SMALL_SIZE);
+        dst_rect.x1 = dst_rect.x0 + SMALL_SIZE;
+        ASSERT_OK(vdpOutputSurfaceRenderBitmapSurface(dst_surface, &dst_rect, glyph, NULL,
+                                                      &color, &blend_state,
+                                                      VDP_OUTPUT_SURFACE_RENDER_ROTATE_90));
+    }
+    ASSERT_OK(vdpOutputSurfaceGetBitsNative(dst_surface, &pixel_rect, pixel_data, pixel_pitches));
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+    printf("RenderBitmapSurface: %.2f us per call\n",
+           elapsed_us(&t_start, &t_end) / iterations);
+
+    const VdpLayer layers[] = {
+        { VDP_LAYER_VERSION, src_surface, NULL, &dst_rect },
+        { VDP_LAYER_VERSION, src_surface, NULL, NULL },
+    };
+
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    for (int k = 0; k < iterations; k ++) {
+        ASSERT_OK(vdpVideoMixerRender(mixer, src_surface, NULL,
+                                      VDP_VIDEO_MIXER_PICTURE_STRUCTURE_FRAME, 0, NULL, video,
+                                      0, NULL, NULL, dst_surface, NULL, NULL, layer_count,
+                                      layers));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+    printf("VideoMixerRender, background and 2 layers: %.2f us per call\n",
+           elapsed_us(&t_start, &t_end) / iterations);
+
+    ASSERT_OK(vdpVideoMixerDestroy(mixer));
+    ASSERT_OK(vdpVideoSurfaceDestroy(video));
+    ASSERT_OK(vdpBitmapSurfaceDestroy(glyph));
+    ASSERT_OK(vdpOutputSurfaceDestroy(src_surface));
+    ASSERT_OK(vdpOutputSurfaceDestroy(dst_surface));
+    ASSERT_OK(vdpDeviceDestroy(device));
+    return 0;
+}
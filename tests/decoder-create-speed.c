@@ -0,0 +1,71 @@
+// decoder-create-speed
+//
+// Measures latency of decoder creation, as it happens when player re-creates decoder on each
+// seek or stream switch. First creation is done from scratch, subsequent ones may reuse
+// context of previously destroyed decoder.
+//
+// usage: decoder-create-speed [repetitions]
+
+#include "tests-common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+
+static double
+elapsed_ms(const struct timespec *t_start, const struct timespec *t_end)
+{
+    return (t_end->tv_sec - t_start->tv_sec) * 1.0e3 +
+           (t_end->tv_nsec - t_start->tv_nsec) / 1.0e6;
+}
+
+int main(int argc, char *argv[])
+{
+    VdpDevice device = create_vdp_device();
+    VdpDecoder decoder;
+
+    int rep_count = 100;
+    if (argc >= 2)
+        rep_count = atoi(argv[1]);
+
+    double first = 0, total = 0, worst = 0;
+    double best = 1.0e9;
+
+    for (int k = 0; k < rep_count + 1; k ++) {
+        struct timespec t_start, t_end;
+
+        clock_gettime(CLOCK_MONOTONIC, &t_start);
+        VdpStatus status = vdpDecoderCreate(device, VDP_DECODER_PROFILE_H264_HIGH, 1920, 1080,
+                                            16, &decoder);
+        clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+        if (status != VDP_STATUS_OK) {
+            printf("no H.264 High decoder available, skipping\n");
+            ASSERT_OK(vdpDeviceDestroy(device));
+            return 0;
+        }
+
+        ASSERT_OK(vdpDecoderDestroy(decoder));
+
+        const double duration = elapsed_ms(&t_start, &t_end);
+        if (k == 0) {
+            first = duration;
+            continue;
+        }
+
+        total += duration;
+        if (duration < best)
+            best = duration;
+        if (duration > worst)
+            worst = duration;
+    }
+
+    printf("first creation: %.3f ms\n", first);
+    if (rep_count > 0) {
+        printf("%d re-creations: average %.3f ms, best %.3f ms, worst %.3f ms\n", rep_count,
+               total / rep_count, best, worst);
+    }
+
+    ASSERT_OK(vdpDeviceDestroy(device));
+    return 0;
+}
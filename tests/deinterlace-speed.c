@@ -0,0 +1,136 @@
+// deinterlace-speed
+//
+// Measures cost of rendering 1080i fields through video mixer with different deinterlacing
+// algorithms. Rendering of progressive frames is measured too, as a baseline; difference
+// between them is the cost of deinterlacing pass itself. Video mixer waits for GPU to finish
+// before returning, so wall time is a fair estimate of GPU time.
+//
+// usage: deinterlace-speed [fields]
+
+#include "tests-common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define WIDTH   1920
+#define HEIGHT  1080
+#define SURFACE_COUNT 3
+
+static double
+elapsed_ms(const struct timespec *t_start, const struct timespec *t_end)
+{
+    return (t_end->tv_sec - t_start->tv_sec) * 1.0e3 +
+           (t_end->tv_nsec - t_start->tv_nsec) / 1.0e6;
+}
+
+static double
+measure(VdpVideoMixer mixer, VdpVideoMixerPictureStructure structure,
+        const VdpVideoSurface *surfaces, VdpOutputSurface out_surface, int field_count)
+{
+    struct timespec t_start, t_end;
+
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    for (int k = 0; k < field_count; k ++) {
+        VdpVideoMixerPictureStructure current = structure;
+        if (structure != VDP_VIDEO_MIXER_PICTURE_STRUCTURE_FRAME) {
+            current = (k & 1) ? VDP_VIDEO_MIXER_PICTURE_STRUCTURE_BOTTOM_FIELD
+                              : VDP_VIDEO_MIXER_PICTURE_STRUCTURE_TOP_FIELD;
+        }
+
+        const VdpVideoSurface past[] = { surfaces[k % SURFACE_COUNT] };
+        const VdpVideoSurface future[] = { surfaces[(k + 2) % SURFACE_COUNT] };
+
+        ASSERT_OK(vdpVideoMixerRender(mixer, VDP_INVALID_HANDLE, NULL, current, 1, past,
+                                      surfaces[(k + 1) % SURFACE_COUNT], 1, future, NULL,
+                                      out_surface, NULL, NULL, 0, NULL));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+    return elapsed_ms(&t_start, &t_end) / field_count;
+}
+
+int main(int argc, char *argv[])
+{
+    VdpDevice device = create_vdp_device();
+
+    int field_count = 300;
+    if (argc >= 2)
+        field_count = atoi(argv[1]);
+    if (field_count < 1)
+        field_count = 1;
+
+    // fill surfaces with distinct moving patterns, so motion detection has something to do
+    static uint8_t y_plane[WIDTH * HEIGHT];
+    static uint8_t uv_plane[WIDTH * HEIGHT / 2];
+    VdpVideoSurface surfaces[SURFACE_COUNT];
+
+    for (int s = 0; s < SURFACE_COUNT; s ++) {
+        for (int y = 0; y < HEIGHT; y ++)
+            for (int x = 0; x < WIDTH; x ++)
+                y_plane[y * WIDTH + x] = (x + y + s * 16) & 0xff;
+        memset(uv_plane, 128, sizeof(uv_plane));
+
+        const void * const planes[] = { y_plane, uv_plane };
+        const uint32_t pitches[] = { WIDTH, WIDTH };
+
+        ASSERT_OK(vdpVideoSurfaceCreate(device, VDP_CHROMA_TYPE_420, WIDTH, HEIGHT,
+                                        &surfaces[s]));
+        ASSERT_OK(vdpVideoSurfacePutBitsYCbCr(surfaces[s], VDP_YCBCR_FORMAT_NV12, planes,
+                                              pitches));
+    }
+
+    VdpOutputSurface out_surface;
+    ASSERT_OK(vdpOutputSurfaceCreate(device, VDP_RGBA_FORMAT_B8G8R8A8, WIDTH, HEIGHT,
+                                     &out_surface));
+
+    const VdpVideoMixerFeature features[] = {
+        VDP_VIDEO_MIXER_FEATURE_DEINTERLACE_TEMPORAL,
+        VDP_VIDEO_MIXER_FEATURE_DEINTERLACE_TEMPORAL_SPATIAL,
+    };
+    const VdpVideoMixerParameter params[] = {
+        VDP_VIDEO_MIXER_PARAMETER_VIDEO_SURFACE_WIDTH,
+        VDP_VIDEO_MIXER_PARAMETER_VIDEO_SURFACE_HEIGHT,
+    };
+    const uint32_t width = WIDTH, height = HEIGHT;
+    const void * const param_values[] = { &width, &height };
+
+    VdpVideoMixer mixer;
+    ASSERT_OK(vdpVideoMixerCreate(device, 2, features, 2, params, param_values, &mixer));
+
+    // warm up
+    measure(mixer, VDP_VIDEO_MIXER_PICTURE_STRUCTURE_TOP_FIELD, surfaces, out_surface, 10);
+
+    const VdpBool enables_none[] = { VDP_FALSE, VDP_FALSE };
+    const VdpBool enables_temporal[] = { VDP_TRUE, VDP_FALSE };
+    const VdpBool enables_temporal_spatial[] = { VDP_FALSE, VDP_TRUE };
+
+    ASSERT_OK(vdpVideoMixerSetFeatureEnables(mixer, 2, features, enables_none));
+    const double frame = measure(mixer, VDP_VIDEO_MIXER_PICTURE_STRUCTURE_FRAME, surfaces,
+                                 out_surface, field_count);
+    const double bob = measure(mixer, VDP_VIDEO_MIXER_PICTURE_STRUCTURE_TOP_FIELD, surfaces,
+                               out_surface, field_count);
+
+    ASSERT_OK(vdpVideoMixerSetFeatureEnables(mixer, 2, features, enables_temporal));
+    const double temporal = measure(mixer, VDP_VIDEO_MIXER_PICTURE_STRUCTURE_TOP_FIELD,
+                                    surfaces, out_surface, field_count);
+
+    ASSERT_OK(vdpVideoMixerSetFeatureEnables(mixer, 2, features, enables_temporal_spatial));
+    const double temporal_spatial = measure(mixer, VDP_VIDEO_MIXER_PICTURE_STRUCTURE_TOP_FIELD,
+                                            surfaces, out_surface, field_count);
+
+    printf("%d fields of %dx%d\n", field_count, WIDTH, HEIGHT);
+    printf("progressive:      %.3f ms per frame\n", frame);
+    printf("bob:              %.3f ms per field (+%.3f ms)\n", bob, bob - frame);
+    printf("temporal:         %.3f ms per field (+%.3f ms)\n", temporal, temporal - frame);
+    printf("temporal_spatial: %.3f ms per field (+%.3f ms)\n", temporal_spatial,
+           temporal_spatial - frame);
+
+    ASSERT_OK(vdpVideoMixerDestroy(mixer));
+    ASSERT_OK(vdpOutputSurfaceDestroy(out_surface));
+    for (int s = 0; s < SURFACE_COUNT; s ++)
+        ASSERT_OK(vdpVideoSurfaceDestroy(surfaces[s]));
+    ASSERT_OK(vdpDeviceDestroy(device));
+    return 0;
+}
@@ -0,0 +1,95 @@
+// indexed-speed
+//
+// Measures upload of indexed pictures, like DVD and DVB subpictures, into an output surface.
+// VdpOutputSurfacePutBitsIndexed expands indices in a shader. For comparison, the same picture
+// is expanded by CPU, the way the driver used to do it, and put with VdpOutputSurfacePutBitsNative.
+//
+// usage: indexed-speed [iterations] [width] [height]
+
+#include "tests-common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+
+static double
+elapsed_us(const struct timespec *t_start, const struct timespec *t_end)
+{
+    return (t_end->tv_sec - t_start->tv_sec) * 1.0e6 +
+           (t_end->tv_nsec - t_start->tv_nsec) / 1.0e3;
+}
+
+int main(int argc, char *argv[])
+{
+    VdpDevice device = create_vdp_device();
+    struct timespec t_start, t_end;
+
+    int iterations = 200;
+    if (argc >= 2)
+        iterations = atoi(argv[1]);
+    if (iterations < 1)
+        iterations = 1;
+
+    uint32_t width = 720;
+    uint32_t height = 576;
+    if (argc >= 4) {
+        width = atoi(argv[2]);
+        height = atoi(argv[3]);
+    }
+    if (width < 1 || width > 4096 || height < 1 || height > 4096) {
+        printf("wrong size\n");
+        return 1;
+    }
+
+    VdpOutputSurface surface;
+    ASSERT_OK(vdpOutputSurfaceCreate(device, VDP_RGBA_FORMAT_B8G8R8A8, width, height, &surface));
+
+    uint8_t *indexed = malloc(width * height * 2);
+    uint32_t *expanded = malloc(width * height * 4);
+    uint32_t color_table[256];
+    if (!indexed || !expanded) {
+        printf("out of memory\n");
+        return 1;
+    }
+
+    for (uint32_t k = 0; k < width * height; k ++) {
+        indexed[2 * k] = (k * 7) & 0xff;
+        indexed[2 * k + 1] = (k & 0x40) ? 0xff : 0;
+    }
+    for (int k = 0; k < 256; k ++)
+        color_table[k] = k * 0x010203;
+
+    const void * const indexed_data[] = { indexed };
+    const uint32_t indexed_pitches[] = { width * 2 };
+    const void * const expanded_data[] = { expanded };
+    const uint32_t expanded_pitches[] = { width * 4 };
+
+    printf("%d iterations, %ux%u picture\n", iterations, width, height);
+
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    for (int k = 0; k < iterations; k ++) {
+        ASSERT_OK(vdpOutputSurfacePutBitsIndexed(surface, VDP_INDEXED_FORMAT_I8A8, indexed_data,
+                                                 indexed_pitches, NULL,
+                                                 VDP_COLOR_TABLE_FORMAT_B8G8R8X8, color_table));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+    printf("PutBitsIndexed: %.1f us per picture\n", elapsed_us(&t_start, &t_end) / iterations);
+
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    for (int k = 0; k < iterations; k ++) {
+        for (uint32_t j = 0; j < width * height; j ++) {
+            expanded[j] = (color_table[indexed[2 * j]] & 0x00ffffff) +
+                          ((uint32_t)indexed[2 * j + 1] << 24);
+        }
+        ASSERT_OK(vdpOutputSurfacePutBitsNative(surface, expanded_data, expanded_pitches, NULL));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+    printf("CPU expansion and PutBitsNative: %.1f us per picture\n",
+           elapsed_us(&t_start, &t_end) / iterations);
+
+    free(expanded);
+    free(indexed);
+    ASSERT_OK(vdpOutputSurfaceDestroy(surface));
+    ASSERT_OK(vdpDeviceDestroy(device));
+    return 0;
+}
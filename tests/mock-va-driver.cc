@@ -0,0 +1,1204 @@
+/*
+ * Copyright 2013-2016  Rinat Ibragimov
+ *
+ * This file is part of libvdpau-va-gl
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Stand-in VA-API driver for exercising decode path without a GPU.
+//
+// Loaded by libva as any other driver:
+//     LIBVA_DRIVERS_PATH=<build>/tests LIBVA_DRIVER_NAME=mock
+//
+// Decoding does nothing but recording submitted buffers. Decoded surfaces contain synthetic
+// NV12 (or P010) frame: luma is a diagonal gradient shifted by picture number, chroma is
+// neutral. Surfaces that were never decoded to are black.
+//
+// Environment variables:
+//     MOCKVA_RECORD               file to write submitted buffers to
+//     MOCKVA_SUBMIT_LATENCY_US    time vaEndPicture blocks for
+//     MOCKVA_DECODE_LATENCY_US    time after vaEndPicture until surface is ready. Readers of
+//                                 surface wait for it, as they would for real hardware
+//
+// Record file is a sequence of native-endian uint32_t fields:
+//     file header:    'MKVA', version (1)
+//     picture:        'PICT', context id, target surface id, buffer count, buffers
+//     buffer:         type, element size, element count, element size * element count bytes
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <va/va.h>
+#include <va/va_backend.h>
+#include <vector>
+
+
+#if VA_CHECK_VERSION(1, 0, 0)
+#define MOCKVA_DRIVER_INIT __vaDriverInit_1_0
+#else
+#define MOCKVA_DRIVER_INIT __vaDriverInit_0_32
+#endif
+
+using std::chrono::steady_clock;
+using std::shared_ptr;
+using std::vector;
+
+
+namespace mockva {
+
+const uint32_t kRecordMagic = 0x41564b4d;   // 'MKVA'
+const uint32_t kRecordVersion = 1;
+const uint32_t kRecordPicture = 0x54434950; // 'PICT'
+const int kMaxDimension = 4096;
+const uint32_t kFourccP010 = VA_FOURCC('P', '0', '1', '0');
+
+const VAProfile kProfiles[] = {
+    VAProfileMPEG2Simple,
+    VAProfileMPEG2Main,
+    VAProfileH264ConstrainedBaseline,
+    VAProfileH264Main,
+    VAProfileH264High,
+    VAProfileVC1Simple,
+    VAProfileVC1Main,
+    VAProfileVC1Advanced,
+    VAProfileHEVCMain,
+    VAProfileHEVCMain10,
+};
+
+const uint32_t kImageFourccs[] = {
+    VA_FOURCC_NV12,
+    VA_FOURCC_YV12,
+    kFourccP010,
+};
+
+struct Config
+{
+    VAProfile   profile;
+    uint32_t    rt_format;
+};
+
+struct Surface
+{
+    uint32_t    width;
+    uint32_t    height;
+    uint32_t    fourcc;
+    uint32_t    pitch;
+    uint32_t    uv_offset;
+    shared_ptr<vector<uint8_t>>     data;
+    uint64_t    picture;            ///< number of picture decoded into, 0 if none
+    uint64_t    filled_picture;     ///< number of picture data currently holds
+    steady_clock::time_point    ready_time;
+};
+
+struct Buffer
+{
+    VABufferType    type;
+    uint32_t        element_size;
+    uint32_t        num_elements;
+    shared_ptr<vector<uint8_t>>     data;   ///< shared with surface for derived images
+    VASurfaceID     derived_from;
+};
+
+struct Context
+{
+    VAConfigID      config;
+    VASurfaceID     target;
+    vector<Buffer>  pending;    ///< copies of buffers of the current picture
+};
+
+struct Driver
+{
+    std::mutex      mtx;
+    uint32_t        next_id;
+    std::map<VAConfigID, Config>    configs;
+    std::map<VASurfaceID, Surface>  surfaces;
+    std::map<VAContextID, Context>  contexts;
+    std::map<VABufferID, Buffer>    buffers;
+    std::map<VAImageID, VAImage>    images;
+    uint64_t        pictures;
+    steady_clock::duration  submit_latency;
+    steady_clock::duration  decode_latency;
+    FILE           *record;
+};
+
+Driver &
+driver(VADriverContextP ctx)
+{
+    return *static_cast<Driver *>(ctx->pDriverData);
+}
+
+steady_clock::duration
+latency_from_env(const char *name)
+{
+    const char *value = getenv(name);
+
+    return std::chrono::microseconds(value ? strtoul(value, nullptr, 10) : 0);
+}
+
+void
+write_u32(FILE *fp, uint32_t value)
+{
+    fwrite(&value, sizeof(value), 1, fp);
+}
+
+bool
+is_known_profile(VAProfile profile)
+{
+    return std::find(std::begin(kProfiles), std::end(kProfiles), profile) != std::end(kProfiles);
+}
+
+uint32_t
+rt_formats_of(VAProfile profile)
+{
+    if (profile == VAProfileHEVCMain10)
+        return VA_RT_FORMAT_YUV420 | VA_RT_FORMAT_YUV420_10BPP;
+
+    return VA_RT_FORMAT_YUV420;
+}
+
+VAImageFormat
+image_format(uint32_t fourcc)
+{
+    VAImageFormat format = {};
+
+    format.fourcc = fourcc;
+    format.byte_order = VA_LSB_FIRST;
+    format.bits_per_pixel = (fourcc == kFourccP010) ? 24 : 12;
+
+    return format;
+}
+
+/// lays out image planes, the same way surfaces are laid out
+void
+fill_image_layout(VAImage *image, uint32_t fourcc, uint32_t width, uint32_t height)
+{
+    const uint32_t bytes_per_sample = (fourcc == kFourccP010) ? 2 : 1;
+    const uint32_t pitch = ((width + 15) & ~15u) * bytes_per_sample;
+    const uint32_t aligned_height = (height + 15) & ~15u;
+    const uint32_t luma_size = pitch * aligned_height;
+
+    *image = VAImage{};
+    image->format = image_format(fourcc);
+    image->width = width;
+    image->height = height;
+    image->pitches[0] = pitch;
+    image->offsets[0] = 0;
+
+    if (fourcc == VA_FOURCC_YV12) {
+        image->num_planes = 3;
+        image->pitches[1] = pitch / 2;
+        image->pitches[2] = pitch / 2;
+        image->offsets[1] = luma_size;
+        image->offsets[2] = luma_size + luma_size / 4;
+    } else {
+        image->num_planes = 2;
+        image->pitches[1] = pitch;
+        image->offsets[1] = luma_size;
+    }
+
+    image->data_size = luma_size * 3 / 2;
+}
+
+/// writes synthetic picture into surface data, unless it's already there
+void
+fill_surface(Surface &surf)
+{
+    if (surf.filled_picture == surf.picture)
+        return;
+
+    auto &data = *surf.data;
+    const bool is_10bit = (surf.fourcc == kFourccP010);
+
+    for (uint32_t y = 0; y < surf.height; y ++) {
+        for (uint32_t x = 0; x < surf.width; x ++) {
+            const uint8_t luma = (surf.picture == 0) ? 16 : (x + y + surf.picture) & 0xff;
+
+            if (is_10bit) {
+                const uint16_t sample = luma << 8;
+                memcpy(&data[y * surf.pitch + x * 2], &sample, sizeof(sample));
+            } else {
+                data[y * surf.pitch + x] = luma;
+            }
+        }
+    }
+
+    if (is_10bit) {
+        const uint16_t neutral = 128 << 8;
+
+        for (uint32_t y = 0; y < surf.height / 2; y ++) {
+            for (uint32_t x = 0; x < surf.width; x ++)
+                memcpy(&data[surf.uv_offset + y * surf.pitch + x * 2], &neutral, sizeof(neutral));
+        }
+    } else {
+        memset(&data[surf.uv_offset], 128, data.size() - surf.uv_offset);
+    }
+
+    surf.filled_picture = surf.picture;
+}
+
+/// blocks until picture decoded into surface is ready. Temporarily releases driver lock
+VAStatus
+wait_for_surface(Driver &drv, std::unique_lock<std::mutex> &lock, VASurfaceID surface_id)
+{
+    auto it = drv.surfaces.find(surface_id);
+    if (it == drv.surfaces.end())
+        return VA_STATUS_ERROR_INVALID_SURFACE;
+
+    const auto ready_time = it->second.ready_time;
+
+    if (steady_clock::now() < ready_time) {
+        lock.unlock();
+        std::this_thread::sleep_until(ready_time);
+        lock.lock();
+    }
+
+    // surface may have been destroyed meanwhile
+    if (drv.surfaces.count(surface_id) == 0)
+        return VA_STATUS_ERROR_INVALID_SURFACE;
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+Terminate(VADriverContextP ctx)
+{
+    Driver *drv = &driver(ctx);
+
+    if (drv->record)
+        fclose(drv->record);
+
+    delete drv;
+    ctx->pDriverData = nullptr;
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+QueryConfigProfiles(VADriverContextP, VAProfile *profile_list, int *num_profiles)
+{
+    std::copy(std::begin(kProfiles), std::end(kProfiles), profile_list);
+    *num_profiles = std::end(kProfiles) - std::begin(kProfiles);
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+QueryConfigEntrypoints(VADriverContextP, VAProfile profile, VAEntrypoint *entrypoint_list,
+                       int *num_entrypoints)
+{
+    if (!is_known_profile(profile))
+        return VA_STATUS_ERROR_UNSUPPORTED_PROFILE;
+
+    entrypoint_list[0] = VAEntrypointVLD;
+    *num_entrypoints = 1;
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+GetConfigAttributes(VADriverContextP, VAProfile profile, VAEntrypoint entrypoint,
+                    VAConfigAttrib *attrib_list, int num_attribs)
+{
+    if (!is_known_profile(profile))
+        return VA_STATUS_ERROR_UNSUPPORTED_PROFILE;
+
+    if (entrypoint != VAEntrypointVLD)
+        return VA_STATUS_ERROR_UNSUPPORTED_ENTRYPOINT;
+
+    for (int k = 0; k < num_attribs; k ++) {
+        switch (attrib_list[k].type) {
+        case VAConfigAttribRTFormat:
+            attrib_list[k].value = rt_formats_of(profile);
+            break;
+
+#if VA_CHECK_VERSION(1, 0, 0)
+        case VAConfigAttribMaxPictureWidth:
+        case VAConfigAttribMaxPictureHeight:
+            attrib_list[k].value = kMaxDimension;
+            break;
+#endif
+
+        default:
+            attrib_list[k].value = VA_ATTRIB_NOT_SUPPORTED;
+            break;
+        }
+    }
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+CreateConfig(VADriverContextP ctx, VAProfile profile, VAEntrypoint entrypoint,
+             VAConfigAttrib *attrib_list, int num_attribs, VAConfigID *config_id)
+{
+    if (!is_known_profile(profile))
+        return VA_STATUS_ERROR_UNSUPPORTED_PROFILE;
+
+    if (entrypoint != VAEntrypointVLD)
+        return VA_STATUS_ERROR_UNSUPPORTED_ENTRYPOINT;
+
+    Config config{profile, VA_RT_FORMAT_YUV420};
+
+    for (int k = 0; k < num_attribs; k ++) {
+        if (attrib_list[k].type != VAConfigAttribRTFormat)
+            continue;
+
+        if ((attrib_list[k].value & rt_formats_of(profile)) == 0)
+            return VA_STATUS_ERROR_UNSUPPORTED_RT_FORMAT;
+
+        config.rt_format = attrib_list[k].value;
+    }
+
+    Driver &drv = driver(ctx);
+    std::unique_lock<std::mutex> lock{drv.mtx};
+
+    *config_id = drv.next_id ++;
+    drv.configs[*config_id] = config;
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+DestroyConfig(VADriverContextP ctx, VAConfigID config_id)
+{
+    Driver &drv = driver(ctx);
+    std::unique_lock<std::mutex> lock{drv.mtx};
+
+    if (drv.configs.erase(config_id) == 0)
+        return VA_STATUS_ERROR_INVALID_CONFIG;
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+QueryConfigAttributes(VADriverContextP ctx, VAConfigID config_id, VAProfile *profile,
+                      VAEntrypoint *entrypoint, VAConfigAttrib *attrib_list, int *num_attribs)
+{
+    Driver &drv = driver(ctx);
+    std::unique_lock<std::mutex> lock{drv.mtx};
+
+    auto it = drv.configs.find(config_id);
+    if (it == drv.configs.end())
+        return VA_STATUS_ERROR_INVALID_CONFIG;
+
+    *profile = it->second.profile;
+    *entrypoint = VAEntrypointVLD;
+    attrib_list[0].type = VAConfigAttribRTFormat;
+    attrib_list[0].value = rt_formats_of(it->second.profile);
+    *num_attribs = 1;
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+CreateSurfaces2(VADriverContextP ctx, unsigned int format, unsigned int width,
+                unsigned int height, VASurfaceID *surfaces, unsigned int num_surfaces,
+                VASurfaceAttrib *, unsigned int)
+{
+    if (format != VA_RT_FORMAT_YUV420 && format != VA_RT_FORMAT_YUV420_10BPP)
+        return VA_STATUS_ERROR_UNSUPPORTED_RT_FORMAT;
+
+    if (width == 0 || height == 0 || width > kMaxDimension || height > kMaxDimension)
+        return VA_STATUS_ERROR_INVALID_PARAMETER;
+
+    const uint32_t fourcc = (format == VA_RT_FORMAT_YUV420_10BPP) ? kFourccP010
+                                                                  : VA_FOURCC_NV12;
+    VAImage layout;
+    fill_image_layout(&layout, fourcc, width, height);
+
+    Driver &drv = driver(ctx);
+    std::unique_lock<std::mutex> lock{drv.mtx};
+
+    for (unsigned int k = 0; k < num_surfaces; k ++) {
+        Surface surf;
+
+        surf.width = width;
+        surf.height = height;
+        surf.fourcc = fourcc;
+        surf.pitch = layout.pitches[0];
+        surf.uv_offset = layout.offsets[1];
+        surf.data = std::make_shared<vector<uint8_t>>(layout.data_size);
+        surf.picture = 0;
+        surf.filled_picture = ~0ull;
+        surf.ready_time = steady_clock::now();
+
+        surfaces[k] = drv.next_id ++;
+        drv.surfaces[surfaces[k]] = surf;
+    }
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+CreateSurfaces(VADriverContextP ctx, int width, int height, int format, int num_surfaces,
+               VASurfaceID *surfaces)
+{
+    return CreateSurfaces2(ctx, format, width, height, surfaces, num_surfaces, nullptr, 0);
+}
+
+VAStatus
+DestroySurfaces(VADriverContextP ctx, VASurfaceID *surface_list, int num_surfaces)
+{
+    Driver &drv = driver(ctx);
+    std::unique_lock<std::mutex> lock{drv.mtx};
+
+    for (int k = 0; k < num_surfaces; k ++) {
+        if (drv.surfaces.erase(surface_list[k]) == 0)
+            return VA_STATUS_ERROR_INVALID_SURFACE;
+    }
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+QuerySurfaceAttributes(VADriverContextP ctx, VAConfigID config_id, VASurfaceAttrib *attrib_list,
+                       unsigned int *num_attribs)
+{
+    Driver &drv = driver(ctx);
+    std::unique_lock<std::mutex> lock{drv.mtx};
+
+    auto it = drv.configs.find(config_id);
+    if (it == drv.configs.end())
+        return VA_STATUS_ERROR_INVALID_CONFIG;
+
+    vector<VASurfaceAttrib> attribs;
+
+    auto add_attrib = [&attribs] (VASurfaceAttribType type, int32_t value) {
+        VASurfaceAttrib attrib = {};
+
+        attrib.type = type;
+        attrib.flags = VA_SURFACE_ATTRIB_GETTABLE;
+        attrib.value.type = VAGenericValueTypeInteger;
+        attrib.value.value.i = value;
+        attribs.push_back(attrib);
+    };
+
+    add_attrib(VASurfaceAttribPixelFormat, VA_FOURCC_NV12);
+    if (it->second.profile == VAProfileHEVCMain10)
+        add_attrib(VASurfaceAttribPixelFormat, kFourccP010);
+
+    add_attrib(VASurfaceAttribMinWidth, 1);
+    add_attrib(VASurfaceAttribMinHeight, 1);
+    add_attrib(VASurfaceAttribMaxWidth, kMaxDimension);
+    add_attrib(VASurfaceAttribMaxHeight, kMaxDimension);
+
+    if (!attrib_list) {
+        *num_attribs = attribs.size();
+        return VA_STATUS_SUCCESS;
+    }
+
+    if (*num_attribs < attribs.size()) {
+        *num_attribs = attribs.size();
+        return VA_STATUS_ERROR_MAX_NUM_EXCEEDED;
+    }
+
+    std::copy(attribs.begin(), attribs.end(), attrib_list);
+    *num_attribs = attribs.size();
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+CreateContext(VADriverContextP ctx, VAConfigID config_id, int, int, int,
+              VASurfaceID *render_targets, int num_render_targets, VAContextID *context_id)
+{
+    Driver &drv = driver(ctx);
+    std::unique_lock<std::mutex> lock{drv.mtx};
+
+    if (drv.configs.count(config_id) == 0)
+        return VA_STATUS_ERROR_INVALID_CONFIG;
+
+    for (int k = 0; k < num_render_targets; k ++) {
+        if (drv.surfaces.count(render_targets[k]) == 0)
+            return VA_STATUS_ERROR_INVALID_SURFACE;
+    }
+
+    *context_id = drv.next_id ++;
+    drv.contexts[*context_id] = Context{config_id, VA_INVALID_SURFACE, {}};
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+DestroyContext(VADriverContextP ctx, VAContextID context_id)
+{
+    Driver &drv = driver(ctx);
+    std::unique_lock<std::mutex> lock{drv.mtx};
+
+    if (drv.contexts.erase(context_id) == 0)
+        return VA_STATUS_ERROR_INVALID_CONTEXT;
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+CreateBuffer(VADriverContextP ctx, VAContextID, VABufferType type, unsigned int size,
+             unsigned int num_elements, void *data, VABufferID *buf_id)
+{
+    Buffer buf;
+
+    buf.type = type;
+    buf.element_size = size;
+    buf.num_elements = num_elements;
+    buf.data = std::make_shared<vector<uint8_t>>(size * num_elements);
+    buf.derived_from = VA_INVALID_SURFACE;
+
+    if (data)
+        memcpy(buf.data->data(), data, buf.data->size());
+
+    Driver &drv = driver(ctx);
+    std::unique_lock<std::mutex> lock{drv.mtx};
+
+    *buf_id = drv.next_id ++;
+    drv.buffers[*buf_id] = buf;
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+BufferSetNumElements(VADriverContextP ctx, VABufferID buf_id, unsigned int num_elements)
+{
+    Driver &drv = driver(ctx);
+    std::unique_lock<std::mutex> lock{drv.mtx};
+
+    auto it = drv.buffers.find(buf_id);
+    if (it == drv.buffers.end())
+        return VA_STATUS_ERROR_INVALID_BUFFER;
+
+    if (num_elements * it->second.element_size > it->second.data->size())
+        return VA_STATUS_ERROR_INVALID_PARAMETER;
+
+    it->second.num_elements = num_elements;
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+MapBuffer(VADriverContextP ctx, VABufferID buf_id, void **pbuf)
+{
+    Driver &drv = driver(ctx);
+    std::unique_lock<std::mutex> lock{drv.mtx};
+
+    auto it = drv.buffers.find(buf_id);
+    if (it == drv.buffers.end())
+        return VA_STATUS_ERROR_INVALID_BUFFER;
+
+    const VASurfaceID derived_from = it->second.derived_from;
+
+    // derived image shows surface contents, which are produced on first access
+    if (derived_from != VA_INVALID_SURFACE) {
+        const VAStatus status = wait_for_surface(drv, lock, derived_from);
+        if (status == VA_STATUS_SUCCESS)
+            fill_surface(drv.surfaces[derived_from]);
+
+        it = drv.buffers.find(buf_id);
+        if (it == drv.buffers.end())
+            return VA_STATUS_ERROR_INVALID_BUFFER;
+    }
+
+    *pbuf = it->second.data->data();
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+UnmapBuffer(VADriverContextP ctx, VABufferID buf_id)
+{
+    Driver &drv = driver(ctx);
+    std::unique_lock<std::mutex> lock{drv.mtx};
+
+    if (drv.buffers.count(buf_id) == 0)
+        return VA_STATUS_ERROR_INVALID_BUFFER;
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+DestroyBuffer(VADriverContextP ctx, VABufferID buf_id)
+{
+    Driver &drv = driver(ctx);
+    std::unique_lock<std::mutex> lock{drv.mtx};
+
+    if (drv.buffers.erase(buf_id) == 0)
+        return VA_STATUS_ERROR_INVALID_BUFFER;
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+BufferInfo(VADriverContextP ctx, VABufferID buf_id, VABufferType *type, unsigned int *size,
+           unsigned int *num_elements)
+{
+    Driver &drv = driver(ctx);
+    std::unique_lock<std::mutex> lock{drv.mtx};
+
+    auto it = drv.buffers.find(buf_id);
+    if (it == drv.buffers.end())
+        return VA_STATUS_ERROR_INVALID_BUFFER;
+
+    *type = it->second.type;
+    *size = it->second.element_size;
+    *num_elements = it->second.num_elements;
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+BeginPicture(VADriverContextP ctx, VAContextID context_id, VASurfaceID render_target)
+{
+    Driver &drv = driver(ctx);
+    std::unique_lock<std::mutex> lock{drv.mtx};
+
+    auto it = drv.contexts.find(context_id);
+    if (it == drv.contexts.end())
+        return VA_STATUS_ERROR_INVALID_CONTEXT;
+
+    if (drv.surfaces.count(render_target) == 0)
+        return VA_STATUS_ERROR_INVALID_SURFACE;
+
+    it->second.target = render_target;
+    it->second.pending.clear();
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+RenderPicture(VADriverContextP ctx, VAContextID context_id, VABufferID *buffers, int num_buffers)
+{
+    Driver &drv = driver(ctx);
+    std::unique_lock<std::mutex> lock{drv.mtx};
+
+    auto it = drv.contexts.find(context_id);
+    if (it == drv.contexts.end())
+        return VA_STATUS_ERROR_INVALID_CONTEXT;
+
+    if (it->second.target == VA_INVALID_SURFACE)
+        return VA_STATUS_ERROR_OPERATION_FAILED;
+
+    for (int k = 0; k < num_buffers; k ++) {
+        auto buf_it = drv.buffers.find(buffers[k]);
+        if (buf_it == drv.buffers.end())
+            return VA_STATUS_ERROR_INVALID_BUFFER;
+
+        if (!drv.record)
+            continue;
+
+        // application is free to reuse buffer after this call, so contents are copied
+        Buffer copy = buf_it->second;
+        const size_t used_size = copy.element_size * copy.num_elements;
+
+        copy.data = std::make_shared<vector<uint8_t>>(copy.data->begin(),
+                                                      copy.data->begin() + used_size);
+        it->second.pending.push_back(copy);
+    }
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+EndPicture(VADriverContextP ctx, VAContextID context_id)
+{
+    Driver &drv = driver(ctx);
+
+    if (drv.submit_latency.count() > 0)
+        std::this_thread::sleep_for(drv.submit_latency);
+
+    std::unique_lock<std::mutex> lock{drv.mtx};
+
+    auto it = drv.contexts.find(context_id);
+    if (it == drv.contexts.end())
+        return VA_STATUS_ERROR_INVALID_CONTEXT;
+
+    Context &context = it->second;
+
+    auto surf_it = drv.surfaces.find(context.target);
+    if (surf_it == drv.surfaces.end())
+        return VA_STATUS_ERROR_INVALID_SURFACE;
+
+    drv.pictures += 1;
+    surf_it->second.picture = drv.pictures;
+    surf_it->second.ready_time = steady_clock::now() + drv.decode_latency;
+
+    if (drv.record) {
+        write_u32(drv.record, kRecordPicture);
+        write_u32(drv.record, context_id);
+        write_u32(drv.record, context.target);
+        write_u32(drv.record, context.pending.size());
+
+        for (const auto &buf: context.pending) {
+            write_u32(drv.record, buf.type);
+            write_u32(drv.record, buf.element_size);
+            write_u32(drv.record, buf.num_elements);
+            fwrite(buf.data->data(), 1, buf.data->size(), drv.record);
+        }
+    }
+
+    context.target = VA_INVALID_SURFACE;
+    context.pending.clear();
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+SyncSurface(VADriverContextP ctx, VASurfaceID render_target)
+{
+    Driver &drv = driver(ctx);
+    std::unique_lock<std::mutex> lock{drv.mtx};
+
+    return wait_for_surface(drv, lock, render_target);
+}
+
+VAStatus
+QuerySurfaceStatus(VADriverContextP ctx, VASurfaceID render_target, VASurfaceStatus *status)
+{
+    Driver &drv = driver(ctx);
+    std::unique_lock<std::mutex> lock{drv.mtx};
+
+    auto it = drv.surfaces.find(render_target);
+    if (it == drv.surfaces.end())
+        return VA_STATUS_ERROR_INVALID_SURFACE;
+
+    *status = (steady_clock::now() < it->second.ready_time) ? VASurfaceRendering
+                                                             : VASurfaceReady;
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+QuerySurfaceError(VADriverContextP, VASurfaceID, VAStatus, void **)
+{
+    return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+/// converts surface to RGB with BT.601 coefficients and draws it to X drawable, scaling with
+/// nearest neighbour
+VAStatus
+PutSurface(VADriverContextP ctx, VASurfaceID surface_id, void *draw, short srcx, short srcy,
+           unsigned short srcw, unsigned short srch, short destx, short desty,
+           unsigned short destw, unsigned short desth, VARectangle *, unsigned int,
+           unsigned int)
+{
+    Driver &drv = driver(ctx);
+    std::unique_lock<std::mutex> lock{drv.mtx};
+
+    const VAStatus status = wait_for_surface(drv, lock, surface_id);
+    if (status != VA_STATUS_SUCCESS)
+        return status;
+
+    if (destw == 0 || desth == 0)
+        return VA_STATUS_SUCCESS;
+
+    Surface &surf = drv.surfaces[surface_id];
+    fill_surface(surf);
+
+    Display *dpy = static_cast<Display *>(ctx->native_dpy);
+    const Drawable drawable = reinterpret_cast<uintptr_t>(draw);
+    const uint32_t bytes_per_sample = (surf.fourcc == kFourccP010) ? 2 : 1;
+    // high byte of 16-bit sample is the 8-bit one
+    const uint32_t sample_ofs = bytes_per_sample - 1;
+    const auto &data = *surf.data;
+
+    auto *pixels = static_cast<uint32_t *>(malloc(destw * desth * 4));
+    if (!pixels)
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+
+    for (uint32_t y = 0; y < desth; y ++) {
+        const uint32_t sy = std::min<uint32_t>(srcy + y * srch / desth, surf.height - 1);
+
+        for (uint32_t x = 0; x < destw; x ++) {
+            const uint32_t sx = std::min<uint32_t>(srcx + x * srcw / destw, surf.width - 1);
+            const size_t uv_pos = surf.uv_offset + (sy / 2) * surf.pitch +
+                                  (sx / 2) * 2 * bytes_per_sample;
+
+            const int c = data[sy * surf.pitch + sx * bytes_per_sample + sample_ofs] - 16;
+            const int d = data[uv_pos + sample_ofs] - 128;
+            const int e = data[uv_pos + bytes_per_sample + sample_ofs] - 128;
+
+            const int r = std::min(std::max((298 * c + 409 * e + 128) >> 8, 0), 255);
+            const int g = std::min(std::max((298 * c - 100 * d - 208 * e + 128) >> 8, 0), 255);
+            const int b = std::min(std::max((298 * c + 516 * d + 128) >> 8, 0), 255);
+
+            pixels[y * destw + x] = (r << 16) | (g << 8) | b;
+        }
+    }
+
+    XImage *image = XCreateImage(dpy, DefaultVisual(dpy, ctx->x11_screen), 24, ZPixmap, 0,
+                                 reinterpret_cast<char *>(pixels), destw, desth, 32, destw * 4);
+    if (!image) {
+        free(pixels);
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+    }
+
+    // pixels were written as host-endian words
+    const uint32_t probe = 1;
+    image->byte_order = (*reinterpret_cast<const uint8_t *>(&probe) == 1) ? LSBFirst : MSBFirst;
+
+    GC gc = XCreateGC(dpy, drawable, 0, nullptr);
+    XPutImage(dpy, drawable, gc, image, 0, 0, destx, desty, destw, desth);
+    XFreeGC(dpy, gc);
+    XDestroyImage(image);   // frees pixels too
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+QueryImageFormats(VADriverContextP, VAImageFormat *format_list, int *num_formats)
+{
+    int count = 0;
+
+    for (const auto fourcc: kImageFourccs)
+        format_list[count ++] = image_format(fourcc);
+
+    *num_formats = count;
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+CreateImage(VADriverContextP ctx, VAImageFormat *format, int width, int height, VAImage *image)
+{
+    if (std::find(std::begin(kImageFourccs), std::end(kImageFourccs), format->fourcc) ==
+        std::end(kImageFourccs))
+    {
+        return VA_STATUS_ERROR_INVALID_IMAGE_FORMAT;
+    }
+
+    if (width <= 0 || height <= 0 || width > kMaxDimension || height > kMaxDimension)
+        return VA_STATUS_ERROR_INVALID_PARAMETER;
+
+    fill_image_layout(image, format->fourcc, width, height);
+
+    Buffer buf;
+    buf.type = VAImageBufferType;
+    buf.element_size = image->data_size;
+    buf.num_elements = 1;
+    buf.data = std::make_shared<vector<uint8_t>>(image->data_size);
+    buf.derived_from = VA_INVALID_SURFACE;
+
+    Driver &drv = driver(ctx);
+    std::unique_lock<std::mutex> lock{drv.mtx};
+
+    image->buf = drv.next_id ++;
+    image->image_id = drv.next_id ++;
+    drv.buffers[image->buf] = buf;
+    drv.images[image->image_id] = *image;
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+DeriveImage(VADriverContextP ctx, VASurfaceID surface_id, VAImage *image)
+{
+    Driver &drv = driver(ctx);
+    std::unique_lock<std::mutex> lock{drv.mtx};
+
+    auto it = drv.surfaces.find(surface_id);
+    if (it == drv.surfaces.end())
+        return VA_STATUS_ERROR_INVALID_SURFACE;
+
+    const Surface &surf = it->second;
+    fill_image_layout(image, surf.fourcc, surf.width, surf.height);
+
+    Buffer buf;
+    buf.type = VAImageBufferType;
+    buf.element_size = image->data_size;
+    buf.num_elements = 1;
+    buf.data = surf.data;
+    buf.derived_from = surface_id;
+
+    image->buf = drv.next_id ++;
+    image->image_id = drv.next_id ++;
+    drv.buffers[image->buf] = buf;
+    drv.images[image->image_id] = *image;
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+DestroyImage(VADriverContextP ctx, VAImageID image_id)
+{
+    Driver &drv = driver(ctx);
+    std::unique_lock<std::mutex> lock{drv.mtx};
+
+    auto it = drv.images.find(image_id);
+    if (it == drv.images.end())
+        return VA_STATUS_ERROR_INVALID_IMAGE;
+
+    drv.buffers.erase(it->second.buf);
+    drv.images.erase(it);
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+SetImagePalette(VADriverContextP, VAImageID, unsigned char *)
+{
+    return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+/// copies surface region into image of the same format
+VAStatus
+GetImage(VADriverContextP ctx, VASurfaceID surface_id, int x, int y, unsigned int width,
+         unsigned int height, VAImageID image_id)
+{
+    Driver &drv = driver(ctx);
+    std::unique_lock<std::mutex> lock{drv.mtx};
+
+    const VAStatus status = wait_for_surface(drv, lock, surface_id);
+    if (status != VA_STATUS_SUCCESS)
+        return status;
+
+    auto img_it = drv.images.find(image_id);
+    if (img_it == drv.images.end())
+        return VA_STATUS_ERROR_INVALID_IMAGE;
+
+    Surface &surf = drv.surfaces[surface_id];
+    const VAImage &image = img_it->second;
+
+    if (image.format.fourcc != surf.fourcc)
+        return VA_STATUS_ERROR_UNIMPLEMENTED;
+
+    if (x < 0 || y < 0 || x + width > surf.width || y + height > surf.height ||
+        width > image.width || height > image.height)
+    {
+        return VA_STATUS_ERROR_INVALID_PARAMETER;
+    }
+
+    fill_surface(surf);
+
+    const uint32_t bytes_per_sample = (surf.fourcc == kFourccP010) ? 2 : 1;
+    const auto &src = *surf.data;
+    auto &dst = *drv.buffers[image.buf].data;
+
+    for (uint32_t row = 0; row < height; row ++) {
+        memcpy(&dst[image.offsets[0] + row * image.pitches[0]],
+               &src[(y + row) * surf.pitch + x * bytes_per_sample], width * bytes_per_sample);
+    }
+
+    for (uint32_t row = 0; row < height / 2; row ++) {
+        memcpy(&dst[image.offsets[1] + row * image.pitches[1]],
+               &src[surf.uv_offset + (y / 2 + row) * surf.pitch + (x & ~1) * bytes_per_sample],
+               width * bytes_per_sample);
+    }
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+PutImage(VADriverContextP, VASurfaceID, VAImageID, int, int, unsigned int, unsigned int, int, int,
+         unsigned int, unsigned int)
+{
+    return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+VAStatus
+QuerySubpictureFormats(VADriverContextP, VAImageFormat *, unsigned int *flags,
+                       unsigned int *num_formats)
+{
+    if (flags)
+        *flags = 0;
+
+    *num_formats = 0;
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+CreateSubpicture(VADriverContextP, VAImageID, VASubpictureID *)
+{
+    return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+VAStatus
+DestroySubpicture(VADriverContextP, VASubpictureID)
+{
+    return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+VAStatus
+SetSubpictureImage(VADriverContextP, VASubpictureID, VAImageID)
+{
+    return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+VAStatus
+SetSubpictureChromakey(VADriverContextP, VASubpictureID, unsigned int, unsigned int,
+                       unsigned int)
+{
+    return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+VAStatus
+SetSubpictureGlobalAlpha(VADriverContextP, VASubpictureID, float)
+{
+    return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+VAStatus
+AssociateSubpicture(VADriverContextP, VASubpictureID, VASurfaceID *, int, short, short,
+                    unsigned short, unsigned short, short, short, unsigned short, unsigned short,
+                    unsigned int)
+{
+    return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+VAStatus
+DeassociateSubpicture(VADriverContextP, VASubpictureID, VASurfaceID *, int)
+{
+    return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+VAStatus
+QueryDisplayAttributes(VADriverContextP, VADisplayAttribute *, int *num_attributes)
+{
+    *num_attributes = 0;
+
+    return VA_STATUS_SUCCESS;
+}
+
+VAStatus
+GetDisplayAttributes(VADriverContextP, VADisplayAttribute *, int)
+{
+    return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+VAStatus
+SetDisplayAttributes(VADriverContextP, VADisplayAttribute *, int)
+{
+    return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+VAStatus
+LockSurface(VADriverContextP, VASurfaceID, unsigned int *, unsigned int *, unsigned int *,
+            unsigned int *, unsigned int *, unsigned int *, unsigned int *, unsigned int *,
+            void **)
+{
+    return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+VAStatus
+UnlockSurface(VADriverContextP, VASurfaceID)
+{
+    return VA_STATUS_ERROR_UNIMPLEMENTED;
+}
+
+} // namespace mockva
+
+extern "C"
+__attribute__ ((visibility("default")))
+VAStatus
+MOCKVA_DRIVER_INIT(VADriverContextP ctx);
+
+VAStatus
+MOCKVA_DRIVER_INIT(VADriverContextP ctx)
+{
+    using namespace mockva;
+
+    Driver *drv = new Driver;
+
+    drv->next_id = 1;
+    drv->pictures = 0;
+    drv->submit_latency = latency_from_env("MOCKVA_SUBMIT_LATENCY_US");
+    drv->decode_latency = latency_from_env("MOCKVA_DECODE_LATENCY_US");
+    drv->record = nullptr;
+
+    const char *record_path = getenv("MOCKVA_RECORD");
+    if (record_path) {
+        drv->record = fopen(record_path, "wb");
+        if (!drv->record) {
+            fprintf(stderr, "mockva: can't open %s\n", record_path);
+            delete drv;
+            return VA_STATUS_ERROR_OPERATION_FAILED;
+        }
+
+        write_u32(drv->record, kRecordMagic);
+        write_u32(drv->record, kRecordVersion);
+    }
+
+    ctx->pDriverData = drv;
+    ctx->version_major = VA_MAJOR_VERSION;
+    ctx->version_minor = VA_MINOR_VERSION;
+    ctx->max_profiles = std::end(kProfiles) - std::begin(kProfiles);
+    ctx->max_entrypoints = 1;
+    ctx->max_attributes = 4;
+    ctx->max_image_formats = std::end(kImageFourccs) - std::begin(kImageFourccs);
+    ctx->max_subpic_formats = 1;
+    ctx->max_display_attributes = 1;
+    ctx->str_vendor = "libvdpau-va-gl mock driver";
+
+    VADriverVTable *vt = ctx->vtable;
+
+    vt->vaTerminate = Terminate;
+    vt->vaQueryConfigProfiles = QueryConfigProfiles;
+    vt->vaQueryConfigEntrypoints = QueryConfigEntrypoints;
+    vt->vaGetConfigAttributes = GetConfigAttributes;
+    vt->vaCreateConfig = CreateConfig;
+    vt->vaDestroyConfig = DestroyConfig;
+    vt->vaQueryConfigAttributes = QueryConfigAttributes;
+    vt->vaCreateSurfaces = CreateSurfaces;
+    vt->vaCreateSurfaces2 = CreateSurfaces2;
+    vt->vaDestroySurfaces = DestroySurfaces;
+    vt->vaQuerySurfaceAttributes = QuerySurfaceAttributes;
+    vt->vaCreateContext = CreateContext;
+    vt->vaDestroyContext = DestroyContext;
+    vt->vaCreateBuffer = CreateBuffer;
+    vt->vaBufferSetNumElements = BufferSetNumElements;
+    vt->vaMapBuffer = MapBuffer;
+    vt->vaUnmapBuffer = UnmapBuffer;
+    vt->vaDestroyBuffer = DestroyBuffer;
+    vt->vaBufferInfo = BufferInfo;
+    vt->vaBeginPicture = BeginPicture;
+    vt->vaRenderPicture = RenderPicture;
+    vt->vaEndPicture = EndPicture;
+    vt->vaSyncSurface = SyncSurface;
+    vt->vaQuerySurfaceStatus = QuerySurfaceStatus;
+    vt->vaQuerySurfaceError = QuerySurfaceError;
+    vt->vaPutSurface = PutSurface;
+    vt->vaQueryImageFormats = QueryImageFormats;
+    vt->vaCreateImage = CreateImage;
+    vt->vaDeriveImage = DeriveImage;
+    vt->vaDestroyImage = DestroyImage;
+    vt->vaSetImagePalette = SetImagePalette;
+    vt->vaGetImage = GetImage;
+    vt->vaPutImage = PutImage;
+    vt->vaQuerySubpictureFormats = QuerySubpictureFormats;
+    vt->vaCreateSubpicture = CreateSubpicture;
+    vt->vaDestroySubpicture = DestroySubpicture;
+    vt->vaSetSubpictureImage = SetSubpictureImage;
+    vt->vaSetSubpictureChromakey = SetSubpictureChromakey;
+    vt->vaSetSubpictureGlobalAlpha = SetSubpictureGlobalAlpha;
+    vt->vaAssociateSubpicture = AssociateSubpicture;
+    vt->vaDeassociateSubpicture = DeassociateSubpicture;
+    vt->vaQueryDisplayAttributes = QueryDisplayAttributes;
+    vt->vaGetDisplayAttributes = GetDisplayAttributes;
+    vt->vaSetDisplayAttributes = SetDisplayAttributes;
+    vt->vaLockSurface = LockSurface;
+    vt->vaUnlockSurface = UnlockSurface;
+
+    return VA_STATUS_SUCCESS;
+}
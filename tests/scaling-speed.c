@@ -0,0 +1,105 @@
+// scaling-speed
+//
+// Measures cost of downscaling 2160p video to 720p by video mixer, with plain bilinear
+// filtering and with each of high quality scaling levels. Video mixer waits for GPU to finish
+// before returning, so wall time is a fair estimate of GPU time.
+//
+// usage: scaling-speed [frames]
+
+#include "tests-common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define SRC_WIDTH   3840
+#define SRC_HEIGHT  2160
+#define DST_WIDTH   1280
+#define DST_HEIGHT  720
+
+static double
+elapsed_ms(const struct timespec *t_start, const struct timespec *t_end)
+{
+    return (t_end->tv_sec - t_start->tv_sec) * 1.0e3 +
+           (t_end->tv_nsec - t_start->tv_nsec) / 1.0e6;
+}
+
+static double
+measure(VdpVideoMixer mixer, VdpVideoSurface surface, VdpOutputSurface out_surface,
+        int frame_count)
+{
+    struct timespec t_start, t_end;
+
+    // first frame computes filter weights, keep it out of measurement
+    ASSERT_OK(vdpVideoMixerRender(mixer, VDP_INVALID_HANDLE, NULL,
+                                  VDP_VIDEO_MIXER_PICTURE_STRUCTURE_FRAME, 0, NULL, surface, 0,
+                                  NULL, NULL, out_surface, NULL, NULL, 0, NULL));
+
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    for (int k = 0; k < frame_count; k ++) {
+        ASSERT_OK(vdpVideoMixerRender(mixer, VDP_INVALID_HANDLE, NULL,
+                                      VDP_VIDEO_MIXER_PICTURE_STRUCTURE_FRAME, 0, NULL, surface,
+                                      0, NULL, NULL, out_surface, NULL, NULL, 0, NULL));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+    return elapsed_ms(&t_start, &t_end) / frame_count;
+}
+
+int main(int argc, char *argv[])
+{
+    VdpDevice device = create_vdp_device();
+
+    int frame_count = 100;
+    if (argc >= 2)
+        frame_count = atoi(argv[1]);
+    if (frame_count < 1)
+        frame_count = 1;
+
+    static uint8_t y_plane[SRC_WIDTH * SRC_HEIGHT];
+    static uint8_t uv_plane[SRC_WIDTH * SRC_HEIGHT / 2];
+    for (int y = 0; y < SRC_HEIGHT; y ++)
+        for (int x = 0; x < SRC_WIDTH; x ++)
+            y_plane[y * SRC_WIDTH + x] = ((x / 2) ^ (y / 2)) & 1 ? 235 : 16;
+    memset(uv_plane, 128, sizeof(uv_plane));
+
+    const void * const planes[] = { y_plane, uv_plane };
+    const uint32_t pitches[] = { SRC_WIDTH, SRC_WIDTH };
+
+    VdpVideoSurface surface;
+    ASSERT_OK(vdpVideoSurfaceCreate(device, VDP_CHROMA_TYPE_420, SRC_WIDTH, SRC_HEIGHT,
+                                    &surface));
+    ASSERT_OK(vdpVideoSurfacePutBitsYCbCr(surface, VDP_YCBCR_FORMAT_NV12, planes, pitches));
+
+    VdpOutputSurface out_surface;
+    ASSERT_OK(vdpOutputSurfaceCreate(device, VDP_RGBA_FORMAT_B8G8R8A8, DST_WIDTH, DST_HEIGHT,
+                                     &out_surface));
+
+    VdpVideoMixerFeature features[9];
+    for (int k = 0; k < 9; k ++)
+        features[k] = VDP_VIDEO_MIXER_FEATURE_HIGH_QUALITY_SCALING_L1 + k;
+
+    VdpVideoMixer mixer;
+    ASSERT_OK(vdpVideoMixerCreate(device, 9, features, 0, NULL, NULL, &mixer));
+
+    printf("%d frames, %dx%d to %dx%d\n", frame_count, SRC_WIDTH, SRC_HEIGHT, DST_WIDTH,
+           DST_HEIGHT);
+    printf("bilinear: %.3f ms per frame\n", measure(mixer, surface, out_surface, frame_count));
+
+    for (int level = 1; level <= 9; level ++) {
+        VdpBool enables[9];
+        for (int k = 0; k < 9; k ++)
+            enables[k] = (k == level - 1) ? VDP_TRUE : VDP_FALSE;
+        ASSERT_OK(vdpVideoMixerSetFeatureEnables(mixer, 9, features, enables));
+
+        printf("L%d:       %.3f ms per frame\n", level,
+               measure(mixer, surface, out_surface, frame_count));
+    }
+
+    ASSERT_OK(vdpVideoMixerDestroy(mixer));
+    ASSERT_OK(vdpOutputSurfaceDestroy(out_surface));
+    ASSERT_OK(vdpVideoSurfaceDestroy(surface));
+    ASSERT_OK(vdpDeviceDestroy(device));
+    return 0;
+}
@@ -0,0 +1,163 @@
+// subtitle-speed
+//
+// Measures subtitle-like rendering: each frame draws a few hundred glyphs from an A8 atlas
+// onto an output surface, one RenderBitmapSurface call per glyph, then reads a pixel back,
+// as if the frame was handed to the mixer or presentation queue. For comparison, the same is
+// done with a read back after every glyph, which defeats batching of draws. The last run draws
+// from separate small bitmap surfaces, one per glyph, as simpler renderers do.
+//
+// usage: subtitle-speed [frames] [glyphs-per-frame]
+
+#include "tests-common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define DST_WIDTH       1920
+#define DST_HEIGHT      1080
+#define ATLAS_SIZE      512
+#define GLYPH_WIDTH     24
+#define GLYPH_HEIGHT    32
+#define LINE_GLYPHS     60
+#define GLYPH_BITMAPS   64
+
+static double
+elapsed_us(const struct timespec *t_start, const struct timespec *t_end)
+{
+    return (t_end->tv_sec - t_start->tv_sec) * 1.0e6 +
+           (t_end->tv_nsec - t_start->tv_nsec) / 1.0e3;
+}
+
+static void
+glyph_rects(int k, VdpRect *src_rect, VdpRect *dst_rect)
+{
+    const int per_row = ATLAS_SIZE / GLYPH_WIDTH;
+    const int glyph = (k * 7) % (per_row * (ATLAS_SIZE / GLYPH_HEIGHT));
+
+    src_rect->x0 = (glyph % per_row) * GLYPH_WIDTH;
+    src_rect->y0 = (glyph / per_row) * GLYPH_HEIGHT;
+    src_rect->x1 = src_rect->x0 + GLYPH_WIDTH;
+    src_rect->y1 = src_rect->y0 + GLYPH_HEIGHT;
+
+    dst_rect->x0 = 100 + (k % LINE_GLYPHS) * GLYPH_WIDTH;
+    dst_rect->y0 = DST_HEIGHT - 100 - (k / LINE_GLYPHS + 1) * GLYPH_HEIGHT;
+    dst_rect->x1 = dst_rect->x0 + GLYPH_WIDTH;
+    dst_rect->y1 = dst_rect->y0 + GLYPH_HEIGHT;
+}
+
+int main(int argc, char *argv[])
+{
+    VdpDevice device = create_vdp_device();
+    struct timespec t_start, t_end;
+
+    int frames = 100;
+    if (argc >= 2)
+        frames = atoi(argv[1]);
+    if (frames < 1)
+        frames = 1;
+
+    int glyphs = 300;
+    if (argc >= 3)
+        glyphs = atoi(argv[2]);
+    if (glyphs < 1)
+        glyphs = 1;
+    if (glyphs > LINE_GLYPHS * 20)
+        glyphs = LINE_GLYPHS * 20;
+
+    VdpOutputSurface dst_surface;
+    ASSERT_OK(vdpOutputSurfaceCreate(device, VDP_RGBA_FORMAT_B8G8R8A8, DST_WIDTH, DST_HEIGHT,
+                                     &dst_surface));
+
+    VdpBitmapSurface atlas;
+    ASSERT_OK(vdpBitmapSurfaceCreate(device, VDP_RGBA_FORMAT_A8, ATLAS_SIZE, ATLAS_SIZE, 0,
+                                     &atlas));
+    static uint8_t atlas_data[ATLAS_SIZE * ATLAS_SIZE];
+    for (int k = 0; k < ATLAS_SIZE * ATLAS_SIZE; k ++)
+        atlas_data[k] = (k * 13) & 0xff;
+    const void * const atlas_planes[] = { atlas_data };
+    const uint32_t atlas_pitches[] = { ATLAS_SIZE };
+    ASSERT_OK(vdpBitmapSurfacePutBitsNative(atlas, atlas_planes, atlas_pitches, NULL));
+
+    VdpBitmapSurface glyph_bitmaps[GLYPH_BITMAPS];
+    const uint32_t glyph_pitches[] = { ATLAS_SIZE };
+    for (int k = 0; k < GLYPH_BITMAPS; k ++) {
+        ASSERT_OK(vdpBitmapSurfaceCreate(device, VDP_RGBA_FORMAT_A8, GLYPH_WIDTH, GLYPH_HEIGHT,
+                                         0, &glyph_bitmaps[k]));
+        const void * const glyph_planes[] = { atlas_data + k * GLYPH_WIDTH };
+        ASSERT_OK(vdpBitmapSurfacePutBitsNative(glyph_bitmaps[k], glyph_planes, glyph_pitches,
+                                                NULL));
+    }
+
+    const VdpOutputSurfaceRenderBlendState blend_state = {
+        .struct_version =                   VDP_OUTPUT_SURFACE_RENDER_BLEND_STATE_VERSION,
+        .blend_factor_source_color =        VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_SRC_ALPHA,
+        .blend_factor_destination_color =
+            VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .blend_factor_source_alpha =        VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE,
+        .blend_factor_destination_alpha =
+            VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .blend_equation_color =             VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_ADD,
+        .blend_equation_alpha =             VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_ADD,
+        .blend_constant =                   {0, 0, 0, 0},
+    };
+    const VdpColor color = {1.0f, 1.0f, 1.0f, 1.0f};
+
+    const VdpRect pixel_rect = {0, 0, 1, 1};
+    uint32_t pixel;
+    void * const pixel_data[] = { &pixel };
+    const uint32_t pixel_pitches[] = { sizeof(pixel) };
+
+    printf("%d frames, %d glyphs per frame\n", frames, glyphs);
+
+    for (int batched = 0; batched <= 1; batched ++) {
+        clock_gettime(CLOCK_MONOTONIC, &t_start);
+        for (int f = 0; f < frames; f ++) {
+            for (int k = 0; k < glyphs; k ++) {
+                VdpRect src_rect, dst_rect;
+                glyph_rects(k, &src_rect, &dst_rect);
+                ASSERT_OK(vdpOutputSurfaceRenderBitmapSurface(dst_surface, &dst_rect, atlas,
+                                                              &src_rect, &color, &blend_state,
+                                                              0));
+                if (!batched) {
+                    ASSERT_OK(vdpOutputSurfaceGetBitsNative(dst_surface, &pixel_rect,
+                                                            pixel_data, pixel_pitches));
+                }
+            }
+            ASSERT_OK(vdpOutputSurfaceGetBitsNative(dst_surface, &pixel_rect, pixel_data,
+                                                    pixel_pitches));
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+        const double us = elapsed_us(&t_start, &t_end);
+        printf("%s: %.1f us per frame, %.2f us per glyph\n",
+               batched ? "read back per frame" : "read back per glyph",
+               us / frames, us / frames / glyphs);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    for (int f = 0; f < frames; f ++) {
+        for (int k = 0; k < glyphs; k ++) {
+            VdpRect src_rect, dst_rect;
+            glyph_rects(k, &src_rect, &dst_rect);
+            ASSERT_OK(vdpOutputSurfaceRenderBitmapSurface(dst_surface, &dst_rect,
+                                                          glyph_bitmaps[k % GLYPH_BITMAPS],
+                                                          NULL, &color, &blend_state, 0));
+        }
+        ASSERT_OK(vdpOutputSurfaceGetBitsNative(dst_surface, &pixel_rect, pixel_data,
+                                                pixel_pitches));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+    const double us = elapsed_us(&t_start, &t_end);
+    printf("separate glyph bitmaps: %.1f us per frame, %.2f us per glyph\n", us / frames,
+           us / frames / glyphs);
+
+    for (int k = 0; k < GLYPH_BITMAPS; k ++)
+        ASSERT_OK(vdpBitmapSurfaceDestroy(glyph_bitmaps[k]));
+    ASSERT_OK(vdpBitmapSurfaceDestroy(atlas));
+    ASSERT_OK(vdpOutputSurfaceDestroy(dst_surface));
+    ASSERT_OK(vdpDeviceDestroy(device));
+    return 0;
+}
@@ -152,6 +152,35 @@ test_navigating_to_nal_element_2()
     assert(b == 0xa3);
 }
 
+static
+void
+test_bounded_view()
+{
+    const vector<uint8_t> buf{0x00, 0x00, 0x01, 0xa3, 0x43, 0x00, 0x00, 0x01, 0xff};
+
+    // view covers only the second and third bytes after the first start code
+    vdp::RBSPState st{buf.data() + 3, 2};
+
+    assert(st.get_u(8) == 0xa3);
+    assert(st.get_u(8) == 0x43);
+    assert(st.bits_eaten() == 16);
+
+    bool thrown = false;
+    try {
+        st.get_u(1);
+    } catch (const vdp::RBSPState::error &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // copies are independent
+    vdp::RBSPState st_a{buf.data() + 3, 2};
+    st_a.get_u(4);
+    vdp::RBSPState st_b{st_a};
+    assert(st_a.get_u(4) == 0x3);
+    assert(st_b.get_u(4) == 0x3);
+}
+
 int
 main()
 {
@@ -166,5 +195,7 @@ main()
     test_navigating_to_nal_element_1();
     test_navigating_to_nal_element_2();
 
+    test_bounded_view();
+
     printf("pass\n");
 }
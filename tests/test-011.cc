@@ -0,0 +1,151 @@
+// MPEG-2 picture translation. No VA driver is involved, fake surface ids stand in for
+// VA surfaces, and buffers are checked field by field.
+
+#undef NDEBUG
+#include <stdio.h>
+#include <assert.h>
+#include <vector>
+#include "../src/mpeg2-parse.hh"
+
+
+using std::vector;
+
+static
+VdpPictureInfoMPEG1Or2
+make_b_field_picture()
+{
+    VdpPictureInfoMPEG1Or2 pi = {};
+
+    pi.forward_reference =          5;
+    pi.backward_reference =         6;
+    pi.slice_count =                2;
+    pi.picture_structure =          2;  // bottom field
+    pi.picture_coding_type =        3;  // B
+    pi.intra_dc_precision =         2;
+    pi.frame_pred_frame_dct =       0;
+    pi.concealment_motion_vectors = 1;
+    pi.intra_vlc_format =           1;
+    pi.alternate_scan =             1;
+    pi.q_scale_type =               1;
+    pi.top_field_first =            0;
+    pi.f_code[0][0] = 1;  pi.f_code[0][1] = 2;
+    pi.f_code[1][0] = 3;  pi.f_code[1][1] = 4;
+
+    for (int k = 0; k < 64; k ++) {
+        pi.intra_quantizer_matrix[k] = k;
+        pi.non_intra_quantizer_matrix[k] = 100 + k;
+    }
+
+    return pi;
+}
+
+static
+void
+test_pic_param()
+{
+    const auto pi = make_b_field_picture();
+    VAPictureParameterBufferMPEG2 pp = {};
+
+    vdp::mpeg2_translate_pic_param(&pp, 720, 576, &pi, 0x101, 0x102, false);
+
+    assert(pp.horizontal_size == 720);
+    assert(pp.vertical_size == 576);
+    assert(pp.forward_reference_picture == 0x101);
+    assert(pp.backward_reference_picture == 0x102);
+    assert(pp.picture_coding_type == 3);
+    assert(pp.f_code == 0x1234);
+
+    const auto &b = pp.picture_coding_extension.bits;
+    assert(b.intra_dc_precision == 2);
+    assert(b.picture_structure == 2);
+    assert(b.top_field_first == 0);
+    assert(b.frame_pred_frame_dct == 0);
+    assert(b.concealment_motion_vectors == 1);
+    assert(b.q_scale_type == 1);
+    assert(b.intra_vlc_format == 1);
+    assert(b.alternate_scan == 1);
+    assert(b.repeat_first_field == 0);
+    assert(b.progressive_frame == 0);
+    assert(b.is_first_field == 0);
+}
+
+static
+void
+test_iq_matrix()
+{
+    const auto pi = make_b_field_picture();
+    VAIQMatrixBufferMPEG2 iq = {};
+
+    vdp::mpeg2_translate_iq_matrix(&iq, &pi);
+
+    assert(iq.load_intra_quantiser_matrix == 1);
+    assert(iq.load_non_intra_quantiser_matrix == 1);
+    assert(iq.load_chroma_intra_quantiser_matrix == 0);
+    assert(iq.load_chroma_non_intra_quantiser_matrix == 0);
+
+    // raster order in, zig-zag order out
+    const uint8_t expected_head[] = {0, 1, 8, 16, 9, 2, 3, 10};
+    for (int k = 0; k < 8; k ++) {
+        assert(iq.intra_quantiser_matrix[k] == expected_head[k]);
+        assert(iq.non_intra_quantiser_matrix[k] == 100 + expected_head[k]);
+    }
+
+    assert(iq.intra_quantiser_matrix[63] == 63);
+}
+
+static
+void
+test_slices()
+{
+    const vector<uint8_t> bitstream{
+        // slice 1: row 4, quantiser_scale_code 10, macroblock_address_increment 2
+        0x00, 0x00, 0x01, 0x05, 0x51, 0x80, 0xaa,
+        // slice 2: row 5, quantiser_scale_code 1, intra slice, macroblock_address_increment 1
+        0x00, 0x00, 0x01, 0x06, 0x0e, 0x01, 0x80, 0x55, 0x55,
+        // not a slice start code (sequence end), ends the search
+        0x00, 0x00, 0x01, 0xb7,
+    };
+
+    const auto offsets = vdp::mpeg2_find_slices(bitstream.data(), bitstream.size());
+    assert(offsets.size() == 2);
+    assert(offsets[0] == 0);
+    assert(offsets[1] == 7);
+
+    VASliceParameterBufferMPEG2 sp = {};
+    bool ok;
+
+    ok = vdp::mpeg2_parse_slice_header(bitstream.data(), 7, 576, &sp);
+    assert(ok);
+    assert(sp.slice_data_size == 7);
+    assert(sp.slice_data_offset == 0);
+    assert(sp.slice_data_flag == VA_SLICE_DATA_FLAG_ALL);
+    assert(sp.macroblock_offset == 38);
+    assert(sp.slice_horizontal_position == 1);
+    assert(sp.slice_vertical_position == 4);
+    assert(sp.quantiser_scale_code == 10);
+    assert(sp.intra_slice_flag == 0);
+
+    ok = vdp::mpeg2_parse_slice_header(bitstream.data() + 7, 9, 576, &sp);
+    assert(ok);
+    assert(sp.slice_data_size == 9);
+    assert(sp.macroblock_offset == 47);
+    assert(sp.slice_horizontal_position == 0);
+    assert(sp.slice_vertical_position == 5);
+    assert(sp.quantiser_scale_code == 1);
+    assert(sp.intra_slice_flag == 1);
+
+    // header cut before the first macroblock
+    ok = vdp::mpeg2_parse_slice_header(bitstream.data(), 4, 576, &sp);
+    assert(!ok);
+}
+
+int
+main()
+{
+    test_pic_param();
+    test_iq_matrix();
+    test_slices();
+
+    printf("pass\n");
+    return 0;
+}
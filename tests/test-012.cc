@@ -0,0 +1,178 @@
+// VC-1 picture header parsing. Bitstreams are hand-made, fake surface ids stand in for
+// VA surfaces, and parameters are checked field by field.
+
+#undef NDEBUG
+#include <stdio.h>
+#include <assert.h>
+#include <string>
+#include <vector>
+#include "../src/vc1-parse.hh"
+
+
+using std::vector;
+
+// packs string of '0' and '1' into bytes, padding with zeros. Spaces are ignored
+static
+vector<uint8_t>
+bits(const char *s)
+{
+    vector<uint8_t> res;
+    int n = 0;
+
+    for (; *s; s ++) {
+        if (*s == ' ')
+            continue;
+
+        if (n % 8 == 0)
+            res.push_back(0);
+
+        if (*s == '1')
+            res.back() |= 0x80 >> (n % 8);
+
+        n ++;
+    }
+
+    return res;
+}
+
+static
+void
+test_main_profile_p_picture()
+{
+    VdpPictureInfoVC1 pi = {};
+    pi.slice_count =    1;
+    pi.vstransform =    1;
+    pi.forward_reference = 3;
+
+    // FRMCNT, PTYPE P, PQINDEX 5, HALFQP, MVMODE 1MV, SKIPMB rowskip bitplane (first
+    // macroblock skipped), MVTAB 2, CBPTAB 1, TTMBF, TTFRM 3, TRANSACFRM 1, TRANSDCTAB
+    auto data = bits("00 1 00101 0 1 0 010 110 0 10 01 1 11 10 1");
+    data.push_back(0x55);
+
+    VAPictureParameterBufferVC1 pp;
+    vector<uint8_t> bitplane;
+    vector<vdp::VC1Slice> slices;
+    uint8_t rnd = 0;
+    bool ok;
+
+    ok = vdp::vc1_translate_picture(&pi, vdp::VC1_PROFILE_MAIN, 32, 32, 0x101,
+                                    VA_INVALID_SURFACE, data.data(), data.size(), &rnd, &pp,
+                                    &bitplane, &slices);
+    assert(ok);
+    assert(pp.forward_reference_picture == 0x101);
+    assert(pp.backward_reference_picture == VA_INVALID_SURFACE);
+    assert(pp.sequence_fields.bits.profile == vdp::VC1_PROFILE_MAIN);
+    assert(pp.coded_width == 32);
+    assert(pp.picture_fields.bits.picture_type == 1);
+    assert(pp.rounding_control == 1);
+    assert(pp.pic_quantizer_fields.bits.pic_quantizer_scale == 5);
+    assert(pp.pic_quantizer_fields.bits.pic_quantizer_type == 1);
+    assert(pp.pic_quantizer_fields.bits.half_qp == 0);
+    assert(pp.mv_fields.bits.mv_mode == VAMvMode1Mv);
+    assert(pp.mv_fields.bits.mv_table == 2);
+    assert(pp.cbp_table == 1);
+    assert(pp.bitplane_present.flags.bp_skip_mb == 1);
+    assert(pp.bitplane_present.flags.bp_mv_type_mb == 0);
+    assert(pp.raw_coding.flags.skip_mb == 0);
+    assert(pp.transform_fields.bits.mb_level_transform_type_flag == 1);
+    assert(pp.transform_fields.bits.frame_level_transform_type == 3);
+    assert(pp.transform_fields.bits.transform_ac_codingset_idx1 == 1);
+    assert(pp.transform_fields.bits.intra_transform_dc_table == 1);
+
+    // nibble per macroblock, skip flag in bit 1
+    assert(bitplane.size() == 2);
+    assert(bitplane[0] == 0x20);
+    assert(bitplane[1] == 0x00);
+
+    assert(slices.size() == 1);
+    assert(slices[0].offset == 0);
+    assert(slices[0].param.slice_data_size == data.size());
+    assert(slices[0].param.macroblock_offset == 28);
+
+    // rounding control toggles on each P picture
+    ok = vdp::vc1_translate_picture(&pi, vdp::VC1_PROFILE_MAIN, 32, 32, 0x101,
+                                    VA_INVALID_SURFACE, data.data(), data.size(), &rnd, &pp,
+                                    &bitplane, &slices);
+    assert(ok);
+    assert(pp.rounding_control == 0);
+}
+
+static
+void
+test_advanced_profile_i_picture()
+{
+    VdpPictureInfoVC1 pi = {};
+    pi.slice_count =    2;
+    pi.quantizer =      3;      // uniform
+    pi.overlap =        1;
+
+    // PTYPE I, RNDCTRL, PQINDEX 4, HALFQP, ACPRED inverted norm-2 bitplane, CONDOVER 2,
+    // OVERFLAGS colskip bitplane (right column set), TRANSACFRM 0, TRANSACFRM2 1, TRANSDCTAB
+    const char *header = "110 1 00100 1 1 10 0 101 11 0 011 0 1 1 1 0 10 0";
+
+    vector<uint8_t> data{0x00, 0x00, 0x01, 0x0d};
+    const auto header_bytes = bits(header);
+    data.insert(data.end(), header_bytes.begin(), header_bytes.end());
+    data.insert(data.end(), {0xaa, 0x55});
+
+    // second slice starts at macroblock row 1 and repeats picture header
+    data.insert(data.end(), {0x00, 0x00, 0x01, 0x0b});
+    const auto slice_bytes = bits((std::string("000000001 1 ") + header).c_str());
+    data.insert(data.end(), slice_bytes.begin(), slice_bytes.end());
+    data.push_back(0x55);
+
+    VAPictureParameterBufferVC1 pp;
+    vector<uint8_t> bitplane;
+    vector<vdp::VC1Slice> slices;
+    uint8_t rnd = 0;
+    bool ok;
+
+    ok = vdp::vc1_translate_picture(&pi, vdp::VC1_PROFILE_ADVANCED, 32, 32, VA_INVALID_SURFACE,
+                                    VA_INVALID_SURFACE, data.data(), data.size(), &rnd, &pp,
+                                    &bitplane, &slices);
+    assert(ok);
+    assert(pp.sequence_fields.bits.profile == vdp::VC1_PROFILE_ADVANCED);
+    assert(pp.picture_fields.bits.picture_type == 0);
+    assert(pp.rounding_control == 1);
+    assert(pp.pic_quantizer_fields.bits.pic_quantizer_scale == 4);
+    assert(pp.pic_quantizer_fields.bits.pic_quantizer_type == 1);
+    assert(pp.pic_quantizer_fields.bits.half_qp == 1);
+    assert(pp.conditional_overlap_flag == 2);
+    assert(pp.bitplane_present.flags.bp_ac_pred == 1);
+    assert(pp.bitplane_present.flags.bp_overflags == 1);
+    assert(pp.transform_fields.bits.transform_ac_codingset_idx1 == 0);
+    assert(pp.transform_fields.bits.transform_ac_codingset_idx2 == 1);
+    assert(pp.transform_fields.bits.intra_transform_dc_table == 0);
+
+    // AC prediction in bit 1, overlap flags in bit 2
+    assert(bitplane.size() == 2);
+    assert(bitplane[0] == 0x26);
+    assert(bitplane[1] == 0x24);
+
+    assert(slices.size() == 2);
+    assert(slices[0].offset == 4);
+    assert(slices[0].param.slice_data_size == 6);
+    assert(slices[0].param.macroblock_offset == 31);
+    assert(slices[0].param.slice_vertical_position == 0);
+    assert(slices[1].offset == 14);
+    assert(slices[1].param.slice_data_size == 7);
+    assert(slices[1].param.macroblock_offset == 41);
+    assert(slices[1].param.slice_vertical_position == 1);
+
+    // interlaced field pictures are not handled
+    pi.frame_coding_mode = 3;
+    ok = vdp::vc1_translate_picture(&pi, vdp::VC1_PROFILE_ADVANCED, 32, 32, VA_INVALID_SURFACE,
+                                    VA_INVALID_SURFACE, data.data(), data.size(), &rnd, &pp,
+                                    &bitplane, &slices);
+    assert(!ok);
+}
+
+int
+main()
+{
+    test_main_profile_p_picture();
+    test_advanced_profile_i_picture();
+
+    printf("pass\n");
+    return 0;
+}
@@ -0,0 +1,263 @@
+// HEVC slice segment header parsing and picture translation. Bitstreams are hand-made, fake
+// surface ids stand in for VA surfaces.
+
+#undef NDEBUG
+#include <stdio.h>
+#include <assert.h>
+#include <vector>
+#include "../src/hevc-parse.hh"
+
+
+using std::vector;
+
+// packs string of '0' and '1' into bytes, padding with zeros. Spaces are ignored
+static
+vector<uint8_t>
+bits(const char *s)
+{
+    vector<uint8_t> res;
+    int n = 0;
+
+    for (; *s; s ++) {
+        if (*s == ' ')
+            continue;
+
+        if (n % 8 == 0)
+            res.push_back(0);
+
+        if (*s == '1')
+            res.back() |= 0x80 >> (n % 8);
+
+        n ++;
+    }
+
+    return res;
+}
+
+static
+VdpPictureInfoHEVC
+make_picture_info()
+{
+    VdpPictureInfoHEVC pi = {};
+
+    // 64x64 picture of 16x16 coding tree blocks, 16 blocks in total
+    pi.chroma_format_idc =                          1;
+    pi.pic_width_in_luma_samples =                  64;
+    pi.pic_height_in_luma_samples =                 64;
+    pi.log2_min_luma_coding_block_size_minus3 =     0;
+    pi.log2_diff_max_min_luma_coding_block_size =   1;
+    pi.log2_max_pic_order_cnt_lsb_minus4 =          4;
+    pi.num_short_term_ref_pic_sets =                1;
+    pi.lists_modification_present_flag =            1;
+    pi.pps_deblocking_filter_disabled_flag =        1;
+    pi.pps_beta_offset_div2 =                       2;
+    pi.NumShortTermPictureSliceHeaderBits =         14;
+
+    for (int k = 0; k < 16; k ++)
+        pi.RefPics[k] = VDP_INVALID_HANDLE;
+
+    pi.RefPics[3] = 10;
+    pi.PicOrderCntVal[3] = 7;
+    pi.RefPics[5] = 11;
+    pi.PicOrderCntVal[5] = 2;
+    pi.IsLongTerm[5] = 1;
+
+    pi.NumPocTotalCurr = 2;
+    pi.NumPocStCurrBefore = 1;
+    pi.RefPicSetStCurrBefore[0] = 3;
+    pi.NumPocLtCurr = 1;
+    pi.RefPicSetLtCurr[0] = 5;
+
+    return pi;
+}
+
+static
+void
+test_pic_param()
+{
+    const auto pi = make_picture_info();
+    VASurfaceID refs[16];
+
+    for (int k = 0; k < 16; k ++)
+        refs[k] = VA_INVALID_SURFACE;
+    refs[3] = 0x103;
+    refs[5] = 0x105;
+
+    VAPictureParameterBufferHEVC pp;
+    vdp::hevc_translate_pic_param(&pp, &pi, 0x100, refs);
+
+    assert(pp.CurrPic.picture_id == 0x100);
+    assert(pp.pic_width_in_luma_samples == 64);
+    assert(pp.pic_fields.bits.chroma_format_idc == 1);
+    assert(pp.st_rps_bits == 14);
+
+    assert(pp.ReferenceFrames[0].picture_id == VA_INVALID_SURFACE);
+    assert(pp.ReferenceFrames[0].flags == VA_PICTURE_HEVC_INVALID);
+    assert(pp.ReferenceFrames[3].picture_id == 0x103);
+    assert(pp.ReferenceFrames[3].pic_order_cnt == 7);
+    assert(pp.ReferenceFrames[3].flags == VA_PICTURE_HEVC_RPS_ST_CURR_BEFORE);
+    assert(pp.ReferenceFrames[5].picture_id == 0x105);
+    assert(pp.ReferenceFrames[5].flags ==
+           (VA_PICTURE_HEVC_LONG_TERM_REFERENCE | VA_PICTURE_HEVC_RPS_LT_CURR));
+}
+
+static
+void
+test_idr_slice()
+{
+    const auto pi = make_picture_info();
+
+    // NAL header (IDR_W_RADL), first_slice_segment_in_pic_flag, no_output_of_prior_pics_flag,
+    // slice_pic_parameter_set_id 0, slice_type I, slice_qp_delta +3, alignment
+    const auto data = bits("0 010011 000000 001  1 0 1 011 00110 1");
+
+    assert(vdp::hevc_is_slice_nal_unit(data.data(), data.size()));
+
+    VASliceParameterBufferHEVC sp;
+    const bool ok = vdp::hevc_parse_slice_header(data.data(), data.size(), &pi, nullptr, &sp);
+
+    assert(ok);
+    assert(sp.slice_data_size == data.size());
+    assert(sp.slice_data_byte_offset == 4);
+    assert(sp.slice_segment_address == 0);
+    assert(sp.LongSliceFlags.fields.slice_type == 2);
+    assert(sp.LongSliceFlags.fields.slice_deblocking_filter_disabled_flag == 1);
+    assert(sp.slice_beta_offset_div2 == 2);
+    assert(sp.slice_qp_delta == 3);
+    assert(sp.collocated_ref_idx == 0xff);
+    assert(sp.RefPicList[0][0] == 0xff);
+    assert(sp.RefPicList[1][0] == 0xff);
+}
+
+static
+void
+test_p_slice_and_dependent_segment()
+{
+    auto pi = make_picture_info();
+
+    // NAL header (TRAIL_R), first_slice_segment_in_pic_flag, slice_pic_parameter_set_id 0,
+    // slice_segment_address 4, slice_type P, slice_pic_order_cnt_lsb, st_ref_pic_set in
+    // slice header, num_ref_idx_active_override_flag with two references, list modification
+    // swapping them, five_minus_max_num_merge_cand, slice_qp_delta -2, alignment
+    auto data = bits("0 000001 000000 001  0 1 0100 010 00000000 0 00000000000000 1 010 "
+                     "1 1 0 1 00101 1");
+
+    // long run of zeros in the header needs emulation prevention byte
+    assert(data[3] == 0x00 && data[4] == 0x00 && data[5] == 0x00);
+    data.insert(data.begin() + 5, 0x03);
+
+    VASliceParameterBufferHEVC sp;
+    bool ok = vdp::hevc_parse_slice_header(data.data(), data.size(), &pi, nullptr, &sp);
+
+    assert(ok);
+    assert(sp.slice_data_byte_offset == 9);
+    assert(sp.slice_segment_address == 4);
+    assert(sp.LongSliceFlags.fields.slice_type == 1);
+    assert(sp.LongSliceFlags.fields.dependent_slice_segment_flag == 0);
+    assert(sp.num_ref_idx_l0_active_minus1 == 1);
+    assert(sp.num_ref_idx_l1_active_minus1 == 0);
+    assert(sp.RefPicList[0][0] == 5);
+    assert(sp.RefPicList[0][1] == 3);
+    assert(sp.RefPicList[0][2] == 0xff);
+    assert(sp.RefPicList[1][0] == 0xff);
+    assert(sp.five_minus_max_num_merge_cand == 0);
+    assert(sp.slice_qp_delta == -2);
+
+    // dependent slice segment at address 5 takes everything else from the previous one
+    pi.dependent_slice_segments_enabled_flag = 1;
+    const auto dep_data = bits("0 000001 000000 001  0 1 1 0101 1");
+    VASliceParameterBufferHEVC dep_sp;
+
+    ok = vdp::hevc_parse_slice_header(dep_data.data(), dep_data.size(), &pi, &sp, &dep_sp);
+    assert(ok);
+    assert(dep_sp.slice_data_size == dep_data.size());
+    assert(dep_sp.slice_data_byte_offset == 3);
+    assert(dep_sp.slice_segment_address == 5);
+    assert(dep_sp.LongSliceFlags.fields.dependent_slice_segment_flag == 1);
+    assert(dep_sp.LongSliceFlags.fields.slice_type == 1);
+    assert(dep_sp.RefPicList[0][0] == 5);
+    assert(dep_sp.slice_qp_delta == -2);
+
+    // and can't go first
+    ok = vdp::hevc_parse_slice_header(dep_data.data(), dep_data.size(), &pi, nullptr, &dep_sp);
+    assert(!ok);
+}
+
+static
+void
+test_empty_reference_sets()
+{
+    auto pi = make_picture_info();
+
+    // NumPocTotalCurr claims references, but none of the sets has any
+    pi.NumPocStCurrBefore = 0;
+    pi.NumPocLtCurr = 0;
+
+    // the same P slice as in test_p_slice_and_dependent_segment()
+    auto data = bits("0 000001 000000 001  0 1 0100 010 00000000 0 00000000000000 1 010 "
+                     "1 1 0 1 00101 1");
+    data.insert(data.begin() + 5, 0x03);
+
+    VASliceParameterBufferHEVC sp;
+    const bool ok = vdp::hevc_parse_slice_header(data.data(), data.size(), &pi, nullptr, &sp);
+    assert(!ok);
+}
+
+static
+void
+test_iq_matrix()
+{
+    auto pi = make_picture_info();
+
+    // VDPAU lists are in up-right diagonal scan order, so n-th value goes to n-th scan position
+    for (int k = 0; k < 16; k ++)
+        pi.ScalingList4x4[1][k] = k + 1;
+    for (int k = 0; k < 64; k ++) {
+        pi.ScalingList8x8[2][k] = k + 1;
+        pi.ScalingList16x16[3][k] = k + 1;
+        pi.ScalingList32x32[1][k] = k + 1;
+    }
+    pi.ScalingListDCCoeff16x16[3] = 20;
+    pi.ScalingListDCCoeff32x32[1] = 30;
+
+    VAIQMatrixBufferHEVC iq;
+    vdp::hevc_translate_iq_matrix(&iq, &pi);
+
+    // 4x4 scan goes (0,0), (0,1), (1,0), (0,2), ... in (x,y) pairs, and ends at (3,3)
+    assert(iq.ScalingList4x4[1][0] == 1);
+    assert(iq.ScalingList4x4[1][4] == 2);
+    assert(iq.ScalingList4x4[1][1] == 3);
+    assert(iq.ScalingList4x4[1][8] == 4);
+    assert(iq.ScalingList4x4[1][3] == 10);
+    assert(iq.ScalingList4x4[1][12] == 7);
+    assert(iq.ScalingList4x4[1][15] == 16);
+
+    // larger lists follow 8x8 scan, which goes down the first column before the first row
+    for (const auto *list: {iq.ScalingList8x8[2], iq.ScalingList16x16[3],
+                            iq.ScalingList32x32[1]})
+    {
+        assert(list[0] == 1);
+        assert(list[8] == 2);
+        assert(list[1] == 3);
+        assert(list[16] == 4);
+        assert(list[7] == 36);
+        assert(list[56] == 29);
+        assert(list[63] == 64);
+    }
+
+    assert(iq.ScalingListDC16x16[3] == 20);
+    assert(iq.ScalingListDC32x32[1] == 30);
+}
+
+int
+main()
+{
+    test_pic_param();
+    test_idr_slice();
+    test_p_slice_and_dependent_segment();
+    test_empty_reference_sets();
+    test_iq_matrix();
+
+    printf("pass\n");
+    return 0;
+}
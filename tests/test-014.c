@@ -0,0 +1,79 @@
+// test-014
+//
+// Decoding through mock VA-API driver, tests/mock-va-driver.cc. Single MPEG-2 picture is decoded
+// into a video surface, which is then read back.
+//
+// Mock driver fills decoded surfaces with luma gradient (x + y + picture number) & 0xff and
+// neutral chroma. This is the first picture, so its number is 1.
+
+#include "tests-common.h"
+#include <stdio.h>
+#include <string.h>
+
+
+int main(void)
+{
+    const uint32_t width = 64;
+    const uint32_t height = 32;
+    VdpDevice device = create_vdp_device();
+    VdpDecoder decoder;
+    VdpVideoSurface surface;
+
+    ASSERT_OK(vdpDecoderCreate(device, VDP_DECODER_PROFILE_MPEG2_MAIN, width, height, 2,
+                               &decoder));
+    ASSERT_OK(vdpVideoSurfaceCreate(device, VDP_CHROMA_TYPE_420, width, height, &surface));
+
+    VdpPictureInfoMPEG1Or2 info;
+    memset(&info, 0, sizeof(info));
+    info.forward_reference = VDP_INVALID_HANDLE;
+    info.backward_reference = VDP_INVALID_HANDLE;
+    info.slice_count = 1;
+    info.picture_structure = 3;
+    info.picture_coding_type = 1;
+    for (int k = 0; k < 4; k ++)
+        info.f_code[k / 2][k % 2] = 15;
+    for (int k = 0; k < 64; k ++) {
+        info.intra_quantizer_matrix[k] = 16;
+        info.non_intra_quantizer_matrix[k] = 16;
+    }
+
+    // slice start code, quantiser_scale_code and some junk; mock driver doesn't look inside
+    const uint8_t slice[] = {0x00, 0x00, 0x01, 0x01, 0x10, 0x55, 0xaa, 0x55};
+    VdpBitstreamBuffer bitstream = {
+        .struct_version = VDP_BITSTREAM_BUFFER_VERSION,
+        .bitstream = slice,
+        .bitstream_bytes = sizeof(slice),
+    };
+
+    ASSERT_OK(vdpDecoderRender(decoder, surface, (VdpPictureInfo *)&info, 1, &bitstream));
+
+    static uint8_t y_plane[64 * 32];
+    static uint8_t uv_plane[64 * 16];
+    void * const planes[] = { y_plane, uv_plane };
+    const uint32_t pitches[] = { width, width };
+
+    ASSERT_OK(vdpVideoSurfaceGetBitsYCbCr(surface, VDP_YCBCR_FORMAT_NV12, planes, pitches));
+
+    for (uint32_t y = 0; y < height; y ++) {
+        for (uint32_t x = 0; x < width; x ++) {
+            if (y_plane[y * width + x] != ((x + y + 1) & 0xff)) {
+                printf("luma mismatch at (%u, %u)\n", x, y);
+                return 1;
+            }
+        }
+    }
+
+    for (uint32_t k = 0; k < sizeof(uv_plane); k ++) {
+        if (uv_plane[k] != 128) {
+            printf("chroma mismatch at %u\n", k);
+            return 1;
+        }
+    }
+
+    ASSERT_OK(vdpVideoSurfaceDestroy(surface));
+    ASSERT_OK(vdpDecoderDestroy(decoder));
+    ASSERT_OK(vdpDeviceDestroy(device));
+
+    printf("pass\n");
+    return 0;
+}
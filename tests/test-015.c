@@ -0,0 +1,120 @@
+// test-015
+//
+// Capturing decoder calls. With VDPAU_CAPTURE set, creation and destruction of decoders and
+// video surfaces, and rendered pictures are written to the capture file. Decoding itself goes
+// through mock VA-API driver.
+
+#include "tests-common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static void
+expect_u32(FILE *fp, uint32_t expected, const char *what)
+{
+    uint32_t value = 0;
+
+    if (fread(&value, sizeof(value), 1, fp) != 1 || value != expected) {
+        printf("%s: expected %u, got %u\n", what, expected, value);
+        exit(1);
+    }
+}
+
+static void
+expect_bytes(FILE *fp, const void *expected, size_t size, const char *what)
+{
+    uint8_t buf[256];
+    const size_t padded_size = (size + 3) & ~(size_t)3;
+
+    if (padded_size > sizeof(buf) || fread(buf, padded_size, 1, fp) != 1 ||
+        memcmp(buf, expected, size) != 0)
+    {
+        printf("%s: contents differ\n", what);
+        exit(1);
+    }
+}
+
+int main(void)
+{
+    const char *capture_path = getenv("VDPAU_CAPTURE");
+    if (!capture_path) {
+        printf("VDPAU_CAPTURE is not set\n");
+        return 1;
+    }
+
+    VdpDevice device = create_vdp_device();
+    VdpDecoder decoder;
+    VdpVideoSurface surface;
+
+    ASSERT_OK(vdpDecoderCreate(device, VDP_DECODER_PROFILE_MPEG2_MAIN, 64, 32, 2, &decoder));
+    ASSERT_OK(vdpVideoSurfaceCreate(device, VDP_CHROMA_TYPE_420, 64, 32, &surface));
+
+    VdpPictureInfoMPEG1Or2 info;
+    memset(&info, 0, sizeof(info));
+    info.forward_reference = VDP_INVALID_HANDLE;
+    info.backward_reference = VDP_INVALID_HANDLE;
+    info.slice_count = 1;
+    info.picture_structure = 3;
+    info.picture_coding_type = 1;
+
+    const uint8_t slice[] = {0x00, 0x00, 0x01, 0x01, 0x10};
+    VdpBitstreamBuffer bitstream = {
+        .struct_version = VDP_BITSTREAM_BUFFER_VERSION,
+        .bitstream = slice,
+        .bitstream_bytes = sizeof(slice),
+    };
+
+    ASSERT_OK(vdpDecoderRender(decoder, surface, (VdpPictureInfo *)&info, 1, &bitstream));
+    ASSERT_OK(vdpVideoSurfaceDestroy(surface));
+    ASSERT_OK(vdpDecoderDestroy(decoder));
+
+    FILE *fp = fopen(capture_path, "rb");
+    if (!fp) {
+        printf("can't open %s\n", capture_path);
+        return 1;
+    }
+
+    expect_u32(fp, 0x43504456, "magic");                // 'VDPC'
+    expect_u32(fp, 1, "version");
+
+    expect_u32(fp, 0x45524344, "decoder create tag");   // 'DCRE'
+    expect_u32(fp, 5 * 4, "decoder create size");
+    expect_u32(fp, decoder, "decoder");
+    expect_u32(fp, VDP_DECODER_PROFILE_MPEG2_MAIN, "profile");
+    expect_u32(fp, 64, "decoder width");
+    expect_u32(fp, 32, "decoder height");
+    expect_u32(fp, 2, "max references");
+
+    expect_u32(fp, 0x45524353, "surface create tag");   // 'SCRE'
+    expect_u32(fp, 4 * 4, "surface create size");
+    expect_u32(fp, surface, "surface");
+    expect_u32(fp, VDP_CHROMA_TYPE_420, "chroma type");
+    expect_u32(fp, 64, "surface width");
+    expect_u32(fp, 32, "surface height");
+
+    const uint32_t padded_info_size = (sizeof(info) + 3) & ~3u;
+    expect_u32(fp, 0x4e455244, "render tag");           // 'DREN'
+    expect_u32(fp, 3 * 4 + padded_info_size + 4 + 4 + 8, "render size");
+    expect_u32(fp, decoder, "render decoder");
+    expect_u32(fp, surface, "render target");
+    expect_u32(fp, sizeof(info), "picture info size");
+    expect_bytes(fp, &info, sizeof(info), "picture info");
+    expect_u32(fp, 1, "bitstream buffer count");
+    expect_u32(fp, sizeof(slice), "bitstream buffer size");
+    expect_bytes(fp, slice, sizeof(slice), "bitstream buffer");
+
+    expect_u32(fp, 0x53454453, "surface destroy tag");  // 'SDES'
+    expect_u32(fp, 4, "surface destroy size");
+    expect_u32(fp, surface, "destroyed surface");
+
+    expect_u32(fp, 0x53454444, "decoder destroy tag");  // 'DDES'
+    expect_u32(fp, 4, "decoder destroy size");
+    expect_u32(fp, decoder, "destroyed decoder");
+
+    fclose(fp);
+
+    ASSERT_OK(vdpDeviceDestroy(device));
+    printf("pass\n");
+    return 0;
+}
@@ -0,0 +1,97 @@
+// test-016
+//
+// Video mixer parameters. Values passed on creation are reported back by GetParameterValues,
+// unknown parameters and out of range values are rejected. Mixer created with video size
+// known in advance then renders decoded picture of that size.
+
+#include "tests-common.h"
+#include <stdio.h>
+#include <string.h>
+
+
+int main(void)
+{
+    const uint32_t width = 64;
+    const uint32_t height = 32;
+    const VdpChromaType chroma_type = VDP_CHROMA_TYPE_420;
+    VdpDevice device = create_vdp_device();
+
+    const VdpVideoMixerParameter params[] = {
+        VDP_VIDEO_MIXER_PARAMETER_VIDEO_SURFACE_WIDTH,
+        VDP_VIDEO_MIXER_PARAMETER_VIDEO_SURFACE_HEIGHT,
+        VDP_VIDEO_MIXER_PARAMETER_CHROMA_TYPE,
+    };
+    const void * const param_values[] = { &width, &height, &chroma_type };
+
+    VdpVideoMixer mixer;
+    ASSERT_OK(vdpVideoMixerCreate(device, 0, NULL, 3, params, param_values, &mixer));
+
+    uint32_t got_width = 0, got_height = 0;
+    VdpChromaType got_chroma_type = ~0u;
+    void * const got_values[] = { &got_width, &got_height, &got_chroma_type };
+    ASSERT_OK(vdpVideoMixerGetParameterValues(mixer, 3, params, got_values));
+    if (got_width != width || got_height != height || got_chroma_type != chroma_type) {
+        printf("parameters mismatch: %u x %u, chroma type %u\n", got_width, got_height,
+               got_chroma_type);
+        return 1;
+    }
+
+    VdpVideoMixer mixer2;
+    const uint32_t too_large = 1000000;
+    const void * const bad_values[] = { &too_large };
+    if (vdpVideoMixerCreate(device, 0, NULL, 1, params, bad_values, &mixer2) !=
+        VDP_STATUS_INVALID_VALUE)
+    {
+        printf("out of range width accepted\n");
+        return 1;
+    }
+
+    const VdpVideoMixerParameter bad_params[] = { (VdpVideoMixerParameter)1000 };
+    if (vdpVideoMixerCreate(device, 0, NULL, 1, bad_params, param_values, &mixer2) !=
+        VDP_STATUS_INVALID_VIDEO_MIXER_PARAMETER)
+    {
+        printf("unknown parameter accepted\n");
+        return 1;
+    }
+
+    // render decoded picture through the mixer
+    VdpDecoder decoder;
+    VdpVideoSurface surface;
+    VdpOutputSurface out_surface;
+    ASSERT_OK(vdpDecoderCreate(device, VDP_DECODER_PROFILE_MPEG2_MAIN, width, height, 2,
+                               &decoder));
+    ASSERT_OK(vdpVideoSurfaceCreate(device, chroma_type, width, height, &surface));
+    ASSERT_OK(vdpOutputSurfaceCreate(device, VDP_RGBA_FORMAT_B8G8R8A8, width, height,
+                                     &out_surface));
+
+    VdpPictureInfoMPEG1Or2 info;
+    memset(&info, 0, sizeof(info));
+    info.forward_reference = VDP_INVALID_HANDLE;
+    info.backward_reference = VDP_INVALID_HANDLE;
+    info.slice_count = 1;
+    info.picture_structure = 3;
+    info.picture_coding_type = 1;
+    for (int k = 0; k < 4; k ++)
+        info.f_code[k / 2][k % 2] = 15;
+
+    const uint8_t slice[] = {0x00, 0x00, 0x01, 0x01, 0x10, 0x55, 0xaa, 0x55};
+    VdpBitstreamBuffer bitstream = {
+        .struct_version = VDP_BITSTREAM_BUFFER_VERSION,
+        .bitstream = slice,
+        .bitstream_bytes = sizeof(slice),
+    };
+
+    ASSERT_OK(vdpDecoderRender(decoder, surface, (VdpPictureInfo *)&info, 1, &bitstream));
+    ASSERT_OK(vdpVideoMixerRender(mixer, VDP_INVALID_HANDLE, NULL,
+                                  VDP_VIDEO_MIXER_PICTURE_STRUCTURE_FRAME, 0, NULL, surface, 0,
+                                  NULL, NULL, out_surface, NULL, NULL, 0, NULL));
+
+    ASSERT_OK(vdpOutputSurfaceDestroy(out_surface));
+    ASSERT_OK(vdpVideoSurfaceDestroy(surface));
+    ASSERT_OK(vdpDecoderDestroy(decoder));
+    ASSERT_OK(vdpVideoMixerDestroy(mixer));
+    ASSERT_OK(vdpDeviceDestroy(device));
+
+    printf("pass\n");
+    return 0;
+}
@@ -0,0 +1,125 @@
+// test-017
+//
+// Deinterlacing in video mixer. Video surface has white even lines and black odd lines. Top field
+// rendered with bob must become entirely white. With temporal deinterlacing the same surface
+// passed as past and future frames means there is no motion, so missing lines are taken from
+// neighbouring fields as is, and lines keep alternating, just like with progressive frame.
+
+#include "tests-common.h"
+#include <stdio.h>
+#include <string.h>
+
+
+#define WIDTH   64
+#define HEIGHT  32
+
+static uint32_t out_buf[WIDTH * HEIGHT];
+
+static int
+render_and_check(VdpVideoMixer mixer, VdpVideoMixerPictureStructure structure,
+                 VdpVideoSurface surface, VdpOutputSurface out_surface, int expect_alternating)
+{
+    ASSERT_OK(vdpVideoMixerRender(mixer, VDP_INVALID_HANDLE, NULL, structure, 1, &surface,
+                                  surface, 1, &surface, NULL, out_surface, NULL, NULL, 0, NULL));
+
+    void * const dst[] = { out_buf };
+    const uint32_t dst_pitches[] = { WIDTH * 4 };
+    ASSERT_OK(vdpOutputSurfaceGetBitsNative(out_surface, NULL, dst, dst_pitches));
+
+    // interior lines only, edge lines may have no neighbours on one side
+    for (int y = 1; y < HEIGHT - 1; y ++) {
+        for (int x = 0; x < WIDTH; x ++) {
+            const uint32_t green = (out_buf[y * WIDTH + x] >> 8) & 0xff;
+            const int bright = (green > 200);
+            const int dark = (green < 40);
+            const int ok = expect_alternating ? (bright || dark) : bright;
+
+            if (!ok) {
+                printf("unexpected value %02x at (%d, %d), structure %d\n", green, x, y,
+                       structure);
+                return 1;
+            }
+        }
+
+        const uint32_t this_line = (out_buf[y * WIDTH] >> 8) & 0xff;
+        const uint32_t next_line = (out_buf[(y + 1) * WIDTH] >> 8) & 0xff;
+        if (expect_alternating && (this_line > 128) == (next_line > 128)) {
+            printf("lines %d and %d are not alternating, structure %d\n", y, y + 1, structure);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int main(void)
+{
+    VdpDevice device = create_vdp_device();
+
+    static uint8_t y_plane[WIDTH * HEIGHT];
+    static uint8_t uv_plane[WIDTH * HEIGHT / 2];
+    for (int y = 0; y < HEIGHT; y ++)
+        memset(y_plane + y * WIDTH, (y & 1) ? 16 : 235, WIDTH);
+    memset(uv_plane, 128, sizeof(uv_plane));
+
+    const void * const planes[] = { y_plane, uv_plane };
+    const uint32_t pitches[] = { WIDTH, WIDTH };
+
+    VdpVideoSurface surface;
+    ASSERT_OK(vdpVideoSurfaceCreate(device, VDP_CHROMA_TYPE_420, WIDTH, HEIGHT, &surface));
+    ASSERT_OK(vdpVideoSurfacePutBitsYCbCr(surface, VDP_YCBCR_FORMAT_NV12, planes, pitches));
+
+    VdpOutputSurface out_surface;
+    ASSERT_OK(vdpOutputSurfaceCreate(device, VDP_RGBA_FORMAT_B8G8R8A8, WIDTH, HEIGHT,
+                                     &out_surface));
+
+    VdpBool is_supported = VDP_FALSE;
+    ASSERT_OK(vdpVideoMixerQueryFeatureSupport(device,
+                                               VDP_VIDEO_MIXER_FEATURE_DEINTERLACE_TEMPORAL,
+                                               &is_supported));
+    if (!is_supported) {
+        printf("temporal deinterlacing is not reported as supported\n");
+        return 1;
+    }
+
+    const VdpVideoMixerFeature features[] = { VDP_VIDEO_MIXER_FEATURE_DEINTERLACE_TEMPORAL };
+    VdpVideoMixer mixer;
+    ASSERT_OK(vdpVideoMixerCreate(device, 1, features, 0, NULL, NULL, &mixer));
+
+    if (render_and_check(mixer, VDP_VIDEO_MIXER_PICTURE_STRUCTURE_FRAME, surface, out_surface,
+                         1))
+    {
+        return 1;
+    }
+
+    // no deinterlacing features enabled yet, so bob is used
+    if (render_and_check(mixer, VDP_VIDEO_MIXER_PICTURE_STRUCTURE_TOP_FIELD, surface,
+                         out_surface, 0))
+    {
+        return 1;
+    }
+
+    const VdpBool enables[] = { VDP_TRUE };
+    ASSERT_OK(vdpVideoMixerSetFeatureEnables(mixer, 1, features, enables));
+
+    VdpBool got_enables[] = { VDP_FALSE };
+    ASSERT_OK(vdpVideoMixerGetFeatureEnables(mixer, 1, features, got_enables));
+    if (got_enables[0] != VDP_TRUE) {
+        printf("feature enable state is not preserved\n");
+        return 1;
+    }
+
+    if (render_and_check(mixer, VDP_VIDEO_MIXER_PICTURE_STRUCTURE_TOP_FIELD, surface,
+                         out_surface, 1))
+    {
+        return 1;
+    }
+
+    ASSERT_OK(vdpVideoMixerDestroy(mixer));
+    ASSERT_OK(vdpOutputSurfaceDestroy(out_surface));
+    ASSERT_OK(vdpVideoSurfaceDestroy(surface));
+    ASSERT_OK(vdpDeviceDestroy(device));
+
+    printf("pass\n");
+    return 0;
+}
@@ -0,0 +1,119 @@
+// test-018
+//
+// Video mixer composes background, video and layers in one Render call. Video covers right
+// three quarters of output surface, leaving green background visible at the left. Layer is
+// transparent except for its right quarter, which is opaque blue.
+
+#include "tests-common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define WIDTH   64
+#define HEIGHT  32
+
+static int
+check_color(const uint32_t *buf, int x, int y, const char *name, int expect_r, int expect_g,
+            int expect_b)
+{
+    const uint32_t pixel = buf[y * WIDTH + x];
+    const int r = (pixel >> 16) & 0xff;
+    const int g = (pixel >> 8) & 0xff;
+    const int b = pixel & 0xff;
+
+    if (abs(r - expect_r) > 8 || abs(g - expect_g) > 8 || abs(b - expect_b) > 8) {
+        printf("%s expected at (%d, %d), got %02x%02x%02x\n", name, x, y, r, g, b);
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(void)
+{
+    VdpDevice device = create_vdp_device();
+
+    // mid-gray video
+    static uint8_t y_plane[WIDTH * HEIGHT];
+    static uint8_t uv_plane[WIDTH * HEIGHT / 2];
+    memset(y_plane, 126, sizeof(y_plane));
+    memset(uv_plane, 128, sizeof(uv_plane));
+    const void * const planes[] = { y_plane, uv_plane };
+    const uint32_t pitches[] = { WIDTH, WIDTH };
+
+    VdpVideoSurface surface;
+    ASSERT_OK(vdpVideoSurfaceCreate(device, VDP_CHROMA_TYPE_420, WIDTH, HEIGHT, &surface));
+    ASSERT_OK(vdpVideoSurfacePutBitsYCbCr(surface, VDP_YCBCR_FORMAT_NV12, planes, pitches));
+
+    static uint32_t buf[WIDTH * HEIGHT];
+    const void * const src[] = { buf };
+    const uint32_t src_pitches[] = { WIDTH * 4 };
+
+    VdpOutputSurface background;
+    for (int k = 0; k < WIDTH * HEIGHT; k ++)
+        buf[k] = 0xff00ff00;
+    ASSERT_OK(vdpOutputSurfaceCreate(device, VDP_RGBA_FORMAT_B8G8R8A8, WIDTH, HEIGHT,
+                                     &background));
+    ASSERT_OK(vdpOutputSurfacePutBitsNative(background, src, src_pitches, NULL));
+
+    VdpOutputSurface layer_surface;
+    for (int k = 0; k < WIDTH * HEIGHT; k ++)
+        buf[k] = (k % WIDTH >= WIDTH * 3 / 4) ? 0xff0000ff : 0x00ff0000;
+    ASSERT_OK(vdpOutputSurfaceCreate(device, VDP_RGBA_FORMAT_B8G8R8A8, WIDTH, HEIGHT,
+                                     &layer_surface));
+    ASSERT_OK(vdpOutputSurfacePutBitsNative(layer_surface, src, src_pitches, NULL));
+
+    VdpOutputSurface out_surface;
+    ASSERT_OK(vdpOutputSurfaceCreate(device, VDP_RGBA_FORMAT_B8G8R8A8, WIDTH, HEIGHT,
+                                     &out_surface));
+
+    const VdpVideoMixerParameter params[] = { VDP_VIDEO_MIXER_PARAMETER_LAYERS };
+    const uint32_t layer_count = 1;
+    const void * const param_values[] = { &layer_count };
+    VdpVideoMixer mixer;
+    ASSERT_OK(vdpVideoMixerCreate(device, 0, NULL, 1, params, param_values, &mixer));
+
+    const VdpLayer layers[] = {{
+        .struct_version = VDP_LAYER_VERSION,
+        .source_surface = layer_surface,
+        .source_rect = NULL,
+        .destination_rect = NULL,
+    }};
+    const VdpRect video_rect = {WIDTH / 4, 0, WIDTH, HEIGHT};
+
+    ASSERT_OK(vdpVideoMixerRender(mixer, background, NULL,
+                                  VDP_VIDEO_MIXER_PICTURE_STRUCTURE_FRAME, 0, NULL, surface, 0,
+                                  NULL, NULL, out_surface, NULL, &video_rect, 1, layers));
+
+    void * const dst[] = { buf };
+    ASSERT_OK(vdpOutputSurfaceGetBitsNative(out_surface, NULL, dst, src_pitches));
+
+    const int y = HEIGHT / 2;
+    if (check_color(buf, WIDTH / 8, y, "background", 0x00, 0xff, 0x00) ||
+        check_color(buf, WIDTH / 2, y, "video", 0x80, 0x80, 0x80) ||
+        check_color(buf, WIDTH * 7 / 8, y, "layer", 0x00, 0x00, 0xff))
+    {
+        return 1;
+    }
+
+    // more layers than mixer was created for
+    const VdpLayer two_layers[] = { layers[0], layers[0] };
+    if (vdpVideoMixerRender(mixer, background, NULL, VDP_VIDEO_MIXER_PICTURE_STRUCTURE_FRAME,
+                            0, NULL, surface, 0, NULL, NULL, out_surface, NULL, &video_rect, 2,
+                            two_layers) != VDP_STATUS_INVALID_VALUE)
+    {
+        printf("layer count above LAYERS parameter accepted\n");
+        return 1;
+    }
+
+    ASSERT_OK(vdpVideoMixerDestroy(mixer));
+    ASSERT_OK(vdpOutputSurfaceDestroy(out_surface));
+    ASSERT_OK(vdpOutputSurfaceDestroy(layer_surface));
+    ASSERT_OK(vdpOutputSurfaceDestroy(background));
+    ASSERT_OK(vdpVideoSurfaceDestroy(surface));
+    ASSERT_OK(vdpDeviceDestroy(device));
+
+    printf("pass\n");
+    return 0;
+}
@@ -0,0 +1,89 @@
+// Filter weights for high quality scaling. Decoded weights of every output pixel must sum to
+// one, scaling to the same size must be identity, and downscaling must widen the kernel.
+
+#undef NDEBUG
+#include <stdio.h>
+#include <assert.h>
+#include <math.h>
+#include "../src/scaling-weights.hh"
+
+
+static float
+weight(const vdp::ScalingWeights &w, uint32_t dst_length, uint32_t out_idx, uint32_t tap)
+{
+    const uint16_t v = w.texels[(tap + 1) * dst_length + out_idx];
+    return v / 65535.0f * vdp::kScalingWeightScale + vdp::kScalingWeightBias;
+}
+
+static int32_t
+first_tap(const vdp::ScalingWeights &w, uint32_t out_idx)
+{
+    return static_cast<int32_t>(w.texels[out_idx]) - vdp::kScalingFirstTapBias;
+}
+
+static void
+test_normalized()
+{
+    const vdp::ScalingKernel kernels[] = {
+        vdp::ScalingKernel::bicubic, vdp::ScalingKernel::lanczos2, vdp::ScalingKernel::lanczos3
+    };
+    const uint32_t sizes[][2] = { {1920, 1280}, {3840, 1280}, {720, 1920}, {100, 33} };
+
+    for (auto kernel: kernels) {
+        for (const auto &size: sizes) {
+            const auto w = vdp::compute_scaling_weights(kernel, size[0], size[1]);
+            assert(w.texels.size() == (w.taps + 1) * size[1]);
+
+            for (uint32_t k = 0; k < size[1]; k ++) {
+                float sum = 0;
+                for (uint32_t j = 0; j < w.taps; j ++)
+                    sum += weight(w, size[1], k, j);
+                assert(fabsf(sum - 1.0f) < 1e-3f);
+            }
+        }
+    }
+}
+
+static void
+test_identity()
+{
+    const uint32_t length = 64;
+    const auto w = vdp::compute_scaling_weights(vdp::ScalingKernel::lanczos3, length, length);
+    assert(w.taps == 6);
+
+    for (uint32_t k = 0; k < length; k ++) {
+        const int32_t first = first_tap(w, k);
+        for (uint32_t j = 0; j < w.taps; j ++) {
+            const float expected = (first + static_cast<int32_t>(j) == static_cast<int32_t>(k))
+                                   ? 1.0f : 0.0f;
+            assert(fabsf(weight(w, length, k, j) - expected) < 1e-3f);
+        }
+    }
+}
+
+static void
+test_downscale()
+{
+    const auto up = vdp::compute_scaling_weights(vdp::ScalingKernel::bicubic, 720, 1440);
+    const auto down = vdp::compute_scaling_weights(vdp::ScalingKernel::bicubic, 1440, 720);
+    const auto huge = vdp::compute_scaling_weights(vdp::ScalingKernel::lanczos3, 4096, 64);
+
+    assert(up.taps == 4);
+    assert(down.taps == 8);
+    assert(huge.taps == vdp::kMaxScalingTaps);
+
+    // taps are centered around output pixel position in source
+    assert(first_tap(down, 0) == -3);
+    assert(first_tap(down, 100) == 197);
+}
+
+int
+main()
+{
+    test_normalized();
+    test_identity();
+    test_downscale();
+
+    printf("pass\n");
+    return 0;
+}
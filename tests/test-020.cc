@@ -0,0 +1,122 @@
+// Color space conversion matrices. Black and white levels must match range of each standard,
+// procamp must shift and desaturate, and correcting a result must equal direct conversion.
+
+#undef NDEBUG
+#include <stdio.h>
+#include <assert.h>
+#include <math.h>
+#include "../src/api-csc-matrix.hh"
+
+
+static void
+convert(const VdpCSCMatrix &m, float y, float cb, float cr, float rgb[3])
+{
+    for (int k = 0; k < 3; k ++)
+        rgb[k] = m[k][0] * y + m[k][1] * cb + m[k][2] * cr + m[k][3];
+}
+
+static void
+assert_rgb(const float rgb[3], float r, float g, float b)
+{
+    assert(fabsf(rgb[0] - r) < 1e-3f);
+    assert(fabsf(rgb[1] - g) < 1e-3f);
+    assert(fabsf(rgb[2] - b) < 1e-3f);
+}
+
+static void
+test_ranges()
+{
+    const vdp::ColorStandard standards[] = {
+        vdp::ColorStandard::bt601, vdp::ColorStandard::bt709, vdp::ColorStandard::smpte240m,
+        vdp::ColorStandard::bt2020
+    };
+
+    for (auto standard: standards) {
+        VdpCSCMatrix limited, full;
+        float rgb[3];
+
+        vdp::compute_csc_matrix(nullptr, standard, false, &limited);
+        vdp::compute_csc_matrix(nullptr, standard, true, &full);
+
+        convert(limited, 16 / 255.0f, 128 / 255.0f, 128 / 255.0f, rgb);
+        assert_rgb(rgb, 0, 0, 0);
+        convert(limited, 235 / 255.0f, 128 / 255.0f, 128 / 255.0f, rgb);
+        assert_rgb(rgb, 1, 1, 1);
+
+        convert(full, 0, 128 / 255.0f, 128 / 255.0f, rgb);
+        assert_rgb(rgb, 0, 0, 0);
+        convert(full, 1, 128 / 255.0f, 128 / 255.0f, rgb);
+        assert_rgb(rgb, 1, 1, 1);
+    }
+
+    // pure red of BT.709: Y = 0.2126, Cr = 0.5
+    VdpCSCMatrix bt709;
+    float rgb[3];
+    vdp::compute_csc_matrix(nullptr, vdp::ColorStandard::bt709, true, &bt709);
+    convert(bt709, 0.2126f, 0.5f - 0.2126f / 1.8556f + 128 / 255.0f - 0.5f,
+            1.0f + 128 / 255.0f - 0.5f, rgb);
+    assert_rgb(rgb, 1, 0, 0);
+}
+
+static void
+test_procamp()
+{
+    VdpProcamp procamp = {VDP_PROCAMP_VERSION, 0.25f, 1.0f, 1.0f, 0.0f};
+    VdpCSCMatrix plain, brighter, gray;
+    float a[3], b[3];
+
+    vdp::compute_csc_matrix(nullptr, vdp::ColorStandard::bt601, false, &plain);
+    vdp::compute_csc_matrix(&procamp, vdp::ColorStandard::bt601, false, &brighter);
+    convert(plain, 0.3f, 0.4f, 0.6f, a);
+    convert(brighter, 0.3f, 0.4f, 0.6f, b);
+    assert_rgb(b, a[0] + 0.25f, a[1] + 0.25f, a[2] + 0.25f);
+
+    // zero saturation leaves luma only
+    procamp = {VDP_PROCAMP_VERSION, 0.0f, 1.0f, 0.0f, 0.0f};
+    vdp::compute_csc_matrix(&procamp, vdp::ColorStandard::bt601, true, &gray);
+    convert(gray, 0.3f, 0.1f, 0.9f, a);
+    assert_rgb(a, 0.3f, 0.3f, 0.3f);
+
+    // GenerateCSCMatrix checks its arguments
+    assert(vdp::GenerateCSCMatrix(&procamp, VDP_COLOR_STANDARD_ITUR_BT_709, &gray) ==
+           VDP_STATUS_OK);
+    assert(vdp::GenerateCSCMatrix(&procamp, 7, &gray) == VDP_STATUS_INVALID_COLOR_STANDARD);
+    assert(vdp::GenerateCSCMatrix(&procamp, VDP_COLOR_STANDARD_ITUR_BT_709, nullptr) ==
+           VDP_STATUS_INVALID_POINTER);
+    procamp.struct_version = VDP_PROCAMP_VERSION + 1;
+    assert(vdp::GenerateCSCMatrix(&procamp, VDP_COLOR_STANDARD_ITUR_BT_709, &gray) ==
+           VDP_STATUS_INVALID_VALUE);
+}
+
+static void
+test_correction()
+{
+    VdpCSCMatrix bt601, bt709, correction;
+    float a[3], b[3];
+
+    vdp::compute_csc_matrix(nullptr, vdp::ColorStandard::bt601, false, &bt601);
+    vdp::compute_csc_matrix(nullptr, vdp::ColorStandard::bt709, true, &bt709);
+
+    vdp::compute_csc_correction(bt601, bt601, &correction);
+    assert(vdp::is_identity_csc(correction));
+
+    vdp::compute_csc_correction(bt709, bt601, &correction);
+    assert(!vdp::is_identity_csc(correction));
+
+    // correction of BT.601 result gives the same as converting with BT.709 directly
+    convert(bt601, 0.4f, 0.3f, 0.7f, a);
+    convert(correction, a[0], a[1], a[2], b);
+    convert(bt709, 0.4f, 0.3f, 0.7f, a);
+    assert_rgb(b, a[0], a[1], a[2]);
+}
+
+int
+main()
+{
+    test_ranges();
+    test_procamp();
+    test_correction();
+
+    printf("pass\n");
+    return 0;
+}
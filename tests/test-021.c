@@ -0,0 +1,128 @@
+// test-021
+//
+// Draws to output surfaces may be recorded and executed later. Checks they still are executed
+// in order, with their own blending, and see source bitmap contents as they were at the time
+// of the call:
+//
+// - bitmap filled with red is drawn over the whole of surface A;
+// - green color alone is drawn over left half of A;
+// - bitmap is refilled with blue, and drawn over the middle columns of A;
+// - bitmap is drawn over the whole of surface B;
+// - bitmap is added to the last column of A, making it magenta.
+//
+// A should become green, blue, blue, magenta in each row, and B should be all blue.
+
+#include "tests-common.h"
+#include <stdio.h>
+#include <string.h>
+
+
+static int
+check_surface(const char *name, VdpOutputSurface surface, const uint32_t *expected)
+{
+    uint32_t result[16];
+    void * const dest_data[] = { result };
+    const uint32_t dest_pitches[] = { 4 * 4 };
+    ASSERT_OK(vdpOutputSurfaceGetBitsNative(surface, NULL, dest_data, dest_pitches));
+
+    printf("=== expected %s ===\n", name);
+    for (int k = 0; k < 16; k ++) {
+        printf(" %08x", expected[k]);
+        if (k % 4 == 3) printf("\n");
+    }
+    printf("--- actual ---\n");
+    for (int k = 0; k < 16; k ++) {
+        printf(" %08x", result[k]);
+        if (k % 4 == 3) printf("\n");
+    }
+    printf("==========\n");
+
+    return memcmp(expected, result, sizeof(result)) == 0;
+}
+
+static void
+fill(uint32_t *pixels, uint32_t value)
+{
+    for (int k = 0; k < 16; k ++)
+        pixels[k] = value;
+}
+
+int main(void)
+{
+    VdpDevice device = create_vdp_device();
+    VdpBitmapSurface bmp;
+    VdpOutputSurface surf_a, surf_b;
+
+    uint32_t pixels[16];
+    const void * const source_data[] = { pixels };
+    const uint32_t source_pitches[] = { 4 * 4 };
+
+    ASSERT_OK(vdpBitmapSurfaceCreate(device, VDP_RGBA_FORMAT_B8G8R8A8, 4, 4, 0, &bmp));
+    ASSERT_OK(vdpOutputSurfaceCreate(device, VDP_RGBA_FORMAT_B8G8R8A8, 4, 4, &surf_a));
+    ASSERT_OK(vdpOutputSurfaceCreate(device, VDP_RGBA_FORMAT_B8G8R8A8, 4, 4, &surf_b));
+
+    fill(pixels, 0xff000000);
+    ASSERT_OK(vdpOutputSurfacePutBitsNative(surf_a, source_data, source_pitches, NULL));
+    ASSERT_OK(vdpOutputSurfacePutBitsNative(surf_b, source_data, source_pitches, NULL));
+
+    const VdpOutputSurfaceRenderBlendState add_blend = {
+        .struct_version =                   VDP_OUTPUT_SURFACE_RENDER_BLEND_STATE_VERSION,
+        .blend_factor_source_color =        VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE,
+        .blend_factor_destination_color =   VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE,
+        .blend_factor_source_alpha =        VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE,
+        .blend_factor_destination_alpha =   VDP_OUTPUT_SURFACE_RENDER_BLEND_FACTOR_ONE,
+        .blend_equation_color =             VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_ADD,
+        .blend_equation_alpha =             VDP_OUTPUT_SURFACE_RENDER_BLEND_EQUATION_ADD,
+        .blend_constant =                   {0, 0, 0, 0}
+    };
+
+    const VdpColor green[] = {{0, 1.0, 0, 1.0}};
+    const VdpRect left_half = {0, 0, 2, 4};
+    const VdpRect middle = {1, 0, 3, 4};
+    const VdpRect last_column = {3, 0, 4, 4};
+
+    fill(pixels, 0xffff0000);
+    ASSERT_OK(vdpBitmapSurfacePutBitsNative(bmp, source_data, source_pitches, NULL));
+    ASSERT_OK(vdpOutputSurfaceRenderBitmapSurface(surf_a, NULL, bmp, NULL, NULL, NULL,
+                                                  VDP_OUTPUT_SURFACE_RENDER_ROTATE_0));
+    ASSERT_OK(vdpOutputSurfaceRenderBitmapSurface(surf_a, &left_half, VDP_INVALID_HANDLE, NULL,
+                                                  green, NULL,
+                                                  VDP_OUTPUT_SURFACE_RENDER_ROTATE_0));
+
+    fill(pixels, 0xff0000ff);
+    ASSERT_OK(vdpBitmapSurfacePutBitsNative(bmp, source_data, source_pitches, NULL));
+    ASSERT_OK(vdpOutputSurfaceRenderBitmapSurface(surf_a, &middle, bmp, NULL, NULL, NULL,
+                                                  VDP_OUTPUT_SURFACE_RENDER_ROTATE_0));
+    ASSERT_OK(vdpOutputSurfaceRenderBitmapSurface(surf_b, NULL, bmp, NULL, NULL, NULL,
+                                                  VDP_OUTPUT_SURFACE_RENDER_ROTATE_0));
+    ASSERT_OK(vdpOutputSurfaceRenderBitmapSurface(surf_a, &last_column, bmp, NULL, NULL,
+                                                  &add_blend,
+                                                  VDP_OUTPUT_SURFACE_RENDER_ROTATE_0));
+
+    uint32_t expected_a[16];
+    for (int k = 0; k < 16; k += 4) {
+        expected_a[k + 0] = 0xff00ff00;
+        expected_a[k + 1] = 0xff0000ff;
+        expected_a[k + 2] = 0xff0000ff;
+        expected_a[k + 3] = 0xffff00ff;
+    }
+
+    uint32_t expected_b[16];
+    fill(expected_b, 0xff0000ff);
+
+    int ok = check_surface("A", surf_a, expected_a);
+    ok = check_surface("B", surf_b, expected_b) && ok;
+
+    if (!ok) {
+        printf("fail\n");
+        return 1;
+    }
+
+    ASSERT_OK(vdpOutputSurfaceDestroy(surf_b));
+    ASSERT_OK(vdpOutputSurfaceDestroy(surf_a));
+    ASSERT_OK(vdpBitmapSurfaceDestroy(bmp));
+    ASSERT_OK(vdpDeviceDestroy(device));
+
+    printf("pass\n");
+    return 0;
+}
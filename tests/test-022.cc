@@ -0,0 +1,113 @@
+// Shelf allocator of bitmap atlas. Allocated rectangles must stay within the area and never
+// overlap, and space must become available again once rectangles are released.
+
+#undef NDEBUG
+#include <stdio.h>
+#include <assert.h>
+#include <vector>
+#include "../src/bitmap-atlas.hh"
+
+
+struct Rect
+{
+    uint32_t    x, y, width, height;
+};
+
+static bool
+overlap(const Rect &a, const Rect &b)
+{
+    return a.x < b.x + b.width && b.x < a.x + a.width &&
+           a.y < b.y + b.height && b.y < a.y + a.height;
+}
+
+static void
+check_placement(const std::vector<Rect> &rects, uint32_t width, uint32_t height)
+{
+    for (size_t k = 0; k < rects.size(); k ++) {
+        assert(rects[k].x + rects[k].width <= width);
+        assert(rects[k].y + rects[k].height <= height);
+
+        for (size_t j = k + 1; j < rects.size(); j ++)
+            assert(!overlap(rects[k], rects[j]));
+    }
+}
+
+static void
+test_no_overlap()
+{
+    vdp::ShelfAllocator allocator{256, 256};
+    std::vector<Rect> rects;
+
+    for (uint32_t k = 0; ; k ++) {
+        Rect r{0, 0, 5 + (k * 7) % 20, 6 + (k * 11) % 17};
+        if (!allocator.allocate(r.width, r.height, &r.x, &r.y))
+            break;
+        rects.push_back(r);
+    }
+
+    // area is used reasonably well
+    uint32_t used = 0;
+    for (const auto &r: rects)
+        used += r.width * r.height;
+    assert(used > 256 * 256 / 2);
+
+    check_placement(rects, 256, 256);
+}
+
+static void
+test_reuse()
+{
+    vdp::ShelfAllocator allocator{64, 64};
+    std::vector<Rect> rects;
+
+    Rect r{0, 0, 16, 16};
+    while (allocator.allocate(r.width, r.height, &r.x, &r.y))
+        rects.push_back(r);
+    assert(rects.size() == 16);
+    assert(!allocator.empty());
+
+    // space of a shelf comes back once all its rectangles are released
+    for (const auto &item: rects) {
+        if (item.y == 16)
+            allocator.release(item.x, item.y);
+    }
+
+    Rect wide{0, 0, 64, 10};
+    assert(allocator.allocate(wide.width, wide.height, &wide.x, &wide.y));
+    assert(wide.y == 16);
+
+    allocator.release(wide.x, wide.y);
+    for (const auto &item: rects) {
+        if (item.y != 16)
+            allocator.release(item.x, item.y);
+    }
+    assert(allocator.empty());
+
+    // whole area is available again
+    Rect full{0, 0, 64, 64};
+    assert(allocator.allocate(full.width, full.height, &full.x, &full.y));
+    assert(full.x == 0 && full.y == 0);
+}
+
+static void
+test_too_large()
+{
+    vdp::ShelfAllocator allocator{64, 64};
+    uint32_t x, y;
+
+    assert(!allocator.allocate(65, 1, &x, &y));
+    assert(!allocator.allocate(1, 65, &x, &y));
+    assert(!allocator.allocate(0, 1, &x, &y));
+    assert(allocator.empty());
+}
+
+int
+main()
+{
+    test_no_overlap();
+    test_reuse();
+    test_too_large();
+
+    printf("pass\n");
+    return 0;
+}
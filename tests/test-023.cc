@@ -0,0 +1,86 @@
+// Content hash used to detect unchanged bitmap updates. Must match reference XXH64 values, and
+// give the same result whether data is fed at once or in arbitrary pieces.
+
+#undef NDEBUG
+#include <stdio.h>
+#include <algorithm>
+#include <assert.h>
+#include <vector>
+#include "../src/content-hash.hh"
+
+
+static uint64_t
+hash_of(const void *data, size_t size)
+{
+    vdp::ContentHash hash;
+    hash.update(data, size);
+    return hash.digest();
+}
+
+static void
+test_reference_values()
+{
+    assert(hash_of("", 0) == 0xef46db3751d8e999ULL);
+    assert(hash_of("a", 1) == 0xd24ec4f1a98c6e5bULL);
+    assert(hash_of("abc", 3) == 0x44bc2cf5ad770999ULL);
+
+    std::vector<uint8_t> data(768);
+    for (size_t k = 0; k < data.size(); k ++)
+        data[k] = k & 0xff;
+    assert(hash_of(data.data(), data.size()) == 0x8e03c838c596036fULL);
+}
+
+static void
+test_pieces()
+{
+    std::vector<uint8_t> data(1000);
+    for (size_t k = 0; k < data.size(); k ++)
+        data[k] = (k * 31 + 7) & 0xff;
+
+    const uint64_t whole = hash_of(data.data(), data.size());
+
+    for (size_t piece = 1; piece <= 70; piece ++) {
+        vdp::ContentHash hash;
+        for (size_t ofs = 0; ofs < data.size(); ofs += piece)
+            hash.update(data.data() + ofs, std::min(piece, data.size() - ofs));
+        assert(hash.digest() == whole);
+    }
+}
+
+static void
+test_rect()
+{
+    // 24x10 rect inside of 40 byte wide picture; padding must not affect the hash
+    const uint32_t pitch = 40, row_bytes = 24, rows = 10;
+    std::vector<uint8_t> picture(pitch * rows);
+    std::vector<uint8_t> packed;
+
+    for (uint32_t y = 0; y < rows; y ++) {
+        for (uint32_t x = 0; x < pitch; x ++) {
+            picture[y * pitch + x] = (x < row_bytes) ? (x * 5 + y * 3) & 0xff : 0xcc;
+            if (x < row_bytes)
+                packed.push_back(picture[y * pitch + x]);
+        }
+    }
+
+    const uint64_t h = vdp::hash_rect(picture.data(), pitch, row_bytes, rows);
+    assert(h == hash_of(packed.data(), packed.size()));
+    assert(h == vdp::hash_rect(packed.data(), row_bytes, row_bytes, rows));
+
+    picture[pitch - 1] = 0;
+    assert(h == vdp::hash_rect(picture.data(), pitch, row_bytes, rows));
+
+    picture[5 * pitch + 3] ^= 1;
+    assert(h != vdp::hash_rect(picture.data(), pitch, row_bytes, rows));
+}
+
+int
+main()
+{
+    test_reference_values();
+    test_pieces();
+    test_rect();
+
+    printf("pass\n");
+    return 0;
+}
@@ -0,0 +1,92 @@
+// Dirty region of bitmap surfaces. Rectangles must always cover everything added, adjacent and
+// contained rectangles must merge, and count of rectangles must stay within the limit.
+
+#undef NDEBUG
+#include <stdio.h>
+#include <assert.h>
+#include <vector>
+#include "../src/dirty-region.hh"
+
+
+static bool
+covered(const vdp::DirtyRegion &region, uint32_t x, uint32_t y)
+{
+    for (const auto &r: region.rects()) {
+        if (r.x0 <= x && x < r.x1 && r.y0 <= y && y < r.y1)
+            return true;
+    }
+    return false;
+}
+
+static bool
+covers_rect(const vdp::DirtyRegion &region, const VdpRect &rect)
+{
+    for (uint32_t y = rect.y0; y < rect.y1; y ++)
+        for (uint32_t x = rect.x0; x < rect.x1; x ++)
+            if (!covered(region, x, y))
+                return false;
+    return true;
+}
+
+static void
+test_merge()
+{
+    vdp::DirtyRegion region{8};
+    assert(region.empty());
+
+    region.add(VdpRect{0, 0, 0, 10});
+    assert(region.empty());
+
+    // horizontal strips of the same width become one
+    region.add(VdpRect{10, 0, 50, 4});
+    region.add(VdpRect{10, 4, 50, 8});
+    assert(region.rects().size() == 1);
+
+    // contained rectangle adds nothing
+    region.add(VdpRect{20, 2, 30, 6});
+    assert(region.rects().size() == 1);
+    const VdpRect r = region.rects()[0];
+    assert(r.x0 == 10 && r.y0 == 0 && r.x1 == 50 && r.y1 == 8);
+
+    // distant rectangle is kept separately
+    region.add(VdpRect{100, 100, 110, 110});
+    assert(region.rects().size() == 2);
+
+    // one that fills the gap between the two merges everything
+    region.add(VdpRect{10, 8, 50, 100});
+    region.add(VdpRect{50, 0, 110, 110});
+    region.add(VdpRect{10, 100, 50, 110});
+    assert(region.rects().size() == 1);
+
+    region.clear();
+    assert(region.empty());
+}
+
+static void
+test_limit()
+{
+    vdp::DirtyRegion region{4};
+    std::vector<VdpRect> added;
+
+    for (uint32_t k = 0; k < 40; k ++) {
+        const uint32_t x = (k * 37) % 200;
+        const uint32_t y = (k * 53) % 150;
+        const VdpRect rect = {x, y, x + 1 + k % 5, y + 1 + k % 3};
+        region.add(rect);
+        added.push_back(rect);
+
+        assert(region.rects().size() <= 4);
+        for (const auto &a: added)
+            assert(covers_rect(region, a));
+    }
+}
+
+int
+main()
+{
+    test_merge();
+    test_limit();
+
+    printf("pass\n");
+    return 0;
+}
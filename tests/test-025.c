@@ -0,0 +1,91 @@
+// test-025
+//
+// Frequently accessed bitmaps upload changed areas only. Checks that the whole of picture is
+// still right after partial updates between draws:
+//
+// - bitmap is filled with red and drawn;
+// - 2x2 blue square is put into bottom-right corner, and green column into first column;
+// - bitmap is drawn again, over the same surface.
+//
+// Surface should become green in the first column, blue in bottom-right corner, red elsewhere.
+
+#include "tests-common.h"
+#include <stdio.h>
+#include <string.h>
+
+
+int main(void)
+{
+    VdpDevice device = create_vdp_device();
+    VdpBitmapSurface bmp;
+    VdpOutputSurface surf;
+
+    ASSERT_OK(vdpBitmapSurfaceCreate(device, VDP_RGBA_FORMAT_B8G8R8A8, 4, 4, 1, &bmp));
+    ASSERT_OK(vdpOutputSurfaceCreate(device, VDP_RGBA_FORMAT_B8G8R8A8, 4, 4, &surf));
+
+    uint32_t pixels[16];
+    const void * const source_data[] = { pixels };
+    const uint32_t source_pitches[] = { 4 * 4 };
+
+    for (int k = 0; k < 16; k ++)
+        pixels[k] = 0xffff0000;
+    ASSERT_OK(vdpBitmapSurfacePutBitsNative(bmp, source_data, source_pitches, NULL));
+    ASSERT_OK(vdpOutputSurfaceRenderBitmapSurface(surf, NULL, bmp, NULL, NULL, NULL,
+                                                  VDP_OUTPUT_SURFACE_RENDER_ROTATE_0));
+
+    const uint32_t blue[4] = { 0xff0000ff, 0xff0000ff, 0xff0000ff, 0xff0000ff };
+    const void * const blue_data[] = { blue };
+    const uint32_t blue_pitches[] = { 2 * 4 };
+    const VdpRect corner = {2, 2, 4, 4};
+    ASSERT_OK(vdpBitmapSurfacePutBitsNative(bmp, blue_data, blue_pitches, &corner));
+
+    const uint32_t green[4] = { 0xff00ff00, 0xff00ff00, 0xff00ff00, 0xff00ff00 };
+    const void * const green_data[] = { green };
+    const uint32_t green_pitches[] = { 1 * 4 };
+    const VdpRect column = {0, 0, 1, 4};
+    ASSERT_OK(vdpBitmapSurfacePutBitsNative(bmp, green_data, green_pitches, &column));
+
+    ASSERT_OK(vdpOutputSurfaceRenderBitmapSurface(surf, NULL, bmp, NULL, NULL, NULL,
+                                                  VDP_OUTPUT_SURFACE_RENDER_ROTATE_0));
+
+    uint32_t expected[16];
+    for (int y = 0; y < 4; y ++) {
+        for (int x = 0; x < 4; x ++) {
+            uint32_t color = 0xffff0000;
+            if (x == 0)
+                color = 0xff00ff00;
+            else if (x >= 2 && y >= 2)
+                color = 0xff0000ff;
+            expected[y * 4 + x] = color;
+        }
+    }
+
+    uint32_t result[16];
+    void * const dest_data[] = { result };
+    const uint32_t dest_pitches[] = { 4 * 4 };
+    ASSERT_OK(vdpOutputSurfaceGetBitsNative(surf, NULL, dest_data, dest_pitches));
+
+    printf("=== expected ===\n");
+    for (int k = 0; k < 16; k ++) {
+        printf(" %08x", expected[k]);
+        if (k % 4 == 3) printf("\n");
+    }
+    printf("--- actual ---\n");
+    for (int k = 0; k < 16; k ++) {
+        printf(" %08x", result[k]);
+        if (k % 4 == 3) printf("\n");
+    }
+    printf("==========\n");
+
+    if (memcmp(expected, result, sizeof(result)) != 0) {
+        printf("fail\n");
+        return 1;
+    }
+
+    ASSERT_OK(vdpOutputSurfaceDestroy(surf));
+    ASSERT_OK(vdpBitmapSurfaceDestroy(bmp));
+    ASSERT_OK(vdpDeviceDestroy(device));
+
+    printf("pass\n");
+    return 0;
+}
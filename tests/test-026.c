@@ -0,0 +1,137 @@
+// test-026
+//
+// VdpOutputSurfacePutBitsIndexed with every indexed format. The same 4x2 picture, made of
+// four colors with different alpha values, is put in each format into the middle of 6x4
+// surface, and surface contents are compared to expected ones. Also checks capabilities are
+// reported for all of the formats.
+
+#include "tests-common.h"
+#include <stdio.h>
+#include <string.h>
+
+
+static const uint32_t color_table[256] = {
+    [1] = 0x00ff0000,
+    [2] = 0x0000ff00,
+    [7] = 0x000000ff,
+    [15] = 0x00ffffff,
+    [200] = 0x00123456,
+};
+
+static int
+check_format(VdpOutputSurface surface, VdpIndexedFormat format, const char *name)
+{
+    // indices and alpha values, for 8-bit and 4-bit formats
+    static const uint8_t idx8[8] = {1, 2, 7, 200, 200, 7, 2, 1};
+    static const uint8_t alpha8[8] = {0xff, 0x80, 0x00, 0xff, 0x40, 0xff, 0xff, 0x20};
+    static const uint8_t idx4[8] = {1, 2, 7, 15, 15, 7, 2, 1};
+    static const uint8_t alpha4[8] = {15, 8, 0, 15, 4, 15, 15, 2};
+
+    uint8_t picture[16];
+    for (int k = 0; k < 8; k ++) {
+        switch (format) {
+        case VDP_INDEXED_FORMAT_I8A8:
+            picture[2 * k] = idx8[k];
+            picture[2 * k + 1] = alpha8[k];
+            break;
+        case VDP_INDEXED_FORMAT_A8I8:
+            picture[2 * k] = alpha8[k];
+            picture[2 * k + 1] = idx8[k];
+            break;
+        case VDP_INDEXED_FORMAT_I4A4:
+            picture[k] = (alpha4[k] << 4) | idx4[k];
+            break;
+        case VDP_INDEXED_FORMAT_A4I4:
+            picture[k] = (idx4[k] << 4) | alpha4[k];
+            break;
+        }
+    }
+
+    const int wide = (format == VDP_INDEXED_FORMAT_I8A8 || format == VDP_INDEXED_FORMAT_A8I8);
+
+    uint32_t background[24];
+    for (int k = 0; k < 24; k ++)
+        background[k] = 0xff808080;
+    const void * const background_data[] = { background };
+    const uint32_t background_pitches[] = { 6 * 4 };
+    ASSERT_OK(vdpOutputSurfacePutBitsNative(surface, background_data, background_pitches, NULL));
+
+    const void * const source_data[] = { picture };
+    const uint32_t source_pitches[] = { wide ? 4 * 2 : 4 };
+    const VdpRect dst_rect = {1, 1, 5, 3};
+    ASSERT_OK(vdpOutputSurfacePutBitsIndexed(surface, format, source_data, source_pitches,
+                                             &dst_rect, VDP_COLOR_TABLE_FORMAT_B8G8R8X8,
+                                             color_table));
+
+    uint32_t expected[24];
+    memcpy(expected, background, sizeof(expected));
+    for (int k = 0; k < 8; k ++) {
+        const int x = 1 + k % 4;
+        const int y = 1 + k / 4;
+        const uint32_t idx = wide ? idx8[k] : idx4[k];
+        const uint32_t alpha = wide ? alpha8[k] : alpha4[k] * 0x11;
+        expected[y * 6 + x] = (color_table[idx] & 0x00ffffff) | (alpha << 24);
+    }
+
+    uint32_t result[24];
+    void * const dest_data[] = { result };
+    const uint32_t dest_pitches[] = { 6 * 4 };
+    ASSERT_OK(vdpOutputSurfaceGetBitsNative(surface, NULL, dest_data, dest_pitches));
+
+    printf("=== expected %s ===\n", name);
+    for (int k = 0; k < 24; k ++) {
+        printf(" %08x", expected[k]);
+        if (k % 6 == 5) printf("\n");
+    }
+    printf("--- actual ---\n");
+    for (int k = 0; k < 24; k ++) {
+        printf(" %08x", result[k]);
+        if (k % 6 == 5) printf("\n");
+    }
+    printf("==========\n");
+
+    return memcmp(expected, result, sizeof(result)) == 0;
+}
+
+int main(void)
+{
+    VdpDevice device = create_vdp_device();
+    VdpOutputSurface surface;
+
+    ASSERT_OK(vdpOutputSurfaceCreate(device, VDP_RGBA_FORMAT_B8G8R8A8, 6, 4, &surface));
+
+    static const struct {
+        VdpIndexedFormat    format;
+        const char         *name;
+    } formats[] = {
+        {VDP_INDEXED_FORMAT_A4I4, "A4I4"},
+        {VDP_INDEXED_FORMAT_I4A4, "I4A4"},
+        {VDP_INDEXED_FORMAT_A8I8, "A8I8"},
+        {VDP_INDEXED_FORMAT_I8A8, "I8A8"},
+    };
+
+    int ok = 1;
+    for (size_t k = 0; k < sizeof(formats) / sizeof(formats[0]); k ++) {
+        VdpBool is_supported = 0;
+        ASSERT_OK(vdpOutputSurfaceQueryPutBitsIndexedCapabilities(
+            device, VDP_RGBA_FORMAT_B8G8R8A8, formats[k].format, VDP_COLOR_TABLE_FORMAT_B8G8R8X8,
+            &is_supported));
+        if (!is_supported) {
+            printf("%s is not supported\n", formats[k].name);
+            ok = 0;
+        }
+
+        ok = check_format(surface, formats[k].format, formats[k].name) && ok;
+    }
+
+    if (!ok) {
+        printf("fail\n");
+        return 1;
+    }
+
+    ASSERT_OK(vdpOutputSurfaceDestroy(surface));
+    ASSERT_OK(vdpDeviceDestroy(device));
+
+    printf("pass\n");
+    return 0;
+}
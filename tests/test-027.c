@@ -0,0 +1,148 @@
+// test-027
+//
+// VdpOutputSurfacePutBitsYCbCr with NV12 and YV12 pictures. 4x2 picture is put into the middle
+// of 6x4 surface with a matrix which passes Y, Cb, and Cr to R, G, and B unchanged, so surface
+// contents show exactly which samples ended up where. Also checks capabilities are reported,
+// and that NULL matrix gives the same picture as the one from VdpGenerateCSCMatrix(NULL, BT.601).
+
+#include "tests-common.h"
+#include <stdio.h>
+#include <string.h>
+
+
+static int
+check_format(VdpOutputSurface surface, VdpYCbCrFormat format, const char *name)
+{
+    static const uint8_t luma[8] = {0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70, 0x80};
+    static const uint8_t cb[2] = {0xa0, 0xb0};
+    static const uint8_t cr[2] = {0xc0, 0xd0};
+    const VdpCSCMatrix pass_through = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}};
+
+    uint8_t nv12_chroma[4] = {cb[0], cr[0], cb[1], cr[1]};
+    const void *source_data[3] = {luma, nv12_chroma, NULL};
+    uint32_t source_pitches[3] = {4, 4, 0};
+
+    if (format == VDP_YCBCR_FORMAT_YV12) {
+        // V plane goes first
+        source_data[1] = cr;
+        source_data[2] = cb;
+        source_pitches[1] = 2;
+        source_pitches[2] = 2;
+    }
+
+    uint32_t background[24];
+    for (int k = 0; k < 24; k ++)
+        background[k] = 0xff000000;
+    const void * const background_data[] = { background };
+    const uint32_t background_pitches[] = { 6 * 4 };
+    ASSERT_OK(vdpOutputSurfacePutBitsNative(surface, background_data, background_pitches, NULL));
+
+    const VdpRect dst_rect = {1, 1, 5, 3};
+    ASSERT_OK(vdpOutputSurfacePutBitsYCbCr(surface, format, source_data, source_pitches,
+                                           &dst_rect, &pass_through));
+
+    uint32_t expected[24];
+    memcpy(expected, background, sizeof(expected));
+    for (int k = 0; k < 8; k ++) {
+        const int x = k % 4;
+        const int y = k / 4;
+        expected[(y + 1) * 6 + x + 1] = 0xff000000 | (luma[k] << 16) | (cb[x / 2] << 8) |
+                                        cr[x / 2];
+    }
+
+    uint32_t result[24];
+    void * const dest_data[] = { result };
+    const uint32_t dest_pitches[] = { 6 * 4 };
+    ASSERT_OK(vdpOutputSurfaceGetBitsNative(surface, NULL, dest_data, dest_pitches));
+
+    printf("=== expected %s ===\n", name);
+    for (int k = 0; k < 24; k ++) {
+        printf(" %08x", expected[k]);
+        if (k % 6 == 5) printf("\n");
+    }
+    printf("--- actual ---\n");
+    for (int k = 0; k < 24; k ++) {
+        printf(" %08x", result[k]);
+        if (k % 6 == 5) printf("\n");
+    }
+    printf("==========\n");
+
+    return memcmp(expected, result, sizeof(result)) == 0;
+}
+
+static int
+check_default_matrix(VdpOutputSurface surface)
+{
+    // luma and chroma close to studio range limits, where full range matrix would differ most
+    static const uint8_t luma[8] = {0x10, 0x20, 0x80, 0xeb, 0x10, 0x40, 0xc0, 0xeb};
+    static const uint8_t chroma[4] = {0x10, 0xf0, 0xf0, 0x10};
+    const void *source_data[2] = {luma, chroma};
+    const uint32_t source_pitches[2] = {4, 4};
+    const VdpRect dst_rect = {1, 1, 5, 3};
+
+    VdpCSCMatrix generated;
+    ASSERT_OK(vdpGenerateCSCMatrix(NULL, VDP_COLOR_STANDARD_ITUR_BT_601, &generated));
+
+    uint32_t with_null[24];
+    uint32_t with_generated[24];
+    void * const dest_null[] = { with_null };
+    void * const dest_generated[] = { with_generated };
+    const uint32_t dest_pitches[] = { 6 * 4 };
+
+    ASSERT_OK(vdpOutputSurfacePutBitsYCbCr(surface, VDP_YCBCR_FORMAT_NV12, source_data,
+                                           source_pitches, &dst_rect, NULL));
+    ASSERT_OK(vdpOutputSurfaceGetBitsNative(surface, NULL, dest_null, dest_pitches));
+
+    ASSERT_OK(vdpOutputSurfacePutBitsYCbCr(surface, VDP_YCBCR_FORMAT_NV12, source_data,
+                                           source_pitches, &dst_rect, &generated));
+    ASSERT_OK(vdpOutputSurfaceGetBitsNative(surface, NULL, dest_generated, dest_pitches));
+
+    if (memcmp(with_null, with_generated, sizeof(with_null)) != 0) {
+        printf("NULL matrix differs from generated BT.601 one\n");
+        return 0;
+    }
+
+    return 1;
+}
+
+int main(void)
+{
+    VdpDevice device = create_vdp_device();
+    VdpOutputSurface surface;
+
+    ASSERT_OK(vdpOutputSurfaceCreate(device, VDP_RGBA_FORMAT_B8G8R8A8, 6, 4, &surface));
+
+    static const struct {
+        VdpYCbCrFormat  format;
+        const char     *name;
+    } formats[] = {
+        {VDP_YCBCR_FORMAT_NV12, "NV12"},
+        {VDP_YCBCR_FORMAT_YV12, "YV12"},
+    };
+
+    int ok = 1;
+    for (size_t k = 0; k < sizeof(formats) / sizeof(formats[0]); k ++) {
+        VdpBool is_supported = 0;
+        ASSERT_OK(vdpOutputSurfaceQueryPutBitsYCbCrCapabilities(
+            device, VDP_RGBA_FORMAT_B8G8R8A8, formats[k].format, &is_supported));
+        if (!is_supported) {
+            printf("%s is not supported\n", formats[k].name);
+            ok = 0;
+        }
+
+        ok = check_format(surface, formats[k].format, formats[k].name) && ok;
+    }
+
+    ok = check_default_matrix(surface) && ok;
+
+    if (!ok) {
+        printf("fail\n");
+        return 1;
+    }
+
+    ASSERT_OK(vdpOutputSurfaceDestroy(surface));
+    ASSERT_OK(vdpDeviceDestroy(device));
+
+    printf("pass\n");
+    return 0;
+}
@@ -0,0 +1,375 @@
+// vdpau-replay
+//
+// Replays decoder calls captured with VDPAU_CAPTURE environment variable (see
+// src/decoder-capture.hh for file format) at full speed, and reports latency percentiles of
+// VdpDecoderRender calls.
+//
+// usage: vdpau-replay <capture file> [repetitions]
+
+#include "tests-common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define CAPTURE_MAGIC           0x43504456u     // 'VDPC'
+#define CAPTURE_VERSION         1u
+#define TAG_SURFACE_CREATE      0x45524353u     // 'SCRE'
+#define TAG_SURFACE_DESTROY     0x53454453u     // 'SDES'
+#define TAG_DECODER_CREATE      0x45524344u     // 'DCRE'
+#define TAG_DECODER_DESTROY     0x53454444u     // 'DDES'
+#define TAG_DECODER_RENDER      0x4e455244u     // 'DREN'
+
+#define MAX_BITSTREAM_BUFFERS   256
+
+// maps handles of capturing process to handles of this one
+struct handle_map {
+    uint32_t    captured[4096];
+    uint32_t    replayed[4096];
+    uint32_t    profile[4096];
+    size_t      count;
+};
+
+static struct handle_map surfaces;
+static struct handle_map decoders;
+
+static double *latencies;
+static size_t latency_count;
+static size_t latency_capacity;
+
+static int
+find_handle(const struct handle_map *map, uint32_t captured)
+{
+    for (size_t k = 0; k < map->count; k ++) {
+        if (map->captured[k] == captured)
+            return k;
+    }
+
+    return -1;
+}
+
+static void
+add_handle(struct handle_map *map, uint32_t captured, uint32_t replayed, uint32_t profile)
+{
+    if (map->count >= sizeof(map->captured) / sizeof(map->captured[0])) {
+        fprintf(stderr, "too many live handles\n");
+        exit(1);
+    }
+
+    map->captured[map->count] = captured;
+    map->replayed[map->count] = replayed;
+    map->profile[map->count] = profile;
+    map->count += 1;
+}
+
+static void
+remove_handle(struct handle_map *map, int idx)
+{
+    map->count -= 1;
+    map->captured[idx] = map->captured[map->count];
+    map->replayed[idx] = map->replayed[map->count];
+    map->profile[idx] = map->profile[map->count];
+}
+
+static void
+remap_surface(VdpVideoSurface *surface)
+{
+    if (*surface == VDP_INVALID_HANDLE)
+        return;
+
+    const int idx = find_handle(&surfaces, *surface);
+    *surface = (idx >= 0) ? surfaces.replayed[idx] : VDP_INVALID_HANDLE;
+}
+
+// picture info refers to reference surfaces by handles, which are different in this process
+static void
+remap_picture_info(uint32_t profile, void *info)
+{
+    switch (profile) {
+    case VDP_DECODER_PROFILE_MPEG1:
+    case VDP_DECODER_PROFILE_MPEG2_SIMPLE:
+    case VDP_DECODER_PROFILE_MPEG2_MAIN:
+        remap_surface(&((VdpPictureInfoMPEG1Or2 *)info)->forward_reference);
+        remap_surface(&((VdpPictureInfoMPEG1Or2 *)info)->backward_reference);
+        break;
+
+    case VDP_DECODER_PROFILE_H264_CONSTRAINED_BASELINE:
+    case VDP_DECODER_PROFILE_H264_BASELINE:
+    case VDP_DECODER_PROFILE_H264_MAIN:
+    case VDP_DECODER_PROFILE_H264_HIGH:
+        for (int k = 0; k < 16; k ++)
+            remap_surface(&((VdpPictureInfoH264 *)info)->referenceFrames[k].surface);
+        break;
+
+    case VDP_DECODER_PROFILE_VC1_SIMPLE:
+    case VDP_DECODER_PROFILE_VC1_MAIN:
+    case VDP_DECODER_PROFILE_VC1_ADVANCED:
+        remap_surface(&((VdpPictureInfoVC1 *)info)->forward_reference);
+        remap_surface(&((VdpPictureInfoVC1 *)info)->backward_reference);
+        break;
+
+    case VDP_DECODER_PROFILE_HEVC_MAIN:
+    case VDP_DECODER_PROFILE_HEVC_MAIN_10:
+        for (int k = 0; k < 16; k ++)
+            remap_surface(&((VdpPictureInfoHEVC *)info)->RefPics[k]);
+        break;
+    }
+}
+
+static void
+add_latency(double value)
+{
+    if (latency_count == latency_capacity) {
+        latency_capacity = latency_capacity ? latency_capacity * 2 : 1024;
+        latencies = realloc(latencies, latency_capacity * sizeof(latencies[0]));
+        if (!latencies) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+
+    latencies[latency_count ++] = value;
+}
+
+static int
+compare_doubles(const void *a, const void *b)
+{
+    const double da = *(const double *)a;
+    const double db = *(const double *)b;
+
+    return (da > db) - (da < db);
+}
+
+static double
+percentile(double p)
+{
+    size_t idx = (size_t)(p / 100.0 * latency_count);
+
+    if (idx >= latency_count)
+        idx = latency_count - 1;
+
+    return latencies[idx];
+}
+
+static const uint32_t *
+take_u32(const uint8_t **pos, const uint8_t *end, size_t count)
+{
+    if ((size_t)(end - *pos) < count * 4) {
+        fprintf(stderr, "truncated record\n");
+        exit(1);
+    }
+
+    const uint32_t *res = (const uint32_t *)*pos;
+    *pos += count * 4;
+    return res;
+}
+
+static void
+render_picture(const uint8_t *pos, const uint8_t *end)
+{
+    const uint32_t *hdr = take_u32(&pos, end, 3);
+    const int decoder_idx = find_handle(&decoders, hdr[0]);
+    const int target_idx = find_handle(&surfaces, hdr[1]);
+    const uint32_t info_size = hdr[2];
+
+    if (decoder_idx < 0 || target_idx < 0) {
+        fprintf(stderr, "picture refers to unknown decoder or surface, skipping\n");
+        return;
+    }
+
+    union {
+        VdpPictureInfoMPEG1Or2  mpeg;
+        VdpPictureInfoH264      h264;
+        VdpPictureInfoVC1       vc1;
+        VdpPictureInfoHEVC      hevc;
+    } info;
+
+    if (info_size > sizeof(info)) {
+        fprintf(stderr, "picture info is too large\n");
+        exit(1);
+    }
+
+    const uint32_t padded_info_size = (info_size + 3) & ~3u;
+    memcpy(&info, take_u32(&pos, end, padded_info_size / 4), info_size);
+    remap_picture_info(decoders.profile[decoder_idx], &info);
+
+    const uint32_t buffer_count = *take_u32(&pos, end, 1);
+    VdpBitstreamBuffer buffers[MAX_BITSTREAM_BUFFERS];
+
+    if (buffer_count > MAX_BITSTREAM_BUFFERS) {
+        fprintf(stderr, "too many bitstream buffers\n");
+        exit(1);
+    }
+
+    for (uint32_t k = 0; k < buffer_count; k ++) {
+        const uint32_t size = *take_u32(&pos, end, 1);
+
+        buffers[k].struct_version = VDP_BITSTREAM_BUFFER_VERSION;
+        buffers[k].bitstream_bytes = size;
+        buffers[k].bitstream = take_u32(&pos, end, (size + 3) / 4);
+    }
+
+    struct timespec t_start, t_end;
+
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    const VdpStatus status = vdpDecoderRender(decoders.replayed[decoder_idx],
+                                              surfaces.replayed[target_idx],
+                                              (VdpPictureInfo *)&info, buffer_count, buffers);
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+    if (status != VDP_STATUS_OK)
+        fprintf(stderr, "VdpDecoderRender failed, %s\n", vdpGetErrorString(status));
+
+    add_latency((t_end.tv_sec - t_start.tv_sec) * 1.0e3 +
+                (t_end.tv_nsec - t_start.tv_nsec) / 1.0e6);
+}
+
+static void
+replay(VdpDevice device, const uint8_t *data, size_t size)
+{
+    const uint8_t *pos = data;
+    const uint8_t *end = data + size;
+    const uint32_t *header = take_u32(&pos, end, 2);
+
+    if (header[0] != CAPTURE_MAGIC || header[1] != CAPTURE_VERSION) {
+        fprintf(stderr, "not a capture file, or unsupported version\n");
+        exit(1);
+    }
+
+    while (pos < end) {
+        const uint32_t *rec = take_u32(&pos, end, 2);
+        const uint32_t tag = rec[0];
+        const uint32_t payload_size = rec[1];
+
+        if ((size_t)(end - pos) < payload_size) {
+            fprintf(stderr, "truncated record\n");
+            exit(1);
+        }
+
+        const uint8_t *payload = pos;
+        const uint8_t *payload_end = pos + payload_size;
+        const uint32_t *f;
+        uint32_t handle;
+        int idx;
+
+        pos = payload_end;
+
+        switch (tag) {
+        case TAG_SURFACE_CREATE:
+            f = take_u32(&payload, payload_end, 4);
+            ASSERT_OK(vdpVideoSurfaceCreate(device, f[1], f[2], f[3], &handle));
+            add_handle(&surfaces, f[0], handle, 0);
+            break;
+
+        case TAG_SURFACE_DESTROY:
+            f = take_u32(&payload, payload_end, 1);
+            idx = find_handle(&surfaces, f[0]);
+            if (idx >= 0) {
+                ASSERT_OK(vdpVideoSurfaceDestroy(surfaces.replayed[idx]));
+                remove_handle(&surfaces, idx);
+            }
+            break;
+
+        case TAG_DECODER_CREATE:
+            f = take_u32(&payload, payload_end, 5);
+            if (vdpDecoderCreate(device, f[1], f[2], f[3], f[4], &handle) != VDP_STATUS_OK) {
+                fprintf(stderr, "can't create decoder\n");
+                exit(1);
+            }
+            add_handle(&decoders, f[0], handle, f[1]);
+            break;
+
+        case TAG_DECODER_DESTROY:
+            f = take_u32(&payload, payload_end, 1);
+            idx = find_handle(&decoders, f[0]);
+            if (idx >= 0) {
+                ASSERT_OK(vdpDecoderDestroy(decoders.replayed[idx]));
+                remove_handle(&decoders, idx);
+            }
+            break;
+
+        case TAG_DECODER_RENDER:
+            render_picture(payload, payload_end);
+            break;
+
+        default:
+            // unknown records are skipped, so newer captures are still usable
+            break;
+        }
+    }
+
+    // capture may end abruptly
+    while (decoders.count > 0) {
+        ASSERT_OK(vdpDecoderDestroy(decoders.replayed[0]));
+        remove_handle(&decoders, 0);
+    }
+
+    while (surfaces.count > 0) {
+        ASSERT_OK(vdpVideoSurfaceDestroy(surfaces.replayed[0]));
+        remove_handle(&surfaces, 0);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <capture file> [repetitions]\n", argv[0]);
+        return 2;
+    }
+
+    const int rep_count = (argc >= 3) ? atoi(argv[2]) : 1;
+
+    FILE *fp = fopen(argv[1], "rb");
+    if (!fp) {
+        fprintf(stderr, "can't open %s\n", argv[1]);
+        return 1;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    const long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    // buffer is 4-byte aligned, as all records are
+    uint32_t *data = malloc(size + 4);
+    if (!data || fread(data, 1, size, fp) != (size_t)size) {
+        fprintf(stderr, "can't read %s\n", argv[1]);
+        return 1;
+    }
+
+    fclose(fp);
+
+    VdpDevice device = create_vdp_device();
+    struct timespec t_start, t_end;
+
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    for (int k = 0; k < rep_count; k ++)
+        replay(device, (const uint8_t *)data, size);
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+    ASSERT_OK(vdpDeviceDestroy(device));
+    free(data);
+
+    if (latency_count == 0) {
+        printf("no pictures in capture\n");
+        return 0;
+    }
+
+    const double duration = t_end.tv_sec - t_start.tv_sec +
+                            (t_end.tv_nsec - t_start.tv_nsec) / 1.0e9;
+    double total = 0;
+
+    for (size_t k = 0; k < latency_count; k ++)
+        total += latencies[k];
+
+    qsort(latencies, latency_count, sizeof(latencies[0]), compare_doubles);
+
+    printf("%zu pictures in %.3f s, %.1f per sec\n", latency_count, duration,
+           latency_count / duration);
+    printf("VdpDecoderRender latency, ms: mean %.3f, p50 %.3f, p90 %.3f, p99 %.3f, max %.3f\n",
+           total / latency_count, percentile(50), percentile(90), percentile(99),
+           latencies[latency_count - 1]);
+
+    free(latencies);
+    return 0;
+}